@@ -0,0 +1,71 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "blake2.h"
+
+/* RFC 9106, section 5 */
+static const uint8_t argon2_kat[3][32] =
+{
+  {
+    0x51, 0x2b, 0x39, 0x1b, 0x6f, 0x11, 0x62, 0x97, 0x53, 0x71, 0xd3, 0x09, 0x19, 0x73, 0x42, 0x94,
+    0xf8, 0x68, 0xe3, 0xbe, 0x39, 0x84, 0xf3, 0xc1, 0xa1, 0x3a, 0x4d, 0xb9, 0xfa, 0xbe, 0x4a, 0xcb
+  },
+  {
+    0xc8, 0x14, 0xd9, 0xd1, 0xdc, 0x7f, 0x37, 0xaa, 0x13, 0xf0, 0xd7, 0x7f, 0x24, 0x94, 0xbd, 0xa1,
+    0xc8, 0xde, 0x6b, 0x01, 0x6d, 0xd3, 0x88, 0xd2, 0x99, 0x52, 0xa4, 0xc4, 0x67, 0x2b, 0x6c, 0xe8
+  },
+  {
+    0x0d, 0x64, 0x0d, 0xf5, 0x8d, 0x78, 0x76, 0x6c, 0x08, 0xc0, 0x37, 0xa3, 0x4a, 0x8b, 0x53, 0xc9,
+    0xd0, 0x1e, 0xf0, 0x45, 0x2d, 0x75, 0xb6, 0x5e, 0xb5, 0x25, 0x20, 0xe9, 0x6b, 0x01, 0xe6, 0x59
+  }
+};
+
+int main( int argc, char **argv )
+{
+  uint8_t pwd[32], salt[16], secret[8], ad[12];
+  blake2_argon2_param P[1];
+
+  memset( pwd, 0x01, sizeof( pwd ) );
+  memset( salt, 0x02, sizeof( salt ) );
+  memset( secret, 0x03, sizeof( secret ) );
+  memset( ad, 0x04, sizeof( ad ) );
+
+  P->pwd = pwd;
+  P->pwdlen = sizeof( pwd );
+  P->salt = salt;
+  P->saltlen = sizeof( salt );
+  P->secret = secret;
+  P->secretlen = sizeof( secret );
+  P->ad = ad;
+  P->adlen = sizeof( ad );
+  P->t_cost = 3;
+  P->m_cost = 32;
+  P->lanes = 4;
+
+  for( uint32_t type = BLAKE2_ARGON2D; type <= BLAKE2_ARGON2ID; ++type )
+  {
+    uint8_t tag[32];
+    P->type = type;
+
+    if( blake2_argon2( tag, sizeof( tag ), P ) < 0 ||
+        0 != memcmp( tag, argon2_kat[type], sizeof( tag ) ) )
+    {
+      puts( "error" );
+      return -1;
+    }
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,513 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include "blake2-config.h"
+#include <emmintrin.h>
+#if defined(HAVE_SSSE3)
+#include <tmmintrin.h>
+#endif
+#if defined(HAVE_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(HAVE_XOP) && !defined(_MSC_VER)
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
+#include "blamka-round.h"
+
+#define ARGON2_QWORDS_IN_BLOCK ( BLAKE2_ARGON2_BLOCKBYTES / 8 )
+#define ARGON2_ADDRESSES_IN_BLOCK 128
+#define ARGON2_PREHASH_BYTES ( BLAKE2B_OUTBYTES + 8 )
+
+/* Allocations this large are aligned so transparent huge pages can back them */
+#define HUGE_PAGE_BYTES ( 2 * 1024 * 1024 )
+
+typedef struct __argon2_block
+{
+  uint64_t v[ARGON2_QWORDS_IN_BLOCK];
+} argon2_block;
+
+typedef struct __argon2_instance
+{
+  argon2_block *memory;
+  uint32_t passes;
+  uint32_t memory_blocks;
+  uint32_t segment_length;
+  uint32_t lane_length;
+  uint32_t lanes;
+  uint32_t type;
+} argon2_instance;
+
+/* next = P(prev ^ ref) ^ prev ^ ref, additionally xored into next on later passes */
+#if defined(HAVE_AVX512F)
+static inline void blamka_transpose( __m512i *d, size_t ds, const __m512i *s, size_t ss )
+{
+  const __m512i i0 = _mm512_setr_epi64( 0, 1,  8,  9, 4, 5, 12, 13 );
+  const __m512i i1 = _mm512_setr_epi64( 2, 3, 10, 11, 6, 7, 14, 15 );
+  const __m512i i2 = _mm512_setr_epi64( 0, 1,  2,  3, 8, 9, 10, 11 );
+  const __m512i i3 = _mm512_setr_epi64( 4, 5,  6,  7, 12, 13, 14, 15 );
+  __m512i a[8], b[8];
+
+  for( size_t i = 0; i < 8; i += 2 )
+  {
+    a[i + 0] = _mm512_unpacklo_epi64( s[i * ss], s[( i + 1 ) * ss] );
+    a[i + 1] = _mm512_unpackhi_epi64( s[i * ss], s[( i + 1 ) * ss] );
+  }
+
+  for( size_t i = 0; i < 8; i += 4 )
+  {
+    b[i + 0] = _mm512_permutex2var_epi64( a[i + 0], i0, a[i + 2] );
+    b[i + 1] = _mm512_permutex2var_epi64( a[i + 1], i0, a[i + 3] );
+    b[i + 2] = _mm512_permutex2var_epi64( a[i + 0], i1, a[i + 2] );
+    b[i + 3] = _mm512_permutex2var_epi64( a[i + 1], i1, a[i + 3] );
+  }
+
+  for( size_t i = 0; i < 4; ++i )
+  {
+    d[( i + 0 ) * ds] = _mm512_permutex2var_epi64( b[i], i2, b[i + 4] );
+    d[( i + 4 ) * ds] = _mm512_permutex2var_epi64( b[i], i3, b[i + 4] );
+  }
+}
+
+/* Rows and columns are transposed into lanes, so each pass is 8 permutations side by side */
+static void fill_block( const argon2_block *prev, const argon2_block *ref, argon2_block *next, int with_xor )
+{
+  const __m512i lo = _mm512_setr_epi64( 0, 8, 1,  9, 2, 10, 3, 11 );
+  const __m512i hi = _mm512_setr_epi64( 4, 12, 5, 13, 6, 14, 7, 15 );
+  __m512i r[16], x[16], v[16], w[16];
+
+  for( size_t i = 0; i < 16; ++i )
+  {
+    r[i] = _mm512_xor_si512( _mm512_loadu_si512( prev->v + 8 * i ), _mm512_loadu_si512( ref->v + 8 * i ) );
+    x[i] = with_xor ? _mm512_xor_si512( r[i], _mm512_loadu_si512( next->v + 8 * i ) ) : r[i];
+  }
+
+  blamka_transpose( v + 0, 1, r + 0, 2 );
+  blamka_transpose( v + 8, 1, r + 1, 2 );
+  BLAMKA_ROUND( v );
+  blamka_transpose( w + 0, 2, v + 0, 2 );
+  blamka_transpose( w + 1, 2, v + 1, 2 );
+  BLAMKA_ROUND( w );
+
+  for( size_t i = 0; i < 16; i += 2 )
+  {
+    _mm512_storeu_si512( next->v + 8 * i, _mm512_xor_si512( x[i], _mm512_permutex2var_epi64( w[i], lo, w[i + 1] ) ) );
+    _mm512_storeu_si512( next->v + 8 * i + 8, _mm512_xor_si512( x[i + 1], _mm512_permutex2var_epi64( w[i], hi, w[i + 1] ) ) );
+  }
+}
+#elif defined(HAVE_AVX2)
+static void fill_block( const argon2_block *prev, const argon2_block *ref, argon2_block *next, int with_xor )
+{
+  const __m256i r16 = _mm256_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m256i r24 = _mm256_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+  __m256i s[32], x[32];
+  __m256i t0, t1;
+
+  for( size_t i = 0; i < 32; ++i )
+  {
+    s[i] = _mm256_xor_si256( _mm256_loadu_si256( ( const __m256i * )prev->v + i ),
+                             _mm256_loadu_si256( ( const __m256i * )ref->v + i ) );
+    x[i] = with_xor ? _mm256_xor_si256( s[i], _mm256_loadu_si256( ( const __m256i * )next->v + i ) ) : s[i];
+  }
+
+  for( size_t i = 0; i < 4; ++i )
+  {
+    BLAMKA_ROUND_1( s[8 * i + 0], s[8 * i + 4], s[8 * i + 1], s[8 * i + 5],
+                    s[8 * i + 2], s[8 * i + 6], s[8 * i + 3], s[8 * i + 7] );
+  }
+
+  for( size_t i = 0; i < 4; ++i )
+  {
+    BLAMKA_ROUND_2( s[ 0 + i], s[ 4 + i], s[ 8 + i], s[12 + i],
+                    s[16 + i], s[20 + i], s[24 + i], s[28 + i] );
+  }
+
+  for( size_t i = 0; i < 32; ++i )
+    _mm256_storeu_si256( ( __m256i * )next->v + i, _mm256_xor_si256( s[i], x[i] ) );
+}
+#elif defined(HAVE_SSE2)
+static void fill_block( const argon2_block *prev, const argon2_block *ref, argon2_block *next, int with_xor )
+{
+#if defined(HAVE_SSSE3) && !defined(HAVE_XOP)
+  const __m128i r16 = _mm_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m128i r24 = _mm_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+#endif
+  __m128i s[64], x[64];
+  __m128i t0, t1;
+
+  for( size_t i = 0; i < 64; ++i )
+  {
+    s[i] = _mm_xor_si128( LOADU( prev->v + 2 * i ), LOADU( ref->v + 2 * i ) );
+    x[i] = with_xor ? _mm_xor_si128( s[i], LOADU( next->v + 2 * i ) ) : s[i];
+  }
+
+  for( size_t i = 0; i < 8; ++i )
+  {
+    BLAMKA_ROUND( s[8 * i + 0], s[8 * i + 1], s[8 * i + 2], s[8 * i + 3],
+                  s[8 * i + 4], s[8 * i + 5], s[8 * i + 6], s[8 * i + 7] );
+  }
+
+  for( size_t i = 0; i < 8; ++i )
+  {
+    BLAMKA_ROUND( s[8 * 0 + i], s[8 * 1 + i], s[8 * 2 + i], s[8 * 3 + i],
+                  s[8 * 4 + i], s[8 * 5 + i], s[8 * 6 + i], s[8 * 7 + i] );
+  }
+
+  for( size_t i = 0; i < 64; ++i )
+    STOREU( next->v + 2 * i, _mm_xor_si128( s[i], x[i] ) );
+}
+#else
+static void fill_block( const argon2_block *prev, const argon2_block *ref, argon2_block *next, int with_xor )
+{
+  uint64_t r[ARGON2_QWORDS_IN_BLOCK], x[ARGON2_QWORDS_IN_BLOCK];
+  uint64_t *v = r;
+
+  for( size_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i )
+  {
+    r[i] = prev->v[i] ^ ref->v[i];
+    x[i] = with_xor ? r[i] ^ next->v[i] : r[i];
+  }
+
+  for( size_t i = 0; i < 8; ++i )
+    BLAMKA_ROUND( v[16 * i +  0], v[16 * i +  1], v[16 * i +  2], v[16 * i +  3],
+                  v[16 * i +  4], v[16 * i +  5], v[16 * i +  6], v[16 * i +  7],
+                  v[16 * i +  8], v[16 * i +  9], v[16 * i + 10], v[16 * i + 11],
+                  v[16 * i + 12], v[16 * i + 13], v[16 * i + 14], v[16 * i + 15] );
+
+  for( size_t i = 0; i < 8; ++i )
+    BLAMKA_ROUND( v[2 * i +   0], v[2 * i +   1], v[2 * i +  16], v[2 * i +  17],
+                  v[2 * i +  32], v[2 * i +  33], v[2 * i +  48], v[2 * i +  49],
+                  v[2 * i +  64], v[2 * i +  65], v[2 * i +  80], v[2 * i +  81],
+                  v[2 * i +  96], v[2 * i +  97], v[2 * i + 112], v[2 * i + 113] );
+
+  for( size_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i )
+    next->v[i] = r[i] ^ x[i];
+}
+#endif
+
+static void *argon2_alloc( size_t size )
+{
+  void *p = NULL;
+#if defined(HAVE_POSIX_MEMALIGN)
+  if( posix_memalign( &p, size >= HUGE_PAGE_BYTES ? HUGE_PAGE_BYTES : 64, size ) != 0 ) return NULL;
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+  if( size >= HUGE_PAGE_BYTES )
+    madvise( p, size - size % HUGE_PAGE_BYTES, MADV_HUGEPAGE );
+#endif
+#else
+  p = malloc( size );
+#endif
+  return p;
+}
+
+static void argon2_free( argon2_block *memory, size_t size )
+{
+  secure_zero_memory( memory, size );
+  free( memory );
+}
+
+static void load_block( argon2_block *dst, const uint8_t *src )
+{
+  for( size_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i )
+    dst->v[i] = load64( src + 8 * i );
+}
+
+static void store_block( uint8_t *dst, const argon2_block *src )
+{
+  for( size_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i )
+    store64( dst + 8 * i, src->v[i] );
+}
+
+/* Data-independent addressing: the next 128 pseudo-random words are G(0, G(0, input)) */
+static void next_addresses( argon2_block *address, argon2_block *input, const argon2_block *zero )
+{
+  input->v[6]++;
+  fill_block( zero, input, address, 0 );
+  fill_block( zero, address, address, 0 );
+}
+
+static uint32_t index_alpha( const argon2_instance *I, uint32_t pass, uint32_t slice, uint32_t index,
+                             uint32_t pseudo_rand, int same_lane )
+{
+  uint32_t area, start = 0;
+  uint64_t pos;
+
+  if( 0 == pass )
+  {
+    if( 0 == slice )
+      area = index - 1; /* all but the previous block */
+    else if( same_lane )
+      area = slice * I->segment_length + index - 1;
+    else
+      area = slice * I->segment_length - ( index == 0 ? 1 : 0 );
+  }
+  else
+  {
+    if( same_lane )
+      area = I->lane_length - I->segment_length + index - 1;
+    else
+      area = I->lane_length - I->segment_length - ( index == 0 ? 1 : 0 );
+
+    if( slice != BLAKE2_ARGON2_SYNC_POINTS - 1 )
+      start = ( slice + 1 ) * I->segment_length;
+  }
+
+  pos = pseudo_rand;
+  pos = pos * pos >> 32;
+  pos = area - 1 - ( area * pos >> 32 );
+  return ( uint32_t )( ( start + pos ) % I->lane_length );
+}
+
+static void fill_segment( const argon2_instance *I, uint32_t pass, uint32_t lane, uint32_t slice )
+{
+  argon2_block address[1], input[1], zero[1];
+  uint32_t start = 0;
+  uint32_t curr, prev;
+  const int independent = I->type == BLAKE2_ARGON2I ||
+                          ( I->type == BLAKE2_ARGON2ID && pass == 0 && slice < BLAKE2_ARGON2_SYNC_POINTS / 2 );
+
+  if( independent )
+  {
+    memset( zero, 0, sizeof( zero ) );
+    memset( input, 0, sizeof( input ) );
+    input->v[0] = pass;
+    input->v[1] = lane;
+    input->v[2] = slice;
+    input->v[3] = I->memory_blocks;
+    input->v[4] = I->passes;
+    input->v[5] = I->type;
+  }
+
+  if( 0 == pass && 0 == slice )
+  {
+    start = 2; /* the first two blocks of each lane come from H0 */
+
+    if( independent ) next_addresses( address, input, zero );
+  }
+
+  curr = lane * I->lane_length + slice * I->segment_length + start;
+  prev = curr % I->lane_length == 0 ? curr + I->lane_length - 1 : curr - 1;
+
+  for( uint32_t i = start; i < I->segment_length; ++i, ++curr, ++prev )
+  {
+    uint64_t pseudo_rand;
+    uint32_t ref_lane, ref_index;
+
+    if( curr % I->lane_length == 1 ) prev = curr - 1;
+
+    if( independent )
+    {
+      if( i % ARGON2_ADDRESSES_IN_BLOCK == 0 ) next_addresses( address, input, zero );
+
+      pseudo_rand = address->v[i % ARGON2_ADDRESSES_IN_BLOCK];
+    }
+    else
+      pseudo_rand = I->memory[prev].v[0];
+
+    ref_lane = ( uint32_t )( ( pseudo_rand >> 32 ) % I->lanes );
+
+    if( 0 == pass && 0 == slice ) ref_lane = lane;
+
+    ref_index = index_alpha( I, pass, slice, i, ( uint32_t ) pseudo_rand, ref_lane == lane );
+    fill_block( I->memory + prev, I->memory + ( size_t ) I->lane_length * ref_lane + ref_index,
+                I->memory + curr, pass != 0 );
+  }
+}
+
+int blake2b_long( uint8_t *out, size_t outlen, const void *in, size_t inlen )
+{
+  blake2b_state S[1];
+  uint8_t outlen_bytes[4];
+
+  if( NULL == out || !outlen || outlen > 0xFFFFFFFFULL ) return -1;
+
+  if( NULL == in && inlen > 0 ) return -1;
+
+  store32( outlen_bytes, ( uint32_t ) outlen );
+
+  if( outlen <= BLAKE2B_OUTBYTES )
+  {
+    if( blake2b_init( S, outlen ) < 0 ) return -1;
+
+    blake2b_update( S, outlen_bytes, sizeof( outlen_bytes ) );
+    blake2b_update( S, ( const uint8_t * )in, inlen );
+    return blake2b_final( S, out, outlen );
+  }
+  else
+  {
+    uint8_t V[BLAKE2B_OUTBYTES], W[BLAKE2B_OUTBYTES];
+    size_t left = outlen - BLAKE2B_OUTBYTES / 2;
+
+    if( blake2b_init( S, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+    blake2b_update( S, outlen_bytes, sizeof( outlen_bytes ) );
+    blake2b_update( S, ( const uint8_t * )in, inlen );
+    blake2b_final( S, V, BLAKE2B_OUTBYTES );
+    memcpy( out, V, BLAKE2B_OUTBYTES / 2 );
+    out += BLAKE2B_OUTBYTES / 2;
+
+    while( left > BLAKE2B_OUTBYTES )
+    {
+      blake2b( W, V, NULL, BLAKE2B_OUTBYTES, BLAKE2B_OUTBYTES, 0 );
+      memcpy( V, W, BLAKE2B_OUTBYTES );
+      memcpy( out, V, BLAKE2B_OUTBYTES / 2 );
+      out += BLAKE2B_OUTBYTES / 2;
+      left -= BLAKE2B_OUTBYTES / 2;
+    }
+
+    blake2b( W, V, NULL, left, BLAKE2B_OUTBYTES, 0 );
+    memcpy( out, W, left );
+    secure_zero_memory( V, sizeof( V ) );
+    secure_zero_memory( W, sizeof( W ) );
+    return 0;
+  }
+}
+
+static void argon2_update_length_prefixed( blake2b_state *S, const uint8_t *in, uint32_t inlen )
+{
+  uint8_t len[4];
+  store32( len, inlen );
+  blake2b_update( S, len, sizeof( len ) );
+
+  if( inlen ) blake2b_update( S, in, inlen );
+}
+
+static int argon2_initial_hash( uint8_t H0[BLAKE2B_OUTBYTES], uint32_t outlen, const blake2_argon2_param *P )
+{
+  blake2b_state S[1];
+  uint8_t word[4];
+  const uint32_t header[6] =
+  {
+    P->lanes, outlen, P->m_cost, P->t_cost, BLAKE2_ARGON2_VERSION, P->type
+  };
+
+  if( blake2b_init( S, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  for( size_t i = 0; i < 6; ++i )
+  {
+    store32( word, header[i] );
+    blake2b_update( S, word, sizeof( word ) );
+  }
+
+  argon2_update_length_prefixed( S, P->pwd, P->pwdlen );
+  argon2_update_length_prefixed( S, P->salt, P->saltlen );
+  argon2_update_length_prefixed( S, P->secret, P->secretlen );
+  argon2_update_length_prefixed( S, P->ad, P->adlen );
+  return blake2b_final( S, H0, BLAKE2B_OUTBYTES );
+}
+
+int blake2_argon2( uint8_t *out, size_t outlen, const blake2_argon2_param *P )
+{
+  argon2_instance I[1];
+  uint8_t prehash[ARGON2_PREHASH_BYTES];
+  uint8_t blockbytes[BLAKE2_ARGON2_BLOCKBYTES];
+  size_t memory_bytes;
+
+  /* Verify parameters */
+  if( NULL == out || NULL == P ) return -1;
+
+  if( outlen < 4 || outlen > 0xFFFFFFFFULL ) return -1;
+
+  if( P->type > BLAKE2_ARGON2ID ) return -1;
+
+  if( ( NULL == P->pwd && P->pwdlen ) || ( NULL == P->secret && P->secretlen ) ||
+      ( NULL == P->ad && P->adlen ) || NULL == P->salt || P->saltlen < 8 )
+    return -1;
+
+  if( !P->t_cost || !P->lanes || P->lanes > 0xFFFFFF ) return -1;
+
+  if( P->m_cost < 2 * BLAKE2_ARGON2_SYNC_POINTS * P->lanes ) return -1;
+
+  I->passes = P->t_cost;
+  I->lanes = P->lanes;
+  I->type = P->type;
+  I->segment_length = P->m_cost / ( P->lanes * BLAKE2_ARGON2_SYNC_POINTS );
+  I->lane_length = I->segment_length * BLAKE2_ARGON2_SYNC_POINTS;
+  I->memory_blocks = I->lane_length * I->lanes;
+  memory_bytes = ( size_t ) I->memory_blocks * sizeof( argon2_block );
+
+  if( memory_bytes / sizeof( argon2_block ) != I->memory_blocks ) return -1;
+
+  if( NULL == ( I->memory = ( argon2_block * )argon2_alloc( memory_bytes ) ) ) return -1;
+
+  if( argon2_initial_hash( prehash, ( uint32_t ) outlen, P ) < 0 )
+  {
+    argon2_free( I->memory, memory_bytes );
+    return -1;
+  }
+
+  /* B[l][0] = H'(H0 || 0 || l), B[l][1] = H'(H0 || 1 || l) */
+  for( uint32_t l = 0; l < I->lanes; ++l )
+  {
+    for( uint32_t j = 0; j < 2; ++j )
+    {
+      store32( prehash + BLAKE2B_OUTBYTES, j );
+      store32( prehash + BLAKE2B_OUTBYTES + 4, l );
+      blake2b_long( blockbytes, sizeof( blockbytes ), prehash, sizeof( prehash ) );
+      load_block( I->memory + ( size_t ) l * I->lane_length + j, blockbytes );
+    }
+  }
+
+  /* Lanes are independent within a slice; slices are the synchronization points */
+  for( uint32_t pass = 0; pass < I->passes; ++pass )
+  {
+    for( uint32_t slice = 0; slice < BLAKE2_ARGON2_SYNC_POINTS; ++slice )
+    {
+#if defined(_OPENMP)
+      #pragma omp parallel for schedule(static) if(I->lanes > 1)
+#endif
+      for( uint32_t lane = 0; lane < I->lanes; ++lane )
+        fill_segment( I, pass, lane, slice );
+    }
+  }
+
+  /* Tag = H'(B[0][q-1] ^ ... ^ B[p-1][q-1]) */
+  {
+    argon2_block *last = I->memory + I->lane_length - 1;
+
+    for( uint32_t l = 1; l < I->lanes; ++l )
+    {
+      const argon2_block *B = I->memory + ( size_t ) l * I->lane_length + I->lane_length - 1;
+
+      for( size_t i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i )
+        last->v[i] ^= B->v[i];
+    }
+
+    store_block( blockbytes, last );
+  }
+
+  blake2b_long( out, outlen, blockbytes, sizeof( blockbytes ) );
+  secure_zero_memory( blockbytes, sizeof( blockbytes ) );
+  secure_zero_memory( prehash, sizeof( prehash ) );
+  argon2_free( I->memory, memory_bytes );
+  return 0;
+}
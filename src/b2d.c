@@ -0,0 +1,119 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+
+/* Never a shared directory such as /tmp, where another user could bind the name first */
+#define B2D_SOCKET "b2d.sock"
+#define B2D_RUNDIR "/run"
+
+static blake2_daemon *daemon_;
+
+static void usage( FILE *fp )
+{
+  fprintf( fp,
+           "Usage: b2d [OPTION]...\n"
+           "Serve BLAKE2 hashing to local processes using libb2's blake2_client functions.\n"
+           "\n"
+           "  -s, --socket=PATH    listen on PATH (default $XDG_RUNTIME_DIR/" B2D_SOCKET ",\n"
+           "                       or " B2D_RUNDIR "/" B2D_SOCKET " without it)\n"
+           "  -t, --threads=N      number of hashing threads (default one per CPU)\n"
+           "  -h, --help           display this help and exit\n" );
+}
+
+static void b2d_stop( int sig )
+{
+  ( void )sig;
+  blake2_daemon_stop( daemon_ );
+}
+
+int main( int argc, char **argv )
+{
+  static const struct option options[] =
+  {
+    { "socket",  required_argument, NULL, 's' },
+    { "threads", required_argument, NULL, 't' },
+    { "help",    no_argument,       NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  const char *path = NULL, *dir = getenv( "XDG_RUNTIME_DIR" );
+  static char rundir_path[4096];
+  unsigned long threads = 0;
+  struct sigaction sa;
+  char *end;
+  int c, ret;
+
+  while( ( c = getopt_long( argc, argv, "s:t:h", options, NULL ) ) != -1 )
+  {
+    switch( c )
+    {
+      case 's': path = optarg; break;
+
+      case 't':
+        threads = strtoul( optarg, &end, 10 );
+
+        if( end == optarg || *end || threads > 4096 )
+        {
+          fprintf( stderr, "b2d: invalid thread count '%s'\n", optarg );
+          return 1;
+        }
+
+        break;
+
+      case 'h': usage( stdout ); return 0;
+      default: usage( stderr ); return 1;
+    }
+  }
+
+  if( optind < argc )
+  {
+    usage( stderr );
+    return 1;
+  }
+
+  if( NULL == path )
+  {
+    if( NULL == dir || '/' != dir[0] ) dir = B2D_RUNDIR;
+
+    if( snprintf( rundir_path, sizeof( rundir_path ), "%s/%s", dir, B2D_SOCKET ) >= ( int )sizeof( rundir_path ) )
+    {
+      fprintf( stderr, "b2d: %s: %s\n", dir, strerror( ENAMETOOLONG ) );
+      return 1;
+    }
+
+    path = rundir_path;
+  }
+
+  if( NULL == ( daemon_ = blake2_daemon_create( path, ( unsigned )threads ) ) )
+  {
+    fprintf( stderr, "b2d: %s: %s\n", path, strerror( errno ) );
+    return 1;
+  }
+
+  memset( &sa, 0, sizeof( sa ) );
+  sa.sa_handler = b2d_stop;
+  sigemptyset( &sa.sa_mask );
+  sigaction( SIGINT, &sa, NULL );
+  sigaction( SIGTERM, &sa, NULL );
+  signal( SIGPIPE, SIG_IGN );
+
+  ret = blake2_daemon_run( daemon_ );
+  blake2_daemon_destroy( daemon_ );
+  return ret < 0 ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "blake2.h"
+
+/* Past b2sum's 64 MiB split size, so the parallel variants put it aside and hash it last with every leaf */
+#define BIG_BYTES ( ( 64 << 20 ) + 129 )
+#define PREFIX_BYTES 70000
+
+static const char *names[] = { "small", "empty", "big", "medium" };
+static const size_t sizes[] = { 1000, 0, BIG_BYTES, PREFIX_BYTES };
+#define NFILES ( sizeof( names ) / sizeof( names[0] ) )
+
+typedef struct
+{
+  const char *name;
+  int ( *hash )( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
+  size_t outlen;
+  size_t keylen;
+} b2sum_case;
+
+static const b2sum_case cases[] =
+{
+  { "blake2b",  blake2b,  BLAKE2B_OUTBYTES, 0 },
+  { "blake2s",  blake2s,  BLAKE2S_OUTBYTES, 20 },
+  { "blake2bp", blake2bp, 32,               0 },
+  { "blake2sp", blake2sp, BLAKE2S_OUTBYTES, 20 }
+};
+
+static int run( const char *fmt, const char *alg, const char *opts, const char *dir )
+{
+  char cmd[1024];
+  int status;
+
+  snprintf( cmd, sizeof( cmd ), fmt, alg, opts, dir, dir, dir, dir, dir, dir );
+  status = system( cmd );
+  return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+/* The sums must come out in argument order and match the one-shot functions */
+static int check_sums( const char *dir, const b2sum_case *C, const uint8_t *msg, const uint8_t *key )
+{
+  char path[256], line[512], expect[512];
+  uint8_t digest[BLAKE2B_OUTBYTES];
+  FILE *fp;
+  int ret = 0;
+
+  snprintf( path, sizeof( path ), "%s/sums", dir );
+
+  if( NULL == ( fp = fopen( path, "r" ) ) ) return -1;
+
+  for( size_t i = 0; i < NFILES && 0 == ret; ++i )
+  {
+    size_t n = 0;
+
+    C->hash( digest, msg, C->keylen ? key : NULL, C->outlen, sizes[i], C->keylen );
+
+    for( size_t j = 0; j < C->outlen; ++j )
+      n += ( size_t )snprintf( expect + n, sizeof( expect ) - n, "%02x", digest[j] );
+
+    snprintf( expect + n, sizeof( expect ) - n, "  %s/%s\n", dir, names[i] );
+
+    if( NULL == fgets( line, sizeof( line ), fp ) || 0 != strcmp( line, expect ) ) ret = -1;
+  }
+
+  if( 0 == ret && NULL != fgets( line, sizeof( line ), fp ) ) ret = -1;
+
+  fclose( fp );
+  return ret;
+}
+
+static int write_file( const char *dir, const char *name, const uint8_t *msg, size_t len )
+{
+  char path[256];
+  FILE *fp;
+
+  snprintf( path, sizeof( path ), "%s/%s", dir, name );
+
+  if( NULL == ( fp = fopen( path, "wb" ) ) ) return -1;
+
+  /* Past the prefix the message is zeros, which a sparse tail provides */
+  if( fwrite( msg, 1, len < PREFIX_BYTES ? len : PREFIX_BYTES, fp ) != ( len < PREFIX_BYTES ? len : PREFIX_BYTES ) )
+  {
+    fclose( fp );
+    return -1;
+  }
+
+  if( fclose( fp ) != 0 ) return -1;
+
+  return truncate( path, ( off_t )len );
+}
+
+static int test_b2sum( const char *dir, const uint8_t *msg, const uint8_t *key )
+{
+  static const char *hash_fmt = "./b2sum -a %s %s %s/small %s/empty %s/big %s/medium > %s/sums";
+  static const char *check_fmt = "./b2sum -a %s %s --quiet -c %s/sums > %s/checked";
+  static const char *status_fmt = "./b2sum -a %s %s --status -c %s/sums";
+  char opts[256];
+
+  for( size_t i = 0; i < sizeof( cases ) / sizeof( cases[0] ); ++i )
+  {
+    const b2sum_case *C = &cases[i];
+    int n = snprintf( opts, sizeof( opts ), "-l %zu", 8 * C->outlen );
+
+    if( C->keylen ) snprintf( opts + n, sizeof( opts ) - ( size_t )n, " -k %s/key", dir );
+
+    if( run( hash_fmt, C->name, opts, dir ) != 0 || check_sums( dir, C, msg, key ) < 0 ) return -1;
+
+    if( run( check_fmt, C->name, opts, dir ) != 0 ) return -1;
+  }
+
+  /* A changed file fails the check of the last list */
+  if( write_file( dir, "small", msg + 1, sizes[0] ) < 0 ) return -1;
+
+  return run( status_fmt, cases[3].name, opts, dir ) == 1 ? 0 : -1;
+}
+
+int main( int argc, char **argv )
+{
+  char dir[] = "b2sum-test.XXXXXX";
+  uint8_t *msg = ( uint8_t * )calloc( 1, BIG_BYTES );
+  uint8_t key[BLAKE2S_KEYBYTES];
+  char path[256];
+  int ret = -1;
+
+  if( NULL == msg || NULL == mkdtemp( dir ) )
+  {
+    free( msg );
+    puts( "error" );
+    return -1;
+  }
+
+  for( size_t i = 0; i < PREFIX_BYTES; ++i )
+    msg[i] = ( uint8_t )( i * 13 + 5 );
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )( 0x40 + i );
+
+  if( 0 == write_file( dir, "key", key, 20 ) )
+  {
+    ret = 0;
+
+    for( size_t i = 0; i < NFILES && 0 == ret; ++i )
+      ret = write_file( dir, names[i], msg, sizes[i] );
+
+    if( 0 == ret ) ret = test_b2sum( dir, msg, key );
+  }
+
+  for( size_t i = 0; i < NFILES; ++i )
+  {
+    snprintf( path, sizeof( path ), "%s/%s", dir, names[i] );
+    unlink( path );
+  }
+
+  snprintf( path, sizeof( path ), "%s/key", dir );
+  unlink( path );
+  snprintf( path, sizeof( path ), "%s/sums", dir );
+  unlink( path );
+  snprintf( path, sizeof( path ), "%s/checked", dir );
+  unlink( path );
+  rmdir( dir );
+  free( msg );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
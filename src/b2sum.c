@@ -0,0 +1,432 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "blake2.h"
+
+/* Files at least this large are hashed one at a time with every leaf of a parallel variant busy */
+#define B2SUM_SPLIT_BYTES ( 64 * 1024 * 1024 )
+
+typedef struct __b2sum_algorithm
+{
+  const char *name;
+  const char *tag;
+  size_t outbytes;
+  size_t keybytes;
+  int parallel;
+  int ( *file )( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen );
+} b2sum_algorithm;
+
+static const b2sum_algorithm algorithms[] =
+{
+  { "blake2b",  "BLAKE2b",  BLAKE2B_OUTBYTES, BLAKE2B_KEYBYTES, 0, blake2b_file },
+  { "blake2s",  "BLAKE2s",  BLAKE2S_OUTBYTES, BLAKE2S_KEYBYTES, 0, blake2s_file },
+  { "blake2bp", "BLAKE2bp", BLAKE2B_OUTBYTES, BLAKE2B_KEYBYTES, 1, blake2bp_file },
+  { "blake2sp", "BLAKE2sp", BLAKE2S_OUTBYTES, BLAKE2S_KEYBYTES, 1, blake2sp_file }
+};
+
+enum
+{
+  JOB_PENDING,
+  JOB_DEFERRED,
+  JOB_DONE
+};
+
+typedef struct __b2sum_job
+{
+  char *path;
+  size_t outlen;
+  uint8_t digest[BLAKE2B_OUTBYTES];
+  uint8_t expect[BLAKE2B_OUTBYTES];
+  int err;
+  int state;
+} b2sum_job;
+
+typedef struct __b2sum_run
+{
+  const b2sum_algorithm *A;
+  uint8_t key[BLAKE2B_KEYBYTES];
+  size_t keylen;
+  int check;
+  int quiet;
+  int status;
+  b2sum_job *jobs;
+  size_t njobs;
+  size_t capacity;
+  size_t printed;
+  size_t failed_read;
+  size_t mismatched;
+  size_t malformed;
+} b2sum_run;
+
+static void usage( FILE *fp )
+{
+  fprintf( fp,
+           "Usage: b2sum [OPTION]... [FILE]...\n"
+           "Print or check BLAKE2 checksums; with no FILE, or when FILE is -, read standard input.\n"
+           "\n"
+           "  -a, --algorithm=ALG  blake2b (default), blake2s, blake2bp or blake2sp\n"
+           "  -l, --length=BITS    digest length in bits, a multiple of 8 up to the algorithm's maximum\n"
+           "  -k, --key-file=FILE  keyed mode, with the key read from FILE\n"
+           "  -c, --check          read checksums from the FILEs and check them\n"
+           "      --quiet          with --check, do not print OK for each verified file\n"
+           "      --status         with --check, print nothing; the exit status tells\n"
+           "  -h, --help           display this help and exit\n" );
+}
+
+/* Returns 0 and fills out, 1 if the file is put aside for later, or -1 with errno set */
+static int b2sum_hash( const b2sum_run *R, b2sum_job *J, const int defer )
+{
+  const int fd = 0 == strcmp( J->path, "-" ) ? STDIN_FILENO : open( J->path, O_RDONLY );
+  struct stat st;
+  int ret;
+
+  if( fd < 0 ) return -1;
+
+  if( defer && R->A->parallel && fd != STDIN_FILENO && 0 == fstat( fd, &st ) &&
+      S_ISREG( st.st_mode ) && st.st_size >= B2SUM_SPLIT_BYTES )
+  {
+    close( fd );
+    return 1;
+  }
+
+  ret = R->A->file( J->digest, J->outlen, fd, R->keylen ? R->key : NULL, R->keylen );
+
+  if( ret < 0 && 0 == errno ) errno = EIO;
+
+  if( fd != STDIN_FILENO )
+  {
+    const int saved = errno;
+    close( fd );
+    errno = saved;
+  }
+
+  return ret;
+}
+
+static void b2sum_print( b2sum_run *R, const b2sum_job *J )
+{
+  if( J->err )
+  {
+    ++R->failed_read;
+
+    if( !R->status ) fprintf( stderr, "b2sum: %s: %s\n", J->path, strerror( J->err ) );
+
+    if( R->check && !R->status ) printf( "%s: FAILED open or read\n", J->path );
+
+    return;
+  }
+
+  if( R->check )
+  {
+    const int ok = 0 == memcmp( J->digest, J->expect, J->outlen );
+
+    if( !ok ) ++R->mismatched;
+
+    if( !R->status && ( !ok || !R->quiet ) ) printf( "%s: %s\n", J->path, ok ? "OK" : "FAILED" );
+
+    return;
+  }
+
+  for( size_t i = 0; i < J->outlen; ++i )
+    printf( "%02x", J->digest[i] );
+
+  printf( "  %s\n", J->path );
+}
+
+/* Output follows the order of the jobs, whatever order they finish in; job states only change in here */
+static void b2sum_finish( b2sum_run *R, size_t i, int ret, int err )
+{
+#if defined(_OPENMP)
+  #pragma omp critical( b2sum_output )
+#endif
+  {
+    R->jobs[i].err = ret < 0 ? err : 0;
+    R->jobs[i].state = ret > 0 ? JOB_DEFERRED : JOB_DONE;
+
+    while( R->printed < R->njobs && JOB_DONE == R->jobs[R->printed].state )
+      b2sum_print( R, &R->jobs[R->printed++] );
+  }
+}
+
+static void b2sum_run_jobs( b2sum_run *R )
+{
+  const long n = ( long )R->njobs;
+
+  /*
+     Files are handed out one at a time to whichever thread is idle, so a few
+     large files cannot hold up a long tail of small ones. Large files for a
+     parallel variant are put aside and hashed afterwards, one at a time with
+     the variant's own leaf threads; with a single file the outer loop stays
+     inactive for the same reason.
+  */
+#if defined(_OPENMP)
+  #pragma omp parallel for schedule( dynamic, 1 ) if( n > 1 )
+#endif
+  for( long i = 0; i < n; ++i )
+  {
+    const int ret = b2sum_hash( R, &R->jobs[i], n > 1 );
+    b2sum_finish( R, ( size_t )i, ret, errno );
+  }
+
+  for( size_t i = 0; i < R->njobs; ++i )
+  {
+    if( JOB_DEFERRED == R->jobs[i].state )
+    {
+      const int ret = b2sum_hash( R, &R->jobs[i], 0 );
+      b2sum_finish( R, i, ret, errno );
+    }
+  }
+}
+
+static int b2sum_add( b2sum_run *R, char *path, size_t outlen, const uint8_t *expect )
+{
+  b2sum_job *J;
+
+  if( R->njobs == R->capacity )
+  {
+    const size_t grown = R->capacity ? 2 * R->capacity : 64;
+    b2sum_job *jobs = ( b2sum_job * )realloc( R->jobs, grown * sizeof( b2sum_job ) );
+
+    if( NULL == jobs ) return -1;
+
+    R->jobs = jobs;
+    R->capacity = grown;
+  }
+
+  J = &R->jobs[R->njobs++];
+  memset( J, 0, sizeof( *J ) );
+  J->path = path;
+  J->outlen = outlen;
+
+  if( expect ) memcpy( J->expect, expect, outlen );
+
+  return 0;
+}
+
+static int unhex( uint8_t *out, const char *hex, size_t len )
+{
+  for( size_t i = 0; i < len; ++i )
+  {
+    unsigned v = 0;
+
+    for( size_t j = 0; j < 2; ++j )
+    {
+      const char c = hex[2 * i + j];
+      v <<= 4;
+
+      if( c >= '0' && c <= '9' ) v |= ( unsigned )( c - '0' );
+      else if( c >= 'a' && c <= 'f' ) v |= ( unsigned )( c - 'a' + 10 );
+      else if( c >= 'A' && c <= 'F' ) v |= ( unsigned )( c - 'A' + 10 );
+      else return -1;
+    }
+
+    out[i] = ( uint8_t )v;
+  }
+
+  return 0;
+}
+
+/* Lines are "<hex digest>  <name>" or "<hex digest> *<name>"; the digest length follows the hex */
+static int b2sum_read_checks( b2sum_run *R, const char *list )
+{
+  FILE *fp = 0 == strcmp( list, "-" ) ? stdin : fopen( list, "r" );
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+
+  if( NULL == fp )
+  {
+    fprintf( stderr, "b2sum: %s: %s\n", list, strerror( errno ) );
+    return -1;
+  }
+
+  while( ( len = getline( &line, &cap, fp ) ) > 0 )
+  {
+    uint8_t expect[BLAKE2B_OUTBYTES];
+    size_t hexlen = strspn( line, "0123456789abcdefABCDEF" );
+    char *name;
+
+    while( len > 0 && ( '\n' == line[len - 1] || '\r' == line[len - 1] ) )
+      line[--len] = '\0';
+
+    if( 0 == hexlen || hexlen % 2 || hexlen / 2 > R->A->outbytes || ( size_t )len < hexlen + 3 ||
+        ' ' != line[hexlen] || ( ' ' != line[hexlen + 1] && '*' != line[hexlen + 1] ) ||
+        unhex( expect, line, hexlen / 2 ) < 0 )
+    {
+      ++R->malformed;
+      continue;
+    }
+
+    if( NULL == ( name = strdup( line + hexlen + 2 ) ) || b2sum_add( R, name, hexlen / 2, expect ) < 0 )
+    {
+      fprintf( stderr, "b2sum: out of memory\n" );
+      free( line );
+      return -1;
+    }
+  }
+
+  free( line );
+
+  if( fp != stdin ) fclose( fp );
+
+  return 0;
+}
+
+static int b2sum_read_key( b2sum_run *R, const char *path )
+{
+  FILE *fp = fopen( path, "rb" );
+  uint8_t extra;
+
+  if( NULL == fp )
+  {
+    fprintf( stderr, "b2sum: %s: %s\n", path, strerror( errno ) );
+    return -1;
+  }
+
+  R->keylen = fread( R->key, 1, R->A->keybytes, fp );
+
+  if( 0 == R->keylen || fread( &extra, 1, 1, fp ) != 0 )
+  {
+    fprintf( stderr, "b2sum: %s: key must be 1 to %zu bytes for %s\n", path, R->A->keybytes, R->A->name );
+    fclose( fp );
+    return -1;
+  }
+
+  fclose( fp );
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  static const struct option options[] =
+  {
+    { "algorithm", required_argument, NULL, 'a' },
+    { "length",    required_argument, NULL, 'l' },
+    { "key-file",  required_argument, NULL, 'k' },
+    { "check",     no_argument,       NULL, 'c' },
+    { "quiet",     no_argument,       NULL, 'q' },
+    { "status",    no_argument,       NULL, 's' },
+    { "help",      no_argument,       NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  static char stdin_name[] = "-";
+  char *stdin_names[1] = { stdin_name };
+  char **names;
+  int count;
+  b2sum_run R[1];
+  const char *keyfile = NULL;
+  unsigned long bits = 0;
+  size_t outlen;
+  int c, ret = 0;
+
+  memset( R, 0, sizeof( R ) );
+  R->A = &algorithms[0];
+
+  while( ( c = getopt_long( argc, argv, "a:l:k:ch", options, NULL ) ) != -1 )
+  {
+    switch( c )
+    {
+      case 'a':
+        R->A = NULL;
+
+        for( size_t i = 0; i < sizeof( algorithms ) / sizeof( algorithms[0] ); ++i )
+          if( 0 == strcmp( optarg, algorithms[i].name ) ) R->A = &algorithms[i];
+
+        if( NULL == R->A )
+        {
+          fprintf( stderr, "b2sum: unknown algorithm '%s'\n", optarg );
+          return 1;
+        }
+
+        break;
+
+      case 'l':
+        bits = strtoul( optarg, NULL, 10 );
+
+        if( 0 == bits || bits % 8 )
+        {
+          fprintf( stderr, "b2sum: invalid length '%s'\n", optarg );
+          return 1;
+        }
+
+        break;
+
+      case 'k': keyfile = optarg; break;
+      case 'c': R->check = 1; break;
+      case 'q': R->quiet = 1; break;
+      case 's': R->status = 1; break;
+      case 'h': usage( stdout ); return 0;
+      default: usage( stderr ); return 1;
+    }
+  }
+
+  outlen = bits ? bits / 8 : R->A->outbytes;
+
+  if( outlen > R->A->outbytes )
+  {
+    fprintf( stderr, "b2sum: %s digests are at most %zu bits\n", R->A->name, 8 * R->A->outbytes );
+    return 1;
+  }
+
+  if( keyfile && b2sum_read_key( R, keyfile ) < 0 ) return 1;
+
+  names = optind < argc ? argv + optind : stdin_names;
+  count = optind < argc ? argc - optind : 1;
+
+  for( int i = 0; i < count; ++i )
+  {
+    if( R->check )
+    {
+      if( b2sum_read_checks( R, names[i] ) < 0 ) ret = 1;
+    }
+    else if( b2sum_add( R, names[i], outlen, NULL ) < 0 )
+    {
+      fprintf( stderr, "b2sum: out of memory\n" );
+      return 1;
+    }
+  }
+
+  b2sum_run_jobs( R );
+
+  if( R->check && !R->status )
+  {
+    fflush( stdout );
+
+    if( R->malformed ) fprintf( stderr, "b2sum: WARNING: %zu lines are improperly formatted\n", R->malformed );
+
+    if( R->failed_read ) fprintf( stderr, "b2sum: WARNING: %zu listed files could not be read\n", R->failed_read );
+
+    if( R->mismatched ) fprintf( stderr, "b2sum: WARNING: %zu computed checksums did NOT match\n", R->mismatched );
+  }
+
+  if( R->failed_read || R->mismatched || ( R->check && 0 == R->njobs ) ) ret = 1;
+
+  if( R->check )
+    for( size_t i = 0; i < R->njobs; ++i )
+      free( R->jobs[i].path );
+
+  free( R->jobs );
+  return ret;
+}
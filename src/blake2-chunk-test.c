@@ -0,0 +1,160 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+/* Several parallel segments, ending mid-chunk */
+#define INPUT_BYTES ( 40 * 1024 * 1024 + 12345 )
+/* A cut point past this offset restarts the chunking on differently placed segments */
+#define SHIFT_FROM ( 5 * 1000 * 1000 )
+
+typedef struct
+{
+  blake2_chunk *chunks;
+  size_t count;
+  size_t capacity;
+  size_t stop;
+} chunk_list;
+
+static int collect( void *ctx, const blake2_chunk *C )
+{
+  chunk_list *L = ( chunk_list * )ctx;
+
+  if( L->count == L->capacity )
+  {
+    const size_t grown = L->capacity ? 2 * L->capacity : 1024;
+    blake2_chunk *chunks = ( blake2_chunk * )realloc( L->chunks, grown * sizeof( *chunks ) );
+
+    if( NULL == chunks ) return -1;
+
+    L->chunks = chunks;
+    L->capacity = grown;
+  }
+
+  L->chunks[L->count++] = *C;
+  return L->stop && L->count == L->stop ? -1 : 0;
+}
+
+/* The chunks tile the input within the size bounds, and each ID is BLAKE2b-256 of the chunk */
+static int check_chunks( const chunk_list *L, const uint8_t *in, size_t inlen, size_t min_size, size_t max_size )
+{
+  uint8_t digest[BLAKE2_CHUNK_DIGESTBYTES];
+  uint64_t pos = 0;
+
+  for( size_t i = 0; i < L->count; ++i )
+  {
+    const blake2_chunk *C = &L->chunks[i];
+
+    if( C->offset != pos || C->length > max_size || 0 == C->length ) return -1;
+
+    if( C->length < min_size && i + 1 != L->count ) return -1;
+
+    blake2b( digest, in + C->offset, NULL, BLAKE2_CHUNK_DIGESTBYTES, C->length, 0 );
+
+    if( 0 != memcmp( digest, C->digest, BLAKE2_CHUNK_DIGESTBYTES ) ) return -1;
+
+    pos += C->length;
+  }
+
+  return pos == inlen ? 0 : -1;
+}
+
+static int test_chunk( const uint8_t *in )
+{
+  const blake2_chunk_param small = { 64, 256, 1024 };
+  const blake2_chunk_param bad = { 4096, 1024, 8192 };
+  chunk_list A[1], B[1];
+  size_t first;
+  int ret = -1;
+
+  memset( A, 0, sizeof( A ) );
+  memset( B, 0, sizeof( B ) );
+
+  if( blake2b_chunk( in, INPUT_BYTES, NULL, collect, A ) < 0 ) goto out;
+
+  if( check_chunks( A, in, INPUT_BYTES, BLAKE2_CHUNK_MINBYTES, BLAKE2_CHUNK_MAXBYTES ) < 0 ) goto out;
+
+  if( A->count < INPUT_BYTES / ( 4 * BLAKE2_CHUNK_AVGBYTES ) || A->count > INPUT_BYTES / BLAKE2_CHUNK_MINBYTES ) goto out;
+
+  /* Content-defined: chunking from any cut point reproduces the rest of the chunks */
+  for( first = 0; A->chunks[first].offset < SHIFT_FROM; ++first );
+
+  if( blake2b_chunk( in + A->chunks[first].offset, INPUT_BYTES - A->chunks[first].offset, NULL, collect, B ) < 0 ) goto out;
+
+  if( B->count != A->count - first ) goto out;
+
+  for( size_t i = 0; i < B->count; ++i )
+  {
+    const blake2_chunk *a = &A->chunks[first + i], *b = &B->chunks[i];
+
+    if( b->offset + A->chunks[first].offset != a->offset || b->length != a->length ||
+        0 != memcmp( b->digest, a->digest, BLAKE2_CHUNK_DIGESTBYTES ) )
+      goto out;
+  }
+
+  B->count = 0;
+
+  if( blake2b_chunk( in, 100000, &small, collect, B ) < 0 || check_chunks( B, in, 100000, 64, 1024 ) < 0 ) goto out;
+
+  /* Bad bounds, an empty input and a callback that stops early */
+  B->count = 0;
+
+  if( blake2b_chunk( in, 100000, &bad, collect, B ) >= 0 || B->count != 0 ) goto out;
+
+  if( blake2b_chunk( in, 0, NULL, collect, B ) < 0 || B->count != 0 ) goto out;
+
+  B->stop = 3;
+
+  if( blake2b_chunk( in, INPUT_BYTES, NULL, collect, B ) >= 0 || B->count != 3 ) goto out;
+
+  ret = 0;
+out:
+  free( A->chunks );
+  free( B->chunks );
+  return ret;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t *in = ( uint8_t * )malloc( INPUT_BYTES );
+  uint64_t x = 0x0123456789abcdefULL;
+  int ret;
+
+  if( NULL == in )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  for( size_t i = 0; i < INPUT_BYTES; ++i )
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    in[i] = ( uint8_t )( x >> 32 );
+  }
+
+  ret = test_chunk( in );
+  free( in );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,268 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   FastCDC with normalized chunking: after skipping min_size bytes a gear
+   hash, h = ( h << 1 ) + gear[byte], rolls over the chunk and a cut is made
+   where its top bits are all zero, testing more bits before avg_size and
+   fewer after it, and forcing a cut at max_size. Each chunk starts from
+   h = 0, so where the next cut lands depends only on where the last one did.
+
+   That makes a speculative parallel scan exact. The input is split into
+   fixed segments, and each one is chunked as if a cut fell on its first
+   byte, until a cut at or past its end; chunks are hashed a batch at a time
+   through blake2b_update_multi while still in cache. The segments are then
+   stitched in order: the true chain coming from the previous segment is
+   continued serially until it lands on one of the speculative cut points,
+   which usually takes a chunk or two, and from there on the two chains are
+   the same. The result never depends on the number of threads. Segments are
+   processed a wave at a time to bound the memory held by pending chunks.
+*/
+#define BLAKE2_CHUNK_SEGMENT ( 16 * BLAKE2_STREAM_BYTES )
+#define BLAKE2_CHUNK_WAVE 64
+#define BLAKE2_CHUNK_BATCH 8
+
+typedef struct __blake2_chunker
+{
+  const uint8_t *in;
+  size_t inlen;
+  size_t min_size;
+  size_t avg_size;
+  size_t max_size;
+  uint64_t mask_s;
+  uint64_t mask_l;
+  uint64_t gear[256];
+} blake2_chunker;
+
+typedef struct __blake2_chunk_list
+{
+  blake2_chunk *chunks;
+  size_t count;
+  size_t capacity;
+} blake2_chunk_list;
+
+/* SplitMix64 of the byte value; the cut points, and so every chunk ID, depend on this table */
+static uint64_t blake2_chunk_gear( uint64_t x )
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+  return x ^ ( x >> 31 );
+}
+
+static int blake2_chunker_init( blake2_chunker *C, const uint8_t *in, size_t inlen, const blake2_chunk_param *P )
+{
+  unsigned bits = 0;
+
+  C->in = in;
+  C->inlen = inlen;
+  C->min_size = P && P->min_size ? P->min_size : BLAKE2_CHUNK_MINBYTES;
+  C->avg_size = P && P->avg_size ? P->avg_size : BLAKE2_CHUNK_AVGBYTES;
+  C->max_size = P && P->max_size ? P->max_size : BLAKE2_CHUNK_MAXBYTES;
+
+  if( C->min_size > C->avg_size || C->avg_size > C->max_size ) return -1;
+
+  while( ( ( size_t )2 << bits ) <= C->avg_size ) ++bits;
+
+  C->mask_s = ~0ULL << ( 64 - ( bits + 2 ) );
+  C->mask_l = ~0ULL << ( 64 - ( bits > 2 ? bits - 2 : 1 ) );
+
+  for( size_t i = 0; i < 256; ++i )
+    C->gear[i] = blake2_chunk_gear( i );
+
+  return 0;
+}
+
+/* Length of the chunk starting at p, with n bytes left in the input */
+static size_t blake2_chunk_cut( const blake2_chunker *C, const uint8_t *p, size_t n )
+{
+  size_t i = C->min_size, normal = C->avg_size, end = C->max_size;
+  uint64_t h = 0;
+
+  if( n <= i ) return n;
+
+  if( end > n ) end = n;
+
+  if( normal > end ) normal = end;
+
+  for( ; i < normal; ++i )
+  {
+    h = ( h << 1 ) + C->gear[p[i]];
+
+    if( 0 == ( h & C->mask_s ) ) return i + 1;
+  }
+
+  for( ; i < end; ++i )
+  {
+    h = ( h << 1 ) + C->gear[p[i]];
+
+    if( 0 == ( h & C->mask_l ) ) return i + 1;
+  }
+
+  return end;
+}
+
+static void blake2_chunk_hash( const uint8_t *in, blake2_chunk *chunks, size_t count )
+{
+  blake2b_state S[BLAKE2_CHUNK_BATCH];
+  blake2b_update_item items[BLAKE2_CHUNK_BATCH];
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    blake2b_init( &S[i], BLAKE2_CHUNK_DIGESTBYTES );
+    items[i].S = &S[i];
+    items[i].in = in + chunks[i].offset;
+    items[i].inlen = chunks[i].length;
+  }
+
+  blake2b_update_multi( items, count );
+
+  for( size_t i = 0; i < count; ++i )
+    blake2b_final( &S[i], chunks[i].digest, BLAKE2_CHUNK_DIGESTBYTES );
+}
+
+/* Chunks from `from` until a cut at or past `stop`, hashing them a batch at a time */
+static int blake2_chunk_scan( const blake2_chunker *C, blake2_chunk_list *L, size_t from, size_t stop )
+{
+  size_t pos = from, hashed = 0;
+
+  while( pos < C->inlen )
+  {
+    blake2_chunk *c;
+
+    if( L->count == L->capacity )
+    {
+      const size_t grown = L->capacity ? 2 * L->capacity : 1024;
+      blake2_chunk *chunks = ( blake2_chunk * )realloc( L->chunks, grown * sizeof( *chunks ) );
+
+      if( NULL == chunks ) return -1;
+
+      L->chunks = chunks;
+      L->capacity = grown;
+    }
+
+    c = &L->chunks[L->count++];
+    c->offset = pos;
+    c->length = ( uint32_t )blake2_chunk_cut( C, C->in + pos, C->inlen - pos );
+    pos += c->length;
+
+    if( L->count - hashed == BLAKE2_CHUNK_BATCH )
+    {
+      blake2_chunk_hash( C->in, L->chunks + hashed, BLAKE2_CHUNK_BATCH );
+      hashed = L->count;
+    }
+
+    if( pos >= stop ) break;
+  }
+
+  if( L->count > hashed ) blake2_chunk_hash( C->in, L->chunks + hashed, L->count - hashed );
+
+  return 0;
+}
+
+/* One chunk of the true chain at *pos, found and hashed on the spot */
+static int blake2_chunk_serial( const blake2_chunker *C, size_t *pos, blake2_chunk_fn fn, void *ctx )
+{
+  blake2_chunk c[1];
+
+  c->offset = *pos;
+  c->length = ( uint32_t )blake2_chunk_cut( C, C->in + *pos, C->inlen - *pos );
+  blake2_chunk_hash( C->in, c, 1 );
+  *pos += c->length;
+  return fn && fn( ctx, c ) < 0 ? -1 : 0;
+}
+
+int blake2b_chunk( const void *in, size_t inlen, const blake2_chunk_param *P, blake2_chunk_fn fn, void *ctx )
+{
+  blake2_chunker *C;
+  blake2_chunk_list *segs;
+  const size_t nseg = ( inlen + BLAKE2_CHUNK_SEGMENT - 1 ) / BLAKE2_CHUNK_SEGMENT;
+  size_t pos = 0;
+  int ret = 0;
+
+  if( NULL == in && inlen > 0 ) return -1;
+
+  if( NULL == ( C = ( blake2_chunker * )malloc( sizeof( *C ) ) ) ) return -1;
+
+  if( blake2_chunker_init( C, ( const uint8_t * )in, inlen, P ) < 0 ||
+      NULL == ( segs = ( blake2_chunk_list * )calloc( BLAKE2_CHUNK_WAVE, sizeof( *segs ) ) ) )
+  {
+    free( C );
+    return -1;
+  }
+
+  for( size_t first = 0; first < nseg && 0 == ret; first += BLAKE2_CHUNK_WAVE )
+  {
+    const long n = ( long )( nseg - first < BLAKE2_CHUNK_WAVE ? nseg - first : BLAKE2_CHUNK_WAVE );
+    int error = 0;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule( dynamic, 1 ) reduction( | : error ) if( n > 1 )
+#endif
+    for( long k = 0; k < n; ++k )
+    {
+      const size_t from = ( first + ( size_t )k ) * BLAKE2_CHUNK_SEGMENT;
+      const size_t stop = inlen - from > BLAKE2_CHUNK_SEGMENT ? from + BLAKE2_CHUNK_SEGMENT : inlen;
+
+      segs[k].count = 0;
+
+      if( blake2_chunk_scan( C, &segs[k], from, stop ) < 0 ) error = 1;
+    }
+
+    if( error ) ret = -1;
+
+    for( long k = 0; k < n && 0 == ret; ++k )
+    {
+      const blake2_chunk_list *L = &segs[k];
+      size_t i = 0;
+
+      /* Continue the true chain until it meets a speculative cut point, or leaves the segment's chunks behind */
+      for( ;; )
+      {
+        while( i < L->count && L->chunks[i].offset < pos ) ++i;
+
+        if( i == L->count || L->chunks[i].offset == pos || 0 != ret ) break;
+
+        ret = blake2_chunk_serial( C, &pos, fn, ctx );
+      }
+
+      for( ; i < L->count && 0 == ret; ++i )
+      {
+        if( fn && fn( ctx, &L->chunks[i] ) < 0 ) ret = -1;
+
+        pos = L->chunks[i].offset + L->chunks[i].length;
+      }
+    }
+  }
+
+  while( pos < inlen && 0 == ret )
+    ret = blake2_chunk_serial( C, &pos, fn, ctx );
+
+  for( size_t k = 0; k < BLAKE2_CHUNK_WAVE; ++k )
+    free( segs[k].chunks );
+
+  free( segs );
+  free( C );
+  return ret;
+}
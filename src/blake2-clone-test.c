@@ -0,0 +1,154 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define MSGBYTES 3000
+
+/* Every checkpoint of a chunked stream must equal the one-shot hash of that prefix */
+static int test_peek( const uint8_t *key, const uint8_t *msg )
+{
+  for( size_t step = 1; step <= 700; step += 233 )
+  {
+    blake2s_state SS[1];
+    blake2b_state SB[1];
+    blake2sp_state SSP[1];
+    blake2bp_state SBP[1];
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+    size_t off = 0;
+
+    blake2s_init_key( SS, BLAKE2S_OUTBYTES, key, BLAKE2S_KEYBYTES );
+    blake2b_init( SB, BLAKE2B_OUTBYTES );
+    blake2sp_init( SSP, BLAKE2S_OUTBYTES );
+    blake2bp_init_key( SBP, BLAKE2B_OUTBYTES, key, BLAKE2B_KEYBYTES );
+
+    for( ;; )
+    {
+      blake2s( a, msg, key, BLAKE2S_OUTBYTES, off, BLAKE2S_KEYBYTES );
+
+      if( blake2s_final_peek( SS, b, BLAKE2S_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+
+      blake2b( a, msg, NULL, BLAKE2B_OUTBYTES, off, 0 );
+
+      if( blake2b_final_peek( SB, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+      blake2sp( a, msg, NULL, BLAKE2S_OUTBYTES, off, 0 );
+
+      if( blake2sp_final_peek( SSP, b, BLAKE2S_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+
+      blake2bp( a, msg, key, BLAKE2B_OUTBYTES, off, BLAKE2B_KEYBYTES );
+
+      if( blake2bp_final_peek( SBP, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+      if( off == MSGBYTES ) break;
+
+      {
+        const size_t n = MSGBYTES - off < step ? MSGBYTES - off : step;
+        blake2s_update( SS, msg + off, n );
+        blake2b_update( SB, msg + off, n );
+        blake2sp_update( SSP, msg + off, n );
+        blake2bp_update( SBP, msg + off, n );
+        off += n;
+      }
+    }
+
+    /* Peeking never disturbed the streams */
+    blake2b( a, msg, NULL, BLAKE2B_OUTBYTES, MSGBYTES, 0 );
+    blake2b_final( SB, b, BLAKE2B_OUTBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+    blake2sp( a, msg, NULL, BLAKE2S_OUTBYTES, MSGBYTES, 0 );
+    blake2sp_final( SSP, b, BLAKE2S_OUTBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+  }
+
+  return 0;
+}
+
+/* Variants sharing a prefix, each hashed from a clone of the prefix state */
+static int test_clone( const uint8_t *key, const uint8_t *msg )
+{
+  static const size_t prefixes[] = { 0, 1, 128, 129, 256, 257, 1000 };
+
+  for( size_t i = 0; i < sizeof( prefixes ) / sizeof( prefixes[0] ); ++i )
+  {
+    blake2b_state P[1], C[1];
+    blake2bp_state PP[1], CP[1];
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+    blake2b_init( P, BLAKE2B_OUTBYTES );
+    blake2b_update( P, msg, prefixes[i] );
+    blake2bp_init( PP, BLAKE2B_OUTBYTES );
+    blake2bp_update( PP, msg, prefixes[i] );
+
+    for( size_t suffix = 0; suffix < 600; suffix += 199 )
+    {
+      blake2b_clone( C, P );
+      blake2b_update( C, msg + prefixes[i], suffix );
+      blake2b_final( C, a, BLAKE2B_OUTBYTES );
+      blake2b( b, msg, NULL, BLAKE2B_OUTBYTES, prefixes[i] + suffix, 0 );
+
+      if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+      blake2bp_clone( CP, PP );
+      blake2bp_update( CP, msg + prefixes[i], suffix );
+      blake2bp_final( CP, a, BLAKE2B_OUTBYTES );
+      blake2bp( b, msg, NULL, BLAKE2B_OUTBYTES, prefixes[i] + suffix, 0 );
+
+      if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+    }
+  }
+
+  /* A prepared state carries its empty-message MAC through a clone */
+  {
+    blake2b_prepared_key K[1];
+    blake2b_state P[1], C[1];
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+    blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key, 20 );
+    blake2b_init_prepared( P, K );
+    blake2b_clone( C, P );
+    blake2b( a, "", key, BLAKE2B_OUTBYTES, 0, 20 );
+
+    if( blake2b_final_peek( P, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+    if( blake2b_final( C, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+  }
+
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t msg[MSGBYTES];
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  if( test_peek( key, msg ) < 0 || test_clone( key, msg ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
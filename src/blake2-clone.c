@@ -0,0 +1,94 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   Clones copy the words and only the live part of the buffer, which for a
+   state between blocks is a fraction of its size. The unused buffer tail of
+   the copy is left as it was; nothing reads it before it is written,
+   save the tag that marks a prepared state, which is copied with it.
+*/
+
+int blake2s_clone( blake2s_state *dst, const blake2s_state *src )
+{
+  if( dst == src ) return 0;
+
+  memcpy( dst->h, src->h, sizeof( dst->h ) );
+  memcpy( dst->t, src->t, sizeof( dst->t ) );
+  memcpy( dst->f, src->f, sizeof( dst->f ) );
+  if( BLAKE2_PREPARED_EMPTY( src, BLAKE2S_BLOCKBYTES ) )
+  {
+    memcpy( dst->buf, src->buf, BLAKE2S_OUTBYTES );
+    BLAKE2_PREPARED_MARK( dst, BLAKE2S_BLOCKBYTES );
+  }
+  else
+    memcpy( dst->buf, src->buf, src->buflen );
+
+  dst->buflen = src->buflen;
+  dst->outlen = src->outlen;
+  dst->last_node = src->last_node;
+  return 0;
+}
+
+int blake2b_clone( blake2b_state *dst, const blake2b_state *src )
+{
+  if( dst == src ) return 0;
+
+  memcpy( dst->h, src->h, sizeof( dst->h ) );
+  memcpy( dst->t, src->t, sizeof( dst->t ) );
+  memcpy( dst->f, src->f, sizeof( dst->f ) );
+  if( BLAKE2_PREPARED_EMPTY( src, BLAKE2B_BLOCKBYTES ) )
+  {
+    memcpy( dst->buf, src->buf, BLAKE2B_OUTBYTES );
+    BLAKE2_PREPARED_MARK( dst, BLAKE2B_BLOCKBYTES );
+  }
+  else
+    memcpy( dst->buf, src->buf, src->buflen );
+
+  dst->buflen = src->buflen;
+  dst->outlen = src->outlen;
+  dst->last_node = src->last_node;
+  return 0;
+}
+
+int blake2sp_clone( blake2sp_state *dst, const blake2sp_state *src )
+{
+  if( dst == src ) return 0;
+
+  for( size_t i = 0; i < sizeof( dst->S ) / sizeof( dst->S[0] ); ++i )
+    blake2s_clone( dst->S[i], src->S[i] );
+
+  blake2s_clone( dst->R, src->R );
+  memcpy( dst->buf, src->buf, src->buflen );
+  dst->buflen = src->buflen;
+  dst->outlen = src->outlen;
+  return 0;
+}
+
+int blake2bp_clone( blake2bp_state *dst, const blake2bp_state *src )
+{
+  if( dst == src ) return 0;
+
+  for( size_t i = 0; i < sizeof( dst->S ) / sizeof( dst->S[0] ); ++i )
+    blake2b_clone( dst->S[i], src->S[i] );
+
+  blake2b_clone( dst->R, src->R );
+  memcpy( dst->buf, src->buf, src->buflen );
+  dst->buflen = src->buflen;
+  dst->outlen = src->outlen;
+  return 0;
+}
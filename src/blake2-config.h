@@ -34,6 +34,19 @@
 #define HAVE_XOP
 #endif
 
+#if defined(__AVX2__)
+#define HAVE_AVX2
+#endif
+
+#if defined(__AVX512F__)
+#define HAVE_AVX512F
+#endif
+
+#ifdef HAVE_AVX512F
+#ifndef HAVE_AVX2
+#define HAVE_AVX2
+#endif
+#endif
 
 #ifdef HAVE_AVX2
 #ifndef HAVE_AVX
@@ -0,0 +1,410 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* memfd_create */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "blake2.h"
+
+#define NREQS 1000
+#define DEPTH 16
+#define ARENA 65536
+
+/* The daemon's hello, which also heads the shared segment; a segment of RAW_BYTES holds the rest */
+#define RAW_MAGIC 0x44443242u
+#define RAW_VERSION 1
+#define RAW_BYTES ( ARENA + ( 1 << 20 ) )
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t depth;
+  uint64_t arena_bytes;
+} raw_hello;
+
+static uint8_t key[BLAKE2B_KEYBYTES];
+
+static void *serve( void *D )
+{
+  return blake2_daemon_run( ( blake2_daemon * )D ) < 0 ? D : NULL;
+}
+
+static int expected( uint8_t *out, blake2_digest_kind kind, const uint8_t *in, size_t inlen, size_t keylen, size_t outlen )
+{
+  const void *k = keylen ? key : NULL;
+
+  switch( kind )
+  {
+    case BLAKE2_DIGEST_S:  return blake2s( out, in, k, outlen, inlen, keylen );
+    case BLAKE2_DIGEST_B:  return blake2b( out, in, k, outlen, inlen, keylen );
+    case BLAKE2_DIGEST_SP: return blake2sp( out, in, k, outlen, inlen, keylen );
+    default:               return blake2bp( out, in, k, outlen, inlen, keylen );
+  }
+}
+
+/* Request i of a client: its kind, key, output length and slice of the arena all vary with i */
+static void request( size_t i, blake2_digest_kind *kind, size_t *offset, size_t *length, size_t *keylen, size_t *outlen )
+{
+  *kind = ( i % 3 ) ? BLAKE2_DIGEST_B : ( blake2_digest_kind )( i % 4 );
+  *offset = ( i * 4099 ) % ( ARENA / 2 );
+  *length = ( i * 1237 ) % ( ARENA / 2 );
+  *keylen = ( i % 5 ) ? 0 : 1 + i % BLAKE2S_KEYBYTES;
+  *outlen = ( BLAKE2_DIGEST_S == *kind || BLAKE2_DIGEST_SP == *kind ) ? 1 + i % BLAKE2S_OUTBYTES : 1 + i % BLAKE2B_OUTBYTES;
+}
+
+static int check( const blake2_client_result *r, const uint8_t *arena )
+{
+  uint8_t expect[BLAKE2B_OUTBYTES];
+  blake2_digest_kind kind;
+  size_t offset, length, keylen, outlen;
+
+  request( ( size_t )r->tag, &kind, &offset, &length, &keylen, &outlen );
+
+  if( 0 != r->status || r->outlen != outlen || expected( expect, kind, arena + offset, length, keylen, outlen ) < 0 ) return -1;
+
+  return 0 == memcmp( expect, r->digest, outlen ) ? 0 : -1;
+}
+
+/* Two clients keep their rings full while the daemon interleaves them */
+static int test_clients( blake2_client **C )
+{
+  blake2_client_result R[DEPTH];
+  size_t sent[2] = { 0, 0 }, done[2] = { 0, 0 };
+
+  while( done[0] < NREQS || done[1] < NREQS )
+  {
+    for( int c = 0; c < 2; ++c )
+    {
+      const uint8_t *arena = blake2_client_arena( C[c], NULL );
+      int n;
+
+      while( sent[c] < NREQS )
+      {
+        blake2_digest_kind kind;
+        size_t offset, length, keylen, outlen;
+
+        request( sent[c], &kind, &offset, &length, &keylen, &outlen );
+
+        if( blake2_client_submit( C[c], kind, offset, length, key, keylen, outlen, sent[c] ) < 0 )
+        {
+          if( EAGAIN != errno ) return -1;
+
+          break;
+        }
+
+        ++sent[c];
+      }
+
+      if( done[c] == NREQS ) continue;
+
+      if( ( n = blake2_client_wait( C[c], R, DEPTH ) ) <= 0 ) return -1;
+
+      for( int k = 0; k < n; ++k )
+        if( check( &R[k], arena ) < 0 ) return -1;
+
+      done[c] += ( size_t )n;
+    }
+  }
+
+  return 0;
+}
+
+static int test_errors( blake2_client *C )
+{
+  uint8_t out[BLAKE2B_OUTBYTES], expect[BLAKE2B_OUTBYTES];
+  blake2_client_result r;
+  static uint8_t msg[3000];
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 1 );
+
+  /* Checked before it reaches the ring */
+  if( blake2_client_submit( C, BLAKE2_DIGEST_B, ARENA - 10, 11, NULL, 0, 32, 0 ) == 0 || EINVAL != errno ) return -1;
+
+  /* Checked by the daemon: a BLAKE2s digest cannot be 64 bytes */
+  if( blake2_client_submit( C, BLAKE2_DIGEST_S, 0, 100, NULL, 0, 64, 7 ) < 0 ) return -1;
+
+  if( blake2_client_wait( C, &r, 1 ) != 1 || 7 != r.tag || 0 == r.status ) return -1;
+
+  if( blake2_client_hash( C, BLAKE2_DIGEST_BP, out, 48, msg, sizeof( msg ), key, 17 ) < 0 ) return -1;
+
+  blake2bp( expect, msg, key, 48, sizeof( msg ), 17 );
+  return 0 == memcmp( out, expect, 48 ) ? 0 : -1;
+}
+
+/* Connects and sends the first len bytes of hello, with memfd attached unless it is negative */
+static int send_raw( const char *path, const raw_hello *hello, size_t len, int memfd )
+{
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE( sizeof( int ) )];
+  } control;
+  struct timeval timeout = { 10, 0 };
+  struct sockaddr_un addr;
+  struct iovec iov = { ( void * )hello, len };
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  int fd;
+
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  strncpy( addr.sun_path, path, sizeof( addr.sun_path ) - 1 );
+
+  memset( &msg, 0, sizeof( msg ) );
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if( memfd >= 0 )
+  {
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof( control.buf );
+    cmsg = CMSG_FIRSTHDR( &msg );
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN( sizeof( int ) );
+    memcpy( CMSG_DATA( cmsg ), &memfd, sizeof( int ) );
+  }
+
+  if( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ) return -1;
+
+  setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+
+  if( connect( fd, ( struct sockaddr * )&addr, sizeof( addr ) ) != 0 || ( len && sendmsg( fd, &msg, 0 ) != ( ssize_t )len ) )
+  {
+    close( fd );
+    return -1;
+  }
+
+  return fd;
+}
+
+/* Does the handshake by hand with a segment of its own, as a hostile client could. If shrink, the
+   segment is truncated right after it is sent. Returns the connection once the daemon takes the
+   segment, or -1 if the daemon hangs up */
+static int connect_raw( const char *path, int memfd, int shrink )
+{
+  const raw_hello hello = { RAW_MAGIC, RAW_VERSION, DEPTH, ARENA };
+  char ack = 0;
+  int fd;
+
+  if( ftruncate( memfd, RAW_BYTES ) != 0 || pwrite( memfd, &hello, sizeof( hello ), 0 ) != ( ssize_t )sizeof( hello ) ) return -1;
+
+  if( ( fd = send_raw( path, &hello, sizeof( hello ), memfd ) ) < 0 ) return -1;
+
+  if( ( shrink && ftruncate( memfd, 0 ) != 0 ) || recv( fd, &ack, 1, 0 ) != 1 || 'k' != ack )
+  {
+    close( fd );
+    return -1;
+  }
+
+  return fd;
+}
+
+/* A client that shrinks its segment under the daemon's mapping must not bring the daemon down:
+   an unsealed segment is refused, and a sealed one cannot shrink */
+static int test_shrink( const char *path, blake2_client *C )
+{
+  uint8_t out[BLAKE2S_OUTBYTES], expect[BLAKE2S_OUTBYTES];
+  int sealed = -1, unsealed = -1, fd = -1, ret = -1;
+
+  if( ( sealed = memfd_create( "blake2-daemon-test", MFD_CLOEXEC | MFD_ALLOW_SEALING ) ) < 0 ||
+      ( unsealed = memfd_create( "blake2-daemon-test", MFD_CLOEXEC ) ) < 0 )
+    goto out;
+
+  if( ( fd = connect_raw( path, unsealed, 1 ) ) >= 0 ) goto out;
+
+  /* The same hello with a sealed segment is taken, and that segment stays whole */
+  if( fcntl( sealed, F_ADD_SEALS, F_SEAL_SHRINK ) != 0 || ( fd = connect_raw( path, sealed, 0 ) ) < 0 ||
+      ftruncate( sealed, 0 ) == 0 || EPERM != errno )
+    goto out;
+
+  if( blake2_client_hash( C, BLAKE2_DIGEST_S, out, sizeof( out ), "abc", 3, NULL, 0 ) < 0 ) goto out;
+
+  blake2s( expect, "abc", NULL, sizeof( expect ), 3, 0 );
+  ret = 0 == memcmp( out, expect, sizeof( out ) ) ? 0 : -1;
+out:
+  if( fd >= 0 ) close( fd );
+  if( sealed >= 0 ) close( sealed );
+  if( unsealed >= 0 ) close( unsealed );
+  return ret;
+}
+
+/* Open descriptors in this process, which hosts the daemon too; -1 without /proc */
+static int count_fds( void )
+{
+  DIR *dir = opendir( "/proc/self/fd" );
+  struct dirent *e;
+  int n = -1; /* dir's own descriptor */
+
+  if( NULL == dir ) return -1;
+
+  while( NULL != ( e = readdir( dir ) ) )
+    n += '.' != e->d_name[0];
+
+  closedir( dir );
+  return n;
+}
+
+/* A connection that never says hello holds up no other client, and a short hello leaks none of
+   the descriptors sent with it */
+static int test_handshake( const char *path, blake2_client *C )
+{
+  const raw_hello hello = { RAW_MAGIC, RAW_VERSION, DEPTH, ARENA };
+  uint8_t out[BLAKE2S_OUTBYTES];
+  struct timespec t0, t1;
+  int memfd, fd = -1, before, ret = -1;
+  char c;
+
+  if( ( memfd = memfd_create( "blake2-daemon-test", MFD_CLOEXEC ) ) < 0 ) return -1;
+
+  if( ( fd = send_raw( path, &hello, 0, -1 ) ) < 0 ) goto out;
+
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+  for( int i = 0; i < 4; ++i )
+    if( blake2_client_hash( C, BLAKE2_DIGEST_S, out, sizeof( out ), "abc", 3, NULL, 0 ) < 0 ) goto out;
+
+  clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+  if( ( t1.tv_sec - t0.tv_sec ) * 1000 + ( t1.tv_nsec - t0.tv_nsec ) / 1000000 >= 500 ) goto out;
+
+  /* Hanging up before the hello gets the connection dropped */
+  if( shutdown( fd, SHUT_WR ) != 0 || recv( fd, &c, 1, 0 ) != 0 ) goto out;
+
+  close( fd );
+  fd = -1;
+  before = count_fds();
+
+  /* Each one is refused, which the daemon only does once it has taken what came with it */
+  for( int i = 0; i < 64; ++i )
+  {
+    if( ( fd = send_raw( path, &hello, sizeof( hello ) / 2, memfd ) ) < 0 || recv( fd, &c, 1, 0 ) != 0 ) goto out;
+
+    close( fd );
+    fd = -1;
+  }
+
+  if( count_fds() > before || blake2_client_hash( C, BLAKE2_DIGEST_S, out, sizeof( out ), "abc", 3, NULL, 0 ) < 0 ) goto out;
+
+  ret = 0;
+out:
+  if( fd >= 0 ) close( fd );
+
+  close( memfd );
+  return ret;
+}
+
+/* The daemon clears away a stale socket at its path, but nothing else that is there */
+static int test_not_socket( const char *path )
+{
+  FILE *fp = fopen( path, "w" );
+  blake2_daemon *D;
+  int ret;
+
+  if( NULL == fp ) return -1;
+
+  fclose( fp );
+  D = blake2_daemon_create( path, 1 );
+  ret = NULL == D && EEXIST == errno && 0 == access( path, F_OK ) ? 0 : -1;
+  blake2_daemon_destroy( D );
+  unlink( path );
+  return ret;
+}
+
+int main( int argc, char **argv )
+{
+  char path[64];
+  blake2_daemon *D = NULL;
+  blake2_client *C[3] = { NULL, NULL, NULL };
+  blake2_client_result r;
+  pthread_t thread;
+  void *status = NULL;
+  int ret = -1;
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )( 0xA0 ^ i );
+
+  snprintf( path, sizeof( path ), "blake2-daemon-test.%ld.sock", ( long )getpid() );
+
+  if( test_not_socket( path ) < 0 || NULL == ( D = blake2_daemon_create( path, 3 ) ) || pthread_create( &thread, NULL, serve, D ) != 0 )
+  {
+    blake2_daemon_destroy( D );
+    puts( "error" );
+    return -1;
+  }
+
+  for( int c = 0; c < 3; ++c )
+  {
+    uint8_t *arena;
+    size_t bytes;
+
+    if( NULL == ( C[c] = blake2_client_open( path, ARENA, DEPTH ) ) || NULL == ( arena = blake2_client_arena( C[c], &bytes ) ) || ARENA != bytes )
+      goto out;
+
+    for( size_t i = 0; i < ARENA; ++i )
+      arena[i] = ( uint8_t )( i * ( 3 + 2 * c ) + c );
+  }
+
+  if( test_clients( C ) < 0 || test_errors( C[0] ) < 0 || test_shrink( path, C[1] ) < 0 ||
+      test_handshake( path, C[1] ) < 0 )
+    goto out;
+
+  /* A client may go away with requests outstanding; the daemon must drop it without fuss */
+  for( size_t i = 0; i < DEPTH; ++i )
+    if( blake2_client_submit( C[2], BLAKE2_DIGEST_B, 0, ARENA, NULL, 0, 64, i ) < 0 ) goto out;
+
+  blake2_client_close( C[2] );
+  C[2] = NULL;
+
+  if( blake2_client_hash( C[1], BLAKE2_DIGEST_S, r.digest, 32, "abc", 3, NULL, 0 ) < 0 ) goto out;
+
+  ret = 0;
+out:
+  blake2_daemon_stop( D );
+  pthread_join( thread, &status );
+  blake2_daemon_destroy( D );
+
+  /* With the daemon gone, waiting on an outstanding request fails rather than blocks */
+  if( 0 == ret && ( NULL != status || blake2_client_submit( C[0], BLAKE2_DIGEST_B, 0, 10, NULL, 0, 32, 0 ) < 0 ||
+                    blake2_client_wait( C[0], &r, 1 ) != -1 || 0 == access( path, F_OK ) ) )
+    ret = -1;
+
+  for( int c = 0; c < 3; ++c )
+    blake2_client_close( C[c] );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,1081 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* memfd_create, MSG_NOSIGNAL */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYS_UIO_H) && \
+    defined(HAVE_UNISTD_H) && defined(HAVE_FCNTL_H) && defined(HAVE_PTHREAD_H)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+#if !defined(MSG_CMSG_CLOEXEC)
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+/*
+   Each client creates one shared mapping and passes its descriptor to the
+   daemon over the Unix socket (SCM_RIGHTS) when it connects. The mapping
+   holds a header, a submission ring of requests, a completion ring of
+   results and the arena that requests point into by offset and length.
+   The mapping is a memfd sealed against shrinking, and the daemon refuses
+   any other kind: a client that truncated its segment under the daemon's
+   mapping would otherwise kill the daemon with SIGBUS.
+
+   Accepted connections are nonblocking and wait in a short pending list
+   until their hello arrives, which the poll loop reads like any other
+   event, so a client that connects and stays silent holds up nobody. It
+   is dropped after BLAKE2_DAEMON_HELLO_MS.
+
+   The submission ring has one producer, the client, and one consumer, the
+   daemon's poll loop, so a shared tail index is all it needs. Completions
+   are written by whichever worker finishes a job, so that ring is Vyukov's
+   MPMC queue: a sequence number per slot says whether it is free or filled.
+   A client never has more than depth requests unreaped, which keeps both
+   rings from overflowing; the daemon checks rather than trusts this, and
+   copies each request out of the mapping before using it.
+
+   Sleeping uses the socket only. Before the daemon blocks in poll it sets
+   need_wakeup in every mapping and looks at the rings once more; a client
+   that posts afterwards sends a byte. A client about to block sets waiting,
+   and the worker that completes one of its jobs sends a byte back. While
+   both sides are busy no system call is made per request.
+
+   Requests from all clients go into one blake2_queue, whose workers run
+   BLAKE2b jobs from different processes together in SIMD lanes.
+*/
+#define BLAKE2_DAEMON_MAGIC 0x44443242u /* "B2DD" */
+#define BLAKE2_DAEMON_VERSION 1
+#define BLAKE2_DAEMON_DEPTH 256
+#define BLAKE2_DAEMON_MAXDEPTH 65536
+#define BLAKE2_DAEMON_ARENA ( 4 * BLAKE2_STREAM_BYTES )
+#define BLAKE2_DAEMON_MAXARENA ( ( uint64_t )1 << 40 )
+#define BLAKE2_DAEMON_QUEUE 4096
+#define BLAKE2_DAEMON_PAGE 4096
+#define BLAKE2_DAEMON_PENDING 64
+#define BLAKE2_DAEMON_HELLO_MS 1000
+
+typedef struct __blake2_daemon_request
+{
+  uint64_t tag;
+  uint64_t offset;
+  uint64_t length;
+  uint8_t  kind;
+  uint8_t  outlen;
+  uint8_t  keylen;
+  uint8_t  reserved[5];
+  uint8_t  key[BLAKE2B_KEYBYTES];
+} blake2_daemon_request;
+
+typedef struct __blake2_daemon_completion
+{
+  uint64_t seq;
+  uint64_t tag;
+  int32_t  status;
+  uint8_t  outlen;
+  uint8_t  reserved[3];
+  uint8_t  digest[BLAKE2B_OUTBYTES];
+} blake2_daemon_completion;
+
+typedef struct __blake2_daemon_shared
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t depth;
+  uint64_t arena_bytes;
+  char     pad0[40];
+  uint64_t sq_tail;     /* Written by the client */
+  char     pad1[56];
+  uint32_t need_wakeup; /* Set by the daemon before it sleeps */
+  char     pad2[60];
+  uint32_t waiting;     /* Set by the client before it sleeps */
+  char     pad3[60];
+} blake2_daemon_shared;
+
+typedef struct __blake2_daemon_hello
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t depth;
+  uint64_t arena_bytes;
+} blake2_daemon_hello;
+
+typedef struct __blake2_daemon_layout
+{
+  size_t sq;
+  size_t cq;
+  size_t arena;
+  size_t total;
+} blake2_daemon_layout;
+
+typedef struct __blake2_daemon_job
+{
+  blake2_job J;
+  struct iovec iov;
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t out[BLAKE2B_OUTBYTES];
+  uint64_t tag;
+  struct __blake2_daemon_client *C;
+  int busy;
+} blake2_daemon_job;
+
+typedef struct __blake2_daemon_client
+{
+  int fd;
+  int dead;
+  void *map;
+  size_t maplen;
+  blake2_daemon_shared *shm;
+  blake2_daemon_request *sq;
+  blake2_daemon_completion *cq;
+  uint8_t *arena;
+  uint64_t arena_bytes;
+  size_t depth;
+  size_t mask;
+  uint64_t sq_head;
+  size_t cq_tail;
+  size_t inflight;
+  blake2_daemon_job *jobs; /* Request n uses jobs[n & mask] */
+} blake2_daemon_client;
+
+/* An accepted connection whose hello has not arrived yet */
+typedef struct __blake2_daemon_pending
+{
+  int fd;
+  uint64_t deadline; /* blake2_daemon_now() by which the hello must be in */
+} blake2_daemon_pending;
+
+struct __blake2_daemon
+{
+  int listen_fd;
+  int wake[2]; /* Written by blake2_daemon_stop */
+  int stop;
+  int backlog;
+  char *path;
+  blake2_queue *Q;
+  blake2_daemon_client **clients;
+  struct pollfd *pfd; /* The wake pipe, the listener, the clients, then the pending connections */
+  size_t count;
+  size_t capacity;
+  blake2_daemon_pending pending[BLAKE2_DAEMON_PENDING];
+  size_t npending;
+};
+
+struct __blake2_client
+{
+  int fd;
+  void *map;
+  size_t maplen;
+  blake2_daemon_shared *shm;
+  blake2_daemon_request *sq;
+  blake2_daemon_completion *cq;
+  uint8_t *arena;
+  size_t arena_bytes;
+  size_t depth;
+  size_t mask;
+  uint64_t sq_tail;
+  uint64_t cq_head;
+  size_t inflight;
+};
+
+static int blake2_daemon_layout_of( blake2_daemon_layout *L, uint64_t depth, uint64_t arena_bytes )
+{
+  if( 0 == depth || depth > BLAKE2_DAEMON_MAXDEPTH || ( depth & ( depth - 1 ) ) ) return -1;
+
+  if( arena_bytes > BLAKE2_DAEMON_MAXARENA || arena_bytes > SIZE_MAX / 2 ) return -1;
+
+  L->sq = sizeof( blake2_daemon_shared );
+  L->cq = L->sq + ( size_t )depth * sizeof( blake2_daemon_request );
+  L->arena = ( L->cq + ( size_t )depth * sizeof( blake2_daemon_completion ) + BLAKE2_DAEMON_PAGE - 1 ) & ~( size_t )( BLAKE2_DAEMON_PAGE - 1 );
+  L->total = L->arena + ( size_t )arena_bytes;
+  return 0;
+}
+
+static void blake2_daemon_kick( int fd )
+{
+  const char c = 0;
+
+  while( send( fd, &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL ) < 0 && EINTR == errno );
+}
+
+/* Consumes pending wake-ups; -1 once the peer has hung up */
+static int blake2_daemon_drain( int fd )
+{
+  char buf[64];
+
+  for( ;; )
+  {
+    const ssize_t n = recv( fd, buf, sizeof( buf ), MSG_DONTWAIT );
+
+    if( n > 0 ) continue;
+
+    if( 0 == n ) return -1;
+
+    if( EINTR == errno ) continue;
+
+    return EAGAIN == errno || EWOULDBLOCK == errno ? 0 : -1;
+  }
+}
+
+static void blake2_daemon_cloexec( int fd, const int nonblock )
+{
+  fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+  if( nonblock ) fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+}
+
+/* Completion ring producer; fails only for a client that broke the ring */
+static int blake2_daemon_post( blake2_daemon_client *C, const blake2_daemon_job *B, int status, size_t outlen )
+{
+  size_t pos = __atomic_load_n( &C->cq_tail, __ATOMIC_RELAXED );
+  blake2_daemon_completion *s;
+
+  for( ;; )
+  {
+    const int64_t diff = ( int64_t )( __atomic_load_n( &C->cq[pos & C->mask].seq, __ATOMIC_ACQUIRE ) - ( uint64_t )pos );
+
+    if( diff < 0 ) return -1;
+
+    if( 0 == diff && __atomic_compare_exchange_n( &C->cq_tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) break;
+
+    if( diff > 0 )
+    {
+      const size_t now = __atomic_load_n( &C->cq_tail, __ATOMIC_RELAXED );
+
+      if( now == pos ) return -1;
+
+      pos = now;
+    }
+  }
+
+  s = &C->cq[pos & C->mask];
+  s->tag = B->tag;
+  s->status = status;
+  s->outlen = ( uint8_t )outlen;
+  memcpy( s->digest, B->out, BLAKE2B_OUTBYTES );
+  __atomic_store_n( &s->seq, ( uint64_t )pos + 1, __ATOMIC_RELEASE );
+  return 0;
+}
+
+static void blake2_daemon_done( void *ctx, blake2_job *J )
+{
+  blake2_daemon_job *B = ( blake2_daemon_job * )J->user;
+  blake2_daemon_client *C = B->C;
+
+  ( void )ctx;
+
+  if( J->status < 0 ) memset( B->out, 0, sizeof( B->out ) );
+
+  secure_zero_memory( B->key, sizeof( B->key ) );
+  blake2_daemon_post( C, B, J->status, J->outlen );
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+  if( __atomic_load_n( &C->shm->waiting, __ATOMIC_SEQ_CST ) ) blake2_daemon_kick( C->fd );
+
+  __atomic_store_n( &B->busy, 0, __ATOMIC_RELEASE );
+  __atomic_sub_fetch( &C->inflight, 1, __ATOMIC_ACQ_REL );
+}
+
+/* Moves a client's new requests into the queue; returns how many were taken */
+static int blake2_daemon_take( blake2_daemon *D, blake2_daemon_client *C )
+{
+  const uint64_t tail = __atomic_load_n( &C->shm->sq_tail, __ATOMIC_ACQUIRE );
+  int taken = 0;
+
+  if( tail - C->sq_head > C->depth )
+  {
+    C->dead = 1; /* Overran its ring */
+    return 0;
+  }
+
+  while( C->sq_head != tail )
+  {
+    blake2_daemon_job *B = &C->jobs[C->sq_head & C->mask];
+    blake2_daemon_request q;
+    int bad;
+
+    if( __atomic_load_n( &B->busy, __ATOMIC_ACQUIRE ) )
+    {
+      D->backlog = 1;
+      break;
+    }
+
+    memcpy( &q, &C->sq[C->sq_head & C->mask], sizeof( q ) );
+    bad = q.kind > BLAKE2_DIGEST_BP || q.offset > C->arena_bytes || q.length > C->arena_bytes - q.offset;
+
+    memset( &B->J, 0, sizeof( B->J ) );
+    memcpy( B->key, q.key, q.keylen < BLAKE2B_KEYBYTES ? q.keylen : BLAKE2B_KEYBYTES );
+    B->tag = q.tag;
+    B->C = C;
+    B->iov.iov_base = bad ? NULL : C->arena + q.offset;
+    B->iov.iov_len = bad ? 0 : ( size_t )q.length;
+    B->J.kind = bad ? BLAKE2_DIGEST_B : ( blake2_digest_kind )q.kind;
+    B->J.iov = &B->iov;
+    B->J.iovcnt = 1;
+    B->J.key = B->key;
+    B->J.keylen = q.keylen;
+    B->J.out = B->out;
+    B->J.outlen = q.outlen;
+    B->J.user = B;
+    B->busy = 1;
+    __atomic_add_fetch( &C->inflight, 1, __ATOMIC_ACQ_REL );
+
+    if( bad )
+    {
+      B->J.status = -1;
+      blake2_daemon_done( NULL, &B->J );
+    }
+    else if( blake2_queue_submit( D->Q, &B->J ) < 0 )
+    {
+      B->busy = 0;
+      __atomic_sub_fetch( &C->inflight, 1, __ATOMIC_ACQ_REL );
+      D->backlog = 1;
+      break;
+    }
+
+    ++C->sq_head;
+    ++taken;
+  }
+
+  return taken;
+}
+
+static void blake2_daemon_detach( blake2_daemon_client *C )
+{
+  close( C->fd );
+  munmap( C->map, C->maplen );
+  free( C->jobs );
+  free( C );
+}
+
+/* Nonzero if memfd can no longer shrink, so that the whole mapping stays backed */
+static int blake2_daemon_sealed( int memfd )
+{
+#if defined(F_GET_SEALS) && defined(F_SEAL_SHRINK)
+  const int seals = fcntl( memfd, F_GET_SEALS );
+
+  return seals >= 0 && 0 != ( seals & F_SEAL_SHRINK );
+#else
+  ( void )memfd;
+  return 0;
+#endif
+}
+
+/* Milliseconds on a monotonic clock, for handshake deadlines */
+static uint64_t blake2_daemon_now( void )
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if( 0 == clock_gettime( CLOCK_MONOTONIC, &ts ) ) return ( uint64_t )ts.tv_sec * 1000 + ( uint64_t )ts.tv_nsec / 1000000;
+#endif
+  return ( uint64_t )time( NULL ) * 1000;
+}
+
+/* Makes room for one more client, and its entry in the poll set */
+static int blake2_daemon_reserve( blake2_daemon *D )
+{
+  const size_t grown = D->capacity ? 2 * D->capacity : 16;
+  blake2_daemon_client **clients;
+  struct pollfd *pfd;
+
+  if( D->count < D->capacity ) return 0;
+
+  if( NULL == ( clients = ( blake2_daemon_client ** )realloc( D->clients, grown * sizeof( *clients ) ) ) ) return -1;
+
+  D->clients = clients;
+
+  if( NULL == ( pfd = ( struct pollfd * )realloc( D->pfd, ( 2 + BLAKE2_DAEMON_PENDING + grown ) * sizeof( *pfd ) ) ) ) return -1;
+
+  D->pfd = pfd;
+  D->capacity = grown;
+  return 0;
+}
+
+/*
+   Reads the hello and the mapping's descriptor from a pending connection,
+   maps it and adds the client. Returns 1 once attached, 0 while the hello
+   has yet to arrive and -1 if the connection is refused. Every descriptor
+   that came with the hello is taken and closed, whatever else is wrong.
+*/
+static int blake2_daemon_attach( blake2_daemon *D, int fd )
+{
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE( sizeof( int ) )];
+  } control;
+  blake2_daemon_hello hello;
+  blake2_daemon_layout L;
+  blake2_daemon_client *C = NULL;
+  struct iovec iov;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct stat st;
+  int memfd = -1;
+  ssize_t n;
+  void *map;
+
+  memset( &msg, 0, sizeof( msg ) );
+  iov.iov_base = &hello;
+  iov.iov_len = sizeof( hello );
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof( control.buf );
+
+  if( ( n = recvmsg( fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC ) ) < 0 )
+    return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno ? 0 : -1;
+
+  for( cmsg = CMSG_FIRSTHDR( &msg ); cmsg; cmsg = CMSG_NXTHDR( &msg, cmsg ) )
+  {
+    if( SOL_SOCKET != cmsg->cmsg_level || SCM_RIGHTS != cmsg->cmsg_type ) continue;
+
+    for( size_t i = 0; ( i + 1 ) * sizeof( int ) <= cmsg->cmsg_len - CMSG_LEN( 0 ); ++i )
+    {
+      int passed;
+
+      memcpy( &passed, CMSG_DATA( cmsg ) + i * sizeof( int ), sizeof( int ) );
+
+      if( memfd < 0 )
+        memfd = passed;
+      else
+        close( passed );
+    }
+  }
+
+  if( memfd < 0 ) return -1;
+
+  if( ( ssize_t )sizeof( hello ) != n || BLAKE2_DAEMON_MAGIC != hello.magic || BLAKE2_DAEMON_VERSION != hello.version ||
+      blake2_daemon_layout_of( &L, hello.depth, hello.arena_bytes ) < 0 || !blake2_daemon_sealed( memfd ) ||
+      fstat( memfd, &st ) != 0 || ( uint64_t )st.st_size < L.total || blake2_daemon_reserve( D ) < 0 ||
+      MAP_FAILED == ( map = mmap( NULL, L.total, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0 ) ) )
+  {
+    close( memfd );
+    return -1;
+  }
+
+  close( memfd );
+
+  if( NULL == ( C = ( blake2_daemon_client * )calloc( 1, sizeof( *C ) ) ) ||
+      NULL == ( C->jobs = ( blake2_daemon_job * )calloc( ( size_t )hello.depth, sizeof( *C->jobs ) ) ) )
+  {
+    free( C );
+    munmap( map, L.total );
+    return -1;
+  }
+
+  C->fd = fd;
+  C->map = map;
+  C->maplen = L.total;
+  C->shm = ( blake2_daemon_shared * )map;
+  C->sq = ( blake2_daemon_request * )( ( uint8_t * )map + L.sq );
+  C->cq = ( blake2_daemon_completion * )( ( uint8_t * )map + L.cq );
+  C->arena = ( uint8_t * )map + L.arena;
+  C->arena_bytes = hello.arena_bytes;
+  C->depth = ( size_t )hello.depth;
+  C->mask = C->depth - 1;
+
+  if( C->shm->magic != hello.magic || C->shm->depth != hello.depth || C->shm->arena_bytes != hello.arena_bytes ||
+      send( fd, "k", 1, MSG_NOSIGNAL ) != 1 )
+  {
+    C->fd = -1;
+    blake2_daemon_detach( C );
+    return -1;
+  }
+
+  D->clients[D->count++] = C;
+  return 1;
+}
+
+/* Takes new connections while there is room for them; their hellos are read from the poll loop */
+static void blake2_daemon_accept( blake2_daemon *D )
+{
+  while( D->npending < BLAKE2_DAEMON_PENDING )
+  {
+    const int fd = accept( D->listen_fd, NULL, NULL );
+
+    if( fd < 0 ) break;
+
+    blake2_daemon_cloexec( fd, 1 );
+    D->pending[D->npending].fd = fd;
+    D->pending[D->npending].deadline = blake2_daemon_now() + BLAKE2_DAEMON_HELLO_MS;
+    ++D->npending;
+  }
+}
+
+blake2_daemon *blake2_daemon_create( const char *path, unsigned threads )
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  blake2_daemon *D;
+  int fd;
+
+  if( NULL == path || strlen( path ) >= sizeof( addr.sun_path ) ) return NULL;
+
+  if( 0 == threads )
+  {
+    const long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+    threads = n > 0 ? ( unsigned )n : 1;
+  }
+
+  if( NULL == ( D = ( blake2_daemon * )calloc( 1, sizeof( *D ) ) ) ) return NULL;
+
+  D->listen_fd = D->wake[0] = D->wake[1] = -1;
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  memcpy( addr.sun_path, path, strlen( path ) );
+
+  if( pipe( D->wake ) < 0 || NULL == ( D->path = strdup( path ) ) ||
+      NULL == ( D->pfd = ( struct pollfd * )malloc( ( 2 + BLAKE2_DAEMON_PENDING ) * sizeof( *D->pfd ) ) ) ||
+      NULL == ( D->Q = blake2_queue_create( threads, BLAKE2_DAEMON_QUEUE, blake2_daemon_done, NULL ) ) )
+    goto fail;
+
+  blake2_daemon_cloexec( D->wake[0], 1 );
+  blake2_daemon_cloexec( D->wake[1], 1 );
+
+  /* A socket file nobody answers on is left over from an earlier run and may go; a live one, or
+     anything that is not a socket, may not */
+  if( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ) goto fail;
+
+  if( 0 == connect( fd, ( struct sockaddr * )&addr, sizeof( addr ) ) )
+  {
+    close( fd );
+    errno = EADDRINUSE;
+    goto fail;
+  }
+
+  close( fd );
+
+  if( 0 == lstat( path, &st ) )
+  {
+    if( !S_ISSOCK( st.st_mode ) )
+    {
+      errno = EEXIST;
+      goto fail;
+    }
+
+    unlink( path );
+  }
+
+  if( ( D->listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ) goto fail;
+
+  blake2_daemon_cloexec( D->listen_fd, 1 );
+
+  if( bind( D->listen_fd, ( struct sockaddr * )&addr, sizeof( addr ) ) < 0 ) goto fail;
+
+  if( listen( D->listen_fd, 64 ) < 0 )
+  {
+    unlink( path );
+    goto fail;
+  }
+
+  return D;
+fail:
+  if( D->listen_fd >= 0 ) close( D->listen_fd );
+
+  if( D->wake[0] >= 0 ) close( D->wake[0] );
+
+  if( D->wake[1] >= 0 ) close( D->wake[1] );
+
+  blake2_queue_destroy( D->Q );
+  free( D->pfd );
+  free( D->path );
+  free( D );
+  return NULL;
+}
+
+int blake2_daemon_run( blake2_daemon *D )
+{
+  if( NULL == D ) return -1;
+
+  while( !__atomic_load_n( &D->stop, __ATOMIC_ACQUIRE ) )
+  {
+    int taken = 0, dying = 0, timeout = -1;
+    size_t n = 0, pending;
+    uint64_t now;
+
+    D->backlog = 0;
+
+    for( size_t i = 0; i < D->count; ++i )
+    {
+      if( !D->clients[i]->dead ) taken += blake2_daemon_take( D, D->clients[i] );
+    }
+
+    /* About to sleep: clients posting from here on kick the socket, and anything posted before is seen now */
+    if( 0 == taken && !D->backlog )
+    {
+      for( size_t i = 0; i < D->count; ++i )
+        __atomic_store_n( &D->clients[i]->shm->need_wakeup, 1, __ATOMIC_SEQ_CST );
+
+      __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+      for( size_t i = 0; i < D->count; ++i )
+      {
+        if( !D->clients[i]->dead ) taken += blake2_daemon_take( D, D->clients[i] );
+      }
+    }
+
+    /* Gone clients are let go once no worker can touch their mapping */
+    for( size_t i = 0; i < D->count; ++i )
+    {
+      blake2_daemon_client *C = D->clients[i];
+
+      if( C->dead && 0 == __atomic_load_n( &C->inflight, __ATOMIC_ACQUIRE ) )
+        blake2_daemon_detach( C );
+      else
+      {
+        dying |= C->dead;
+        D->clients[n++] = C;
+      }
+    }
+
+    D->count = n;
+
+    if( taken > 0 )
+      timeout = 0;
+    else if( D->backlog || dying )
+      timeout = 1;
+
+    /* Connections still silent at their deadline are dropped; until then they bound the sleep */
+    now = blake2_daemon_now();
+    n = 0;
+
+    for( size_t i = 0; i < D->npending; ++i )
+    {
+      const blake2_daemon_pending *P = &D->pending[i];
+
+      if( P->deadline <= now )
+        close( P->fd );
+      else
+      {
+        if( timeout < 0 || P->deadline - now < ( uint64_t )timeout ) timeout = ( int )( P->deadline - now );
+
+        D->pending[n++] = *P;
+      }
+    }
+
+    D->npending = n;
+    D->pfd[0].fd = D->wake[0];
+    D->pfd[1].fd = D->npending < BLAKE2_DAEMON_PENDING ? D->listen_fd : -1;
+
+    for( size_t i = 0; i < D->count; ++i )
+      D->pfd[2 + i].fd = D->clients[i]->dead ? -1 : D->clients[i]->fd;
+
+    for( size_t i = 0; i < D->npending; ++i )
+      D->pfd[2 + D->count + i].fd = D->pending[i].fd;
+
+    for( size_t i = 0; i < 2 + D->count + D->npending; ++i )
+    {
+      D->pfd[i].events = POLLIN;
+      D->pfd[i].revents = 0;
+    }
+
+    if( poll( D->pfd, ( nfds_t )( 2 + D->count + D->npending ), timeout ) < 0 && EINTR != errno ) return -1;
+
+    for( size_t i = 0; i < D->count; ++i )
+    {
+      blake2_daemon_client *C = D->clients[i];
+
+      if( D->pfd[2 + i].revents && blake2_daemon_drain( C->fd ) < 0 ) C->dead = 1;
+
+      __atomic_store_n( &C->shm->need_wakeup, 0, __ATOMIC_RELAXED );
+    }
+
+    /* Attaching appends to the clients, so the pending entries are found by their offset from before */
+    pending = 2 + D->count;
+    n = 0;
+
+    for( size_t i = 0; i < D->npending; ++i )
+    {
+      const int ret = D->pfd[pending + i].revents ? blake2_daemon_attach( D, D->pending[i].fd ) : 0;
+
+      if( 0 == ret )
+        D->pending[n++] = D->pending[i];
+      else if( ret < 0 )
+        close( D->pending[i].fd );
+    }
+
+    D->npending = n;
+
+    if( D->pfd[0].revents ) blake2_daemon_drain( D->wake[0] );
+
+    if( D->pfd[1].revents ) blake2_daemon_accept( D );
+  }
+
+  return 0;
+}
+
+void blake2_daemon_stop( blake2_daemon *D )
+{
+  const char c = 0;
+
+  if( NULL == D ) return;
+
+  __atomic_store_n( &D->stop, 1, __ATOMIC_RELEASE );
+
+  while( write( D->wake[1], &c, 1 ) < 0 && EINTR == errno );
+}
+
+void blake2_daemon_destroy( blake2_daemon *D )
+{
+  if( NULL == D ) return;
+
+  /* Finishes every job first, so no worker refers to a client any more */
+  blake2_queue_destroy( D->Q );
+
+  for( size_t i = 0; i < D->count; ++i )
+    blake2_daemon_detach( D->clients[i] );
+
+  for( size_t i = 0; i < D->npending; ++i )
+    close( D->pending[i].fd );
+
+  close( D->listen_fd );
+  unlink( D->path );
+  close( D->wake[0] );
+  close( D->wake[1] );
+  free( D->clients );
+  free( D->pfd );
+  free( D->path );
+  free( D );
+}
+
+/* The daemon only maps segments that cannot shrink; without sealing there is no client */
+static int blake2_client_memfd( size_t size )
+{
+#if defined(HAVE_MEMFD_CREATE) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS) && defined(F_SEAL_SHRINK)
+  int fd = memfd_create( "blake2-client", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+
+  if( fd >= 0 && ( ftruncate( fd, ( off_t )size ) != 0 || fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL ) != 0 ) )
+  {
+    close( fd );
+    fd = -1;
+  }
+
+  return fd;
+#else
+  ( void )size;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+blake2_client *blake2_client_open( const char *path, size_t arena_bytes, size_t depth )
+{
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE( sizeof( int ) )];
+  } control;
+  struct sockaddr_un addr;
+  blake2_daemon_hello hello;
+  blake2_daemon_layout L;
+  blake2_client *C;
+  struct iovec iov;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  int memfd;
+  char ack = 0;
+
+  if( NULL == path || strlen( path ) >= sizeof( addr.sun_path ) ) return NULL;
+
+  if( 0 == depth ) depth = BLAKE2_DAEMON_DEPTH;
+
+  if( 0 == arena_bytes ) arena_bytes = BLAKE2_DAEMON_ARENA;
+
+  while( depth & ( depth - 1 ) ) depth += depth & -depth; /* Round up to a power of two */
+
+  if( blake2_daemon_layout_of( &L, depth, arena_bytes ) < 0 ) return NULL;
+
+  if( NULL == ( C = ( blake2_client * )calloc( 1, sizeof( *C ) ) ) ) return NULL;
+
+  C->fd = -1;
+  C->map = MAP_FAILED;
+
+  if( ( memfd = blake2_client_memfd( L.total ) ) < 0 ) goto fail;
+
+  if( MAP_FAILED == ( C->map = mmap( NULL, L.total, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0 ) ) ) goto fail;
+
+  C->maplen = L.total;
+  C->shm = ( blake2_daemon_shared * )C->map;
+  C->sq = ( blake2_daemon_request * )( ( uint8_t * )C->map + L.sq );
+  C->cq = ( blake2_daemon_completion * )( ( uint8_t * )C->map + L.cq );
+  C->arena = ( uint8_t * )C->map + L.arena;
+  C->arena_bytes = arena_bytes;
+  C->depth = depth;
+  C->mask = depth - 1;
+
+  C->shm->magic = BLAKE2_DAEMON_MAGIC;
+  C->shm->version = BLAKE2_DAEMON_VERSION;
+  C->shm->depth = depth;
+  C->shm->arena_bytes = arena_bytes;
+
+  for( size_t i = 0; i < depth; ++i )
+    C->cq[i].seq = i;
+
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  memcpy( addr.sun_path, path, strlen( path ) );
+
+  if( ( C->fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ) goto fail;
+
+  blake2_daemon_cloexec( C->fd, 0 );
+
+  if( connect( C->fd, ( struct sockaddr * )&addr, sizeof( addr ) ) < 0 ) goto fail;
+
+  hello.magic = BLAKE2_DAEMON_MAGIC;
+  hello.version = BLAKE2_DAEMON_VERSION;
+  hello.depth = depth;
+  hello.arena_bytes = arena_bytes;
+
+  memset( &msg, 0, sizeof( msg ) );
+  memset( &control, 0, sizeof( control ) );
+  iov.iov_base = &hello;
+  iov.iov_len = sizeof( hello );
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof( control.buf );
+  cmsg = CMSG_FIRSTHDR( &msg );
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN( sizeof( int ) );
+  memcpy( CMSG_DATA( cmsg ), &memfd, sizeof( int ) );
+
+  if( sendmsg( C->fd, &msg, MSG_NOSIGNAL ) != ( ssize_t )sizeof( hello ) ) goto fail;
+
+  if( recv( C->fd, &ack, 1, 0 ) != 1 || 'k' != ack ) goto fail;
+
+  close( memfd );
+  return C;
+fail:
+  if( memfd >= 0 ) close( memfd );
+
+  if( C->fd >= 0 ) close( C->fd );
+
+  if( MAP_FAILED != C->map ) munmap( C->map, L.total );
+
+  free( C );
+  return NULL;
+}
+
+uint8_t *blake2_client_arena( blake2_client *C, size_t *arena_bytes )
+{
+  if( NULL == C ) return NULL;
+
+  if( arena_bytes ) *arena_bytes = C->arena_bytes;
+
+  return C->arena;
+}
+
+int blake2_client_submit( blake2_client *C, blake2_digest_kind kind, size_t offset, size_t length, const void *key, size_t keylen, size_t outlen, uint64_t tag )
+{
+  blake2_daemon_request *q;
+
+  if( NULL == C || ( unsigned )kind > BLAKE2_DIGEST_BP || 0 == outlen || outlen > BLAKE2B_OUTBYTES ||
+      ( NULL == key && keylen > 0 ) || keylen > BLAKE2B_KEYBYTES ||
+      offset > C->arena_bytes || length > C->arena_bytes - offset )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if( C->inflight == C->depth )
+  {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  q = &C->sq[C->sq_tail & C->mask];
+  q->tag = tag;
+  q->offset = offset;
+  q->length = length;
+  q->kind = ( uint8_t )kind;
+  q->outlen = ( uint8_t )outlen;
+  q->keylen = ( uint8_t )keylen;
+  memset( q->key, 0, sizeof( q->key ) );
+
+  if( keylen ) memcpy( q->key, key, keylen );
+
+  __atomic_store_n( &C->shm->sq_tail, ++C->sq_tail, __ATOMIC_RELEASE );
+  ++C->inflight;
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+  if( __atomic_load_n( &C->shm->need_wakeup, __ATOMIC_SEQ_CST ) ) blake2_daemon_kick( C->fd );
+
+  return 0;
+}
+
+size_t blake2_client_reap( blake2_client *C, blake2_client_result *R, size_t max )
+{
+  size_t n = 0;
+
+  if( NULL == C || NULL == R ) return 0;
+
+  while( n < max )
+  {
+    blake2_daemon_completion *s = &C->cq[C->cq_head & C->mask];
+
+    if( __atomic_load_n( &s->seq, __ATOMIC_ACQUIRE ) != C->cq_head + 1 ) break;
+
+    R[n].tag = s->tag;
+    R[n].status = s->status;
+    R[n].outlen = s->outlen;
+    memcpy( R[n].digest, s->digest, BLAKE2B_OUTBYTES );
+    __atomic_store_n( &s->seq, C->cq_head + C->depth, __ATOMIC_RELEASE );
+    ++C->cq_head;
+    --C->inflight;
+    ++n;
+  }
+
+  return n;
+}
+
+int blake2_client_wait( blake2_client *C, blake2_client_result *R, size_t max )
+{
+  size_t n;
+
+  if( NULL == C || NULL == R || 0 == max ) return -1;
+
+  for( ;; )
+  {
+    struct pollfd pfd;
+    int gone;
+
+    if( ( n = blake2_client_reap( C, R, max ) ) > 0 ) return ( int )n;
+
+    if( 0 == C->inflight ) return 0;
+
+    /* Set before the last look, so a completion posted after it is followed by a kick */
+    __atomic_store_n( &C->shm->waiting, 1, __ATOMIC_SEQ_CST );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    if( ( n = blake2_client_reap( C, R, max ) ) > 0 )
+    {
+      __atomic_store_n( &C->shm->waiting, 0, __ATOMIC_RELAXED );
+      return ( int )n;
+    }
+
+    pfd.fd = C->fd;
+    pfd.events = POLLIN;
+    gone = poll( &pfd, 1, -1 ) < 0 && EINTR != errno;
+    __atomic_store_n( &C->shm->waiting, 0, __ATOMIC_RELAXED );
+
+    if( gone || blake2_daemon_drain( C->fd ) < 0 )
+    {
+      n = blake2_client_reap( C, R, max );
+      return n > 0 ? ( int )n : -1;
+    }
+  }
+}
+
+int blake2_client_hash( blake2_client *C, blake2_digest_kind kind, uint8_t *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
+{
+  blake2_client_result r;
+
+  if( NULL == C || NULL == out || C->inflight > 0 || inlen > C->arena_bytes || ( NULL == in && inlen > 0 ) ) return -1;
+
+  if( inlen ) memcpy( C->arena, in, inlen );
+
+  if( blake2_client_submit( C, kind, 0, inlen, key, keylen, outlen, 0 ) < 0 ) return -1;
+
+  if( blake2_client_wait( C, &r, 1 ) != 1 || 0 != r.status ) return -1;
+
+  memcpy( out, r.digest, outlen );
+  return 0;
+}
+
+void blake2_client_close( blake2_client *C )
+{
+  if( NULL == C ) return;
+
+  close( C->fd );
+  munmap( C->map, C->maplen );
+  free( C );
+}
+#else
+blake2_daemon *blake2_daemon_create( const char *path, unsigned threads )
+{
+  return NULL;
+}
+
+int blake2_daemon_run( blake2_daemon *D )
+{
+  return -1;
+}
+
+void blake2_daemon_stop( blake2_daemon *D )
+{
+}
+
+void blake2_daemon_destroy( blake2_daemon *D )
+{
+}
+
+blake2_client *blake2_client_open( const char *path, size_t arena_bytes, size_t depth )
+{
+  return NULL;
+}
+
+uint8_t *blake2_client_arena( blake2_client *C, size_t *arena_bytes )
+{
+  return NULL;
+}
+
+int blake2_client_submit( blake2_client *C, blake2_digest_kind kind, size_t offset, size_t length, const void *key, size_t keylen, size_t outlen, uint64_t tag )
+{
+  return -1;
+}
+
+size_t blake2_client_reap( blake2_client *C, blake2_client_result *R, size_t max )
+{
+  return 0;
+}
+
+int blake2_client_wait( blake2_client *C, blake2_client_result *R, size_t max )
+{
+  return -1;
+}
+
+int blake2_client_hash( blake2_client *C, blake2_digest_kind kind, uint8_t *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
+{
+  return -1;
+}
+
+void blake2_client_close( blake2_client *C )
+{
+}
+#endif
@@ -0,0 +1,158 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define MSGBYTES ( 200 * 1024 + 77 )
+#define NSTATES 21
+
+/* Unkeyed BLAKE2b-512, keyed BLAKE2b-256 and BLAKE2bp of one object, updated in two uneven calls */
+static int test_mixed( const uint8_t *key, const uint8_t *msg )
+{
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  blake2b_state B512[1], B256[1];
+  blake2bp_state BP[1];
+  blake2_digest D[3];
+
+  blake2b_init( B512, 64 );
+  blake2b_init_key( B256, 32, key, 32 );
+  blake2bp_init( BP, 64 );
+
+  D[0].kind = BLAKE2_DIGEST_B;
+  D[0].S.b = B512;
+  D[1].kind = BLAKE2_DIGEST_B;
+  D[1].S.b = B256;
+  D[2].kind = BLAKE2_DIGEST_BP;
+  D[2].S.bp = BP;
+
+  if( blake2_update_digests( D, 3, msg, 1000 ) < 0 ||
+      blake2_update_digests( D, 3, msg + 1000, MSGBYTES - 1000 ) < 0 )
+    return -1;
+
+  blake2b( a, msg, NULL, 64, MSGBYTES, 0 );
+  blake2b_final( B512, b, 64 );
+
+  if( 0 != memcmp( a, b, 64 ) ) return -1;
+
+  blake2b( a, msg, key, 32, MSGBYTES, 32 );
+  blake2b_final( B256, b, 32 );
+
+  if( 0 != memcmp( a, b, 32 ) ) return -1;
+
+  blake2bp( a, msg, NULL, 64, MSGBYTES, 0 );
+  blake2bp_final( BP, b, 64 );
+
+  return 0 == memcmp( a, b, 64 ) ? 0 : -1;
+}
+
+/* More BLAKE2b states than one lane batch, interleaved with the other kinds */
+static int test_many( const uint8_t *key, const uint8_t *msg )
+{
+  blake2s_state  SS[NSTATES];
+  blake2b_state  SB[NSTATES];
+  blake2sp_state SSP[NSTATES];
+  blake2bp_state SBP[NSTATES];
+  blake2_digest D[NSTATES];
+
+  for( size_t i = 0; i < NSTATES; ++i )
+  {
+    D[i].kind = ( blake2_digest_kind )( i % 5 == 4 ? i % 4 : BLAKE2_DIGEST_B );
+
+    switch( D[i].kind )
+    {
+      case BLAKE2_DIGEST_S:
+        blake2s_init_key( &SS[i], 1 + i, key, 1 + i );
+        D[i].S.s = &SS[i];
+        break;
+
+      case BLAKE2_DIGEST_B:
+        blake2b_init_key( &SB[i], 1 + i * 3, key, 1 + i );
+        D[i].S.b = &SB[i];
+        break;
+
+      case BLAKE2_DIGEST_SP:
+        blake2sp_init( &SSP[i], 1 + i );
+        D[i].S.sp = &SSP[i];
+        break;
+
+      case BLAKE2_DIGEST_BP:
+        blake2bp_init_key( &SBP[i], 1 + i * 3, key, 1 + i );
+        D[i].S.bp = &SBP[i];
+        break;
+    }
+  }
+
+  if( blake2_update_digests( D, NSTATES, msg, MSGBYTES ) < 0 ) return -1;
+
+  for( size_t i = 0; i < NSTATES; ++i )
+  {
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+    size_t outlen;
+
+    switch( D[i].kind )
+    {
+      case BLAKE2_DIGEST_S:
+        outlen = 1 + i;
+        blake2s( a, msg, key, outlen, MSGBYTES, 1 + i );
+        blake2s_final( &SS[i], b, outlen );
+        break;
+
+      case BLAKE2_DIGEST_B:
+        outlen = 1 + i * 3;
+        blake2b( a, msg, key, outlen, MSGBYTES, 1 + i );
+        blake2b_final( &SB[i], b, outlen );
+        break;
+
+      case BLAKE2_DIGEST_SP:
+        outlen = 1 + i;
+        blake2sp( a, msg, NULL, outlen, MSGBYTES, 0 );
+        blake2sp_final( &SSP[i], b, outlen );
+        break;
+
+      default:
+        outlen = 1 + i * 3;
+        blake2bp( a, msg, key, outlen, MSGBYTES, 1 + i );
+        blake2bp_final( &SBP[i], b, outlen );
+        break;
+    }
+
+    if( 0 != memcmp( a, b, outlen ) ) return -1;
+  }
+
+  /* Unknown kinds are rejected before any state is touched */
+  D[0].kind = ( blake2_digest_kind )7;
+
+  return blake2_update_digests( D, NSTATES, msg, 1 ) == 0 ? -1 : 0;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t *msg = ( uint8_t * )malloc( MSGBYTES );
+  int ret;
+
+  if( NULL == msg ) return -1;
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < MSGBYTES; ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  ret = test_mixed( key, msg ) < 0 || test_many( key, msg ) < 0 ? -1 : 0;
+  free( msg );
+  puts( ret < 0 ? "error" : "ok" );
+  return ret;
+}
@@ -0,0 +1,87 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   The input is walked in chunks small enough to stay in L2 while every state
+   consumes them, and large enough to amortize the thread start-up of the
+   parallel variants, so memory is read once however many digests are asked
+   for. BLAKE2b states at any parameters advance together through
+   blake2b_update_multi, which runs them in SIMD lanes where available.
+*/
+#define BLAKE2_DIGESTS_CHUNK ( 64 * 1024 )
+#define BLAKE2_DIGESTS_BATCH 16
+
+int blake2_update_digests( const blake2_digest *D, size_t count, const void *in, size_t inlen )
+{
+  blake2b_update_item items[BLAKE2_DIGESTS_BATCH];
+  const uint8_t *p = ( const uint8_t * )in;
+
+  if( NULL == p && inlen > 0 ) return -1;
+
+  if( NULL == D && count > 0 ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    if( ( unsigned )D[i].kind > BLAKE2_DIGEST_BP || NULL == D[i].S.b ) return -1;
+  }
+
+  while( inlen > 0 )
+  {
+    const size_t n = inlen < BLAKE2_DIGESTS_CHUNK ? inlen : BLAKE2_DIGESTS_CHUNK;
+    size_t nb = 0;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+      switch( D[i].kind )
+      {
+        case BLAKE2_DIGEST_S:
+          blake2s_update( D[i].S.s, p, n );
+          break;
+
+        case BLAKE2_DIGEST_B:
+          items[nb].S = D[i].S.b;
+          items[nb].in = p;
+          items[nb].inlen = n;
+
+          if( ++nb == BLAKE2_DIGESTS_BATCH )
+          {
+            blake2b_update_multi( items, nb );
+            nb = 0;
+          }
+
+          break;
+
+        case BLAKE2_DIGEST_SP:
+          blake2sp_update( D[i].S.sp, p, n );
+          break;
+
+        case BLAKE2_DIGEST_BP:
+          blake2bp_update( D[i].S.bp, p, n );
+          break;
+      }
+    }
+
+    if( nb > 0 ) blake2b_update_multi( items, nb );
+
+    p += n;
+    inlen -= n;
+  }
+
+  return 0;
+}
@@ -167,6 +167,14 @@ extern "C" {
   int blake2b_init_param_ref( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_ref( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_ref( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_ref( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_ref( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_ref( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_ref( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_ref( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_ref( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_ref( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_ref( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_ref( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
 #if defined(HAVE_X86)
@@ -176,6 +184,14 @@ extern "C" {
   int blake2b_init_param_sse2( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_sse2( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_sse2( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_sse2( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_sse2( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_sse2( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_sse2( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_sse2( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_sse2( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_sse2( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_sse2( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_sse2( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2b_init_ssse3( blake2b_state *S, size_t outlen );
@@ -183,6 +199,14 @@ extern "C" {
   int blake2b_init_param_ssse3( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_ssse3( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_ssse3( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_ssse3( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_ssse3( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_ssse3( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_ssse3( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_ssse3( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_ssse3( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_ssse3( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_ssse3( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_ssse3( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2b_init_sse41( blake2b_state *S, size_t outlen );
@@ -190,6 +214,14 @@ extern "C" {
   int blake2b_init_param_sse41( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_sse41( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_sse41( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_sse41( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_sse41( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_sse41( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_sse41( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_sse41( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_sse41( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_sse41( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_sse41( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_sse41( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2b_init_avx( blake2b_state *S, size_t outlen );
@@ -197,6 +229,14 @@ extern "C" {
   int blake2b_init_param_avx( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_avx( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_avx( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_avx( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_avx( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_avx( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_avx( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_avx( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_avx( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_avx( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_avx( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_avx( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2b_init_xop( blake2b_state *S, size_t outlen );
@@ -204,6 +244,14 @@ extern "C" {
   int blake2b_init_param_xop( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_xop( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_xop( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_xop( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_xop( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_xop( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_xop( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_xop( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_xop( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_xop( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_xop( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_xop( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
 #endif /* HAVE_X86 */
@@ -213,6 +261,13 @@ extern "C" {
   int blake2s_init_param_ref( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_ref( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_ref( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_ref( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_ref( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_ref( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_ref( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_ref( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_ref( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_ref( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_ref( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
 #if defined(HAVE_X86)
@@ -222,6 +277,13 @@ extern "C" {
   int blake2s_init_param_sse2( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_sse2( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_sse2( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_sse2( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_sse2( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_sse2( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_sse2( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_sse2( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_sse2( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_sse2( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_sse2( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2s_init_ssse3( blake2s_state *S, size_t outlen );
@@ -229,6 +291,13 @@ extern "C" {
   int blake2s_init_param_ssse3( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_ssse3( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_ssse3( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_ssse3( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_ssse3( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_ssse3( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_ssse3( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_ssse3( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_ssse3( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_ssse3( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_ssse3( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2s_init_sse41( blake2s_state *S, size_t outlen );
@@ -236,6 +305,13 @@ extern "C" {
   int blake2s_init_param_sse41( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_sse41( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_sse41( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_sse41( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_sse41( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_sse41( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_sse41( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_sse41( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_sse41( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_sse41( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_sse41( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2s_init_avx( blake2s_state *S, size_t outlen );
@@ -243,6 +319,13 @@ extern "C" {
   int blake2s_init_param_avx( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_avx( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_avx( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_avx( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_avx( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_avx( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_avx( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_avx( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_avx( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_avx( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_avx( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2s_init_xop( blake2s_state *S, size_t outlen );
@@ -250,6 +333,13 @@ extern "C" {
   int blake2s_init_param_xop( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_xop( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_xop( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_xop( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_xop( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_xop( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_xop( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_xop( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_xop( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_xop( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_xop( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
 #endif /* HAVE_X86 */
@@ -263,6 +353,14 @@ typedef int ( *blake2b_init_key_fn )( blake2b_state *, size_t, const void *, siz
 typedef int ( *blake2b_init_param_fn )( blake2b_state *, const blake2b_param * );
 typedef int ( *blake2b_update_fn )( blake2b_state *, const uint8_t *, size_t );
 typedef int ( *blake2b_final_fn )( blake2b_state *, uint8_t *, size_t );
+typedef int ( *blake2b_final_batch_fn )( const blake2b_state *, uint8_t *, size_t, const void *, size_t, size_t );
+typedef int ( *blake2b_update_multi_fn )( const blake2b_update_item *, size_t );
+typedef int ( *blake2b_updatev_fn )( blake2b_state *, const struct iovec *, int );
+typedef int ( *blake2b_update_copy_fn )( blake2b_state *, uint8_t *, const uint8_t *, size_t );
+typedef int ( *blake2b_v2_update_fn )( blake2b_state_v2 *, const uint8_t *, size_t );
+typedef int ( *blake2b_v2_final_fn )( blake2b_state_v2 *, uint8_t *, size_t );
+typedef int ( *blake2b_final_peek_fn )( const blake2b_state *, uint8_t *, size_t );
+typedef int ( *blake2b_compress_blocks_fn )( uint64_t *, const uint8_t *, size_t, size_t, uint64_t *, const uint64_t * );
 typedef int ( *blake2b_fn )( uint8_t *, const void *, const void *, size_t, size_t, size_t );
 
 typedef int ( *blake2s_init_fn )( blake2s_state *, size_t );
@@ -270,6 +368,13 @@ typedef int ( *blake2s_init_key_fn )( blake2s_state *, size_t, const void *, siz
 typedef int ( *blake2s_init_param_fn )( blake2s_state *, const blake2s_param * );
 typedef int ( *blake2s_update_fn )( blake2s_state *, const uint8_t *, size_t );
 typedef int ( *blake2s_final_fn )( blake2s_state *, uint8_t *, size_t );
+typedef int ( *blake2s_verify_batch_fn )( uint8_t *, const blake2s_mac_item *, size_t, size_t );
+typedef int ( *blake2s_updatev_fn )( blake2s_state *, const struct iovec *, int );
+typedef int ( *blake2s_update_copy_fn )( blake2s_state *, uint8_t *, const uint8_t *, size_t );
+typedef int ( *blake2s_v2_update_fn )( blake2s_state_v2 *, const uint8_t *, size_t );
+typedef int ( *blake2s_v2_final_fn )( blake2s_state_v2 *, uint8_t *, size_t );
+typedef int ( *blake2s_final_peek_fn )( const blake2s_state *, uint8_t *, size_t );
+typedef int ( *blake2s_compress_blocks_fn )( uint32_t *, const uint8_t *, size_t, size_t, uint32_t *, const uint32_t * );
 typedef int ( *blake2s_fn )( uint8_t *, const void *, const void *, size_t, size_t, size_t );
 
 static const blake2b_init_fn blake2b_init_table[] =
@@ -332,6 +437,102 @@ static const blake2b_final_fn blake2b_final_table[] =
 #endif
 };
 
+static const blake2b_final_batch_fn blake2b_final_batch_table[] =
+{
+  blake2b_final_batch_ref,
+#if defined(HAVE_X86)
+  blake2b_final_batch_sse2,
+  blake2b_final_batch_ssse3,
+  blake2b_final_batch_sse41,
+  blake2b_final_batch_avx,
+  blake2b_final_batch_xop
+#endif
+};
+
+static const blake2b_update_multi_fn blake2b_update_multi_table[] =
+{
+  blake2b_update_multi_ref,
+#if defined(HAVE_X86)
+  blake2b_update_multi_sse2,
+  blake2b_update_multi_ssse3,
+  blake2b_update_multi_sse41,
+  blake2b_update_multi_avx,
+  blake2b_update_multi_xop
+#endif
+};
+
+static const blake2b_updatev_fn blake2b_updatev_table[] =
+{
+  blake2b_updatev_ref,
+#if defined(HAVE_X86)
+  blake2b_updatev_sse2,
+  blake2b_updatev_ssse3,
+  blake2b_updatev_sse41,
+  blake2b_updatev_avx,
+  blake2b_updatev_xop
+#endif
+};
+
+static const blake2b_update_copy_fn blake2b_update_copy_table[] =
+{
+  blake2b_update_copy_ref,
+#if defined(HAVE_X86)
+  blake2b_update_copy_sse2,
+  blake2b_update_copy_ssse3,
+  blake2b_update_copy_sse41,
+  blake2b_update_copy_avx,
+  blake2b_update_copy_xop
+#endif
+};
+
+static const blake2b_v2_update_fn blake2b_v2_update_table[] =
+{
+  blake2b_v2_update_ref,
+#if defined(HAVE_X86)
+  blake2b_v2_update_sse2,
+  blake2b_v2_update_ssse3,
+  blake2b_v2_update_sse41,
+  blake2b_v2_update_avx,
+  blake2b_v2_update_xop
+#endif
+};
+
+static const blake2b_v2_final_fn blake2b_v2_final_table[] =
+{
+  blake2b_v2_final_ref,
+#if defined(HAVE_X86)
+  blake2b_v2_final_sse2,
+  blake2b_v2_final_ssse3,
+  blake2b_v2_final_sse41,
+  blake2b_v2_final_avx,
+  blake2b_v2_final_xop
+#endif
+};
+
+static const blake2b_final_peek_fn blake2b_final_peek_table[] =
+{
+  blake2b_final_peek_ref,
+#if defined(HAVE_X86)
+  blake2b_final_peek_sse2,
+  blake2b_final_peek_ssse3,
+  blake2b_final_peek_sse41,
+  blake2b_final_peek_avx,
+  blake2b_final_peek_xop
+#endif
+};
+
+static const blake2b_compress_blocks_fn blake2b_compress_blocks_table[] =
+{
+  blake2b_compress_blocks_ref,
+#if defined(HAVE_X86)
+  blake2b_compress_blocks_sse2,
+  blake2b_compress_blocks_ssse3,
+  blake2b_compress_blocks_sse41,
+  blake2b_compress_blocks_avx,
+  blake2b_compress_blocks_xop
+#endif
+};
+
 static const blake2b_fn blake2b_table[] =
 {
   blake2b_ref,
@@ -404,6 +605,90 @@ static const blake2s_final_fn blake2s_final_table[] =
 #endif
 };
 
+static const blake2s_verify_batch_fn blake2s_verify_batch_table[] =
+{
+  blake2s_verify_batch_ref,
+#if defined(HAVE_X86)
+  blake2s_verify_batch_sse2,
+  blake2s_verify_batch_ssse3,
+  blake2s_verify_batch_sse41,
+  blake2s_verify_batch_avx,
+  blake2s_verify_batch_xop
+#endif
+};
+
+static const blake2s_updatev_fn blake2s_updatev_table[] =
+{
+  blake2s_updatev_ref,
+#if defined(HAVE_X86)
+  blake2s_updatev_sse2,
+  blake2s_updatev_ssse3,
+  blake2s_updatev_sse41,
+  blake2s_updatev_avx,
+  blake2s_updatev_xop
+#endif
+};
+
+static const blake2s_update_copy_fn blake2s_update_copy_table[] =
+{
+  blake2s_update_copy_ref,
+#if defined(HAVE_X86)
+  blake2s_update_copy_sse2,
+  blake2s_update_copy_ssse3,
+  blake2s_update_copy_sse41,
+  blake2s_update_copy_avx,
+  blake2s_update_copy_xop
+#endif
+};
+
+static const blake2s_v2_update_fn blake2s_v2_update_table[] =
+{
+  blake2s_v2_update_ref,
+#if defined(HAVE_X86)
+  blake2s_v2_update_sse2,
+  blake2s_v2_update_ssse3,
+  blake2s_v2_update_sse41,
+  blake2s_v2_update_avx,
+  blake2s_v2_update_xop
+#endif
+};
+
+static const blake2s_v2_final_fn blake2s_v2_final_table[] =
+{
+  blake2s_v2_final_ref,
+#if defined(HAVE_X86)
+  blake2s_v2_final_sse2,
+  blake2s_v2_final_ssse3,
+  blake2s_v2_final_sse41,
+  blake2s_v2_final_avx,
+  blake2s_v2_final_xop
+#endif
+};
+
+static const blake2s_final_peek_fn blake2s_final_peek_table[] =
+{
+  blake2s_final_peek_ref,
+#if defined(HAVE_X86)
+  blake2s_final_peek_sse2,
+  blake2s_final_peek_ssse3,
+  blake2s_final_peek_sse41,
+  blake2s_final_peek_avx,
+  blake2s_final_peek_xop
+#endif
+};
+
+static const blake2s_compress_blocks_fn blake2s_compress_blocks_table[] =
+{
+  blake2s_compress_blocks_ref,
+#if defined(HAVE_X86)
+  blake2s_compress_blocks_sse2,
+  blake2s_compress_blocks_ssse3,
+  blake2s_compress_blocks_sse41,
+  blake2s_compress_blocks_avx,
+  blake2s_compress_blocks_xop
+#endif
+};
+
 static const blake2s_fn blake2s_table[] =
 {
   blake2s_ref,
@@ -424,6 +709,14 @@ extern "C" {
   int blake2b_init_param_dispatch( blake2b_state *S, const blake2b_param *P );
   int blake2b_update_dispatch( blake2b_state *S, const uint8_t *in, size_t inlen );
   int blake2b_final_dispatch( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch_dispatch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi_dispatch( const blake2b_update_item *items, size_t count );
+  int blake2b_updatev_dispatch( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy_dispatch( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2b_v2_update_dispatch( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final_dispatch( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek_dispatch( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks_dispatch( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
   int blake2b_dispatch( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
   int blake2s_init_dispatch( blake2s_state *S, size_t outlen );
@@ -431,6 +724,13 @@ extern "C" {
   int blake2s_init_param_dispatch( blake2s_state *S, const blake2s_param *P );
   int blake2s_update_dispatch( blake2s_state *S, const uint8_t *in, size_t inlen );
   int blake2s_final_dispatch( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch_dispatch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
+  int blake2s_updatev_dispatch( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy_dispatch( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  int blake2s_v2_update_dispatch( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final_dispatch( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek_dispatch( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks_dispatch( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
   int blake2s_dispatch( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 #if defined(__cplusplus)
 }
@@ -441,6 +741,14 @@ static blake2b_init_key_fn blake2b_init_key_ptr = blake2b_init_key_dispatch;
 static blake2b_init_param_fn blake2b_init_param_ptr = blake2b_init_param_dispatch;
 static blake2b_update_fn blake2b_update_ptr = blake2b_update_dispatch;
 static blake2b_final_fn blake2b_final_ptr = blake2b_final_dispatch;
+static blake2b_final_batch_fn blake2b_final_batch_ptr = blake2b_final_batch_dispatch;
+static blake2b_update_multi_fn blake2b_update_multi_ptr = blake2b_update_multi_dispatch;
+static blake2b_updatev_fn blake2b_updatev_ptr = blake2b_updatev_dispatch;
+static blake2b_update_copy_fn blake2b_update_copy_ptr = blake2b_update_copy_dispatch;
+static blake2b_v2_update_fn blake2b_v2_update_ptr = blake2b_v2_update_dispatch;
+static blake2b_v2_final_fn blake2b_v2_final_ptr = blake2b_v2_final_dispatch;
+static blake2b_final_peek_fn blake2b_final_peek_ptr = blake2b_final_peek_dispatch;
+static blake2b_compress_blocks_fn blake2b_compress_blocks_ptr = blake2b_compress_blocks_dispatch;
 static blake2b_fn blake2b_ptr = blake2b_dispatch;
 
 static blake2s_init_fn blake2s_init_ptr = blake2s_init_dispatch;
@@ -448,6 +756,13 @@ static blake2s_init_key_fn blake2s_init_key_ptr = blake2s_init_key_dispatch;
 static blake2s_init_param_fn blake2s_init_param_ptr = blake2s_init_param_dispatch;
 static blake2s_update_fn blake2s_update_ptr = blake2s_update_dispatch;
 static blake2s_final_fn blake2s_final_ptr = blake2s_final_dispatch;
+static blake2s_verify_batch_fn blake2s_verify_batch_ptr = blake2s_verify_batch_dispatch;
+static blake2s_updatev_fn blake2s_updatev_ptr = blake2s_updatev_dispatch;
+static blake2s_update_copy_fn blake2s_update_copy_ptr = blake2s_update_copy_dispatch;
+static blake2s_v2_update_fn blake2s_v2_update_ptr = blake2s_v2_update_dispatch;
+static blake2s_v2_final_fn blake2s_v2_final_ptr = blake2s_v2_final_dispatch;
+static blake2s_final_peek_fn blake2s_final_peek_ptr = blake2s_final_peek_dispatch;
+static blake2s_compress_blocks_fn blake2s_compress_blocks_ptr = blake2s_compress_blocks_dispatch;
 static blake2s_fn blake2s_ptr = blake2s_dispatch;
 
 int blake2b_init_dispatch( blake2b_state *S, size_t outlen )
@@ -480,6 +795,54 @@ int blake2b_final_dispatch( blake2b_state *S, uint8_t *out, size_t outlen )
   return blake2b_final_ptr( S, out, outlen );
 }
 
+int blake2b_final_batch_dispatch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count )
+{
+  blake2b_final_batch_ptr = blake2b_final_batch_table[get_cpu_features()];
+  return blake2b_final_batch_ptr( S, out, outlen, suffixes, suffixlen, count );
+}
+
+int blake2b_update_multi_dispatch( const blake2b_update_item *items, size_t count )
+{
+  blake2b_update_multi_ptr = blake2b_update_multi_table[get_cpu_features()];
+  return blake2b_update_multi_ptr( items, count );
+}
+
+int blake2b_updatev_dispatch( blake2b_state *S, const struct iovec *iov, int iovcnt )
+{
+  blake2b_updatev_ptr = blake2b_updatev_table[get_cpu_features()];
+  return blake2b_updatev_ptr( S, iov, iovcnt );
+}
+
+int blake2b_update_copy_dispatch( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  blake2b_update_copy_ptr = blake2b_update_copy_table[get_cpu_features()];
+  return blake2b_update_copy_ptr( S, dst, src, len );
+}
+
+int blake2b_v2_update_dispatch( blake2b_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  blake2b_v2_update_ptr = blake2b_v2_update_table[get_cpu_features()];
+  return blake2b_v2_update_ptr( S, in, inlen );
+}
+
+int blake2b_v2_final_dispatch( blake2b_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  blake2b_v2_final_ptr = blake2b_v2_final_table[get_cpu_features()];
+  return blake2b_v2_final_ptr( S, out, outlen );
+}
+
+int blake2b_final_peek_dispatch( const blake2b_state *S, uint8_t *out, size_t outlen )
+{
+  blake2b_final_peek_ptr = blake2b_final_peek_table[get_cpu_features()];
+  return blake2b_final_peek_ptr( S, out, outlen );
+}
+
+int blake2b_compress_blocks_dispatch( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] )
+{
+  blake2b_compress_blocks_ptr = blake2b_compress_blocks_table[get_cpu_features()];
+  return blake2b_compress_blocks_ptr( h, blocks, nblocks, lastlen, t, f );
+}
+
 int blake2b_dispatch( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   blake2b_ptr = blake2b_table[get_cpu_features()];
@@ -511,6 +874,46 @@ BLAKE2_API int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
   return blake2b_final_ptr( S, out, outlen );
 }
 
+BLAKE2_API int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count )
+{
+  return blake2b_final_batch_ptr( S, out, outlen, suffixes, suffixlen, count );
+}
+
+BLAKE2_API int blake2b_update_multi( const blake2b_update_item *items, size_t count )
+{
+  return blake2b_update_multi_ptr( items, count );
+}
+
+BLAKE2_API int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt )
+{
+  return blake2b_updatev_ptr( S, iov, iovcnt );
+}
+
+BLAKE2_API int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  return blake2b_update_copy_ptr( S, dst, src, len );
+}
+
+BLAKE2_API int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  return blake2b_v2_update_ptr( S, in, inlen );
+}
+
+BLAKE2_API int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  return blake2b_v2_final_ptr( S, out, outlen );
+}
+
+BLAKE2_API int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen )
+{
+  return blake2b_final_peek_ptr( S, out, outlen );
+}
+
+BLAKE2_API int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] )
+{
+  return blake2b_compress_blocks_ptr( h, blocks, nblocks, lastlen, t, f );
+}
+
 BLAKE2_API int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   return blake2b_ptr( out, in, key, outlen, inlen, keylen );
@@ -546,6 +949,48 @@ int blake2s_final_dispatch( blake2s_state *S, uint8_t *out, size_t outlen )
   return blake2s_final_ptr( S, out, outlen );
 }
 
+int blake2s_verify_batch_dispatch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  blake2s_verify_batch_ptr = blake2s_verify_batch_table[get_cpu_features()];
+  return blake2s_verify_batch_ptr( bitmap, items, count, taglen );
+}
+
+int blake2s_updatev_dispatch( blake2s_state *S, const struct iovec *iov, int iovcnt )
+{
+  blake2s_updatev_ptr = blake2s_updatev_table[get_cpu_features()];
+  return blake2s_updatev_ptr( S, iov, iovcnt );
+}
+
+int blake2s_update_copy_dispatch( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  blake2s_update_copy_ptr = blake2s_update_copy_table[get_cpu_features()];
+  return blake2s_update_copy_ptr( S, dst, src, len );
+}
+
+int blake2s_v2_update_dispatch( blake2s_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  blake2s_v2_update_ptr = blake2s_v2_update_table[get_cpu_features()];
+  return blake2s_v2_update_ptr( S, in, inlen );
+}
+
+int blake2s_v2_final_dispatch( blake2s_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  blake2s_v2_final_ptr = blake2s_v2_final_table[get_cpu_features()];
+  return blake2s_v2_final_ptr( S, out, outlen );
+}
+
+int blake2s_final_peek_dispatch( const blake2s_state *S, uint8_t *out, size_t outlen )
+{
+  blake2s_final_peek_ptr = blake2s_final_peek_table[get_cpu_features()];
+  return blake2s_final_peek_ptr( S, out, outlen );
+}
+
+int blake2s_compress_blocks_dispatch( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] )
+{
+  blake2s_compress_blocks_ptr = blake2s_compress_blocks_table[get_cpu_features()];
+  return blake2s_compress_blocks_ptr( h, blocks, nblocks, lastlen, t, f );
+}
+
 int blake2s_dispatch( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   blake2s_ptr = blake2s_table[get_cpu_features()];
@@ -577,6 +1022,41 @@ BLAKE2_API int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
   return blake2s_final_ptr( S, out, outlen );
 }
 
+BLAKE2_API int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  return blake2s_verify_batch_ptr( bitmap, items, count, taglen );
+}
+
+BLAKE2_API int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt )
+{
+  return blake2s_updatev_ptr( S, iov, iovcnt );
+}
+
+BLAKE2_API int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  return blake2s_update_copy_ptr( S, dst, src, len );
+}
+
+BLAKE2_API int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  return blake2s_v2_update_ptr( S, in, inlen );
+}
+
+BLAKE2_API int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  return blake2s_v2_final_ptr( S, out, outlen );
+}
+
+BLAKE2_API int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen )
+{
+  return blake2s_final_peek_ptr( S, out, outlen );
+}
+
+BLAKE2_API int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] )
+{
+  return blake2s_compress_blocks_ptr( h, blocks, nblocks, lastlen, t, f );
+}
+
 BLAKE2_API int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   return blake2s_ptr( out, in, key, outlen, inlen, keylen );
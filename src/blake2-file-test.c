@@ -0,0 +1,404 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* memfd_create */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "blake2.h"
+
+/* Spans several mapping windows and ends mid-block */
+#define FILE_BYTES ( 19 * 1024 * 1024 + 333 )
+#define PIPE_BYTES 5000
+/* Fits in a default pipe, so each test can run on one thread */
+#define FORWARD_BYTES 50000
+/* At SCRUB_RATE a scrub of SCRUB_BYTES cannot finish in under 125 ms */
+#define SCRUB_BYTES ( 1024 * 1024 + 77 )
+#define SCRUB_RATE ( 8 * 1024 * 1024 )
+
+static int test_regular( const uint8_t *key, const uint8_t *msg )
+{
+  static const size_t sizes[] = { 0, 1, 4096, FILE_BYTES };
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+  for( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++i )
+  {
+    FILE *fp = tmpfile();
+    int ret = -1;
+
+    if( NULL == fp ) return -1;
+
+    if( fwrite( msg, 1, sizes[i], fp ) != sizes[i] || fflush( fp ) != 0 ) goto out;
+
+    if( blake2b_file( a, BLAKE2B_OUTBYTES, fileno( fp ), NULL, 0 ) < 0 ||
+        blake2b( b, msg, NULL, BLAKE2B_OUTBYTES, sizes[i], 0 ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+      goto out;
+
+    if( blake2s_file( a, BLAKE2S_OUTBYTES, fileno( fp ), key, BLAKE2S_KEYBYTES ) < 0 ||
+        blake2s( b, msg, key, BLAKE2S_OUTBYTES, sizes[i], BLAKE2S_KEYBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+      goto out;
+
+    if( blake2sp_file( a, BLAKE2S_OUTBYTES, fileno( fp ), NULL, 0 ) < 0 ||
+        blake2sp( b, msg, NULL, BLAKE2S_OUTBYTES, sizes[i], 0 ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+      goto out;
+
+    if( blake2bp_file( a, BLAKE2B_OUTBYTES, fileno( fp ), key, BLAKE2B_KEYBYTES ) < 0 ||
+        blake2bp( b, msg, key, BLAKE2B_OUTBYTES, sizes[i], BLAKE2B_KEYBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+      goto out;
+
+    ret = 0;
+out:
+    fclose( fp );
+
+    if( ret < 0 ) return -1;
+  }
+
+  return 0;
+}
+
+/* Only a file that cannot shrink is mapped */
+static int test_sealed( const uint8_t *msg )
+{
+#if defined(MFD_ALLOW_SEALING) && defined(F_SEAL_SHRINK)
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  const int fd = memfd_create( "blake2-file-test", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+  int ret = -1;
+
+  if( fd < 0 ) return -1;
+
+  if( write( fd, msg, FILE_BYTES ) == FILE_BYTES && 0 == fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK ) &&
+      0 == blake2bp_file( a, BLAKE2B_OUTBYTES, fd, NULL, 0 ) && 0 == blake2bp( b, msg, NULL, BLAKE2B_OUTBYTES, FILE_BYTES, 0 ) )
+    ret = 0 == memcmp( a, b, BLAKE2B_OUTBYTES ) ? 0 : -1;
+
+  close( fd );
+  return ret;
+#else
+  return 0;
+#endif
+}
+
+typedef struct
+{
+  int fd;
+  int stop;
+} shrinker;
+
+static void *shrink_loop( void *arg )
+{
+  shrinker *T = ( shrinker * )arg;
+
+  while( !__atomic_load_n( &T->stop, __ATOMIC_ACQUIRE ) )
+  {
+    if( ftruncate( T->fd, 0 ) != 0 || ftruncate( T->fd, FILE_BYTES ) != 0 ) break;
+  }
+
+  return NULL;
+}
+
+/* A file truncated while it is hashed, a rotated log say, gives some digest or an error, never SIGBUS */
+static int test_shrinking( const uint8_t *msg )
+{
+  uint8_t a[BLAKE2B_OUTBYTES];
+  FILE *fp = tmpfile();
+  shrinker T[1];
+  pthread_t thread;
+
+  if( NULL == fp ) return -1;
+
+  T->fd = fileno( fp );
+  T->stop = 0;
+
+  if( fwrite( msg, 1, FILE_BYTES, fp ) != FILE_BYTES || fflush( fp ) != 0 ||
+      pthread_create( &thread, NULL, shrink_loop, T ) != 0 )
+  {
+    fclose( fp );
+    return -1;
+  }
+
+  for( int i = 0; i < 16; ++i )
+  {
+    blake2b_file( a, BLAKE2B_OUTBYTES, T->fd, NULL, 0 );
+    blake2bp_file( a, BLAKE2B_OUTBYTES, T->fd, NULL, 0 );
+  }
+
+  __atomic_store_n( &T->stop, 1, __ATOMIC_RELEASE );
+  pthread_join( thread, NULL );
+  fclose( fp );
+  return 0;
+}
+
+/* A pipe cannot be mapped and takes the read loop */
+static int test_pipe( const uint8_t *msg )
+{
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  int fds[2], ret;
+
+  if( pipe( fds ) < 0 ) return -1;
+
+  if( write( fds[1], msg, PIPE_BYTES ) != PIPE_BYTES )
+  {
+    close( fds[0] );
+    close( fds[1] );
+    return -1;
+  }
+
+  close( fds[1] );
+  ret = blake2bp_file( a, BLAKE2B_OUTBYTES, fds[0], NULL, 0 );
+  close( fds[0] );
+
+  if( ret < 0 || blake2bp( b, msg, NULL, BLAKE2B_OUTBYTES, PIPE_BYTES, 0 ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  return blake2b_file( a, BLAKE2B_OUTBYTES, -1, NULL, 0 ) == 0 ? -1 : 0;
+}
+
+/* Both pipelines, over files smaller than one read and larger than the whole ring */
+static int test_direct( const uint8_t *key, const uint8_t *msg )
+{
+  static const size_t sizes[] = { 0, 1, 4096, 1024 * 1024, FILE_BYTES };
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  char path[] = "blake2-file-test.XXXXXX";
+
+  for( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++i )
+  {
+    const int fd = mkstemp( path );
+    int ret = 0;
+
+    if( fd < 0 ) return -1;
+
+    if( write( fd, msg, sizes[i] ) != ( ssize_t )sizes[i] ) ret = -1;
+
+    close( fd );
+
+    for( unsigned flags = 0; flags <= BLAKE2_DIRECT_PREAD && 0 == ret; flags += BLAKE2_DIRECT_PREAD )
+    {
+      if( blake2b_file_direct( a, BLAKE2B_OUTBYTES, path, key, BLAKE2B_KEYBYTES, flags ) < 0 ||
+          blake2b( b, msg, key, BLAKE2B_OUTBYTES, sizes[i], BLAKE2B_KEYBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+        ret = -1;
+
+      if( blake2bp_file_direct( a, BLAKE2B_OUTBYTES, path, NULL, 0, flags ) < 0 ||
+          blake2bp( b, msg, NULL, BLAKE2B_OUTBYTES, sizes[i], 0 ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+        ret = -1;
+    }
+
+    unlink( path );
+    memcpy( path + sizeof( path ) - 7, "XXXXXX", 6 );
+
+    if( ret < 0 ) return -1;
+  }
+
+  /* Character devices go through the plain read loop; missing files fail */
+  if( blake2s_file_direct( a, BLAKE2S_OUTBYTES, "/dev/null", NULL, 0, 0 ) < 0 ||
+      blake2s( b, msg, NULL, BLAKE2S_OUTBYTES, 0, 0 ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+    return -1;
+
+  return blake2b_file_direct( a, BLAKE2B_OUTBYTES, "blake2-file-test.missing", NULL, 0, 0 ) == 0 ? -1 : 0;
+}
+
+/* Forwards FORWARD_BYTES from in_fd to out_fd, then checks what came out and the digest */
+static int check_forward( const uint8_t *msg, int out_fd, int in_fd, int out_rd )
+{
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  static uint8_t seen[FORWARD_BYTES];
+  blake2b_state S[1];
+  size_t got = 0;
+
+  blake2b_init( S, BLAKE2B_OUTBYTES );
+
+  if( blake2b_forward( S, out_fd, in_fd ) < 0 || blake2b_final( S, a, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  while( got < FORWARD_BYTES )
+  {
+    const ssize_t n = read( out_rd, seen + got, FORWARD_BYTES - got );
+
+    if( n <= 0 ) return -1;
+
+    got += ( size_t )n;
+  }
+
+  if( 0 != memcmp( seen, msg, FORWARD_BYTES ) ) return -1;
+
+  if( blake2b( b, msg, NULL, BLAKE2B_OUTBYTES, FORWARD_BYTES, 0 ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  return 0;
+}
+
+/* Pipe to pipe, socket to pipe through the staging pipe, and pipe to an appending file, which refuses splice */
+static int test_forward( const uint8_t *msg )
+{
+  char path[] = "blake2-file-test.XXXXXX";
+  int in[2], out[2], ret = -1;
+  int fd, rd;
+
+  if( pipe( in ) < 0 ) return -1;
+
+  if( pipe( out ) < 0 ) goto close_in;
+
+  if( write( in[1], msg, FORWARD_BYTES ) != FORWARD_BYTES ) goto close_out;
+
+  close( in[1] );
+  in[1] = -1;
+
+  if( check_forward( msg, out[1], in[0], out[0] ) < 0 ) goto close_out;
+
+  close( in[0] );
+
+  if( socketpair( AF_UNIX, SOCK_STREAM, 0, in ) < 0 ) goto close_out;
+
+  if( write( in[1], msg, FORWARD_BYTES ) != FORWARD_BYTES ) goto close_in;
+
+  shutdown( in[1], SHUT_WR );
+
+  if( check_forward( msg, out[1], in[0], out[0] ) < 0 ) goto close_in;
+
+  close( in[0] );
+  close( in[1] );
+
+  if( pipe( in ) < 0 ) goto close_out;
+
+  if( write( in[1], msg, FORWARD_BYTES ) != FORWARD_BYTES ) goto close_in;
+
+  close( in[1] );
+  in[1] = -1;
+
+  if( ( fd = mkstemp( path ) ) < 0 ) goto close_in;
+
+  close( fd );
+  fd = open( path, O_WRONLY | O_APPEND );
+  rd = open( path, O_RDONLY );
+  ret = fd < 0 || rd < 0 ? -1 : check_forward( msg, fd, in[0], rd );
+
+  if( fd >= 0 ) close( fd );
+
+  if( rd >= 0 ) close( rd );
+
+  unlink( path );
+close_in:
+  close( in[0] );
+
+  if( in[1] >= 0 ) close( in[1] );
+close_out:
+  close( out[0] );
+  close( out[1] );
+  return ret;
+}
+
+typedef struct
+{
+  uint64_t done;
+  uint64_t eta;
+  int reports;
+  int stop;
+  int error;
+} scrub_watch;
+
+static int watch_scrub( void *ctx, const blake2_scrub_progress *P )
+{
+  scrub_watch *W = ( scrub_watch * )ctx;
+
+  if( P->done < W->done || P->done > P->total ) W->error = 1;
+
+  W->done = P->done;
+  W->eta = P->eta_ns;
+  ++W->reports;
+  return W->stop ? -1 : 0;
+}
+
+static uint64_t now_ns( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ( uint64_t )ts.tv_sec * 1000000000ULL + ( uint64_t )ts.tv_nsec;
+}
+
+/* A paced scrub digests like blake2b and cannot get ahead of its byte budget */
+static int test_scrub( const uint8_t *key, const uint8_t *msg )
+{
+  const blake2_scrub_limits limits = { SCRUB_RATE, 50 };
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  scrub_watch W[1];
+  FILE *fp = tmpfile();
+  uint64_t start;
+  int ret = -1;
+
+  if( NULL == fp ) return -1;
+
+  if( fwrite( msg, 1, SCRUB_BYTES, fp ) != SCRUB_BYTES || fflush( fp ) != 0 ) goto out;
+
+  memset( W, 0, sizeof( W ) );
+  start = now_ns();
+
+  if( blake2b_scrub( a, BLAKE2B_OUTBYTES, fileno( fp ), key, BLAKE2B_KEYBYTES, &limits, watch_scrub, W ) < 0 ) goto out;
+
+  if( now_ns() - start < 1000000000ULL * SCRUB_BYTES / SCRUB_RATE ) goto out;
+
+  if( blake2b( b, msg, key, BLAKE2B_OUTBYTES, SCRUB_BYTES, BLAKE2B_KEYBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+    goto out;
+
+  if( W->error || 0 == W->reports || W->done != SCRUB_BYTES || W->eta != 0 ) goto out;
+
+  /* Unpaced, and stopped by the progress callback */
+  memset( W, 0, sizeof( W ) );
+  W->stop = 1;
+
+  if( blake2b_scrub( a, BLAKE2B_OUTBYTES, fileno( fp ), NULL, 0, NULL, watch_scrub, W ) >= 0 ) goto out;
+
+  ret = 0;
+out:
+  fclose( fp );
+  return ret;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t *msg = ( uint8_t * )malloc( FILE_BYTES );
+  int ret;
+
+  if( NULL == msg )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < FILE_BYTES; ++i )
+    msg[i] = ( uint8_t )( i * 7 + ( i >> 13 ) );
+
+  ret = test_regular( key, msg ) < 0 || test_sealed( msg ) < 0 || test_shrinking( msg ) < 0 ||
+        test_pipe( msg ) < 0 || test_direct( key, msg ) < 0 ||
+        test_forward( msg ) < 0 || test_scrub( key, msg ) < 0 ? -1 : 0;
+  free( msg );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,1129 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* O_DIRECT, splice and tee */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_FCNTL_H)
+#include <fcntl.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+#if defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+#if defined(HAVE_SCHED_H)
+#include <sched.h>
+#endif
+#include <time.h>
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_SYS_SYSCALL_H) && defined(HAVE_SYS_MMAN_H)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BLAKE2_HAVE_URING
+#endif
+#endif
+
+/*
+   Regular files are read with pread into a page-aligned buffer, with the
+   kernel asked to read two windows ahead while the current one is
+   compressed. Only a file sealed against shrinking (a memfd with
+   F_SEAL_SHRINK) is mapped instead: any other file may be truncated while
+   it is hashed, a rotated log say, and touching a mapped page past the new
+   end raises SIGBUS in the caller. Pipes, sockets and character devices
+   go through the same read loop with plain read.
+*/
+#define BLAKE2_FILE_WINDOW ( 8 * BLAKE2_STREAM_BYTES )
+#define BLAKE2_FILE_BUFFER ( 2 * BLAKE2_STREAM_BYTES )
+#define BLAKE2_FILE_ALIGN 4096
+
+typedef int ( *blake2_file_update_fn )( void *S, const uint8_t *in, size_t inlen );
+
+#if defined(HAVE_SYS_MMAN_H)
+/* Nonzero if fd cannot shrink, so that a mapping of its current length stays backed */
+static int blake2_file_sealed( int fd )
+{
+#if defined(HAVE_FCNTL_H) && defined(F_GET_SEALS) && defined(F_SEAL_SHRINK)
+  const int seals = fcntl( fd, F_GET_SEALS );
+
+  return seals >= 0 && 0 != ( seals & F_SEAL_SHRINK );
+#else
+  ( void )fd;
+  return 0;
+#endif
+}
+
+/* Hashes and unmaps the size bytes mapped at p */
+static int blake2_hash_mapped( void *S, blake2_file_update_fn update, uint8_t *p, size_t size )
+{
+  int ret = 0;
+
+#if defined(HAVE_MADVISE)
+  madvise( p, size, MADV_SEQUENTIAL );
+  madvise( p, size < 2 * BLAKE2_FILE_WINDOW ? size : 2 * BLAKE2_FILE_WINDOW, MADV_WILLNEED );
+#endif
+
+  for( size_t off = 0; off < size && 0 == ret; off += BLAKE2_FILE_WINDOW )
+  {
+    const size_t n = size - off < BLAKE2_FILE_WINDOW ? size - off : BLAKE2_FILE_WINDOW;
+#if defined(HAVE_MADVISE)
+    const size_t ahead = off + 2 * BLAKE2_FILE_WINDOW;
+
+    if( ahead < size )
+      madvise( p + ahead, size - ahead < BLAKE2_FILE_WINDOW ? size - ahead : BLAKE2_FILE_WINDOW, MADV_WILLNEED );
+#endif
+    ret = update( S, p + off, n ) < 0 ? -1 : 0;
+  }
+
+  munmap( p, size );
+  return ret;
+}
+#endif
+
+static int blake2_hash_read( void *S, blake2_file_update_fn update, int fd, const int seekable )
+{
+  uint8_t *buf = NULL;
+  off_t off = 0;
+  int ret = 0;
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+  off_t advised = 0;
+#endif
+
+#if defined(HAVE_POSIX_MEMALIGN)
+  if( posix_memalign( ( void ** )&buf, BLAKE2_FILE_ALIGN, BLAKE2_FILE_BUFFER ) != 0 ) return -1;
+#else
+  if( NULL == ( buf = ( uint8_t * )malloc( BLAKE2_FILE_BUFFER ) ) ) return -1;
+#endif
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+  if( seekable ) posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+  for( ;; )
+  {
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    /* Read-ahead is asked for a window at a time, two windows ahead of the hashing */
+    while( seekable && advised < off + 2 * BLAKE2_FILE_WINDOW )
+    {
+      posix_fadvise( fd, advised, BLAKE2_FILE_WINDOW, POSIX_FADV_WILLNEED );
+      advised += BLAKE2_FILE_WINDOW;
+    }
+#endif
+#if defined(HAVE_PREAD)
+    const ssize_t n = seekable ? pread( fd, buf, BLAKE2_FILE_BUFFER, off ) : read( fd, buf, BLAKE2_FILE_BUFFER );
+#else
+    const ssize_t n = read( fd, buf, BLAKE2_FILE_BUFFER );
+#endif
+
+    if( n < 0 )
+    {
+      if( EINTR == errno ) continue;
+
+      ret = -1;
+      break;
+    }
+
+    if( 0 == n ) break;
+
+    if( update( S, buf, ( size_t )n ) < 0 )
+    {
+      ret = -1;
+      break;
+    }
+
+    off += n;
+  }
+
+  free( buf );
+  return ret;
+}
+
+static int blake2_hash_fd( void *S, blake2_file_update_fn update, int fd )
+{
+  struct stat st;
+  int seekable = 0;
+
+  if( fd < 0 ) return -1;
+
+  if( 0 == fstat( fd, &st ) && S_ISREG( st.st_mode ) )
+  {
+    seekable = 1;
+#if defined(HAVE_SYS_MMAN_H)
+    /* Unsealed, empty and oversized files, and failed maps, go through the read loop */
+    if( st.st_size > 0 && ( uint64_t )st.st_size <= SIZE_MAX && blake2_file_sealed( fd ) )
+    {
+      uint8_t *p = ( uint8_t * )mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+      if( MAP_FAILED != p ) return blake2_hash_mapped( S, update, p, ( size_t )st.st_size );
+    }
+#endif
+  }
+
+  return blake2_hash_read( S, update, fd, seekable );
+}
+
+/*
+   Cold reads: a ring of aligned slots, each holding one O_DIRECT read of up
+   to BLAKE2_DIRECT_BYTES. Read k lands in slot k % BLAKE2_DIRECT_SLOTS and
+   slots are hashed in file order, so while one slot is compressed the other
+   reads stay in flight, submitted through io_uring or issued by a reader
+   thread when io_uring is unavailable.
+*/
+#define BLAKE2_DIRECT_SLOTS 8
+#define BLAKE2_DIRECT_BYTES BLAKE2_STREAM_BYTES
+
+typedef struct __blake2_direct_ring
+{
+  uint8_t *buf[BLAKE2_DIRECT_SLOTS];
+  uint64_t size;
+  uint64_t nreads;
+  int fd;
+} blake2_direct_ring;
+
+/* The file length covered by read k; only the last read is short */
+static size_t blake2_direct_len( const blake2_direct_ring *D, uint64_t k )
+{
+  const uint64_t left = D->size - k * BLAKE2_DIRECT_BYTES;
+  return left < BLAKE2_DIRECT_BYTES ? ( size_t )left : BLAKE2_DIRECT_BYTES;
+}
+
+#if defined(BLAKE2_HAVE_URING)
+typedef struct __blake2_uring
+{
+  int fd;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_map, *cq_map;
+  size_t sq_bytes, cq_bytes, sqe_bytes;
+  struct iovec iov[BLAKE2_DIRECT_SLOTS];
+  size_t got[BLAKE2_DIRECT_SLOTS];
+  unsigned inflight;
+} blake2_uring;
+
+static void blake2_uring_close( blake2_uring *R )
+{
+  if( R->sqes ) munmap( R->sqes, R->sqe_bytes );
+
+  if( R->cq_map && R->cq_map != R->sq_map ) munmap( R->cq_map, R->cq_bytes );
+
+  if( R->sq_map ) munmap( R->sq_map, R->sq_bytes );
+
+  close( R->fd );
+}
+
+static int blake2_uring_open( blake2_uring *R )
+{
+  struct io_uring_params p;
+  void *map;
+
+  memset( R, 0, sizeof( *R ) );
+  memset( &p, 0, sizeof( p ) );
+  R->fd = ( int )syscall( __NR_io_uring_setup, BLAKE2_DIRECT_SLOTS, &p );
+
+  if( R->fd < 0 ) return -1;
+
+  R->sq_bytes = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+  R->cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof( struct io_uring_cqe );
+  R->sqe_bytes = p.sq_entries * sizeof( struct io_uring_sqe );
+
+  if( p.features & IORING_FEAT_SINGLE_MMAP )
+    R->sq_bytes = R->cq_bytes = R->sq_bytes > R->cq_bytes ? R->sq_bytes : R->cq_bytes;
+
+  map = mmap( NULL, R->sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_SQ_RING );
+
+  if( MAP_FAILED == map ) goto fail;
+
+  R->sq_map = map;
+
+  if( p.features & IORING_FEAT_SINGLE_MMAP )
+    R->cq_map = R->sq_map;
+  else
+  {
+    map = mmap( NULL, R->cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_CQ_RING );
+
+    if( MAP_FAILED == map ) goto fail;
+
+    R->cq_map = map;
+  }
+
+  map = mmap( NULL, R->sqe_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_SQES );
+
+  if( MAP_FAILED == map ) goto fail;
+
+  R->sqes = ( struct io_uring_sqe * )map;
+  R->sq_tail = ( unsigned * )( ( uint8_t * )R->sq_map + p.sq_off.tail );
+  R->sq_mask = ( unsigned * )( ( uint8_t * )R->sq_map + p.sq_off.ring_mask );
+  R->sq_array = ( unsigned * )( ( uint8_t * )R->sq_map + p.sq_off.array );
+  R->cq_head = ( unsigned * )( ( uint8_t * )R->cq_map + p.cq_off.head );
+  R->cq_tail = ( unsigned * )( ( uint8_t * )R->cq_map + p.cq_off.tail );
+  R->cq_mask = ( unsigned * )( ( uint8_t * )R->cq_map + p.cq_off.ring_mask );
+  R->cqes = ( struct io_uring_cqe * )( ( uint8_t * )R->cq_map + p.cq_off.cqes );
+  return 0;
+fail:
+  blake2_uring_close( R );
+  return -1;
+}
+
+/* Queues the rest of read k into its slot and hands it to the kernel */
+static int blake2_uring_read( blake2_uring *R, const blake2_direct_ring *D, uint64_t k )
+{
+  const size_t slot = k % BLAKE2_DIRECT_SLOTS;
+  const unsigned tail = *R->sq_tail;
+  const unsigned i = tail & *R->sq_mask;
+  struct io_uring_sqe *sqe = &R->sqes[i];
+
+  R->iov[slot].iov_base = D->buf[slot] + R->got[slot];
+  R->iov[slot].iov_len = BLAKE2_DIRECT_BYTES - R->got[slot];
+  memset( sqe, 0, sizeof( *sqe ) );
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = D->fd;
+  sqe->addr = ( uint64_t )( uintptr_t )&R->iov[slot];
+  sqe->len = 1;
+  sqe->off = k * BLAKE2_DIRECT_BYTES + R->got[slot];
+  sqe->user_data = k;
+  R->sq_array[i] = i;
+  __atomic_store_n( R->sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+  while( syscall( __NR_io_uring_enter, R->fd, 1, 0, 0, NULL, 0 ) < 0 )
+    if( EINTR != errno ) return -1;
+
+  ++R->inflight;
+  return 0;
+}
+
+/* Waits for at least one completion and accounts for every one available */
+static int blake2_uring_reap( blake2_uring *R, const blake2_direct_ring *D, uint8_t *done )
+{
+  unsigned head, tail;
+  int ret = 0;
+
+  if( syscall( __NR_io_uring_enter, R->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 && EINTR != errno )
+    return -1;
+
+  head = *R->cq_head;
+  tail = __atomic_load_n( R->cq_tail, __ATOMIC_ACQUIRE );
+
+  for( ; head != tail; ++head )
+  {
+    const struct io_uring_cqe *cqe = &R->cqes[head & *R->cq_mask];
+    const uint64_t k = cqe->user_data;
+    const size_t slot = k % BLAKE2_DIRECT_SLOTS;
+    const int res = cqe->res;
+
+    --R->inflight;
+
+    if( ret < 0 ) continue;
+
+    if( res > 0 ) R->got[slot] += ( size_t )res;
+
+    if( R->got[slot] >= blake2_direct_len( D, k ) )
+      done[slot] = 1;
+    else if( 0 == res || ( res < 0 && -EAGAIN != res && -EINTR != res ) )
+      ret = -1; /* The file shrank under us, or the read failed */
+    else if( blake2_uring_read( R, D, k ) < 0 ) /* Short read: queue the rest */
+      ret = -1;
+  }
+
+  __atomic_store_n( R->cq_head, head, __ATOMIC_RELEASE );
+  return ret;
+}
+
+/* Retires every outstanding read, whatever its result */
+static void blake2_uring_drain( blake2_uring *R )
+{
+  while( R->inflight > 0 )
+  {
+    const unsigned tail = __atomic_load_n( R->cq_tail, __ATOMIC_ACQUIRE );
+
+    R->inflight -= tail - *R->cq_head;
+    __atomic_store_n( R->cq_head, tail, __ATOMIC_RELEASE );
+
+    if( R->inflight > 0 && syscall( __NR_io_uring_enter, R->fd, 0, R->inflight, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 && EINTR != errno )
+      break;
+  }
+}
+
+static int blake2_direct_uring( void *S, blake2_file_update_fn update, const blake2_direct_ring *D )
+{
+  uint8_t done[BLAKE2_DIRECT_SLOTS] = {0};
+  blake2_uring R[1];
+  uint64_t hashed = 0;
+  int ret = 0;
+
+  if( blake2_uring_open( R ) < 0 ) return 1;
+
+  for( uint64_t k = 0; k < D->nreads && k < BLAKE2_DIRECT_SLOTS && 0 == ret; ++k )
+    ret = blake2_uring_read( R, D, k );
+
+  while( 0 == ret && hashed < D->nreads )
+  {
+    const size_t slot = hashed % BLAKE2_DIRECT_SLOTS;
+
+    if( !done[slot] )
+    {
+      ret = blake2_uring_reap( R, D, done );
+      continue;
+    }
+
+    if( update( S, D->buf[slot], blake2_direct_len( D, hashed ) ) < 0 )
+    {
+      ret = -1;
+      break;
+    }
+
+    done[slot] = 0;
+    R->got[slot] = 0;
+
+    if( hashed + BLAKE2_DIRECT_SLOTS < D->nreads )
+      ret = blake2_uring_read( R, D, hashed + BLAKE2_DIRECT_SLOTS );
+
+    ++hashed;
+  }
+
+  /* The kernel may still be writing into the slots; let it finish before they are freed */
+  blake2_uring_drain( R );
+  blake2_uring_close( R );
+  return ret;
+}
+#endif
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PREAD)
+typedef struct __blake2_direct_thread
+{
+  const blake2_direct_ring *D;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint64_t ready;
+  uint64_t hashed;
+  int error;
+} blake2_direct_thread;
+
+static void *blake2_direct_reader( void *arg )
+{
+  blake2_direct_thread *T = ( blake2_direct_thread * )arg;
+  const blake2_direct_ring *D = T->D;
+
+  for( uint64_t k = 0; k < D->nreads; ++k )
+  {
+    const size_t slot = k % BLAKE2_DIRECT_SLOTS;
+    const size_t len = blake2_direct_len( D, k );
+    size_t got = 0;
+
+    pthread_mutex_lock( &T->lock );
+
+    while( k - T->hashed >= BLAKE2_DIRECT_SLOTS && !T->error )
+      pthread_cond_wait( &T->cond, &T->lock );
+
+    /* The hashing side gave up */
+    if( T->error )
+    {
+      pthread_mutex_unlock( &T->lock );
+      break;
+    }
+
+    pthread_mutex_unlock( &T->lock );
+
+    while( got < len )
+    {
+      const ssize_t n = pread( D->fd, D->buf[slot] + got, BLAKE2_DIRECT_BYTES - got, ( off_t )( k * BLAKE2_DIRECT_BYTES + got ) );
+
+      if( n < 0 && EINTR == errno ) continue;
+
+      if( n <= 0 ) break;
+
+      got += ( size_t )n;
+    }
+
+    pthread_mutex_lock( &T->lock );
+
+    if( got < len ) T->error = 1;
+    else T->ready = k + 1;
+
+    pthread_cond_signal( &T->cond );
+    pthread_mutex_unlock( &T->lock );
+
+    if( got < len ) break;
+  }
+
+  return NULL;
+}
+
+static int blake2_direct_threaded( void *S, blake2_file_update_fn update, const blake2_direct_ring *D )
+{
+  blake2_direct_thread T[1];
+  pthread_t reader;
+  int ret = 0;
+
+  memset( T, 0, sizeof( T ) );
+  T->D = D;
+  pthread_mutex_init( &T->lock, NULL );
+  pthread_cond_init( &T->cond, NULL );
+
+  if( pthread_create( &reader, NULL, blake2_direct_reader, T ) != 0 )
+  {
+    ret = blake2_hash_read( S, update, D->fd, 1 );
+    goto out;
+  }
+
+  for( uint64_t k = 0; k < D->nreads; ++k )
+  {
+    pthread_mutex_lock( &T->lock );
+
+    while( T->ready <= k && !T->error )
+      pthread_cond_wait( &T->cond, &T->lock );
+
+    pthread_mutex_unlock( &T->lock );
+
+    if( T->ready <= k )
+    {
+      ret = -1;
+      break;
+    }
+
+    ret = update( S, D->buf[k % BLAKE2_DIRECT_SLOTS], blake2_direct_len( D, k ) ) < 0 ? -1 : 0;
+    pthread_mutex_lock( &T->lock );
+
+    if( ret < 0 )
+      T->error = 1;
+    else
+      T->hashed = k + 1;
+
+    pthread_cond_signal( &T->cond );
+    pthread_mutex_unlock( &T->lock );
+
+    if( ret < 0 ) break;
+  }
+
+  pthread_join( reader, NULL );
+out:
+  pthread_cond_destroy( &T->cond );
+  pthread_mutex_destroy( &T->lock );
+  return ret;
+}
+#endif
+
+/* Non-regular files have no length to pipeline against and take the plain descriptor path */
+static int blake2_hash_direct( void *S, blake2_file_update_fn update, const char *path, unsigned flags )
+{
+  blake2_direct_ring D[1];
+  struct stat st;
+  int ret = 1;
+
+  if( NULL == path ) return -1;
+
+  memset( D, 0, sizeof( D ) );
+#if defined(O_DIRECT)
+  D->fd = open( path, O_RDONLY | O_DIRECT );
+
+  if( D->fd < 0 && EINVAL == errno ) /* The file system does not do direct I/O */
+#endif
+    D->fd = open( path, O_RDONLY );
+
+  if( D->fd < 0 ) return -1;
+
+  if( fstat( D->fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size == 0 )
+  {
+#if defined(O_DIRECT)
+    fcntl( D->fd, F_SETFL, fcntl( D->fd, F_GETFL ) & ~O_DIRECT );
+#endif
+    ret = blake2_hash_fd( S, update, D->fd );
+    close( D->fd );
+    return ret;
+  }
+
+  D->size = ( uint64_t )st.st_size;
+  D->nreads = ( D->size + BLAKE2_DIRECT_BYTES - 1 ) / BLAKE2_DIRECT_BYTES;
+
+  for( size_t i = 0; i < BLAKE2_DIRECT_SLOTS; ++i )
+  {
+#if defined(HAVE_POSIX_MEMALIGN)
+    if( posix_memalign( ( void ** )&D->buf[i], BLAKE2_FILE_ALIGN, BLAKE2_DIRECT_BYTES ) != 0 ) D->buf[i] = NULL;
+#else
+    D->buf[i] = ( uint8_t * )malloc( BLAKE2_DIRECT_BYTES );
+#endif
+
+    if( NULL == D->buf[i] )
+    {
+      ret = -1;
+      goto out;
+    }
+  }
+
+#if defined(BLAKE2_HAVE_URING)
+  if( !( flags & BLAKE2_DIRECT_PREAD ) ) ret = blake2_direct_uring( S, update, D );
+#endif
+
+  /* io_uring was refused or not asked for */
+  if( ret > 0 )
+  {
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PREAD)
+    ret = blake2_direct_threaded( S, update, D );
+#else
+    ret = blake2_hash_read( S, update, D->fd, 1 );
+#endif
+  }
+
+out:
+  for( size_t i = 0; i < BLAKE2_DIRECT_SLOTS; ++i )
+    free( D->buf[i] );
+
+  close( D->fd );
+  return ret;
+}
+/*
+   Forwarding: data is moved from in_fd to out_fd with splice, never passing
+   through user memory, while tee duplicates the same pages into a private
+   pipe that is drained into one page-aligned buffer for hashing. That is a
+   single copy per byte where a read/write loop makes two. A descriptor that
+   is not a pipe is first spliced into a staging pipe so tee has a pipe to
+   work from. Without splice, or when out_fd cannot take it, the bytes go
+   through a plain read/write loop.
+*/
+#define BLAKE2_TEE_BYTES ( 1 << 20 )
+
+static int blake2_write_all( int fd, const uint8_t *buf, size_t len )
+{
+  while( len > 0 )
+  {
+    const ssize_t n = write( fd, buf, len );
+
+    if( n < 0 && EINTR == errno ) continue;
+
+    if( n <= 0 ) return -1;
+
+    buf += n;
+    len -= ( size_t )n;
+  }
+
+  return 0;
+}
+
+/* Hashes and forwards up to limit bytes of in_fd, stopping early at end of file */
+static int blake2_forward_rw( void *S, blake2_file_update_fn update, int out_fd, int in_fd, uint8_t *buf, size_t bufsize, uint64_t limit )
+{
+  while( limit > 0 )
+  {
+    const ssize_t n = read( in_fd, buf, limit < bufsize ? ( size_t )limit : bufsize );
+
+    if( n < 0 && EINTR == errno ) continue;
+
+    if( n < 0 ) return -1;
+
+    if( 0 == n ) break;
+
+    update( S, buf, ( size_t )n );
+
+    if( blake2_write_all( out_fd, buf, ( size_t )n ) < 0 ) return -1;
+
+    limit -= ( uint64_t )n;
+  }
+
+  return 0;
+}
+
+#if defined(HAVE_SPLICE) && defined(HAVE_TEE)
+static int blake2_read_all( int fd, uint8_t *buf, size_t len )
+{
+  while( len > 0 )
+  {
+    const ssize_t n = read( fd, buf, len );
+
+    if( n < 0 && EINTR == errno ) continue;
+
+    if( n <= 0 ) return -1;
+
+    buf += n;
+    len -= ( size_t )n;
+  }
+
+  return 0;
+}
+
+static size_t blake2_pipe_grow( int fd )
+{
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+  int size;
+
+  fcntl( fd, F_SETPIPE_SZ, BLAKE2_TEE_BYTES ); /* Best effort, pipe-max-size may be lower */
+
+  if( ( size = fcntl( fd, F_GETPIPE_SZ ) ) > 0 ) return ( size_t )size;
+#endif
+  return 65536;
+}
+
+static int blake2_forward_spliced( void *S, blake2_file_update_fn update, int out_fd, int in_fd, uint8_t *buf, size_t bufsize )
+{
+  int stage[2] = { -1, -1 }, copy[2] = { -1, -1 };
+  struct stat st;
+  const int in_pipe = 0 == fstat( in_fd, &st ) && S_ISFIFO( st.st_mode );
+  size_t cap, pending = 0;
+  int src, moved = 0, ret = -1;
+
+  if( pipe( copy ) < 0 ) return -1;
+
+  if( !in_pipe && pipe( stage ) < 0 ) goto out;
+
+  cap = blake2_pipe_grow( copy[1] );
+
+  if( cap > bufsize ) cap = bufsize;
+
+  if( !in_pipe )
+  {
+    const size_t staged = blake2_pipe_grow( stage[1] );
+
+    if( staged < cap ) cap = staged;
+  }
+
+  src = in_pipe ? in_fd : stage[0];
+
+  for( ;; )
+  {
+    ssize_t t;
+
+    if( !in_pipe && 0 == pending )
+    {
+      const ssize_t n = splice( in_fd, NULL, stage[1], NULL, cap, SPLICE_F_MOVE | SPLICE_F_MORE );
+
+      if( n < 0 && EINTR == errno ) continue;
+
+      if( n < 0 && EINVAL == errno && !moved ) /* in_fd cannot be spliced from */
+      {
+        ret = blake2_forward_rw( S, update, out_fd, in_fd, buf, bufsize, UINT64_MAX );
+        goto out;
+      }
+
+      if( n < 0 ) goto out;
+
+      if( 0 == n ) break;
+
+      pending = ( size_t )n;
+    }
+
+    t = tee( src, copy[1], in_pipe ? cap : pending, 0 );
+
+    if( t < 0 && EINTR == errno ) continue;
+
+    if( t < 0 ) goto out;
+
+    if( 0 == t ) break;
+
+    for( size_t left = ( size_t )t; left > 0; )
+    {
+      const ssize_t n = splice( src, NULL, out_fd, NULL, left, SPLICE_F_MOVE | SPLICE_F_MORE );
+
+      if( n < 0 && EINTR == errno ) continue;
+
+      if( n < 0 && EINVAL == errno && !moved ) /* out_fd cannot be spliced to; src still holds everything */
+      {
+        ret = blake2_forward_rw( S, update, out_fd, src, buf, bufsize, in_pipe ? UINT64_MAX : pending );
+
+        if( 0 == ret && !in_pipe ) ret = blake2_forward_rw( S, update, out_fd, in_fd, buf, bufsize, UINT64_MAX );
+
+        goto out;
+      }
+
+      if( n <= 0 ) goto out;
+
+      left -= ( size_t )n;
+      moved = 1;
+    }
+
+    if( blake2_read_all( copy[0], buf, ( size_t )t ) < 0 ) goto out;
+
+    update( S, buf, ( size_t )t );
+
+    if( !in_pipe ) pending -= ( size_t )t;
+  }
+
+  ret = 0;
+out:
+  close( copy[0] );
+  close( copy[1] );
+
+  if( !in_pipe && stage[0] >= 0 )
+  {
+    close( stage[0] );
+    close( stage[1] );
+  }
+
+  return ret;
+}
+#endif
+
+static int blake2_hash_forward( void *S, blake2_file_update_fn update, int out_fd, int in_fd )
+{
+  uint8_t *buf = NULL;
+  int ret;
+
+  if( in_fd < 0 || out_fd < 0 ) return -1;
+
+#if defined(HAVE_POSIX_MEMALIGN)
+  if( posix_memalign( ( void ** )&buf, BLAKE2_FILE_ALIGN, BLAKE2_TEE_BYTES ) != 0 ) return -1;
+#else
+  if( NULL == ( buf = ( uint8_t * )malloc( BLAKE2_TEE_BYTES ) ) ) return -1;
+#endif
+
+#if defined(HAVE_SPLICE) && defined(HAVE_TEE)
+  ret = blake2_forward_spliced( S, update, out_fd, in_fd, buf, BLAKE2_TEE_BYTES );
+#else
+  ret = blake2_forward_rw( S, update, out_fd, in_fd, buf, BLAKE2_TEE_BYTES, UINT64_MAX );
+#endif
+  free( buf );
+  return ret;
+}
+
+/*
+   Scrubbing: the read loop again, but paced. After each chunk the wall time
+   by which both budgets are met is worked out from the totals so far (bytes
+   over the byte rate, thread CPU time over the CPU share) and the thread
+   sleeps until then, or only yields when it is already behind. Chunks are
+   resized so that one takes about BLAKE2_SCRUB_SLICE_NS, which keeps each
+   burst of reading and compressing short whatever the budgets are.
+*/
+#define BLAKE2_SCRUB_MIN ( 64 * 1024 )
+#define BLAKE2_SCRUB_MAX BLAKE2_STREAM_BYTES
+#define BLAKE2_SCRUB_SLICE_NS 20000000ULL
+#define BLAKE2_SCRUB_REPORT_NS 1000000000ULL
+
+/* Monotonic time, or this thread's CPU time; 0 where the clock is missing, which turns pacing off */
+static uint64_t blake2_scrub_clock( const int cpu )
+{
+#if defined(HAVE_CLOCK_GETTIME)
+  struct timespec ts;
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  const clockid_t id = cpu ? CLOCK_THREAD_CPUTIME_ID : CLOCK_MONOTONIC;
+#else
+  const clockid_t id = CLOCK_MONOTONIC;
+
+  if( cpu ) return 0;
+#endif
+
+  if( clock_gettime( id, &ts ) != 0 ) return 0;
+
+  return ( uint64_t )ts.tv_sec * 1000000000ULL + ( uint64_t )ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static void blake2_scrub_wait( uint64_t ns )
+{
+#if defined(HAVE_NANOSLEEP)
+  struct timespec ts;
+
+  ts.tv_sec = ( time_t )( ns / 1000000000ULL );
+  ts.tv_nsec = ( long )( ns % 1000000000ULL );
+
+  while( nanosleep( &ts, &ts ) != 0 && EINTR == errno );
+#endif
+}
+
+static int blake2_scrub_report( blake2_scrub_fn fn, void *ctx, uint64_t done, uint64_t total, uint64_t elapsed, const int finished )
+{
+  blake2_scrub_progress P[1];
+
+  P->done = done;
+  P->total = total;
+  P->elapsed_ns = elapsed;
+  P->rate = elapsed ? ( uint64_t )( ( double )done * 1e9 / ( double )elapsed ) : 0;
+
+  if( finished )
+    P->eta_ns = 0;
+  else if( total > done && P->rate )
+    P->eta_ns = ( uint64_t )( ( double )( total - done ) * 1e9 / ( double )P->rate );
+  else
+    P->eta_ns = UINT64_MAX;
+
+  return fn( ctx, P );
+}
+
+static int blake2_hash_scrub( void *S, blake2_file_update_fn update, int fd, const blake2_scrub_limits *limits, blake2_scrub_fn fn, void *ctx )
+{
+  const uint64_t rate = limits ? limits->bytes_per_sec : 0;
+  const uint64_t share = limits && limits->cpu_percent < 100 ? limits->cpu_percent : 0;
+  size_t chunk, cap = BLAKE2_SCRUB_MAX;
+  uint64_t total = 0, done = 0, start, reported, cpu0;
+  uint8_t *buf = NULL;
+  struct stat st;
+  int seekable = 0, ret = 0;
+
+  if( fd < 0 ) return -1;
+
+  if( 0 == fstat( fd, &st ) && S_ISREG( st.st_mode ) )
+  {
+    seekable = 1;
+    total = ( uint64_t )st.st_size;
+  }
+
+  /* At low rates no chunk is larger than one slice's worth of the byte budget */
+  if( rate && rate / ( 1000000000ULL / BLAKE2_SCRUB_SLICE_NS ) < cap )
+  {
+    cap = ( size_t )( rate / ( 1000000000ULL / BLAKE2_SCRUB_SLICE_NS ) ) & ~( size_t )( BLAKE2_FILE_ALIGN - 1 );
+
+    if( cap < BLAKE2_SCRUB_MIN ) cap = BLAKE2_SCRUB_MIN;
+  }
+
+  chunk = cap;
+
+#if defined(HAVE_POSIX_MEMALIGN)
+  if( posix_memalign( ( void ** )&buf, BLAKE2_FILE_ALIGN, BLAKE2_SCRUB_MAX ) != 0 ) return -1;
+#else
+  if( NULL == ( buf = ( uint8_t * )malloc( BLAKE2_SCRUB_MAX ) ) ) return -1;
+#endif
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+  if( seekable ) posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+  start = reported = blake2_scrub_clock( 0 );
+  cpu0 = blake2_scrub_clock( 1 );
+
+  for( ;; )
+  {
+    const uint64_t begin = blake2_scrub_clock( 0 );
+    uint64_t now, due = 0;
+#if defined(HAVE_PREAD)
+    const ssize_t n = seekable ? pread( fd, buf, chunk, ( off_t )done ) : read( fd, buf, chunk );
+#else
+    const ssize_t n = read( fd, buf, chunk );
+#endif
+
+    if( n < 0 )
+    {
+      if( EINTR == errno ) continue;
+
+      ret = -1;
+      break;
+    }
+
+    if( 0 == n ) break;
+
+    update( S, buf, ( size_t )n );
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+    /* Scrubbed pages are not wanted again soon; leave the page cache to the foreground */
+    if( seekable ) posix_fadvise( fd, ( off_t )done, ( off_t )n, POSIX_FADV_DONTNEED );
+#endif
+    done += ( uint64_t )n;
+    now = blake2_scrub_clock( 0 );
+
+    if( now - begin > BLAKE2_SCRUB_SLICE_NS && chunk > BLAKE2_SCRUB_MIN )
+      chunk = chunk / 2 > BLAKE2_SCRUB_MIN ? chunk / 2 : BLAKE2_SCRUB_MIN;
+    else if( 4 * ( now - begin ) < BLAKE2_SCRUB_SLICE_NS && chunk < cap )
+      chunk = 2 * chunk < cap ? 2 * chunk : cap;
+
+    if( rate ) due = ( uint64_t )( ( double )done * 1e9 / ( double )rate );
+
+    if( share )
+    {
+      const uint64_t busy = ( blake2_scrub_clock( 1 ) - cpu0 ) * 100 / share;
+
+      if( busy > due ) due = busy;
+    }
+
+    if( start + due > now )
+    {
+      blake2_scrub_wait( start + due - now );
+      now = start + due;
+    }
+    else
+    {
+#if defined(HAVE_SCHED_YIELD)
+      sched_yield();
+#endif
+    }
+
+    if( fn && now - reported >= BLAKE2_SCRUB_REPORT_NS )
+    {
+      reported = now;
+
+      if( blake2_scrub_report( fn, ctx, done, total, now - start, 0 ) < 0 )
+      {
+        ret = -1;
+        break;
+      }
+    }
+  }
+
+  if( 0 == ret && fn && blake2_scrub_report( fn, ctx, done, total, blake2_scrub_clock( 0 ) - start, 1 ) < 0 ) ret = -1;
+
+  free( buf );
+  return ret;
+}
+#else
+typedef int ( *blake2_file_update_fn )( void *S, const uint8_t *in, size_t inlen );
+
+static int blake2_hash_fd( void *S, blake2_file_update_fn update, int fd )
+{
+  return -1;
+}
+
+static int blake2_hash_direct( void *S, blake2_file_update_fn update, const char *path, unsigned flags )
+{
+  return -1;
+}
+
+static int blake2_hash_forward( void *S, blake2_file_update_fn update, int out_fd, int in_fd )
+{
+  return -1;
+}
+
+static int blake2_hash_scrub( void *S, blake2_file_update_fn update, int fd, const blake2_scrub_limits *limits, blake2_scrub_fn fn, void *ctx )
+{
+  return -1;
+}
+#endif
+
+static int blake2s_file_update( void *S, const uint8_t *in, size_t inlen )
+{
+  return blake2s_update( ( blake2s_state * )S, in, inlen );
+}
+
+static int blake2b_file_update( void *S, const uint8_t *in, size_t inlen )
+{
+  return blake2b_update( ( blake2b_state * )S, in, inlen );
+}
+
+static int blake2sp_file_update( void *S, const uint8_t *in, size_t inlen )
+{
+  return blake2sp_update( ( blake2sp_state * )S, in, inlen );
+}
+
+static int blake2bp_file_update( void *S, const uint8_t *in, size_t inlen )
+{
+  return blake2bp_update( ( blake2bp_state * )S, in, inlen );
+}
+
+int blake2s_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen )
+{
+  blake2s_state S[1];
+
+  if( ( keylen ? blake2s_init_key( S, outlen, key, keylen ) : blake2s_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_fd( S, blake2s_file_update, fd ) < 0 ) return -1;
+
+  return blake2s_final( S, out, outlen );
+}
+
+int blake2b_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen )
+{
+  blake2b_state S[1];
+
+  if( ( keylen ? blake2b_init_key( S, outlen, key, keylen ) : blake2b_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_fd( S, blake2b_file_update, fd ) < 0 ) return -1;
+
+  return blake2b_final( S, out, outlen );
+}
+
+int blake2sp_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen )
+{
+  blake2sp_state S[1];
+
+  if( ( keylen ? blake2sp_init_key( S, outlen, key, keylen ) : blake2sp_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_fd( S, blake2sp_file_update, fd ) < 0 ) return -1;
+
+  return blake2sp_final( S, out, outlen );
+}
+
+int blake2bp_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen )
+{
+  blake2bp_state S[1];
+
+  if( ( keylen ? blake2bp_init_key( S, outlen, key, keylen ) : blake2bp_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_fd( S, blake2bp_file_update, fd ) < 0 ) return -1;
+
+  return blake2bp_final( S, out, outlen );
+}
+
+int blake2s_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags )
+{
+  blake2s_state S[1];
+
+  if( ( keylen ? blake2s_init_key( S, outlen, key, keylen ) : blake2s_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_direct( S, blake2s_file_update, path, flags ) < 0 ) return -1;
+
+  return blake2s_final( S, out, outlen );
+}
+
+int blake2b_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags )
+{
+  blake2b_state S[1];
+
+  if( ( keylen ? blake2b_init_key( S, outlen, key, keylen ) : blake2b_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_direct( S, blake2b_file_update, path, flags ) < 0 ) return -1;
+
+  return blake2b_final( S, out, outlen );
+}
+
+int blake2sp_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags )
+{
+  blake2sp_state S[1];
+
+  if( ( keylen ? blake2sp_init_key( S, outlen, key, keylen ) : blake2sp_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_direct( S, blake2sp_file_update, path, flags ) < 0 ) return -1;
+
+  return blake2sp_final( S, out, outlen );
+}
+
+int blake2bp_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags )
+{
+  blake2bp_state S[1];
+
+  if( ( keylen ? blake2bp_init_key( S, outlen, key, keylen ) : blake2bp_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_direct( S, blake2bp_file_update, path, flags ) < 0 ) return -1;
+
+  return blake2bp_final( S, out, outlen );
+}
+
+int blake2b_forward( blake2b_state *S, int out_fd, int in_fd )
+{
+  return blake2_hash_forward( S, blake2b_file_update, out_fd, in_fd );
+}
+
+int blake2bp_forward( blake2bp_state *S, int out_fd, int in_fd )
+{
+  return blake2_hash_forward( S, blake2bp_file_update, out_fd, in_fd );
+}
+
+int blake2b_scrub( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen, const blake2_scrub_limits *limits, blake2_scrub_fn fn, void *ctx )
+{
+  blake2b_state S[1];
+
+  if( ( keylen ? blake2b_init_key( S, outlen, key, keylen ) : blake2b_init( S, outlen ) ) < 0 ) return -1;
+
+  if( blake2_hash_scrub( S, blake2b_file_update, fd, limits, fn, ctx ) < 0 ) return -1;
+
+  return blake2b_final( S, out, outlen );
+}
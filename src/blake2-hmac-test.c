@@ -0,0 +1,183 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+static int unhex( uint8_t *out, const char *hex )
+{
+  size_t n = strlen( hex ) / 2;
+
+  for( size_t i = 0; i < n; ++i )
+  {
+    unsigned int v;
+    sscanf( hex + 2 * i, "%2x", &v );
+    out[i] = ( uint8_t )v;
+  }
+
+  return ( int )n;
+}
+
+/* HMAC-BLAKE2s(0..31, 0..99) */
+static const char hmac_blake2s_kat[] =
+  "a81c95080ba2a7c4ed1b7b4c21dec2c4fd6dc9f03ff37b6d65289dc95a7d1ef1";
+
+/* HMAC-BLAKE2b(0..199, ""), with a key longer than a block */
+static const char hmac_blake2b_kat[] =
+  "7388546f6fc7f13d6a774d6c7ed213aafc3c82f27851f8fae9fa679c6f52eb7c"
+  "c873c4a7f0b574ce29ff40e0641a436015a41a2cfbb84b9906495d4f801dbe4c";
+
+/* HKDF-BLAKE2s(salt = "salt", ikm = 0..21, info = "info", L = 80) */
+static const char hkdf_blake2s_kat[] =
+  "128e90ef1ad871479e5bc2b525afc08321d35b5b2bf452b7cc487af5b72549cc"
+  "346c7e8bd8a82df49744e9c7c6db9dd14ad56c612337637501ae75ddb30f2afc"
+  "9944767213871ab9710fd6d2b2e54a5c";
+
+/* HKDF-BLAKE2b(salt = "", ikm = 0..21, info = "", L = 100) */
+static const char hkdf_blake2b_kat[] =
+  "55e8a7037f290e5804b2ad1e43033b68f9b71f8bb64a93a7e6664af7892c0052"
+  "00426ed8c22a8245fe0c571abf3dd925a1f595a7d48cc91846dd21227f6488cc"
+  "6b3b8f3bff752491c444af67c334df9ad0703a5aced4f5b0f88276d4172b4218"
+  "7d99219e";
+
+/* HMAC spelled out with two plain hashes */
+static void naive_hmac_blake2s( uint8_t *out, const uint8_t *in, size_t inlen, const uint8_t *key, size_t keylen )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES] = {0};
+  uint8_t inner[BLAKE2S_OUTBYTES];
+  blake2s_state S[1];
+
+  if( keylen > BLAKE2S_BLOCKBYTES ) blake2s( block, key, NULL, BLAKE2S_OUTBYTES, keylen, 0 );
+  else memcpy( block, key, keylen );
+
+  for( size_t i = 0; i < sizeof( block ); ++i ) block[i] ^= 0x36;
+
+  blake2s_init( S, BLAKE2S_OUTBYTES );
+  blake2s_update( S, block, sizeof( block ) );
+  blake2s_update( S, in, inlen );
+  blake2s_final( S, inner, BLAKE2S_OUTBYTES );
+
+  for( size_t i = 0; i < sizeof( block ); ++i ) block[i] ^= 0x36 ^ 0x5c;
+
+  blake2s_init( S, BLAKE2S_OUTBYTES );
+  blake2s_update( S, block, sizeof( block ) );
+  blake2s_update( S, inner, sizeof( inner ) );
+  blake2s_final( S, out, BLAKE2S_OUTBYTES );
+}
+
+static int test_kat( void )
+{
+  uint8_t key[200], msg[100], buf[128], prk[BLAKE2B_OUTBYTES], kat[128];
+  blake2s_hmac_key KS[1];
+  blake2b_hmac_key KB[1];
+
+  for( size_t i = 0; i < sizeof( key ); ++i ) key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i ) msg[i] = ( uint8_t )i;
+
+  if( blake2s_hmac( buf, msg, key, 100, 32 ) < 0 ||
+      0 != memcmp( buf, kat, unhex( kat, hmac_blake2s_kat ) ) )
+    return -1;
+
+  if( blake2b_hmac( buf, "", key, 0, 200 ) < 0 ||
+      0 != memcmp( buf, kat, unhex( kat, hmac_blake2b_kat ) ) )
+    return -1;
+
+  if( blake2s_hkdf_extract( prk, "salt", 4, key, 22 ) < 0 ||
+      blake2s_hmac_key_init( KS, prk, BLAKE2S_OUTBYTES ) < 0 ||
+      blake2s_hkdf_expand( buf, 80, KS, "info", 4 ) < 0 ||
+      0 != memcmp( buf, kat, unhex( kat, hkdf_blake2s_kat ) ) )
+    return -1;
+
+  if( blake2b_hkdf_extract( prk, NULL, 0, key, 22 ) < 0 ||
+      blake2b_hmac_key_init( KB, prk, BLAKE2B_OUTBYTES ) < 0 ||
+      blake2b_hkdf_expand( buf, 100, KB, NULL, 0 ) < 0 ||
+      0 != memcmp( buf, kat, unhex( kat, hkdf_blake2b_kat ) ) )
+    return -1;
+
+  return 0;
+}
+
+static int test_streaming( void )
+{
+  uint8_t key[150], msg[300];
+  uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+
+  for( size_t i = 0; i < sizeof( key ); ++i ) key[i] = ( uint8_t )( i + 7 );
+
+  for( size_t i = 0; i < sizeof( msg ); ++i ) msg[i] = ( uint8_t )( i * 3 );
+
+  for( size_t keylen = 0; keylen <= sizeof( key ); keylen += 13 )
+  {
+    blake2s_hmac_key K[1];
+
+    if( blake2s_hmac_key_init( K, key, keylen ) < 0 ) return -1;
+
+    for( size_t inlen = 0; inlen <= sizeof( msg ); inlen += 23 )
+    {
+      blake2s_hmac_state S[1];
+      naive_hmac_blake2s( a, msg, inlen, key, keylen );
+
+      blake2s_hmac_init( S, K );
+      blake2s_hmac_update( S, msg, inlen / 2 );
+      blake2s_hmac_update( S, msg + inlen / 2, inlen - inlen / 2 );
+
+      if( blake2s_hmac_final( S, b, BLAKE2S_OUTBYTES ) < 0 || 0 != memcmp( a, b, sizeof( a ) ) )
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int test_batch( void )
+{
+  uint8_t infos[10][5];
+  uint8_t batch[10 * 70], one[70];
+  blake2b_hmac_key K[1];
+
+  if( blake2b_hmac_key_init( K, "prk", 3 ) < 0 ) return -1;
+
+  for( size_t i = 0; i < 10; ++i )
+  {
+    memcpy( infos[i], "key-", 4 );
+    infos[i][4] = ( uint8_t )( '0' + i );
+  }
+
+  if( blake2b_hkdf_expand_batch( batch, 70, K, infos, 5, 10 ) < 0 ) return -1;
+
+  for( size_t i = 0; i < 10; ++i )
+  {
+    if( blake2b_hkdf_expand( one, 70, K, infos[i], 5 ) < 0 ||
+        0 != memcmp( one, batch + i * 70, 70 ) )
+      return -1;
+  }
+
+  /* More than 255 blocks is not expressible */
+  if( blake2b_hkdf_expand( batch, 255 * BLAKE2B_OUTBYTES + 1, K, NULL, 0 ) == 0 ) return -1;
+
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  if( test_kat() < 0 || test_streaming() < 0 || test_batch() < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
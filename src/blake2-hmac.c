@@ -0,0 +1,312 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   HMAC over unkeyed, full-length BLAKE2. Both pad blocks are compressed once
+   per key with the prepared-key machinery, so a MAC costs only the message
+   blocks plus one outer block, as with the native keyed mode. The pads are
+   exactly one block, which is the shape blake2[bs]_prepare_state expects.
+*/
+
+static int blake2s_hmac_pad( blake2s_prepared_key *K, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+{
+  blake2s_state S[1];
+  int ret;
+
+  if( blake2s_init( S, BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  blake2s_update( S, block, BLAKE2S_BLOCKBYTES );
+  ret = blake2s_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2s_hmac_key_init( blake2s_hmac_key *K, const void *key, size_t keylen )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  int ret = 0;
+
+  if( NULL == key && keylen > 0 ) return -1;
+
+  memset( block, 0, BLAKE2S_BLOCKBYTES );
+
+  if( keylen > BLAKE2S_BLOCKBYTES )
+    blake2s( block, key, NULL, BLAKE2S_OUTBYTES, keylen, 0 );
+  else if( keylen > 0 )
+    memcpy( block, key, keylen );
+
+  for( size_t i = 0; i < BLAKE2S_BLOCKBYTES; ++i ) block[i] ^= 0x36;
+
+  if( blake2s_hmac_pad( K->I, block ) < 0 ) ret = -1;
+
+  for( size_t i = 0; i < BLAKE2S_BLOCKBYTES; ++i ) block[i] ^= 0x36 ^ 0x5c;
+
+  if( blake2s_hmac_pad( K->O, block ) < 0 ) ret = -1;
+
+  secure_zero_memory( block, BLAKE2S_BLOCKBYTES ); /* Burn the key from stack */
+  return ret;
+}
+
+int blake2s_hmac_init( blake2s_hmac_state *S, const blake2s_hmac_key *K )
+{
+  memcpy( S->O, K->O, sizeof( S->O ) );
+  return blake2s_init_prepared( S->S, K->I );
+}
+
+int blake2s_hmac_update( blake2s_hmac_state *S, const uint8_t *in, size_t inlen )
+{
+  return blake2s_update( S->S, in, inlen );
+}
+
+int blake2s_hmac_final( blake2s_hmac_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t inner[BLAKE2S_OUTBYTES];
+  blake2s_state O[1];
+  int ret;
+
+  if( outlen != BLAKE2S_OUTBYTES ) return -1;
+
+  if( blake2s_final( S->S, inner, BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  blake2s_init_prepared( O, S->O );
+  blake2s_update( O, inner, BLAKE2S_OUTBYTES );
+  ret = blake2s_final( O, out, outlen );
+  secure_zero_memory( inner, sizeof( inner ) );
+  secure_zero_memory( O, sizeof( O ) );
+  return ret;
+}
+
+int blake2s_hmac( uint8_t *out, const void *in, const void *key, size_t inlen, size_t keylen )
+{
+  blake2s_hmac_key K[1];
+  blake2s_hmac_state S[1];
+  int ret;
+
+  if( NULL == out || ( NULL == in && inlen > 0 ) ) return -1;
+
+  if( blake2s_hmac_key_init( K, key, keylen ) < 0 ) return -1;
+
+  blake2s_hmac_init( S, K );
+  blake2s_hmac_update( S, ( const uint8_t * )in, inlen );
+  ret = blake2s_hmac_final( S, out, BLAKE2S_OUTBYTES );
+  secure_zero_memory( K, sizeof( K ) );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+/* An empty salt is the same HMAC key as HashLen zero bytes, so no special case is needed */
+int blake2s_hkdf_extract( uint8_t *prk, const void *salt, size_t saltlen, const void *ikm, size_t ikmlen )
+{
+  return blake2s_hmac( prk, ikm, salt, ikmlen, saltlen );
+}
+
+/* T(i) = HMAC(PRK, T(i-1) || info || i), every block starting from the cached pad midstates */
+static int blake2s_hkdf_expand_one( uint8_t *out, size_t outlen, const blake2s_hmac_key *K, const uint8_t *info, size_t infolen )
+{
+  blake2s_hmac_state S[1];
+  uint8_t t[BLAKE2S_OUTBYTES];
+  size_t tlen = 0;
+  uint8_t counter = 1;
+
+  while( outlen > 0 )
+  {
+    size_t n = outlen < BLAKE2S_OUTBYTES ? outlen : BLAKE2S_OUTBYTES;
+    blake2s_hmac_init( S, K );
+    blake2s_hmac_update( S, t, tlen );
+    blake2s_hmac_update( S, info, infolen );
+    blake2s_hmac_update( S, &counter, 1 );
+    blake2s_hmac_final( S, t, BLAKE2S_OUTBYTES );
+    memcpy( out, t, n );
+    out += n;
+    outlen -= n;
+    tlen = BLAKE2S_OUTBYTES;
+    ++counter;
+  }
+
+  secure_zero_memory( t, sizeof( t ) );
+  secure_zero_memory( S, sizeof( S ) );
+  return 0;
+}
+
+int blake2s_hkdf_expand( uint8_t *out, size_t outlen, const blake2s_hmac_key *K, const void *info, size_t infolen )
+{
+  if( NULL == out || outlen > 255 * BLAKE2S_OUTBYTES ) return -1;
+
+  if( NULL == info && infolen > 0 ) return -1;
+
+  return blake2s_hkdf_expand_one( out, outlen, K, ( const uint8_t * )info, infolen );
+}
+
+int blake2s_hkdf_expand_batch( uint8_t *out, size_t outlen, const blake2s_hmac_key *K, const void *infos, size_t infolen, size_t count )
+{
+  const uint8_t *info = ( const uint8_t * )infos;
+
+  if( NULL == out || outlen > 255 * BLAKE2S_OUTBYTES ) return -1;
+
+  if( NULL == infos && infolen > 0 ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+    blake2s_hkdf_expand_one( out + i * outlen, outlen, K, info + i * infolen, infolen );
+
+  return 0;
+}
+
+static int blake2b_hmac_pad( blake2b_prepared_key *K, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  blake2b_state S[1];
+  int ret;
+
+  if( blake2b_init( S, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  blake2b_update( S, block, BLAKE2B_BLOCKBYTES );
+  ret = blake2b_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2b_hmac_key_init( blake2b_hmac_key *K, const void *key, size_t keylen )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  int ret = 0;
+
+  if( NULL == key && keylen > 0 ) return -1;
+
+  memset( block, 0, BLAKE2B_BLOCKBYTES );
+
+  if( keylen > BLAKE2B_BLOCKBYTES )
+    blake2b( block, key, NULL, BLAKE2B_OUTBYTES, keylen, 0 );
+  else if( keylen > 0 )
+    memcpy( block, key, keylen );
+
+  for( size_t i = 0; i < BLAKE2B_BLOCKBYTES; ++i ) block[i] ^= 0x36;
+
+  if( blake2b_hmac_pad( K->I, block ) < 0 ) ret = -1;
+
+  for( size_t i = 0; i < BLAKE2B_BLOCKBYTES; ++i ) block[i] ^= 0x36 ^ 0x5c;
+
+  if( blake2b_hmac_pad( K->O, block ) < 0 ) ret = -1;
+
+  secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
+  return ret;
+}
+
+int blake2b_hmac_init( blake2b_hmac_state *S, const blake2b_hmac_key *K )
+{
+  memcpy( S->O, K->O, sizeof( S->O ) );
+  return blake2b_init_prepared( S->S, K->I );
+}
+
+int blake2b_hmac_update( blake2b_hmac_state *S, const uint8_t *in, size_t inlen )
+{
+  return blake2b_update( S->S, in, inlen );
+}
+
+int blake2b_hmac_final( blake2b_hmac_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t inner[BLAKE2B_OUTBYTES];
+  blake2b_state O[1];
+  int ret;
+
+  if( outlen != BLAKE2B_OUTBYTES ) return -1;
+
+  if( blake2b_final( S->S, inner, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  blake2b_init_prepared( O, S->O );
+  blake2b_update( O, inner, BLAKE2B_OUTBYTES );
+  ret = blake2b_final( O, out, outlen );
+  secure_zero_memory( inner, sizeof( inner ) );
+  secure_zero_memory( O, sizeof( O ) );
+  return ret;
+}
+
+int blake2b_hmac( uint8_t *out, const void *in, const void *key, size_t inlen, size_t keylen )
+{
+  blake2b_hmac_key K[1];
+  blake2b_hmac_state S[1];
+  int ret;
+
+  if( NULL == out || ( NULL == in && inlen > 0 ) ) return -1;
+
+  if( blake2b_hmac_key_init( K, key, keylen ) < 0 ) return -1;
+
+  blake2b_hmac_init( S, K );
+  blake2b_hmac_update( S, ( const uint8_t * )in, inlen );
+  ret = blake2b_hmac_final( S, out, BLAKE2B_OUTBYTES );
+  secure_zero_memory( K, sizeof( K ) );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+/* An empty salt is the same HMAC key as HashLen zero bytes, so no special case is needed */
+int blake2b_hkdf_extract( uint8_t *prk, const void *salt, size_t saltlen, const void *ikm, size_t ikmlen )
+{
+  return blake2b_hmac( prk, ikm, salt, ikmlen, saltlen );
+}
+
+/* T(i) = HMAC(PRK, T(i-1) || info || i), every block starting from the cached pad midstates */
+static int blake2b_hkdf_expand_one( uint8_t *out, size_t outlen, const blake2b_hmac_key *K, const uint8_t *info, size_t infolen )
+{
+  blake2b_hmac_state S[1];
+  uint8_t t[BLAKE2B_OUTBYTES];
+  size_t tlen = 0;
+  uint8_t counter = 1;
+
+  while( outlen > 0 )
+  {
+    size_t n = outlen < BLAKE2B_OUTBYTES ? outlen : BLAKE2B_OUTBYTES;
+    blake2b_hmac_init( S, K );
+    blake2b_hmac_update( S, t, tlen );
+    blake2b_hmac_update( S, info, infolen );
+    blake2b_hmac_update( S, &counter, 1 );
+    blake2b_hmac_final( S, t, BLAKE2B_OUTBYTES );
+    memcpy( out, t, n );
+    out += n;
+    outlen -= n;
+    tlen = BLAKE2B_OUTBYTES;
+    ++counter;
+  }
+
+  secure_zero_memory( t, sizeof( t ) );
+  secure_zero_memory( S, sizeof( S ) );
+  return 0;
+}
+
+int blake2b_hkdf_expand( uint8_t *out, size_t outlen, const blake2b_hmac_key *K, const void *info, size_t infolen )
+{
+  if( NULL == out || outlen > 255 * BLAKE2B_OUTBYTES ) return -1;
+
+  if( NULL == info && infolen > 0 ) return -1;
+
+  return blake2b_hkdf_expand_one( out, outlen, K, ( const uint8_t * )info, infolen );
+}
+
+int blake2b_hkdf_expand_batch( uint8_t *out, size_t outlen, const blake2b_hmac_key *K, const void *infos, size_t infolen, size_t count )
+{
+  const uint8_t *info = ( const uint8_t * )infos;
+
+  if( NULL == out || outlen > 255 * BLAKE2B_OUTBYTES ) return -1;
+
+  if( NULL == infos && infolen > 0 ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+    blake2b_hkdf_expand_one( out + i * outlen, outlen, K, info + i * infolen, infolen );
+
+  return 0;
+}
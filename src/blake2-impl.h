@@ -23,10 +23,24 @@
 #include <string.h>
 #include "config.h"
 
+#if defined(HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#else
+/* POSIX layout, so the scatter-gather updates build where sys/uio.h is missing */
+struct iovec
+{
+  void  *iov_base;
+  size_t iov_len;
+};
+#endif
+
 #define BLAKE2_IMPL_CAT(x,y) x ## y
 #define BLAKE2_IMPL_EVAL(x,y)  BLAKE2_IMPL_CAT(x,y)
 #define BLAKE2_IMPL_NAME(fun)  BLAKE2_IMPL_EVAL(fun, SUFFIX)
 
+/* Copies at least this long bypass the cache with non-temporal stores */
+#define BLAKE2_STREAM_BYTES ( 1 << 20 )
+
 static inline uint32_t load32( const void *src )
 {
 #if defined(NATIVE_LITTLE_ENDIAN)
@@ -136,6 +150,23 @@ static inline uint64_t rotr64( const uint64_t w, const unsigned c )
   return ( w >> c ) | ( w << ( 64 - c ) );
 }
 
+/*
+   A state fresh from blake2[bs]_init_prepared has its key block compressed
+   and nothing buffered; buf then carries the empty-message MAC, and the
+   upper half of buf, dead while nothing is buffered, carries
+   BLAKE2_PREPARED_TAG. The public states are packed and have no room for
+   a flag. Only init_prepared writes the tag, and the counter retires it as
+   soon as any further block is compressed, so no update path has to clear it.
+*/
+#define BLAKE2_PREPARED_TAG "BLAKE2 prepared"
+
+#define BLAKE2_PREPARED_MARK( S, blockbytes ) \
+  memcpy( ( S )->buf + ( blockbytes ), BLAKE2_PREPARED_TAG, sizeof( BLAKE2_PREPARED_TAG ) )
+
+#define BLAKE2_PREPARED_EMPTY( S, blockbytes ) \
+  ( 0 == ( S )->buflen && ( blockbytes ) == ( S )->t[0] && 0 == ( S )->t[1] && \
+    0 == memcmp( ( S )->buf + ( blockbytes ), BLAKE2_PREPARED_TAG, sizeof( BLAKE2_PREPARED_TAG ) ) )
+
 /* prevents compiler optimizing out memset() */
 static inline void secure_zero_memory(void *v, size_t n)
 {
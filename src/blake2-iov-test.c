@@ -0,0 +1,212 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "blake2.h"
+
+#define MSGBYTES 2000
+
+/* Fragment sizes cycled through when cutting a message up, empty ones included */
+static const size_t sizes[] = { 0, 1, 63, 64, 65, 127, 128, 129, 0, 255, 256, 257, 3, 512, 700 };
+#define NSIZES ( sizeof( sizes ) / sizeof( sizes[0] ) )
+
+/* Cuts in[0..inlen) into fragments, starting at sizes[first]; returns the fragment count */
+static int cut( struct iovec *iov, const uint8_t *in, size_t inlen, size_t first )
+{
+  size_t off = 0;
+  int n = 0;
+
+  for( size_t i = first; off < inlen; ++i, ++n )
+  {
+    size_t len = sizes[i % NSIZES];
+
+    if( len > inlen - off ) len = inlen - off;
+
+    iov[n].iov_base = ( void * )( in + off );
+    iov[n].iov_len = len;
+    off += len;
+  }
+
+  return n;
+}
+
+/* Hashes msg[0..inlen) as a plain update of the first skip bytes followed by updatev of the rest */
+static int check_blake2s( const uint8_t *msg, size_t inlen, size_t skip, const struct iovec *iov, int n )
+{
+  uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+  blake2s_state S[1];
+
+  blake2s( a, msg, NULL, BLAKE2S_OUTBYTES, inlen, 0 );
+  blake2s_init( S, BLAKE2S_OUTBYTES );
+  blake2s_update( S, msg, skip );
+
+  if( blake2s_updatev( S, iov, n ) < 0 || blake2s_final( S, b, BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  return 0 == memcmp( a, b, sizeof( a ) ) ? 0 : -1;
+}
+
+static int check_blake2b( const uint8_t *msg, size_t inlen, size_t skip, const struct iovec *iov, int n )
+{
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  blake2b_state S[1];
+
+  blake2b( a, msg, NULL, BLAKE2B_OUTBYTES, inlen, 0 );
+  blake2b_init( S, BLAKE2B_OUTBYTES );
+  blake2b_update( S, msg, skip );
+
+  if( blake2b_updatev( S, iov, n ) < 0 || blake2b_final( S, b, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  return 0 == memcmp( a, b, sizeof( a ) ) ? 0 : -1;
+}
+
+static int check_blake2sp( const uint8_t *msg, size_t inlen, size_t skip, const struct iovec *iov, int n )
+{
+  uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+  blake2sp_state S[1];
+
+  blake2sp( a, msg, NULL, BLAKE2S_OUTBYTES, inlen, 0 );
+  blake2sp_init( S, BLAKE2S_OUTBYTES );
+  blake2sp_update( S, msg, skip );
+
+  if( blake2sp_updatev( S, iov, n ) < 0 || blake2sp_final( S, b, BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  return 0 == memcmp( a, b, sizeof( a ) ) ? 0 : -1;
+}
+
+static int check_blake2bp( const uint8_t *msg, size_t inlen, size_t skip, const struct iovec *iov, int n )
+{
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  blake2bp_state S[1];
+
+  blake2bp( a, msg, NULL, BLAKE2B_OUTBYTES, inlen, 0 );
+  blake2bp_init( S, BLAKE2B_OUTBYTES );
+  blake2bp_update( S, msg, skip );
+
+  if( blake2bp_updatev( S, iov, n ) < 0 || blake2bp_final( S, b, BLAKE2B_OUTBYTES ) < 0 ) return -1;
+
+  return 0 == memcmp( a, b, sizeof( a ) ) ? 0 : -1;
+}
+
+static int test_updatev( const uint8_t *msg )
+{
+  static const size_t skips[] = { 0, 1, 64, 77, 128, 200, 256 };
+  struct iovec iov[MSGBYTES];
+
+  for( size_t inlen = 0; inlen <= MSGBYTES; inlen += 97 )
+    for( size_t first = 0; first < NSIZES; ++first )
+      for( size_t k = 0; k < sizeof( skips ) / sizeof( skips[0] ); ++k )
+      {
+        const size_t skip = skips[k] < inlen ? skips[k] : inlen;
+        const int n = cut( iov, msg + skip, inlen - skip, first );
+
+        if( check_blake2s( msg, inlen, skip, iov, n ) < 0 ||
+            check_blake2b( msg, inlen, skip, iov, n ) < 0 ||
+            check_blake2sp( msg, inlen, skip, iov, n ) < 0 ||
+            check_blake2bp( msg, inlen, skip, iov, n ) < 0 )
+          return -1;
+      }
+
+  return 0;
+}
+
+static int test_invalid( void )
+{
+  struct iovec iov[2] = { { NULL, 0 }, { NULL, 1 } };
+  blake2b_state S[1];
+
+  blake2b_init( S, BLAKE2B_OUTBYTES );
+
+  if( blake2b_updatev( S, iov, -1 ) == 0 || blake2b_updatev( S, iov, 2 ) == 0 ) return -1;
+
+  /* An empty NULL fragment is fine */
+  return blake2b_updatev( S, iov, 1 );
+}
+
+static int test_update_msg( const uint8_t *msg )
+{
+  struct iovec iov[MSGBYTES];
+  struct msghdr mh;
+  const int n = cut( iov, msg, MSGBYTES, 3 );
+
+  memset( &mh, 0, sizeof( mh ) );
+  mh.msg_iov = iov;
+  mh.msg_iovlen = n;
+
+  /* recvmsg filled len bytes, usually less than the buffers offered */
+  for( size_t len = 0; len <= MSGBYTES; len += 61 )
+  {
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+    blake2s_state SS[1];
+    blake2b_state SB[1];
+    blake2sp_state SSP[1];
+    blake2bp_state SBP[1];
+
+    blake2s( a, msg, NULL, BLAKE2S_OUTBYTES, len, 0 );
+    blake2s_init( SS, BLAKE2S_OUTBYTES );
+
+    if( blake2s_update_msg( SS, &mh, len ) < 0 || blake2s_final( SS, b, BLAKE2S_OUTBYTES ) < 0 ||
+        0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+      return -1;
+
+    blake2b( a, msg, NULL, BLAKE2B_OUTBYTES, len, 0 );
+    blake2b_init( SB, BLAKE2B_OUTBYTES );
+
+    if( blake2b_update_msg( SB, &mh, len ) < 0 || blake2b_final( SB, b, BLAKE2B_OUTBYTES ) < 0 ||
+        0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+      return -1;
+
+    blake2sp( a, msg, NULL, BLAKE2S_OUTBYTES, len, 0 );
+    blake2sp_init( SSP, BLAKE2S_OUTBYTES );
+
+    if( blake2sp_update_msg( SSP, &mh, len ) < 0 || blake2sp_final( SSP, b, BLAKE2S_OUTBYTES ) < 0 ||
+        0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+      return -1;
+
+    blake2bp( a, msg, NULL, BLAKE2B_OUTBYTES, len, 0 );
+    blake2bp_init( SBP, BLAKE2B_OUTBYTES );
+
+    if( blake2bp_update_msg( SBP, &mh, len ) < 0 || blake2bp_final( SBP, b, BLAKE2B_OUTBYTES ) < 0 ||
+        0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+      return -1;
+  }
+
+  /* More bytes than the message holds */
+  {
+    blake2b_state S[1];
+    blake2b_init( S, BLAKE2B_OUTBYTES );
+
+    if( blake2b_update_msg( S, &mh, MSGBYTES + 1 ) == 0 ) return -1;
+  }
+
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t msg[MSGBYTES];
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  if( test_updatev( msg ) < 0 || test_invalid() < 0 || test_update_msg( msg ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
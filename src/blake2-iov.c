@@ -0,0 +1,111 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_SYS_SOCKET_H)
+#include <sys/socket.h>
+
+/*
+   The msghdr variants hash the first len bytes described by msg->msg_iov,
+   typically the return value of recvmsg(). Fragments wholly covered by len go
+   straight to updatev; the one cut short is passed as a shortened copy of its
+   iovec, so no data is copied either way.
+*/
+static int blake2_msg_split( const struct msghdr *msg, size_t len, struct iovec *tail )
+{
+  const struct iovec *iov = msg->msg_iov;
+  const size_t iovlen = ( size_t )msg->msg_iovlen;
+  size_t n = 0;
+
+  if( NULL == iov && iovlen > 0 ) return -1;
+
+  while( n < iovlen && iov[n].iov_len <= len )
+    len -= iov[n++].iov_len;
+
+  /* len reaches past the last fragment */
+  if( n == iovlen && len > 0 ) return -1;
+
+  if( n > INT_MAX ) return -1;
+
+  tail->iov_base = len > 0 ? iov[n].iov_base : NULL;
+  tail->iov_len = len;
+  return ( int )n;
+}
+
+int blake2s_update_msg( blake2s_state *S, const struct msghdr *msg, size_t len )
+{
+  struct iovec tail[1];
+  const int n = blake2_msg_split( msg, len, tail );
+
+  if( n < 0 || blake2s_updatev( S, msg->msg_iov, n ) < 0 ) return -1;
+
+  return blake2s_updatev( S, tail, tail->iov_len > 0 );
+}
+
+int blake2b_update_msg( blake2b_state *S, const struct msghdr *msg, size_t len )
+{
+  struct iovec tail[1];
+  const int n = blake2_msg_split( msg, len, tail );
+
+  if( n < 0 || blake2b_updatev( S, msg->msg_iov, n ) < 0 ) return -1;
+
+  return blake2b_updatev( S, tail, tail->iov_len > 0 );
+}
+
+int blake2sp_update_msg( blake2sp_state *S, const struct msghdr *msg, size_t len )
+{
+  struct iovec tail[1];
+  const int n = blake2_msg_split( msg, len, tail );
+
+  if( n < 0 || blake2sp_updatev( S, msg->msg_iov, n ) < 0 ) return -1;
+
+  return blake2sp_updatev( S, tail, tail->iov_len > 0 );
+}
+
+int blake2bp_update_msg( blake2bp_state *S, const struct msghdr *msg, size_t len )
+{
+  struct iovec tail[1];
+  const int n = blake2_msg_split( msg, len, tail );
+
+  if( n < 0 || blake2bp_updatev( S, msg->msg_iov, n ) < 0 ) return -1;
+
+  return blake2bp_updatev( S, tail, tail->iov_len > 0 );
+}
+
+#else
+int blake2s_update_msg( blake2s_state *S, const struct msghdr *msg, size_t len )
+{
+  return -1;
+}
+
+int blake2b_update_msg( blake2b_state *S, const struct msghdr *msg, size_t len )
+{
+  return -1;
+}
+
+int blake2sp_update_msg( blake2sp_state *S, const struct msghdr *msg, size_t len )
+{
+  return -1;
+}
+
+int blake2bp_update_msg( blake2bp_state *S, const struct msghdr *msg, size_t len )
+{
+  return -1;
+}
+#endif
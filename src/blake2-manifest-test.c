@@ -0,0 +1,192 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "blake2.h"
+
+static const char *names[] = { "a", "sub/b", "sub/deep/c", "z-empty" };
+static const size_t sizes[] = { 1000, 70000, 129, 0 };
+#define NFILES ( sizeof( names ) / sizeof( names[0] ) )
+
+typedef struct
+{
+  blake2b_state S[1];
+  const uint8_t *msg;
+  size_t seen;
+  int error;
+} listing;
+
+/* Rebuilds the tree digest from the entries, checking their order and file digests on the way */
+static int check_entry( void *ctx, const char *path, uint64_t size, const uint8_t *digest )
+{
+  listing *L = ( listing * )ctx;
+  uint8_t word[8], expect[BLAKE2_MANIFEST_DIGESTBYTES];
+
+  if( L->seen >= NFILES || 0 != strcmp( path, names[L->seen] ) || size != sizes[L->seen] ) L->error = 1;
+
+  /* The files were hashed from inside the walker's parallel region; each must still match a plain BLAKE2bp */
+  if( 0 == L->error && L->msg )
+  {
+    blake2bp( expect, L->msg, NULL, BLAKE2_MANIFEST_DIGESTBYTES, ( size_t )size, 0 );
+
+    if( 0 != memcmp( expect, digest, BLAKE2_MANIFEST_DIGESTBYTES ) ) L->error = 1;
+  }
+
+  for( size_t i = 0; i < 8; ++i ) word[i] = ( uint8_t )( strlen( path ) >> ( 8 * i ) );
+
+  blake2b_update( L->S, word, 8 );
+  blake2b_update( L->S, ( const uint8_t * )path, strlen( path ) );
+
+  for( size_t i = 0; i < 8; ++i ) word[i] = ( uint8_t )( size >> ( 8 * i ) );
+
+  blake2b_update( L->S, word, 8 );
+  blake2b_update( L->S, digest, BLAKE2_MANIFEST_DIGESTBYTES );
+  ++L->seen;
+  return 0;
+}
+
+static int write_file( const char *dir, const char *name, const uint8_t *msg, size_t len )
+{
+  char path[256];
+  FILE *fp;
+
+  snprintf( path, sizeof( path ), "%s/%s", dir, name );
+
+  if( NULL == ( fp = fopen( path, "wb" ) ) ) return -1;
+
+  if( fwrite( msg, 1, len, fp ) != len )
+  {
+    fclose( fp );
+    return -1;
+  }
+
+  return fclose( fp );
+}
+
+static int test_manifest( const char *dir, const uint8_t *msg )
+{
+  uint8_t first[BLAKE2B_OUTBYTES], again[BLAKE2B_OUTBYTES], fresh[BLAKE2B_OUTBYTES], expect[BLAKE2B_OUTBYTES];
+  char cache[256], path[256];
+  struct timespec times[2];
+  struct stat st;
+  listing L[1];
+  uint8_t changed[1000];
+
+  snprintf( cache, sizeof( cache ), "%s.cache", dir );
+
+  /* A cold scan lists the files in path order, skipping the symlink */
+  memset( L, 0, sizeof( L ) );
+  L->msg = msg;
+  blake2b_init( L->S, BLAKE2B_OUTBYTES );
+
+  if( blake2_manifest( first, BLAKE2B_OUTBYTES, dir, cache, check_entry, L ) < 0 ) return -1;
+
+  blake2b_final( L->S, expect, BLAKE2B_OUTBYTES );
+
+  if( L->error || L->seen != NFILES || 0 != memcmp( first, expect, BLAKE2B_OUTBYTES ) ) return -1;
+
+  if( blake2_manifest( again, BLAKE2B_OUTBYTES, dir, cache, NULL, NULL ) < 0 || 0 != memcmp( first, again, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  /* Same size, same mtime: the cache vouches for the old digest and the file is not read */
+  snprintf( path, sizeof( path ), "%s/a", dir );
+
+  if( stat( path, &st ) != 0 ) return -1;
+
+  memcpy( changed, msg, sizeof( changed ) );
+  changed[500] ^= 1;
+
+  if( write_file( dir, "a", changed, sizeof( changed ) ) < 0 ) return -1;
+
+  times[0] = st.st_atim;
+  times[1] = st.st_mtim;
+
+  if( utimensat( AT_FDCWD, path, times, 0 ) != 0 ) return -1;
+
+  if( blake2_manifest( again, BLAKE2B_OUTBYTES, dir, cache, NULL, NULL ) < 0 || 0 != memcmp( first, again, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  if( blake2_manifest( fresh, BLAKE2B_OUTBYTES, dir, NULL, NULL, NULL ) < 0 || 0 == memcmp( first, fresh, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  /* A new mtime invalidates the record */
+  times[1].tv_sec += 1;
+
+  if( utimensat( AT_FDCWD, path, times, 0 ) != 0 ) return -1;
+
+  if( blake2_manifest( again, BLAKE2B_OUTBYTES, dir, cache, NULL, NULL ) < 0 || 0 != memcmp( fresh, again, BLAKE2B_OUTBYTES ) )
+    return -1;
+
+  remove( cache );
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  char dir[] = "blake2-manifest-test.XXXXXX";
+  static uint8_t msg[70000];
+  char path[256];
+  int ret = -1;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 13 + 5 );
+
+  if( NULL == mkdtemp( dir ) )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  snprintf( path, sizeof( path ), "%s/sub", dir );
+  mkdir( path, 0700 );
+  snprintf( path, sizeof( path ), "%s/sub/deep", dir );
+  mkdir( path, 0700 );
+  snprintf( path, sizeof( path ), "%s/link", dir );
+
+  if( symlink( "a", path ) == 0 )
+  {
+    ret = 0;
+
+    for( size_t i = 0; i < NFILES && 0 == ret; ++i )
+      ret = write_file( dir, names[i], msg, sizes[i] );
+
+    if( 0 == ret ) ret = test_manifest( dir, msg );
+  }
+
+  unlink( path );
+
+  for( size_t i = 0; i < NFILES; ++i )
+  {
+    snprintf( path, sizeof( path ), "%s/%s", dir, names[i] );
+    unlink( path );
+  }
+
+  snprintf( path, sizeof( path ), "%s/sub/deep", dir );
+  rmdir( path );
+  snprintf( path, sizeof( path ), "%s/sub", dir );
+  rmdir( path );
+  rmdir( dir );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
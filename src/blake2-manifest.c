@@ -0,0 +1,404 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* st_mtim, fstatat and openat */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_DIRENT_H) && defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && defined(HAVE_FCNTL_H)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
+/*
+   A manifest lists every regular file below the root, sorted by path, with
+   its size and BLAKE2bp digest. The tree digest is BLAKE2b over the list,
+   each entry encoded as le64( pathlen ) || path || le64( size ) || digest,
+   so it depends on names and contents only, never on walk order.
+
+   The cache is a flat file of fixed-size records sorted by (dev, inode) and
+   searched in place through a read-only mapping. It is only a hint: a file
+   whose size or mtime differs from its record is simply hashed again.
+*/
+#define BLAKE2_MANIFEST_MAGIC "B2MC"
+#define BLAKE2_MANIFEST_VERSION 1
+
+typedef struct __blake2_manifest_record
+{
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  uint64_t mtime;
+  uint8_t  digest[BLAKE2_MANIFEST_DIGESTBYTES];
+} blake2_manifest_record;
+
+typedef struct __blake2_manifest_header
+{
+  char     magic[4];
+  uint32_t version;
+  uint64_t count;
+} blake2_manifest_header;
+
+typedef struct __blake2_manifest_file
+{
+  char *path;
+  blake2_manifest_record r;
+  int cached;
+} blake2_manifest_file;
+
+typedef struct __blake2_manifest_list
+{
+  const char *root;
+  blake2_manifest_file *files;
+  size_t count;
+  size_t capacity;
+  int error;
+} blake2_manifest_list;
+
+static char *blake2_manifest_join( const char *dir, const char *name )
+{
+  const size_t a = strlen( dir ), b = strlen( name );
+  char *path = ( char * )malloc( a + b + 2 );
+
+  if( NULL == path ) return NULL;
+
+  memcpy( path, dir, a );
+  path[a] = '/';
+  memcpy( path + a + ( a ? 1 : 0 ), name, b + 1 );
+  return path;
+}
+
+static uint64_t blake2_manifest_mtime( const struct stat *st )
+{
+#if defined(__APPLE__)
+  return ( uint64_t )st->st_mtimespec.tv_sec * 1000000000u + ( uint64_t )st->st_mtimespec.tv_nsec;
+#else
+  return ( uint64_t )st->st_mtim.tv_sec * 1000000000u + ( uint64_t )st->st_mtim.tv_nsec;
+#endif
+}
+
+/* Walker tasks report failures concurrently */
+static void blake2_manifest_fail( blake2_manifest_list *L )
+{
+#if defined(_OPENMP)
+  #pragma omp atomic write
+#endif
+  L->error = 1;
+}
+
+static void blake2_manifest_add( blake2_manifest_list *L, char *path, const struct stat *st )
+{
+#if defined(_OPENMP)
+  #pragma omp critical( blake2_manifest_list )
+#endif
+  {
+    if( L->count == L->capacity )
+    {
+      const size_t grown = L->capacity ? 2 * L->capacity : 256;
+      blake2_manifest_file *files = ( blake2_manifest_file * )realloc( L->files, grown * sizeof( *files ) );
+
+      if( NULL == files )
+      {
+        blake2_manifest_fail( L );
+        free( path );
+        path = NULL;
+      }
+      else
+      {
+        L->files = files;
+        L->capacity = grown;
+      }
+    }
+
+    if( path )
+    {
+      blake2_manifest_file *F = &L->files[L->count++];
+      memset( F, 0, sizeof( *F ) );
+      F->path = path;
+      F->r.dev = ( uint64_t )st->st_dev;
+      F->r.ino = ( uint64_t )st->st_ino;
+      F->r.size = ( uint64_t )st->st_size;
+      F->r.mtime = blake2_manifest_mtime( st );
+    }
+  }
+}
+
+/* Each subdirectory becomes a task, so wide trees are listed by several threads at once */
+static void blake2_manifest_walk( blake2_manifest_list *L, char *rel )
+{
+  char *dirpath = rel[0] ? blake2_manifest_join( L->root, rel ) : NULL;
+  DIR *d = opendir( rel[0] ? dirpath : L->root );
+  struct dirent *e;
+
+  free( dirpath );
+
+  if( NULL == d )
+  {
+    blake2_manifest_fail( L );
+    free( rel );
+    return;
+  }
+
+  while( ( e = readdir( d ) ) != NULL )
+  {
+    struct stat st;
+    char *child;
+
+    if( 0 == strcmp( e->d_name, "." ) || 0 == strcmp( e->d_name, ".." ) ) continue;
+
+    if( fstatat( dirfd( d ), e->d_name, &st, AT_SYMLINK_NOFOLLOW ) != 0 )
+    {
+      blake2_manifest_fail( L );
+      continue;
+    }
+
+    if( !S_ISDIR( st.st_mode ) && !S_ISREG( st.st_mode ) ) continue;
+
+    if( NULL == ( child = blake2_manifest_join( rel, e->d_name ) ) )
+    {
+      blake2_manifest_fail( L );
+      continue;
+    }
+
+    if( S_ISREG( st.st_mode ) )
+    {
+      blake2_manifest_add( L, child, &st );
+      continue;
+    }
+
+#if defined(_OPENMP)
+    #pragma omp task firstprivate( child )
+#endif
+    blake2_manifest_walk( L, child );
+  }
+
+  closedir( d );
+  free( rel );
+}
+
+static int blake2_manifest_key_cmp( const blake2_manifest_record *a, const blake2_manifest_record *b )
+{
+  if( a->dev != b->dev ) return a->dev < b->dev ? -1 : 1;
+
+  if( a->ino != b->ino ) return a->ino < b->ino ? -1 : 1;
+
+  return 0;
+}
+
+static int blake2_manifest_record_cmp( const void *a, const void *b )
+{
+  return blake2_manifest_key_cmp( ( const blake2_manifest_record * )a, ( const blake2_manifest_record * )b );
+}
+
+static int blake2_manifest_path_cmp( const void *a, const void *b )
+{
+  return strcmp( ( ( const blake2_manifest_file * )a )->path, ( ( const blake2_manifest_file * )b )->path );
+}
+
+/* Copies the digests of unchanged files out of the cache; a missing or foreign cache is ignored */
+static void blake2_manifest_load( blake2_manifest_list *L, const char *cache_path )
+{
+#if defined(HAVE_SYS_MMAN_H)
+  const int fd = open( cache_path, O_RDONLY );
+  const blake2_manifest_header *H;
+  const blake2_manifest_record *R;
+  struct stat st;
+  void *map;
+
+  if( fd < 0 ) return;
+
+  if( fstat( fd, &st ) != 0 || ( uint64_t )st.st_size < sizeof( *H ) ||
+      MAP_FAILED == ( map = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_SHARED, fd, 0 ) ) )
+  {
+    close( fd );
+    return;
+  }
+
+  H = ( const blake2_manifest_header * )map;
+  R = ( const blake2_manifest_record * )( H + 1 );
+
+  if( 0 == memcmp( H->magic, BLAKE2_MANIFEST_MAGIC, 4 ) && BLAKE2_MANIFEST_VERSION == H->version &&
+      H->count == ( ( uint64_t )st.st_size - sizeof( *H ) ) / sizeof( *R ) )
+  {
+    for( size_t i = 0; i < L->count; ++i )
+    {
+      blake2_manifest_file *F = &L->files[i];
+      const blake2_manifest_record *hit = ( const blake2_manifest_record * )
+        bsearch( &F->r, R, ( size_t )H->count, sizeof( *R ), blake2_manifest_record_cmp );
+
+      if( hit && hit->size == F->r.size && hit->mtime == F->r.mtime )
+      {
+        memcpy( F->r.digest, hit->digest, sizeof( F->r.digest ) );
+        F->cached = 1;
+      }
+    }
+  }
+
+  munmap( map, ( size_t )st.st_size );
+  close( fd );
+#endif
+}
+
+/* Written beside the old cache and renamed over it, so a crash never leaves a torn cache */
+static int blake2_manifest_save( const blake2_manifest_list *L, const char *cache_path )
+{
+  blake2_manifest_header H;
+  blake2_manifest_record *R = ( blake2_manifest_record * )malloc( ( L->count ? L->count : 1 ) * sizeof( *R ) );
+  char *tmp = ( char * )malloc( strlen( cache_path ) + 5 );
+  FILE *fp = NULL;
+  int ret = -1;
+
+  if( NULL == R || NULL == tmp ) goto out;
+
+  for( size_t i = 0; i < L->count; ++i )
+    R[i] = L->files[i].r;
+
+  qsort( R, L->count, sizeof( *R ), blake2_manifest_record_cmp );
+  memcpy( H.magic, BLAKE2_MANIFEST_MAGIC, 4 );
+  H.version = BLAKE2_MANIFEST_VERSION;
+  H.count = L->count;
+  strcpy( tmp, cache_path );
+  strcat( tmp, ".tmp" );
+
+  if( NULL == ( fp = fopen( tmp, "wb" ) ) ) goto out;
+
+  if( fwrite( &H, sizeof( H ), 1, fp ) != 1 || fwrite( R, sizeof( *R ), L->count, fp ) != L->count )
+  {
+    fclose( fp );
+    remove( tmp );
+    goto out;
+  }
+
+  if( fclose( fp ) != 0 || rename( tmp, cache_path ) != 0 )
+  {
+    remove( tmp );
+    goto out;
+  }
+
+  ret = 0;
+out:
+  free( tmp );
+  free( R );
+  return ret;
+}
+
+static int blake2_manifest_hash( blake2_manifest_list *L )
+{
+  const long n = ( long )L->count;
+  int error = 0;
+
+#if defined(_OPENMP)
+  #pragma omp parallel for schedule( dynamic, 1 ) reduction( | : error )
+#endif
+  for( long i = 0; i < n; ++i )
+  {
+    blake2_manifest_file *F = &L->files[i];
+    char *path;
+    int fd;
+
+    if( F->cached ) continue;
+
+    if( NULL == ( path = blake2_manifest_join( L->root, F->path ) ) )
+    {
+      error = 1;
+      continue;
+    }
+
+    fd = open( path, O_RDONLY );
+    free( path );
+
+    if( fd < 0 || blake2bp_file( F->r.digest, BLAKE2_MANIFEST_DIGESTBYTES, fd, NULL, 0 ) < 0 ) error = 1;
+
+    if( fd >= 0 ) close( fd );
+  }
+
+  return error ? -1 : 0;
+}
+
+int blake2_manifest( uint8_t *out, size_t outlen, const char *root, const char *cache_path, blake2_manifest_fn fn, void *ctx )
+{
+  blake2_manifest_list L[1];
+  blake2b_state S[1];
+  char *top;
+  int ret = -1;
+
+  if( NULL == root || blake2b_init( S, outlen ) < 0 ) return -1;
+
+  memset( L, 0, sizeof( L ) );
+  L->root = root;
+
+  if( NULL == ( top = ( char * )calloc( 1, 1 ) ) ) return -1;
+
+#if defined(_OPENMP)
+  #pragma omp parallel
+  #pragma omp single
+#endif
+  blake2_manifest_walk( L, top );
+
+  if( L->error ) goto out;
+
+  if( cache_path ) blake2_manifest_load( L, cache_path );
+
+  if( blake2_manifest_hash( L ) < 0 ) goto out;
+
+  qsort( L->files, L->count, sizeof( L->files[0] ), blake2_manifest_path_cmp );
+
+  for( size_t i = 0; i < L->count; ++i )
+  {
+    const blake2_manifest_file *F = &L->files[i];
+    const uint64_t pathlen = strlen( F->path );
+    uint8_t word[8];
+
+    store64( word, pathlen );
+    blake2b_update( S, word, sizeof( word ) );
+    blake2b_update( S, ( const uint8_t * )F->path, ( size_t )pathlen );
+    store64( word, F->r.size );
+    blake2b_update( S, word, sizeof( word ) );
+    blake2b_update( S, F->r.digest, sizeof( F->r.digest ) );
+
+    if( fn && fn( ctx, F->path, F->r.size, F->r.digest ) < 0 ) goto out;
+  }
+
+  if( cache_path && blake2_manifest_save( L, cache_path ) < 0 ) goto out;
+
+  ret = blake2b_final( S, out, outlen );
+out:
+  for( size_t i = 0; i < L->count; ++i )
+    free( L->files[i].path );
+
+  free( L->files );
+  return ret;
+}
+#else
+int blake2_manifest( uint8_t *out, size_t outlen, const char *root, const char *cache_path, blake2_manifest_fn fn, void *ctx )
+{
+  return -1;
+}
+#endif
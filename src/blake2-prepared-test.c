@@ -0,0 +1,245 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define MSGBYTES 1100
+
+static const size_t lengths[] = { 0, 1, 63, 64, 65, 127, 128, 129, 255, 256, 257, 512, 513, 1100 };
+#define NLENGTHS ( sizeof( lengths ) / sizeof( lengths[0] ) )
+
+static int test_blake2s( const uint8_t *key, const uint8_t *msg )
+{
+  for( size_t keylen = 1; keylen <= BLAKE2S_KEYBYTES; keylen += 31 )
+  {
+    blake2s_prepared_key K[1];
+    blake2s_param P[1];
+    blake2s_state S[1], T[1];
+    uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+
+    if( blake2s_prepare_key( K, BLAKE2S_OUTBYTES, key, keylen ) < 0 ) return -1;
+
+    for( size_t i = 0; i < NLENGTHS; ++i )
+    {
+      blake2s( a, msg, key, BLAKE2S_OUTBYTES, lengths[i], keylen );
+      blake2s_init_prepared( S, K );
+      blake2s_update( S, msg, lengths[i] );
+      blake2s_final( S, b, BLAKE2S_OUTBYTES );
+
+      if( 0 != memcmp( a, b, sizeof( a ) ) ) return -1;
+    }
+
+    /* Salt and personalization are part of the midstate */
+    memset( P, 0, sizeof( P ) );
+    P->digest_length = 20;
+    P->key_length = ( uint8_t ) keylen;
+    P->fanout = 1;
+    P->depth = 1;
+    memset( P->salt, 0x5a, sizeof( P->salt ) );
+    memset( P->personal, 0xa5, sizeof( P->personal ) );
+
+    if( blake2s_prepare_key_param( K, P, key ) < 0 ) return -1;
+
+    for( size_t i = 0; i < NLENGTHS; ++i )
+    {
+      uint8_t block[BLAKE2S_BLOCKBYTES] = {0};
+      memcpy( block, key, keylen );
+      blake2s_init_param( T, P );
+      blake2s_update( T, block, sizeof( block ) );
+      blake2s_update( T, msg, lengths[i] );
+      blake2s_final( T, a, 20 );
+      blake2s_init_prepared( S, K );
+      blake2s_update( S, msg, lengths[i] );
+      blake2s_final( S, b, 20 );
+
+      if( 0 != memcmp( a, b, 20 ) ) return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int test_blake2b( const uint8_t *key, const uint8_t *msg )
+{
+  for( size_t keylen = 1; keylen <= BLAKE2B_KEYBYTES; keylen += 63 )
+  {
+    blake2b_prepared_key K[1];
+    blake2b_param P[1];
+    blake2b_state S[1], T[1];
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+    if( blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key, keylen ) < 0 ) return -1;
+
+    for( size_t i = 0; i < NLENGTHS; ++i )
+    {
+      blake2b( a, msg, key, BLAKE2B_OUTBYTES, lengths[i], keylen );
+      blake2b_init_prepared( S, K );
+      blake2b_update( S, msg, lengths[i] );
+      blake2b_final( S, b, BLAKE2B_OUTBYTES );
+
+      if( 0 != memcmp( a, b, sizeof( a ) ) ) return -1;
+    }
+
+    memset( P, 0, sizeof( P ) );
+    P->digest_length = 40;
+    P->key_length = ( uint8_t ) keylen;
+    P->fanout = 1;
+    P->depth = 1;
+    memset( P->salt, 0x5a, sizeof( P->salt ) );
+    memset( P->personal, 0xa5, sizeof( P->personal ) );
+
+    if( blake2b_prepare_key_param( K, P, key ) < 0 ) return -1;
+
+    for( size_t i = 0; i < NLENGTHS; ++i )
+    {
+      uint8_t block[BLAKE2B_BLOCKBYTES] = {0};
+      memcpy( block, key, keylen );
+      blake2b_init_param( T, P );
+      blake2b_update( T, block, sizeof( block ) );
+      blake2b_update( T, msg, lengths[i] );
+      blake2b_final( T, a, 40 );
+      blake2b_init_prepared( S, K );
+      blake2b_update( S, msg, lengths[i] );
+      blake2b_final( S, b, 40 );
+
+      if( 0 != memcmp( a, b, 40 ) ) return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int test_parallel( const uint8_t *key, const uint8_t *msg )
+{
+  blake2sp_prepared_key KS[1];
+  blake2bp_prepared_key KB[1];
+  blake2sp_state SS[1];
+  blake2bp_state SB[1];
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+  if( blake2sp_prepare_key( KS, BLAKE2S_OUTBYTES, key, BLAKE2S_KEYBYTES ) < 0 ||
+      blake2bp_prepare_key( KB, BLAKE2B_OUTBYTES, key, BLAKE2B_KEYBYTES ) < 0 )
+    return -1;
+
+  for( size_t i = 0; i < NLENGTHS; ++i )
+  {
+    blake2sp( a, msg, key, BLAKE2S_OUTBYTES, lengths[i], BLAKE2S_KEYBYTES );
+    blake2sp_init_prepared( SS, KS );
+    blake2sp_update( SS, msg, lengths[i] );
+    blake2sp_final( SS, b, BLAKE2S_OUTBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+
+    blake2bp( a, msg, key, BLAKE2B_OUTBYTES, lengths[i], BLAKE2B_KEYBYTES );
+    blake2bp_init_prepared( SB, KB );
+    blake2bp_update( SB, msg, lengths[i] );
+    blake2bp_final( SB, b, BLAKE2B_OUTBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+  }
+
+  return 0;
+}
+
+static int cache_mac( blake2b_key_cache *C, uint64_t id, uint8_t out[BLAKE2B_OUTBYTES] )
+{
+  blake2b_state S[1];
+
+  if( blake2b_key_cache_init( C, S, id ) < 0 ) return -1;
+
+  blake2b_update( S, ( const uint8_t * )"msg", 3 );
+  return blake2b_final( S, out, BLAKE2B_OUTBYTES );
+}
+
+static int test_cache( const uint8_t *key )
+{
+  blake2b_key_cache *C = blake2b_key_cache_new( 3 );
+  blake2b_prepared_key K[1];
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  int ret = -1;
+
+  if( NULL == C ) return -1;
+
+  /* Key id i uses the key starting at key + i */
+  for( uint64_t id = 0; id < 3; ++id )
+  {
+    if( blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key + id, 32 ) < 0 ) goto out;
+
+    blake2b_key_cache_put( C, id, K );
+  }
+
+  /* Touch 0, so inserting 3 evicts 1, the least recently used */
+  if( cache_mac( C, 0, a ) < 0 ) goto out;
+
+  blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key + 3, 32 );
+  blake2b_key_cache_put( C, 3, K );
+
+  if( cache_mac( C, 1, a ) == 0 ) goto out;
+
+  for( uint64_t id = 0; id < 4; ++id )
+  {
+    if( id == 1 ) continue;
+
+    blake2b( b, "msg", key + id, BLAKE2B_OUTBYTES, 3, 32 );
+
+    if( cache_mac( C, id, a ) < 0 || 0 != memcmp( a, b, sizeof( a ) ) ) goto out;
+  }
+
+  /* Removal frees a slot without evicting anyone */
+  if( blake2b_key_cache_remove( C, 2 ) < 0 || blake2b_key_cache_remove( C, 2 ) == 0 ) goto out;
+
+  blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key + 1, 32 );
+  blake2b_key_cache_put( C, 1, K );
+
+  if( cache_mac( C, 0, a ) < 0 || cache_mac( C, 1, a ) < 0 || cache_mac( C, 3, a ) < 0 ) goto out;
+
+  ret = 0;
+out:
+  blake2b_key_cache_free( C );
+  return ret;
+}
+
+/* The packed states are part of the ABI: a prepared state must fit in them unchanged */
+static int test_layout( void )
+{
+  if( 182 != sizeof( blake2s_state ) || 358 != sizeof( blake2b_state ) ) return -1;
+
+  return 2155 == sizeof( blake2sp_state ) && 2307 == sizeof( blake2bp_state ) ? 0 : -1;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES + 8];
+  uint8_t msg[MSGBYTES];
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  if( test_layout() < 0 ||
+      test_blake2s( key, msg ) < 0 ||
+      test_blake2b( key, msg ) < 0 ||
+      test_parallel( key, msg ) < 0 ||
+      test_cache( key ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,346 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   A keyed state holds its padded key as a buffered block until more input
+   arrives. Preparing pushes that block through the compression function once;
+   blake2[bs]_init_prepared then only copies the chaining value and sets the
+   counter to one block. An empty message never compresses after the key
+   block, so its MAC is computed up front and carried in the state's buffer,
+   where blake2[bs]_final picks it up while BLAKE2_PREPARED_EMPTY holds.
+*/
+
+int blake2s_prepare_state( blake2s_prepared_key *K, const blake2s_state *S )
+{
+  blake2s_state T[1];
+  const uint8_t zero[BLAKE2S_BLOCKBYTES + 1] = {0};
+
+  /* Exactly the key block absorbed, nothing compressed yet */
+  if( S->buflen != BLAKE2S_BLOCKBYTES || S->t[0] || S->t[1] || S->f[0] ) return -1;
+
+  memset( K->empty, 0, sizeof( K->empty ) );
+  memcpy( T, S, sizeof( T ) );
+  blake2s_final( T, K->empty, T->outlen );
+
+  /* The buffer holds two blocks; overflowing it forces the key block through the compression function */
+  memcpy( T, S, sizeof( T ) );
+  blake2s_update( T, zero, sizeof( zero ) );
+  memcpy( K->h, T->h, sizeof( K->h ) );
+  K->outlen = S->outlen;
+  K->last_node = S->last_node;
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+}
+
+int blake2s_prepare_key_param( blake2s_prepared_key *K, const blake2s_param *P, const void *key )
+{
+  blake2s_state S[1];
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  int ret;
+
+  if( !P->digest_length || P->digest_length > BLAKE2S_OUTBYTES ) return -1;
+
+  if( !key || !P->key_length || P->key_length > BLAKE2S_KEYBYTES ) return -1;
+
+  if( blake2s_init_param( S, P ) < 0 ) return -1;
+
+  memset( block, 0, BLAKE2S_BLOCKBYTES );
+  memcpy( block, key, P->key_length );
+  blake2s_update( S, block, BLAKE2S_BLOCKBYTES );
+  secure_zero_memory( block, BLAKE2S_BLOCKBYTES ); /* Burn the key from stack */
+  ret = blake2s_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2s_prepare_key( blake2s_prepared_key *K, size_t outlen, const void *key, size_t keylen )
+{
+  blake2s_state S[1];
+  int ret;
+
+  if( !key || blake2s_init_key( S, outlen, key, keylen ) < 0 ) return -1;
+
+  ret = blake2s_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2s_init_prepared( blake2s_state *S, const blake2s_prepared_key *K )
+{
+  memcpy( S->h, K->h, sizeof( S->h ) );
+  S->t[0] = BLAKE2S_BLOCKBYTES;
+  S->t[1] = 0;
+  S->f[0] = 0;
+  S->f[1] = 0;
+  memcpy( S->buf, K->empty, K->outlen );
+  S->buflen = 0;
+  S->outlen = K->outlen;
+  S->last_node = K->last_node;
+  BLAKE2_PREPARED_MARK( S, BLAKE2S_BLOCKBYTES );
+  return 0;
+}
+
+int blake2b_prepare_state( blake2b_prepared_key *K, const blake2b_state *S )
+{
+  blake2b_state T[1];
+  const uint8_t zero[BLAKE2B_BLOCKBYTES + 1] = {0};
+
+  /* Exactly the key block absorbed, nothing compressed yet */
+  if( S->buflen != BLAKE2B_BLOCKBYTES || S->t[0] || S->t[1] || S->f[0] ) return -1;
+
+  memset( K->empty, 0, sizeof( K->empty ) );
+  memcpy( T, S, sizeof( T ) );
+  blake2b_final( T, K->empty, T->outlen );
+
+  /* The buffer holds two blocks; overflowing it forces the key block through the compression function */
+  memcpy( T, S, sizeof( T ) );
+  blake2b_update( T, zero, sizeof( zero ) );
+  memcpy( K->h, T->h, sizeof( K->h ) );
+  K->outlen = S->outlen;
+  K->last_node = S->last_node;
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+}
+
+int blake2b_prepare_key_param( blake2b_prepared_key *K, const blake2b_param *P, const void *key )
+{
+  blake2b_state S[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  int ret;
+
+  if( !P->digest_length || P->digest_length > BLAKE2B_OUTBYTES ) return -1;
+
+  if( !key || !P->key_length || P->key_length > BLAKE2B_KEYBYTES ) return -1;
+
+  if( blake2b_init_param( S, P ) < 0 ) return -1;
+
+  memset( block, 0, BLAKE2B_BLOCKBYTES );
+  memcpy( block, key, P->key_length );
+  blake2b_update( S, block, BLAKE2B_BLOCKBYTES );
+  secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
+  ret = blake2b_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2b_prepare_key( blake2b_prepared_key *K, size_t outlen, const void *key, size_t keylen )
+{
+  blake2b_state S[1];
+  int ret;
+
+  if( !key || blake2b_init_key( S, outlen, key, keylen ) < 0 ) return -1;
+
+  ret = blake2b_prepare_state( K, S );
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2b_init_prepared( blake2b_state *S, const blake2b_prepared_key *K )
+{
+  memcpy( S->h, K->h, sizeof( S->h ) );
+  S->t[0] = BLAKE2B_BLOCKBYTES;
+  S->t[1] = 0;
+  S->f[0] = 0;
+  S->f[1] = 0;
+  memcpy( S->buf, K->empty, K->outlen );
+  S->buflen = 0;
+  S->outlen = K->outlen;
+  S->last_node = K->last_node;
+  BLAKE2_PREPARED_MARK( S, BLAKE2B_BLOCKBYTES );
+  return 0;
+}
+
+/*
+   LRU key cache: a chained hash table over a fixed entry array, with the
+   entries also threaded on a doubly linked recency list. Links are entry
+   indices plus one, so zero means none.
+*/
+
+typedef struct __blake2b_key_cache_entry
+{
+  uint64_t id;
+  uint32_t chain;       // next entry in the same bucket
+  uint32_t prev;        // more recently used
+  uint32_t next;        // less recently used; free list link when unused
+  blake2b_prepared_key K[1];
+} blake2b_key_cache_entry;
+
+struct __blake2b_key_cache
+{
+  blake2b_key_cache_entry *entry;
+  uint32_t *bucket;
+  size_t   capacity;
+  size_t   mask;
+  uint32_t head;        // most recently used
+  uint32_t tail;        // least recently used
+  uint32_t free;
+};
+
+static inline size_t blake2b_key_cache_slot( const blake2b_key_cache *C, uint64_t id )
+{
+  return ( size_t )( ( id * 0x9E3779B97F4A7C15ULL ) >> 32 ) & C->mask;
+}
+
+static uint32_t blake2b_key_cache_find( const blake2b_key_cache *C, uint64_t id )
+{
+  uint32_t e = C->bucket[blake2b_key_cache_slot( C, id )];
+
+  while( e && C->entry[e - 1].id != id )
+    e = C->entry[e - 1].chain;
+
+  return e;
+}
+
+static void blake2b_key_cache_unlink( blake2b_key_cache *C, uint32_t e )
+{
+  blake2b_key_cache_entry *E = &C->entry[e - 1];
+
+  if( E->prev ) C->entry[E->prev - 1].next = E->next;
+  else C->head = E->next;
+
+  if( E->next ) C->entry[E->next - 1].prev = E->prev;
+  else C->tail = E->prev;
+}
+
+static void blake2b_key_cache_push_front( blake2b_key_cache *C, uint32_t e )
+{
+  blake2b_key_cache_entry *E = &C->entry[e - 1];
+  E->prev = 0;
+  E->next = C->head;
+
+  if( C->head ) C->entry[C->head - 1].prev = e;
+  else C->tail = e;
+
+  C->head = e;
+}
+
+/* Drops e from its bucket chain and the recency list; the caller decides where the slot goes */
+static void blake2b_key_cache_evict( blake2b_key_cache *C, uint32_t e )
+{
+  blake2b_key_cache_entry *E = &C->entry[e - 1];
+  uint32_t *link = &C->bucket[blake2b_key_cache_slot( C, E->id )];
+
+  while( *link != e )
+    link = &C->entry[*link - 1].chain;
+
+  *link = E->chain;
+  blake2b_key_cache_unlink( C, e );
+  secure_zero_memory( E->K, sizeof( E->K ) );
+}
+
+blake2b_key_cache *blake2b_key_cache_new( size_t capacity )
+{
+  blake2b_key_cache *C;
+  size_t nbuckets = 1;
+
+  if( !capacity || capacity >= UINT32_MAX / 2 ) return NULL;
+
+  while( nbuckets < capacity ) nbuckets <<= 1;
+
+  if( NULL == ( C = ( blake2b_key_cache * )calloc( 1, sizeof( *C ) ) ) ) return NULL;
+
+  C->entry = ( blake2b_key_cache_entry * )calloc( capacity, sizeof( *C->entry ) );
+  C->bucket = ( uint32_t * )calloc( nbuckets, sizeof( *C->bucket ) );
+
+  if( !C->entry || !C->bucket )
+  {
+    free( C->entry );
+    free( C->bucket );
+    free( C );
+    return NULL;
+  }
+
+  C->capacity = capacity;
+  C->mask = nbuckets - 1;
+
+  for( size_t i = 0; i < capacity; ++i )
+    C->entry[i].next = i + 1 < capacity ? ( uint32_t )( i + 2 ) : 0;
+
+  C->free = 1;
+  return C;
+}
+
+void blake2b_key_cache_free( blake2b_key_cache *C )
+{
+  if( NULL == C ) return;
+
+  secure_zero_memory( C->entry, C->capacity * sizeof( *C->entry ) );
+  free( C->entry );
+  free( C->bucket );
+  free( C );
+}
+
+int blake2b_key_cache_put( blake2b_key_cache *C, uint64_t id, const blake2b_prepared_key *K )
+{
+  uint32_t e = blake2b_key_cache_find( C, id );
+
+  if( e )
+    blake2b_key_cache_unlink( C, e );
+  else
+  {
+    size_t slot = blake2b_key_cache_slot( C, id );
+
+    if( C->free )
+    {
+      e = C->free;
+      C->free = C->entry[e - 1].next;
+    }
+    else
+    {
+      e = C->tail;
+      blake2b_key_cache_evict( C, e );
+    }
+
+    C->entry[e - 1].id = id;
+    C->entry[e - 1].chain = C->bucket[slot];
+    C->bucket[slot] = e;
+  }
+
+  memcpy( C->entry[e - 1].K, K, sizeof( *K ) );
+  blake2b_key_cache_push_front( C, e );
+  return 0;
+}
+
+int blake2b_key_cache_remove( blake2b_key_cache *C, uint64_t id )
+{
+  uint32_t e = blake2b_key_cache_find( C, id );
+
+  if( !e ) return -1;
+
+  blake2b_key_cache_evict( C, e );
+  C->entry[e - 1].next = C->free;
+  C->free = e;
+  return 0;
+}
+
+/* Returns -1 on a miss, leaving S untouched */
+int blake2b_key_cache_init( blake2b_key_cache *C, blake2b_state *S, uint64_t id )
+{
+  uint32_t e = blake2b_key_cache_find( C, id );
+
+  if( !e ) return -1;
+
+  if( C->head != e )
+  {
+    blake2b_key_cache_unlink( C, e );
+    blake2b_key_cache_push_front( C, e );
+  }
+
+  return blake2b_init_prepared( S, C->entry[e - 1].K );
+}
@@ -0,0 +1,287 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "blake2.h"
+
+#define NJOBS 300
+#define DEPTH 32
+#define MSG_BYTES 5000
+#define CHURN_JOBS 200000
+
+typedef struct
+{
+  blake2_job J;
+  struct iovec iov[3];
+  uint8_t out[BLAKE2B_OUTBYTES];
+  size_t inlen;
+} test_job;
+
+static uint8_t msg[MSG_BYTES];
+static uint8_t key[BLAKE2B_KEYBYTES];
+
+/* Varies kind, keying, output length and how the message is split across iovecs */
+static void make_job( test_job *T, size_t i )
+{
+  const size_t cut1 = ( i * 97 ) % MSG_BYTES, cut2 = ( i * 31 ) % MSG_BYTES;
+  const size_t a = cut1 < cut2 ? cut1 : cut2, b = cut1 < cut2 ? cut2 : cut1;
+  size_t len[3], pos = 0;
+
+  memset( T, 0, sizeof( *T ) );
+  T->inlen = ( i * 1237 ) % MSG_BYTES;
+  T->J.kind = ( i % 3 ) ? BLAKE2_DIGEST_B : ( blake2_digest_kind )( i % 4 );
+  T->J.outlen = ( BLAKE2_DIGEST_S == T->J.kind || BLAKE2_DIGEST_SP == T->J.kind ) ? 1 + i % BLAKE2S_OUTBYTES : 1 + i % BLAKE2B_OUTBYTES;
+  T->J.out = T->out;
+  T->J.key = ( i % 5 ) ? NULL : key;
+  T->J.keylen = ( i % 5 ) ? 0 : 1 + i % BLAKE2S_KEYBYTES;
+  T->J.user = T;
+  T->J.iov = T->iov;
+  T->J.iovcnt = 1 + ( int )( i % 3 );
+
+  len[0] = a < T->inlen ? a : T->inlen;
+  len[1] = ( b < T->inlen ? b : T->inlen ) - len[0];
+  len[2] = T->inlen - len[0] - len[1];
+
+  for( int k = T->J.iovcnt; k < 3; ++k )
+    len[T->J.iovcnt - 1] += len[k];
+
+  for( int k = 0; k < T->J.iovcnt; ++k )
+  {
+    T->iov[k].iov_base = msg + pos;
+    T->iov[k].iov_len = len[k];
+    pos += len[k];
+  }
+}
+
+static int check_job( const blake2_job *J )
+{
+  const test_job *T = ( const test_job * )J->user;
+  uint8_t expect[BLAKE2B_OUTBYTES];
+  int ret = -1;
+
+  switch( J->kind )
+  {
+    case BLAKE2_DIGEST_S:  ret = blake2s( expect, msg, J->key, J->outlen, T->inlen, J->keylen ); break;
+    case BLAKE2_DIGEST_B:  ret = blake2b( expect, msg, J->key, J->outlen, T->inlen, J->keylen ); break;
+    case BLAKE2_DIGEST_SP: ret = blake2sp( expect, msg, J->key, J->outlen, T->inlen, J->keylen ); break;
+    case BLAKE2_DIGEST_BP: ret = blake2bp( expect, msg, J->key, J->outlen, T->inlen, J->keylen ); break;
+  }
+
+  if( ret < 0 || 0 != J->status || 0 != memcmp( expect, J->out, J->outlen ) ) return -1;
+
+  return 0;
+}
+
+static int test_reap( test_job *jobs )
+{
+  blake2_queue *Q = blake2_queue_create( 3, DEPTH, NULL, NULL );
+  blake2_job *done[DEPTH];
+  struct pollfd pfd;
+  size_t submitted = 0, reaped = 0;
+  int ret = -1;
+
+  if( NULL == Q ) return -1;
+
+  while( reaped < NJOBS )
+  {
+    size_t n;
+
+    while( submitted < NJOBS && 0 == blake2_queue_submit( Q, &jobs[submitted].J ) ) ++submitted;
+
+    if( submitted < NJOBS && EAGAIN != errno ) goto out;
+
+    n = blake2_queue_wait( Q, done, DEPTH );
+
+    if( 0 == n ) goto out;
+
+    for( size_t i = 0; i < n; ++i )
+    {
+      if( check_job( done[i] ) < 0 ) goto out;
+    }
+
+    reaped += n;
+  }
+
+  if( blake2_queue_wait( Q, done, DEPTH ) != 0 ) goto out;
+
+  /* Nothing is reaped, so the queue fills at depth */
+  for( size_t i = 0; i < DEPTH; ++i )
+  {
+    if( blake2_queue_submit( Q, &jobs[i].J ) < 0 ) goto out;
+  }
+
+  if( blake2_queue_submit( Q, &jobs[DEPTH].J ) == 0 || EAGAIN != errno ) goto out;
+
+  /* The eventfd becomes readable once completions are waiting */
+  pfd.fd = blake2_queue_fd( Q );
+  pfd.events = POLLIN;
+
+  if( pfd.fd < 0 || poll( &pfd, 1, 5000 ) != 1 ) goto out;
+
+  for( reaped = 0; reaped < DEPTH; reaped += blake2_queue_wait( Q, done, DEPTH ) );
+
+  ret = 0;
+out:
+  blake2_queue_destroy( Q );
+  return ret;
+}
+
+static void count_job( void *ctx, blake2_job *J )
+{
+  size_t *bad = ( size_t * )ctx;
+
+  if( check_job( J ) < 0 ) __atomic_add_fetch( bad, 1, __ATOMIC_RELAXED );
+
+  J->user = NULL;
+}
+
+/* With a callback every job is seen by the time the queue is destroyed */
+static int test_callback( test_job *jobs )
+{
+  size_t bad = 0;
+  blake2_queue *Q = blake2_queue_create( 2, NJOBS, count_job, &bad );
+
+  if( NULL == Q || blake2_queue_fd( Q ) >= 0 ) return -1;
+
+  for( size_t i = 0; i < NJOBS; ++i )
+  {
+    if( blake2_queue_submit( Q, &jobs[i].J ) < 0 ) return -1;
+  }
+
+  blake2_queue_destroy( Q );
+
+  if( bad ) return -1;
+
+  for( size_t i = 0; i < NJOBS; ++i )
+  {
+    if( NULL != jobs[i].J.user ) return -1;
+  }
+
+  return 0;
+}
+
+/* Bad parameters complete with status -1 rather than failing the batch */
+static int test_bad( void )
+{
+  blake2_queue *Q = blake2_queue_create( 1, 4, NULL, NULL );
+  blake2_job *done[4];
+  test_job T[2];
+  size_t n = 0;
+
+  if( NULL == Q ) return -1;
+
+  make_job( &T[0], 1 );
+  make_job( &T[1], 2 );
+  T[0].J.outlen = BLAKE2B_OUTBYTES + 1;
+
+  if( blake2_queue_submit( Q, &T[0].J ) < 0 || blake2_queue_submit( Q, &T[1].J ) < 0 ) n = 100;
+
+  while( n < 2 ) n += blake2_queue_wait( Q, done + n, 4 - n );
+
+  blake2_queue_destroy( Q );
+
+  if( 2 != n || -1 != T[0].J.status || check_job( &T[1].J ) < 0 ) return -1;
+
+  return 0;
+}
+
+/* Many workers on a tiny ring of one-byte jobs: slots come round again while the thread that took them may still hold them */
+static int test_churn( void )
+{
+  blake2_queue *Q = blake2_queue_create( 8, 4, NULL, NULL );
+  uint8_t expect[32];
+  blake2_job *idle[4], *done[4];
+  test_job T[4];
+  size_t nidle = 0, completed = 0;
+  int ret = -1;
+
+  if( NULL == Q ) return -1;
+
+  blake2b( expect, msg, NULL, 32, 1, 0 );
+
+  for( size_t i = 0; i < 4; ++i )
+  {
+    memset( &T[i], 0, sizeof( T[i] ) );
+    T[i].iov[0].iov_base = msg;
+    T[i].iov[0].iov_len = 1;
+    T[i].J.kind = BLAKE2_DIGEST_B;
+    T[i].J.iov = T[i].iov;
+    T[i].J.iovcnt = 1;
+    T[i].J.out = T[i].out;
+    T[i].J.outlen = 32;
+    idle[nidle++] = &T[i].J;
+  }
+
+  while( completed < CHURN_JOBS )
+  {
+    size_t n;
+
+    while( nidle > 0 && 0 == blake2_queue_submit( Q, idle[nidle - 1] ) ) --nidle;
+
+    if( 0 == ( n = blake2_queue_wait( Q, done, 4 ) ) ) goto out;
+
+    for( size_t i = 0; i < n; ++i )
+    {
+      if( 0 != done[i]->status || 0 != memcmp( done[i]->out, expect, 32 ) ) goto out;
+
+      idle[nidle++] = done[i];
+    }
+
+    completed += n;
+  }
+
+  ret = 0;
+out:
+  blake2_queue_destroy( Q );
+  return ret;
+}
+
+int main( int argc, char **argv )
+{
+  test_job *jobs = ( test_job * )malloc( NJOBS * sizeof( *jobs ) );
+  int ret;
+
+  if( NULL == jobs )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 11 + 3 );
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < NJOBS; ++i )
+    make_job( &jobs[i], i );
+
+  /* A lost job would leave blake2_queue_wait asleep forever */
+  alarm( 120 );
+  ret = test_reap( jobs ) < 0 || test_callback( jobs ) < 0 || test_bad() < 0 || test_churn() < 0 ? -1 : 0;
+  free( jobs );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,518 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_SYS_UIO_H) && defined(HAVE_UNISTD_H)
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#if defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
+#if defined(HAVE_SCHED_H)
+#include <sched.h>
+#endif
+
+/*
+   Jobs travel through two bounded lock-free rings, submission and
+   completion, each a power-of-two array of slots whose sequence numbers
+   tell producers and consumers whether a slot is free or filled (Vyukov's
+   MPMC queue). Submitting never blocks: the in-flight count is capped at
+   depth, which no ring is smaller than, so a push into either ring always
+   finds a slot, at worst after the popper that claimed it has released it.
+   Locks are only taken to put idle workers or waiting
+   reapers to sleep, and to wake them when someone is known to be asleep.
+
+   A worker takes up to BLAKE2_QUEUE_BATCH jobs at a time. The BLAKE2b jobs
+   among them advance together, one iovec per job per blake2b_update_multi
+   call; the others are hashed one after the other.
+*/
+#define BLAKE2_QUEUE_BATCH 8
+
+typedef struct __blake2_ring_slot
+{
+  size_t seq;
+  blake2_job *job;
+} blake2_ring_slot;
+
+typedef struct __blake2_ring
+{
+  blake2_ring_slot *slots;
+  size_t mask;
+  char pad0[64];
+  size_t head; /* Next slot to pop */
+  char pad1[64];
+  size_t tail; /* Next slot to push */
+  char pad2[64];
+} blake2_ring;
+
+struct __blake2_queue
+{
+  blake2_ring sq[1];
+  blake2_ring cq[1];
+  size_t depth;
+  size_t inflight;
+  unsigned idle;
+  unsigned waiting;
+  int stop;
+  int efd;
+  blake2_job_fn fn;
+  void *ctx;
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  unsigned nthreads;
+  pthread_t *threads;
+};
+
+static int blake2_ring_init( blake2_ring *R, size_t depth )
+{
+  size_t size = 1;
+
+  while( size < depth ) size <<= 1;
+
+  if( NULL == ( R->slots = ( blake2_ring_slot * )malloc( size * sizeof( *R->slots ) ) ) ) return -1;
+
+  for( size_t i = 0; i < size; ++i )
+    R->slots[i].seq = i;
+
+  R->mask = size - 1;
+  R->head = R->tail = 0;
+  return 0;
+}
+
+/*
+   Never fails: with at most depth jobs in flight, a slot that is not free
+   yet has been claimed by a popper that has not released it, which takes
+   a few instructions unless that thread is preempted. Giving up would lose
+   the job and leave the in-flight count stuck above zero.
+*/
+static void blake2_ring_push( blake2_ring *R, blake2_job *J )
+{
+  size_t pos = __atomic_load_n( &R->tail, __ATOMIC_RELAXED );
+  blake2_ring_slot *s;
+
+  for( ;; )
+  {
+    const intptr_t diff = ( intptr_t )__atomic_load_n( &R->slots[pos & R->mask].seq, __ATOMIC_ACQUIRE ) - ( intptr_t )pos;
+
+    if( diff < 0 )
+    {
+#if defined(HAVE_SCHED_YIELD)
+      sched_yield();
+#endif
+      pos = __atomic_load_n( &R->tail, __ATOMIC_RELAXED );
+      continue;
+    }
+
+    if( 0 == diff && __atomic_compare_exchange_n( &R->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) break;
+
+    if( diff > 0 ) pos = __atomic_load_n( &R->tail, __ATOMIC_RELAXED );
+  }
+
+  s = &R->slots[pos & R->mask];
+  s->job = J;
+  __atomic_store_n( &s->seq, pos + 1, __ATOMIC_RELEASE );
+}
+
+static blake2_job *blake2_ring_pop( blake2_ring *R )
+{
+  size_t pos = __atomic_load_n( &R->head, __ATOMIC_RELAXED );
+  blake2_ring_slot *s;
+  blake2_job *J;
+
+  for( ;; )
+  {
+    const intptr_t diff = ( intptr_t )__atomic_load_n( &R->slots[pos & R->mask].seq, __ATOMIC_ACQUIRE ) - ( intptr_t )( pos + 1 );
+
+    if( diff < 0 ) return NULL;
+
+    if( 0 == diff && __atomic_compare_exchange_n( &R->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) break;
+
+    if( diff > 0 ) pos = __atomic_load_n( &R->head, __ATOMIC_RELAXED );
+  }
+
+  s = &R->slots[pos & R->mask];
+  J = s->job;
+  __atomic_store_n( &s->seq, pos + R->mask + 1, __ATOMIC_RELEASE );
+  return J;
+}
+
+static int blake2_ring_empty( const blake2_ring *R )
+{
+  const size_t pos = __atomic_load_n( &R->head, __ATOMIC_SEQ_CST );
+
+  return __atomic_load_n( &R->slots[pos & R->mask].seq, __ATOMIC_SEQ_CST ) != pos + 1;
+}
+
+/* Hashes a job that is not batched; the states are only as large as the kind needs */
+static int blake2_job_hash( const blake2_job *J )
+{
+  switch( J->kind )
+  {
+    case BLAKE2_DIGEST_S:
+    {
+      blake2s_state S[1];
+
+      if( ( J->keylen ? blake2s_init_key( S, J->outlen, J->key, J->keylen ) : blake2s_init( S, J->outlen ) ) < 0 ) return -1;
+
+      if( blake2s_updatev( S, J->iov, J->iovcnt ) < 0 ) return -1;
+
+      return blake2s_final( S, J->out, J->outlen );
+    }
+
+    case BLAKE2_DIGEST_B:
+    {
+      blake2b_state S[1];
+
+      if( ( J->keylen ? blake2b_init_key( S, J->outlen, J->key, J->keylen ) : blake2b_init( S, J->outlen ) ) < 0 ) return -1;
+
+      if( blake2b_updatev( S, J->iov, J->iovcnt ) < 0 ) return -1;
+
+      return blake2b_final( S, J->out, J->outlen );
+    }
+
+    case BLAKE2_DIGEST_SP:
+    {
+      blake2sp_state S[1];
+
+      if( ( J->keylen ? blake2sp_init_key( S, J->outlen, J->key, J->keylen ) : blake2sp_init( S, J->outlen ) ) < 0 ) return -1;
+
+      if( blake2sp_updatev( S, J->iov, J->iovcnt ) < 0 ) return -1;
+
+      return blake2sp_final( S, J->out, J->outlen );
+    }
+
+    case BLAKE2_DIGEST_BP:
+    {
+      blake2bp_state S[1];
+
+      if( ( J->keylen ? blake2bp_init_key( S, J->outlen, J->key, J->keylen ) : blake2bp_init( S, J->outlen ) ) < 0 ) return -1;
+
+      if( blake2bp_updatev( S, J->iov, J->iovcnt ) < 0 ) return -1;
+
+      return blake2bp_final( S, J->out, J->outlen );
+    }
+  }
+
+  return -1;
+}
+
+static int blake2_job_iov_bad( const blake2_job *J )
+{
+  for( int i = 0; i < J->iovcnt; ++i )
+  {
+    if( NULL == J->iov[i].iov_base && J->iov[i].iov_len > 0 ) return 1;
+  }
+
+  return 0;
+}
+
+static void blake2_queue_run( blake2_job **jobs, size_t n )
+{
+  blake2b_state S[BLAKE2_QUEUE_BATCH];
+  blake2b_update_item items[BLAKE2_QUEUE_BATCH];
+  blake2_job *lanes[BLAKE2_QUEUE_BATCH];
+  size_t nb = 0;
+  int rounds = 0;
+
+  for( size_t i = 0; i < n; ++i )
+  {
+    blake2_job *J = jobs[i];
+
+    if( BLAKE2_DIGEST_B != J->kind )
+    {
+      J->status = blake2_job_hash( J ) < 0 ? -1 : 0;
+      continue;
+    }
+
+    if( blake2_job_iov_bad( J ) ||
+        ( J->keylen ? blake2b_init_key( &S[nb], J->outlen, J->key, J->keylen ) : blake2b_init( &S[nb], J->outlen ) ) < 0 )
+    {
+      J->status = -1;
+      continue;
+    }
+
+    if( J->iovcnt > rounds ) rounds = J->iovcnt;
+
+    lanes[nb++] = J;
+  }
+
+  for( int r = 0; r < rounds; ++r )
+  {
+    size_t ni = 0;
+
+    for( size_t i = 0; i < nb; ++i )
+    {
+      if( r >= lanes[i]->iovcnt || 0 == lanes[i]->iov[r].iov_len ) continue;
+
+      items[ni].S = &S[i];
+      items[ni].in = ( const uint8_t * )lanes[i]->iov[r].iov_base;
+      items[ni].inlen = lanes[i]->iov[r].iov_len;
+      ++ni;
+    }
+
+    if( ni > 0 ) blake2b_update_multi( items, ni );
+  }
+
+  for( size_t i = 0; i < nb; ++i )
+    lanes[i]->status = blake2b_final( &S[i], lanes[i]->out, lanes[i]->outlen ) < 0 ? -1 : 0;
+}
+
+static void blake2_queue_complete( blake2_queue *Q, blake2_job *J )
+{
+  if( Q->fn )
+  {
+    Q->fn( Q->ctx, J );
+    __atomic_sub_fetch( &Q->inflight, 1, __ATOMIC_SEQ_CST );
+    return;
+  }
+
+  blake2_ring_push( Q->cq, J );
+
+#if defined(HAVE_SYS_EVENTFD_H)
+  if( Q->efd >= 0 )
+  {
+    const uint64_t one = 1;
+
+    while( write( Q->efd, &one, sizeof( one ) ) < 0 && EINTR == errno );
+  }
+#endif
+
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+  if( __atomic_load_n( &Q->waiting, __ATOMIC_SEQ_CST ) )
+  {
+    pthread_mutex_lock( &Q->lock );
+    pthread_cond_broadcast( &Q->done );
+    pthread_mutex_unlock( &Q->lock );
+  }
+}
+
+static void *blake2_queue_worker( void *arg )
+{
+  blake2_queue *Q = ( blake2_queue * )arg;
+  blake2_job *jobs[BLAKE2_QUEUE_BATCH];
+
+  for( ;; )
+  {
+    size_t n = 0;
+
+    while( n < BLAKE2_QUEUE_BATCH && NULL != ( jobs[n] = blake2_ring_pop( Q->sq ) ) ) ++n;
+
+    if( n > 0 )
+    {
+      blake2_queue_run( jobs, n );
+
+      for( size_t i = 0; i < n; ++i )
+        blake2_queue_complete( Q, jobs[i] );
+
+      continue;
+    }
+
+    /* The idle count is raised before the ring is checked, so a submitter either sees it or we see the job */
+    pthread_mutex_lock( &Q->lock );
+    __atomic_add_fetch( &Q->idle, 1, __ATOMIC_SEQ_CST );
+
+    while( !Q->stop && blake2_ring_empty( Q->sq ) )
+      pthread_cond_wait( &Q->work, &Q->lock );
+
+    __atomic_sub_fetch( &Q->idle, 1, __ATOMIC_SEQ_CST );
+    n = Q->stop && blake2_ring_empty( Q->sq );
+    pthread_mutex_unlock( &Q->lock );
+
+    if( n ) break;
+  }
+
+  return NULL;
+}
+
+blake2_queue *blake2_queue_create( unsigned threads, size_t depth, blake2_job_fn fn, void *ctx )
+{
+  blake2_queue *Q;
+
+  if( 0 == threads || 0 == depth || depth > SIZE_MAX / 4 ) return NULL;
+
+  if( NULL == ( Q = ( blake2_queue * )calloc( 1, sizeof( *Q ) ) ) ) return NULL;
+
+  if( NULL == ( Q->threads = ( pthread_t * )malloc( threads * sizeof( *Q->threads ) ) ) ) goto fail;
+
+  if( blake2_ring_init( Q->sq, depth ) < 0 ) goto fail;
+
+  if( blake2_ring_init( Q->cq, depth ) < 0 ) goto fail;
+
+  Q->depth = depth;
+  Q->fn = fn;
+  Q->ctx = ctx;
+  Q->efd = -1;
+#if defined(HAVE_SYS_EVENTFD_H)
+  if( NULL == fn ) Q->efd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+#endif
+  pthread_mutex_init( &Q->lock, NULL );
+  pthread_cond_init( &Q->work, NULL );
+  pthread_cond_init( &Q->done, NULL );
+
+  for( ; Q->nthreads < threads; ++Q->nthreads )
+  {
+    if( pthread_create( &Q->threads[Q->nthreads], NULL, blake2_queue_worker, Q ) != 0 ) break;
+  }
+
+  if( 0 == Q->nthreads )
+  {
+    blake2_queue_destroy( Q );
+    return NULL;
+  }
+
+  return Q;
+fail:
+  free( Q->sq->slots );
+  free( Q->cq->slots );
+  free( Q->threads );
+  free( Q );
+  return NULL;
+}
+
+int blake2_queue_submit( blake2_queue *Q, blake2_job *J )
+{
+  if( NULL == Q || NULL == J || ( unsigned )J->kind > BLAKE2_DIGEST_BP || J->iovcnt < 0 || ( NULL == J->iov && J->iovcnt > 0 ) )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if( __atomic_add_fetch( &Q->inflight, 1, __ATOMIC_SEQ_CST ) > Q->depth )
+  {
+    __atomic_sub_fetch( &Q->inflight, 1, __ATOMIC_SEQ_CST );
+    errno = EAGAIN;
+    return -1;
+  }
+
+  blake2_ring_push( Q->sq, J );
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+  if( __atomic_load_n( &Q->idle, __ATOMIC_SEQ_CST ) )
+  {
+    pthread_mutex_lock( &Q->lock );
+    pthread_cond_signal( &Q->work );
+    pthread_mutex_unlock( &Q->lock );
+  }
+
+  return 0;
+}
+
+size_t blake2_queue_reap( blake2_queue *Q, blake2_job **jobs, size_t max )
+{
+  size_t n = 0;
+
+  if( NULL == Q || NULL == jobs ) return 0;
+
+  while( n < max && NULL != ( jobs[n] = blake2_ring_pop( Q->cq ) ) )
+  {
+    __atomic_sub_fetch( &Q->inflight, 1, __ATOMIC_SEQ_CST );
+    ++n;
+  }
+
+  return n;
+}
+
+size_t blake2_queue_wait( blake2_queue *Q, blake2_job **jobs, size_t max )
+{
+  size_t n;
+
+  if( NULL == Q || NULL == jobs || 0 == max || Q->fn ) return 0;
+
+  while( 0 == ( n = blake2_queue_reap( Q, jobs, max ) ) )
+  {
+    int idle;
+
+    pthread_mutex_lock( &Q->lock );
+    __atomic_add_fetch( &Q->waiting, 1, __ATOMIC_SEQ_CST );
+
+    while( blake2_ring_empty( Q->cq ) && __atomic_load_n( &Q->inflight, __ATOMIC_SEQ_CST ) > 0 )
+      pthread_cond_wait( &Q->done, &Q->lock );
+
+    __atomic_sub_fetch( &Q->waiting, 1, __ATOMIC_SEQ_CST );
+    idle = 0 == __atomic_load_n( &Q->inflight, __ATOMIC_SEQ_CST );
+    pthread_mutex_unlock( &Q->lock );
+
+    if( idle ) return 0; /* Nothing submitted, so nothing will complete */
+  }
+
+  return n;
+}
+
+int blake2_queue_fd( const blake2_queue *Q )
+{
+  return Q ? Q->efd : -1;
+}
+
+void blake2_queue_destroy( blake2_queue *Q )
+{
+  if( NULL == Q ) return;
+
+  pthread_mutex_lock( &Q->lock );
+  Q->stop = 1;
+  pthread_cond_broadcast( &Q->work );
+  pthread_mutex_unlock( &Q->lock );
+
+  for( unsigned i = 0; i < Q->nthreads; ++i )
+    pthread_join( Q->threads[i], NULL );
+
+#if defined(HAVE_SYS_EVENTFD_H)
+  if( Q->efd >= 0 ) close( Q->efd );
+#endif
+  pthread_cond_destroy( &Q->done );
+  pthread_cond_destroy( &Q->work );
+  pthread_mutex_destroy( &Q->lock );
+  free( Q->sq->slots );
+  free( Q->cq->slots );
+  free( Q->threads );
+  free( Q );
+}
+#else
+blake2_queue *blake2_queue_create( unsigned threads, size_t depth, blake2_job_fn fn, void *ctx )
+{
+  return NULL;
+}
+
+int blake2_queue_submit( blake2_queue *Q, blake2_job *J )
+{
+  return -1;
+}
+
+size_t blake2_queue_reap( blake2_queue *Q, blake2_job **jobs, size_t max )
+{
+  return 0;
+}
+
+size_t blake2_queue_wait( blake2_queue *Q, blake2_job **jobs, size_t max )
+{
+  return 0;
+}
+
+int blake2_queue_fd( const blake2_queue *Q )
+{
+  return -1;
+}
+
+void blake2_queue_destroy( blake2_queue *Q )
+{
+}
+#endif
@@ -0,0 +1,180 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define MSGBYTES 2000
+
+/* Checkpoint after every prefix length in a sweep, resume from the record and finish */
+static int test_resume( const uint8_t *key, const uint8_t *msg )
+{
+  static uint8_t rec[BLAKE2BP_EXPORTBYTES];
+
+  for( size_t split = 0; split <= MSGBYTES; split += 97 )
+  {
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+    blake2s_state SS[1];
+    blake2b_state SB[1];
+    blake2sp_state SSP[1];
+    blake2bp_state SBP[1];
+    int n;
+
+    blake2s_init_key( SS, BLAKE2S_OUTBYTES, key, BLAKE2S_KEYBYTES );
+    blake2s_update( SS, msg, split );
+
+    if( ( n = blake2s_export( SS, rec, sizeof( rec ) ) ) < 0 || n != blake2s_export( SS, NULL, 0 ) || n > BLAKE2S_EXPORTBYTES ) return -1;
+
+    memset( SS, 0xA5, sizeof( SS ) );
+
+    if( blake2s_import( SS, rec, n ) < 0 ) return -1;
+
+    blake2s_update( SS, msg + split, MSGBYTES - split );
+    blake2s_final( SS, a, BLAKE2S_OUTBYTES );
+    blake2s( b, msg, key, BLAKE2S_OUTBYTES, MSGBYTES, BLAKE2S_KEYBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+
+    blake2b_init( SB, 40 );
+    blake2b_update( SB, msg, split );
+
+    if( ( n = blake2b_export( SB, rec, sizeof( rec ) ) ) < 0 || n > BLAKE2B_EXPORTBYTES ) return -1;
+
+    memset( SB, 0xA5, sizeof( SB ) );
+
+    if( blake2b_import( SB, rec, n ) < 0 ) return -1;
+
+    blake2b_update( SB, msg + split, MSGBYTES - split );
+    blake2b_final( SB, a, 40 );
+    blake2b( b, msg, NULL, 40, MSGBYTES, 0 );
+
+    if( 0 != memcmp( a, b, 40 ) ) return -1;
+
+    blake2sp_init( SSP, BLAKE2S_OUTBYTES );
+    blake2sp_update( SSP, msg, split );
+
+    if( ( n = blake2sp_export( SSP, rec, sizeof( rec ) ) ) < 0 || n > BLAKE2SP_EXPORTBYTES ) return -1;
+
+    memset( SSP, 0xA5, sizeof( SSP ) );
+
+    if( blake2sp_import( SSP, rec, n ) < 0 ) return -1;
+
+    blake2sp_update( SSP, msg + split, MSGBYTES - split );
+    blake2sp_final( SSP, a, BLAKE2S_OUTBYTES );
+    blake2sp( b, msg, NULL, BLAKE2S_OUTBYTES, MSGBYTES, 0 );
+
+    if( 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) ) return -1;
+
+    blake2bp_init_key( SBP, BLAKE2B_OUTBYTES, key, BLAKE2B_KEYBYTES );
+    blake2bp_update( SBP, msg, split );
+
+    if( ( n = blake2bp_export( SBP, rec, sizeof( rec ) ) ) < 0 || n > BLAKE2BP_EXPORTBYTES ) return -1;
+
+    memset( SBP, 0xA5, sizeof( SBP ) );
+
+    if( blake2bp_import( SBP, rec, n ) < 0 ) return -1;
+
+    blake2bp_update( SBP, msg + split, MSGBYTES - split );
+    blake2bp_final( SBP, a, BLAKE2B_OUTBYTES );
+    blake2bp( b, msg, key, BLAKE2B_OUTBYTES, MSGBYTES, BLAKE2B_KEYBYTES );
+
+    if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+  }
+
+  return 0;
+}
+
+/* The encoding is fixed: the same bytes come out on every host */
+static int test_layout( const uint8_t *msg )
+{
+  static const uint8_t head[] =
+  {
+    'B', '2', 1, 0, 32, 0, 3, 0,
+    /* h[0] = IV[0] ^ 0x01010020, little-endian */
+    0x47, 0xe6, 0x08, 0x6b
+  };
+  uint8_t rec[BLAKE2S_EXPORTBYTES];
+  blake2s_state S[1];
+  blake2b_state B[1];
+  int n;
+
+  blake2s_init( S, BLAKE2S_OUTBYTES );
+  blake2s_update( S, msg, 3 );
+  n = blake2s_export( S, rec, sizeof( rec ) );
+
+  if( n != 8 + 12 * 4 + 3 || 0 != memcmp( rec, head, sizeof( head ) ) || 0 != memcmp( rec + n - 3, msg, 3 ) ) return -1;
+
+  /* Too small an output, truncation, trailing bytes, a bad version or outlen */
+  if( blake2s_export( S, rec, n - 1 ) == 0 ) return -1;
+
+  if( blake2s_import( S, rec, n - 1 ) == 0 || blake2s_import( S, rec, n + 1 ) == 0 ) return -1;
+
+  rec[2] = 2;
+
+  if( blake2s_import( S, rec, n ) == 0 ) return -1;
+
+  rec[2] = 1;
+  rec[4] = 33;
+
+  if( blake2s_import( S, rec, n ) == 0 ) return -1;
+
+  rec[4] = 32;
+
+  if( blake2b_import( B, rec, n ) == 0 ) return -1;
+
+  return blake2s_import( S, rec, n );
+}
+
+/* A prepared state keeps its empty-message MAC across a round trip */
+static int test_prepared( const uint8_t *key )
+{
+  uint8_t rec[BLAKE2B_EXPORTBYTES];
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+  blake2b_prepared_key K[1];
+  blake2b_state S[1];
+  int n;
+
+  blake2b_prepare_key( K, BLAKE2B_OUTBYTES, key, 20 );
+  blake2b_init_prepared( S, K );
+
+  /* The marker travels in the flags byte, not in the shape of the counter */
+  if( ( n = blake2b_export( S, rec, sizeof( rec ) ) ) < 0 || 2 != rec[5] || blake2b_import( S, rec, n ) < 0 ) return -1;
+
+  blake2b( a, "", key, BLAKE2B_OUTBYTES, 0, 20 );
+
+  if( blake2b_final( S, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t msg[MSGBYTES];
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  if( test_resume( key, msg ) < 0 || test_layout( msg ) < 0 || test_prepared( key ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
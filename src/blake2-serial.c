@@ -0,0 +1,319 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   Exported states have a fixed little-endian layout, independent of struct
+   packing and host byte order:
+
+     0      'B' '2' version kind
+     4      outlen flags buflen (16 bits)
+     8      h[0..7] t[0..1] f[0..1], one word each
+     ...    the live buffer bytes
+
+   flags has last_node in bit 0 and the prepared marker in bit 1. A
+   blake2sp/blake2bp record starts with the same 8 bytes (flags are 0)
+   and is followed by the leaf records, the root record and its own buffer.
+*/
+
+#define BLAKE2_EXPORT_VERSION 1
+
+enum blake2_export_kind
+{
+  EXPORT_S  = 0,
+  EXPORT_B  = 1,
+  EXPORT_SP = 2,
+  EXPORT_BP = 3
+};
+
+static void export_header( uint8_t *out, int kind, size_t outlen, int flags, size_t buflen )
+{
+  out[0] = 'B';
+  out[1] = '2';
+  out[2] = BLAKE2_EXPORT_VERSION;
+  out[3] = ( uint8_t )kind;
+  out[4] = ( uint8_t )outlen;
+  out[5] = ( uint8_t )flags;
+  out[6] = ( uint8_t )( buflen );
+  out[7] = ( uint8_t )( buflen >> 8 );
+}
+
+static int import_header( const uint8_t *in, size_t inlen, int kind, size_t maxout, size_t maxbuf, size_t *outlen, size_t *buflen )
+{
+  if( inlen < 8 || in[0] != 'B' || in[1] != '2' ) return -1;
+
+  if( in[2] != BLAKE2_EXPORT_VERSION || in[3] != kind ) return -1;
+
+  if( in[4] == 0 || in[4] > maxout || in[5] > 3 ) return -1;
+
+  *outlen = in[4];
+  *buflen = in[6] | ( ( size_t )in[7] << 8 );
+  return *buflen > maxbuf ? -1 : 0;
+}
+
+static size_t blake2s_live( const blake2s_state *S )
+{
+  return BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) ? BLAKE2S_OUTBYTES : S->buflen;
+}
+
+static size_t blake2b_live( const blake2b_state *S )
+{
+  return BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) ? BLAKE2B_OUTBYTES : S->buflen;
+}
+
+static size_t blake2s_put( uint8_t *out, const blake2s_state *S )
+{
+  const size_t live = blake2s_live( S );
+  export_header( out, EXPORT_S, S->outlen, S->last_node | ( BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) << 1 ), S->buflen );
+  out += 8;
+
+  for( size_t i = 0; i < 8; ++i, out += 4 ) store32( out, S->h[i] );
+
+  for( size_t i = 0; i < 2; ++i, out += 4 ) store32( out, S->t[i] );
+
+  for( size_t i = 0; i < 2; ++i, out += 4 ) store32( out, S->f[i] );
+
+  memcpy( out, S->buf, live );
+  return 8 + 12 * 4 + live;
+}
+
+static size_t blake2b_put( uint8_t *out, const blake2b_state *S )
+{
+  const size_t live = blake2b_live( S );
+  export_header( out, EXPORT_B, S->outlen, S->last_node | ( BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) << 1 ), S->buflen );
+  out += 8;
+
+  for( size_t i = 0; i < 8; ++i, out += 8 ) store64( out, S->h[i] );
+
+  for( size_t i = 0; i < 2; ++i, out += 8 ) store64( out, S->t[i] );
+
+  for( size_t i = 0; i < 2; ++i, out += 8 ) store64( out, S->f[i] );
+
+  memcpy( out, S->buf, live );
+  return 8 + 12 * 8 + live;
+}
+
+/* Returns the number of bytes consumed, or 0 if the record is malformed */
+static size_t blake2s_get( blake2s_state *S, const uint8_t *in, size_t inlen )
+{
+  size_t outlen, buflen, live;
+  int prepared;
+
+  if( import_header( in, inlen, EXPORT_S, BLAKE2S_OUTBYTES, 2 * BLAKE2S_BLOCKBYTES, &outlen, &buflen ) < 0 ) return 0;
+
+  if( inlen < 8 + 12 * 4 ) return 0;
+
+  memset( S, 0, sizeof( blake2s_state ) );
+  S->outlen = ( uint8_t )outlen;
+  S->last_node = in[5] & 1;
+  prepared = in[5] >> 1;
+  S->buflen = ( uint32_t )buflen;
+  in += 8;
+
+  for( size_t i = 0; i < 8; ++i, in += 4 ) S->h[i] = load32( in );
+
+  for( size_t i = 0; i < 2; ++i, in += 4 ) S->t[i] = load32( in );
+
+  for( size_t i = 0; i < 2; ++i, in += 4 ) S->f[i] = load32( in );
+
+  if( prepared ) BLAKE2_PREPARED_MARK( S, BLAKE2S_BLOCKBYTES );
+
+  live = blake2s_live( S );
+
+  if( inlen < 8 + 12 * 4 + live ) return 0;
+
+  memcpy( S->buf, in, live );
+  return 8 + 12 * 4 + live;
+}
+
+static size_t blake2b_get( blake2b_state *S, const uint8_t *in, size_t inlen )
+{
+  size_t outlen, buflen, live;
+  int prepared;
+
+  if( import_header( in, inlen, EXPORT_B, BLAKE2B_OUTBYTES, 2 * BLAKE2B_BLOCKBYTES, &outlen, &buflen ) < 0 ) return 0;
+
+  if( inlen < 8 + 12 * 8 ) return 0;
+
+  memset( S, 0, sizeof( blake2b_state ) );
+  S->outlen = ( uint8_t )outlen;
+  S->last_node = in[5] & 1;
+  prepared = in[5] >> 1;
+  S->buflen = ( uint32_t )buflen;
+  in += 8;
+
+  for( size_t i = 0; i < 8; ++i, in += 8 ) S->h[i] = load64( in );
+
+  for( size_t i = 0; i < 2; ++i, in += 8 ) S->t[i] = load64( in );
+
+  for( size_t i = 0; i < 2; ++i, in += 8 ) S->f[i] = load64( in );
+
+  if( prepared ) BLAKE2_PREPARED_MARK( S, BLAKE2B_BLOCKBYTES );
+
+  live = blake2b_live( S );
+
+  if( inlen < 8 + 12 * 8 + live ) return 0;
+
+  memcpy( S->buf, in, live );
+  return 8 + 12 * 8 + live;
+}
+
+int blake2s_export( const blake2s_state *S, uint8_t *out, size_t outlen )
+{
+  const size_t need = 8 + 12 * 4 + blake2s_live( S );
+
+  if( NULL == out ) return ( int )need;
+
+  if( outlen < need ) return -1;
+
+  return ( int )blake2s_put( out, S );
+}
+
+int blake2b_export( const blake2b_state *S, uint8_t *out, size_t outlen )
+{
+  const size_t need = 8 + 12 * 8 + blake2b_live( S );
+
+  if( NULL == out ) return ( int )need;
+
+  if( outlen < need ) return -1;
+
+  return ( int )blake2b_put( out, S );
+}
+
+int blake2sp_export( const blake2sp_state *S, uint8_t *out, size_t outlen )
+{
+  size_t need = 8 + 8 + 12 * 4 + blake2s_live( S->R ) + S->buflen;
+
+  for( size_t i = 0; i < 8; ++i )
+    need += 8 + 12 * 4 + blake2s_live( S->S[i] );
+
+  if( NULL == out ) return ( int )need;
+
+  if( outlen < need ) return -1;
+
+  export_header( out, EXPORT_SP, S->outlen, 0, S->buflen );
+  outlen = 8;
+
+  for( size_t i = 0; i < 8; ++i )
+    outlen += blake2s_put( out + outlen, S->S[i] );
+
+  outlen += blake2s_put( out + outlen, S->R );
+  memcpy( out + outlen, S->buf, S->buflen );
+  return ( int )need;
+}
+
+int blake2bp_export( const blake2bp_state *S, uint8_t *out, size_t outlen )
+{
+  size_t need = 8 + 8 + 12 * 8 + blake2b_live( S->R ) + S->buflen;
+
+  for( size_t i = 0; i < 4; ++i )
+    need += 8 + 12 * 8 + blake2b_live( S->S[i] );
+
+  if( NULL == out ) return ( int )need;
+
+  if( outlen < need ) return -1;
+
+  export_header( out, EXPORT_BP, S->outlen, 0, S->buflen );
+  outlen = 8;
+
+  for( size_t i = 0; i < 4; ++i )
+    outlen += blake2b_put( out + outlen, S->S[i] );
+
+  outlen += blake2b_put( out + outlen, S->R );
+  memcpy( out + outlen, S->buf, S->buflen );
+  return ( int )need;
+}
+
+int blake2s_import( blake2s_state *S, const uint8_t *in, size_t inlen )
+{
+  blake2s_state T[1];
+
+  if( blake2s_get( T, in, inlen ) != inlen ) return -1;
+
+  memcpy( S, T, sizeof( T ) );
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+}
+
+int blake2b_import( blake2b_state *S, const uint8_t *in, size_t inlen )
+{
+  blake2b_state T[1];
+
+  if( blake2b_get( T, in, inlen ) != inlen ) return -1;
+
+  memcpy( S, T, sizeof( T ) );
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+}
+
+/* S is only written once the whole record has been checked */
+int blake2sp_import( blake2sp_state *S, const uint8_t *in, size_t inlen )
+{
+  blake2sp_state T[1];
+  size_t outlen, buflen, off = 8, n;
+
+  if( import_header( in, inlen, EXPORT_SP, BLAKE2S_OUTBYTES, 8 * BLAKE2S_BLOCKBYTES, &outlen, &buflen ) < 0 ) return -1;
+
+  memset( T, 0, sizeof( T ) );
+
+  for( size_t i = 0; i < 9; ++i, off += n )
+  {
+    n = blake2s_get( i < 8 ? T->S[i] : T->R, in + off, inlen - off );
+
+    if( 0 == n ) goto fail;
+  }
+
+  if( inlen - off != buflen ) goto fail;
+
+  memcpy( T->buf, in + off, buflen );
+  T->buflen = ( uint32_t )buflen;
+  T->outlen = ( uint8_t )outlen;
+  memcpy( S, T, sizeof( T ) );
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+fail:
+  secure_zero_memory( T, sizeof( T ) );
+  return -1;
+}
+
+int blake2bp_import( blake2bp_state *S, const uint8_t *in, size_t inlen )
+{
+  blake2bp_state T[1];
+  size_t outlen, buflen, off = 8, n;
+
+  if( import_header( in, inlen, EXPORT_BP, BLAKE2B_OUTBYTES, 4 * BLAKE2B_BLOCKBYTES, &outlen, &buflen ) < 0 ) return -1;
+
+  memset( T, 0, sizeof( T ) );
+
+  for( size_t i = 0; i < 5; ++i, off += n )
+  {
+    n = blake2b_get( i < 4 ? T->S[i] : T->R, in + off, inlen - off );
+
+    if( 0 == n ) goto fail;
+  }
+
+  if( inlen - off != buflen ) goto fail;
+
+  memcpy( T->buf, in + off, buflen );
+  T->buflen = ( uint32_t )buflen;
+  T->outlen = ( uint8_t )outlen;
+  memcpy( S, T, sizeof( T ) );
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+fail:
+  secure_zero_memory( T, sizeof( T ) );
+  return -1;
+}
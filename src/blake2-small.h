@@ -0,0 +1,266 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#pragma once
+#ifndef __BLAKE2_SMALL_H__
+#define __BLAKE2_SMALL_H__
+
+/*
+   Header-only blake2s()/blake2b() for inputs of at most one block, for hash
+   table and dedup keys where the call itself dominates. The input is copied
+   into one zero-filled block on the stack and compressed from there; no
+   state is built and no library call is made. Keyed calls wipe the block,
+   the message words and the chaining value before returning, as the library
+   does. Results match blake2s() and blake2b(); longer inputs return -1 and
+   must go through the library.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "blake2.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+  static const uint32_t blake2s_small_IV[8] =
+  {
+    0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+    0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+  };
+
+  static const uint64_t blake2b_small_IV[8] =
+  {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+  };
+
+  static const uint8_t blake2_small_sigma[12][16] =
+  {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 } ,
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 } ,
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 } ,
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 } ,
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 } ,
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 } ,
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 } ,
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+  };
+
+  /* Cannot be optimized away, unlike a memset of memory that is about to go out of scope */
+  static inline void blake2_small_wipe( void *v, size_t n )
+  {
+    static void *( *const volatile memset_v )( void *, int, size_t ) = &memset;
+
+    memset_v( v, 0, n );
+  }
+
+  /* Little-endian words of p[0..n) zero-padded to a block in b; compilers turn the shifts into plain loads */
+  static inline void blake2s_small_load( uint32_t m[16], uint8_t b[BLAKE2S_BLOCKBYTES], const uint8_t *p, size_t n )
+  {
+    memset( b, 0, BLAKE2S_BLOCKBYTES );
+
+    if( n > 0 ) memcpy( b, p, n );
+
+    for( size_t i = 0; i < 16; ++i )
+      m[i] = ( uint32_t )b[4 * i + 0] <<  0 | ( uint32_t )b[4 * i + 1] <<  8 |
+             ( uint32_t )b[4 * i + 2] << 16 | ( uint32_t )b[4 * i + 3] << 24;
+  }
+
+  static inline void blake2b_small_load( uint64_t m[16], uint8_t b[BLAKE2B_BLOCKBYTES], const uint8_t *p, size_t n )
+  {
+    memset( b, 0, BLAKE2B_BLOCKBYTES );
+
+    if( n > 0 ) memcpy( b, p, n );
+
+    for( size_t i = 0; i < 16; ++i )
+      m[i] = ( uint64_t )b[8 * i + 0] <<  0 | ( uint64_t )b[8 * i + 1] <<  8 |
+             ( uint64_t )b[8 * i + 2] << 16 | ( uint64_t )b[8 * i + 3] << 24 |
+             ( uint64_t )b[8 * i + 4] << 32 | ( uint64_t )b[8 * i + 5] << 40 |
+             ( uint64_t )b[8 * i + 6] << 48 | ( uint64_t )b[8 * i + 7] << 56;
+  }
+
+#define BLAKE2_SMALL_G(m,r,i,a,b,c,d,R1,R2,R3,R4,W) \
+  do { \
+    a = a + b + m[blake2_small_sigma[r][2*i+0]]; \
+    d = ( ( d ^ a ) >> R1 ) | ( ( d ^ a ) << ( W - R1 ) ); \
+    c = c + d; \
+    b = ( ( b ^ c ) >> R2 ) | ( ( b ^ c ) << ( W - R2 ) ); \
+    a = a + b + m[blake2_small_sigma[r][2*i+1]]; \
+    d = ( ( d ^ a ) >> R3 ) | ( ( d ^ a ) << ( W - R3 ) ); \
+    c = c + d; \
+    b = ( ( b ^ c ) >> R4 ) | ( ( b ^ c ) << ( W - R4 ) ); \
+  } while(0)
+
+#define BLAKE2_SMALL_ROUND(m,v,r,R1,R2,R3,R4,W) \
+  do { \
+    BLAKE2_SMALL_G(m,r,0,v[ 0],v[ 4],v[ 8],v[12],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,1,v[ 1],v[ 5],v[ 9],v[13],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,2,v[ 2],v[ 6],v[10],v[14],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,3,v[ 3],v[ 7],v[11],v[15],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,4,v[ 0],v[ 5],v[10],v[15],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,5,v[ 1],v[ 6],v[11],v[12],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,6,v[ 2],v[ 7],v[ 8],v[13],R1,R2,R3,R4,W); \
+    BLAKE2_SMALL_G(m,r,7,v[ 3],v[ 4],v[ 9],v[14],R1,R2,R3,R4,W); \
+  } while(0)
+
+  static inline void blake2s_small_compress( uint32_t h[8], const uint32_t m[16], uint32_t t, uint32_t f )
+  {
+    uint32_t v[16];
+
+    for( size_t i = 0; i < 8; ++i )
+    {
+      v[i] = h[i];
+      v[i + 8] = blake2s_small_IV[i];
+    }
+
+    v[12] ^= t;
+    v[14] ^= f;
+
+    BLAKE2_SMALL_ROUND( m, v, 0, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 1, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 2, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 3, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 4, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 5, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 6, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 7, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 8, 16, 12, 8, 7, 32 );
+    BLAKE2_SMALL_ROUND( m, v, 9, 16, 12, 8, 7, 32 );
+
+    for( size_t i = 0; i < 8; ++i )
+      h[i] ^= v[i] ^ v[i + 8];
+  }
+
+  static inline void blake2b_small_compress( uint64_t h[8], const uint64_t m[16], uint64_t t, uint64_t f )
+  {
+    uint64_t v[16];
+
+    for( size_t i = 0; i < 8; ++i )
+    {
+      v[i] = h[i];
+      v[i + 8] = blake2b_small_IV[i];
+    }
+
+    v[12] ^= t;
+    v[14] ^= f;
+
+    BLAKE2_SMALL_ROUND( m, v,  0, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  1, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  2, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  3, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  4, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  5, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  6, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  7, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  8, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v,  9, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v, 10, 32, 24, 16, 63, 64 );
+    BLAKE2_SMALL_ROUND( m, v, 11, 32, 24, 16, 63, 64 );
+
+    for( size_t i = 0; i < 8; ++i )
+      h[i] ^= v[i] ^ v[i + 8];
+  }
+
+#undef BLAKE2_SMALL_ROUND
+#undef BLAKE2_SMALL_G
+
+  static inline int blake2s_small( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+  {
+    uint32_t h[8], m[16];
+    uint8_t b[BLAKE2S_BLOCKBYTES];
+
+    if( ( NULL == in && inlen > 0 ) || NULL == out || ( NULL == key && keylen > 0 ) ) return -1;
+
+    if( !outlen || outlen > BLAKE2S_OUTBYTES || keylen > BLAKE2S_KEYBYTES || inlen > BLAKE2S_BLOCKBYTES ) return -1;
+
+    for( size_t i = 0; i < 8; ++i ) h[i] = blake2s_small_IV[i];
+
+    /* digest_length, key_length, fanout = 1, depth = 1 */
+    h[0] ^= 0x01010000UL ^ ( uint32_t )( keylen << 8 ) ^ ( uint32_t )outlen;
+
+    if( keylen > 0 )
+    {
+      blake2s_small_load( m, b, ( const uint8_t * )key, keylen );
+      blake2s_small_compress( h, m, BLAKE2S_BLOCKBYTES, inlen > 0 ? 0 : ~0U );
+    }
+
+    if( inlen > 0 || 0 == keylen )
+    {
+      blake2s_small_load( m, b, ( const uint8_t * )in, inlen );
+      blake2s_small_compress( h, m, ( uint32_t )( ( keylen > 0 ? BLAKE2S_BLOCKBYTES : 0 ) + inlen ), ~0U );
+    }
+
+    for( size_t i = 0; i < outlen; ++i )
+      out[i] = ( uint8_t )( h[i / 4] >> ( 8 * ( i % 4 ) ) );
+
+    if( keylen > 0 )
+    {
+      blake2_small_wipe( b, sizeof( b ) );
+      blake2_small_wipe( m, sizeof( m ) );
+      blake2_small_wipe( h, sizeof( h ) );
+    }
+
+    return 0;
+  }
+
+  static inline int blake2b_small( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+  {
+    uint64_t h[8], m[16];
+    uint8_t b[BLAKE2B_BLOCKBYTES];
+
+    if( ( NULL == in && inlen > 0 ) || NULL == out || ( NULL == key && keylen > 0 ) ) return -1;
+
+    if( !outlen || outlen > BLAKE2B_OUTBYTES || keylen > BLAKE2B_KEYBYTES || inlen > BLAKE2B_BLOCKBYTES ) return -1;
+
+    for( size_t i = 0; i < 8; ++i ) h[i] = blake2b_small_IV[i];
+
+    h[0] ^= 0x01010000ULL ^ ( uint64_t )( keylen << 8 ) ^ ( uint64_t )outlen;
+
+    if( keylen > 0 )
+    {
+      blake2b_small_load( m, b, ( const uint8_t * )key, keylen );
+      blake2b_small_compress( h, m, BLAKE2B_BLOCKBYTES, inlen > 0 ? 0 : ~0ULL );
+    }
+
+    if( inlen > 0 || 0 == keylen )
+    {
+      blake2b_small_load( m, b, ( const uint8_t * )in, inlen );
+      blake2b_small_compress( h, m, ( uint64_t )( ( keylen > 0 ? BLAKE2B_BLOCKBYTES : 0 ) + inlen ), ~0ULL );
+    }
+
+    for( size_t i = 0; i < outlen; ++i )
+      out[i] = ( uint8_t )( h[i / 8] >> ( 8 * ( i % 8 ) ) );
+
+    if( keylen > 0 )
+    {
+      blake2_small_wipe( b, sizeof( b ) );
+      blake2_small_wipe( m, sizeof( m ) );
+      blake2_small_wipe( h, sizeof( h ) );
+    }
+
+    return 0;
+  }
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "blake2.h"
+
+/* Several default 2 MiB leaves, the last one short */
+#define INPUT_BYTES ( 5 * 1024 * 1024 + 3 )
+
+static void store_le( void *dst, uint64_t w, size_t n )
+{
+  uint8_t *p = ( uint8_t * )dst;
+
+  for( size_t i = 0; i < n; ++i )
+    p[i] = ( uint8_t )( w >> ( 8 * i ) );
+}
+
+static void init_node( blake2b_state *S, size_t outlen, const uint8_t *key, size_t keylen, size_t leaf_length, uint64_t offset, uint8_t node_depth )
+{
+  blake2b_param P[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+
+  memset( P, 0, sizeof( P ) );
+  P->digest_length = ( uint8_t )outlen;
+  P->key_length = ( uint8_t )keylen;
+  P->depth = 2;
+  store_le( &P->leaf_length, leaf_length, 4 );
+  store_le( &P->node_offset, offset, 8 );
+  P->node_depth = node_depth;
+  P->inner_length = BLAKE2B_OUTBYTES;
+  blake2b_init_param( S, P );
+
+  if( keylen )
+  {
+    memset( block, 0, sizeof( block ) );
+    memcpy( block, key, keylen );
+    blake2b_update( S, block, sizeof( block ) );
+  }
+}
+
+/* The tree spelled out one node at a time */
+static void tree_reference( uint8_t *out, size_t outlen, const uint8_t *in, size_t inlen, const uint8_t *key, size_t keylen, size_t leaf_length )
+{
+  const size_t n = inlen ? ( inlen - 1 ) / leaf_length + 1 : 1;
+  uint8_t digest[BLAKE2B_OUTBYTES];
+  blake2b_state R[1], S[1];
+
+  init_node( R, outlen, key, keylen, leaf_length, 0, 1 );
+  R->last_node = 1;
+
+  for( size_t i = 0; i < n; ++i )
+  {
+    const size_t len = inlen - i * leaf_length < leaf_length ? inlen - i * leaf_length : leaf_length;
+
+    init_node( S, outlen, key, keylen, leaf_length, i, 0 );
+    S->outlen = BLAKE2B_OUTBYTES;
+    S->last_node = i + 1 == n;
+    blake2b_update( S, in + i * leaf_length, len );
+    blake2b_final( S, digest, BLAKE2B_OUTBYTES );
+    blake2b_update( R, digest, BLAKE2B_OUTBYTES );
+  }
+
+  blake2b_final( R, out, outlen );
+}
+
+static int test_tree( const uint8_t *in, const uint8_t *key )
+{
+  const size_t page = ( size_t )sysconf( _SC_PAGESIZE ), leaf = 4 * page;
+  const size_t sizes[] = { 0, 1, leaf - 1, leaf, leaf + 1, 37 * leaf + 999 };
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+  for( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++i )
+  {
+    for( size_t keylen = 0; keylen <= BLAKE2B_KEYBYTES; keylen += BLAKE2B_KEYBYTES )
+    {
+      const size_t outlen = keylen ? 20 : BLAKE2B_OUTBYTES;
+
+      if( blake2b_tree( a, outlen, in, sizes[i], key, keylen, leaf ) < 0 ) return -1;
+
+      tree_reference( b, outlen, in, sizes[i], key, keylen, leaf );
+
+      if( 0 != memcmp( a, b, outlen ) ) return -1;
+    }
+  }
+
+  if( blake2b_tree( a, BLAKE2B_OUTBYTES, in, INPUT_BYTES, NULL, 0, 0 ) < 0 ) return -1;
+
+  tree_reference( b, BLAKE2B_OUTBYTES, in, INPUT_BYTES, NULL, 0, 2 * 1024 * 1024 );
+
+  if( 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) ) return -1;
+
+  /* Leaves must be whole pages */
+  if( blake2b_tree( a, BLAKE2B_OUTBYTES, in, INPUT_BYTES, NULL, 0, page + 1 ) >= 0 ) return -1;
+
+  if( blake2b_tree( a, BLAKE2B_OUTBYTES, in, INPUT_BYTES, key, BLAKE2B_KEYBYTES + 1, 0 ) >= 0 ) return -1;
+
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t *in = ( uint8_t * )malloc( INPUT_BYTES );
+  int ret;
+
+  if( NULL == in )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < INPUT_BYTES; ++i )
+    in[i] = ( uint8_t )( i * 5 + ( i >> 11 ) );
+
+  ret = test_tree( in, key );
+  free( in );
+
+  if( ret < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,403 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+/* cpu_set_t and pthread_attr_setaffinity_np */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+#if defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+#if defined(HAVE_SCHED_H)
+#include <sched.h>
+#endif
+#if defined(HAVE_SYS_SYSCALL_H)
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP) && \
+    defined(HAVE_SCHED_GETAFFINITY) && defined(__NR_move_pages) && defined(CPU_SET)
+#define BLAKE2_HAVE_NUMA
+#endif
+
+/*
+   A two-level BLAKE2b tree (fanout 0, depth 2, inner length 64) whose leaves
+   are contiguous leaf_length ranges of the input, leaf i at node offset i,
+   so each thread streams through whole pages of its own instead of every
+   thread touching every page as the interleaved blake2bp leaves do. The
+   root hashes the concatenated leaf digests. As in blake2bp every node
+   carries the requested digest length and, when keyed, starts with the
+   padded key block.
+
+   Placement comes from move_pages with no target nodes, which reports where
+   each page currently lives; a few pages are sampled per leaf and the most
+   common node wins. Leaves are then grouped by node and every node gets as
+   many workers, pinned to its allowed CPUs, as it has CPUs or leaves. A
+   worker drains its own node first, then the leaves whose pages were not
+   resident or whose node has no usable CPU, and then helps the other nodes,
+   so an uneven split never leaves threads idle. On a single node, or
+   without the Linux interfaces, every leaf is in the shared group and the
+   workers are not pinned.
+*/
+#define BLAKE2_TREE_LEAF ( 2 * BLAKE2_STREAM_BYTES )
+#define BLAKE2_TREE_NODES 64
+#define BLAKE2_TREE_SAMPLES 4
+#define BLAKE2_TREE_QUERY 1024
+
+typedef struct __blake2_tree_group
+{
+  size_t first; /* The group's leaves are order[first] to order[last - 1] */
+  size_t last;
+  char pad[64];
+  size_t next;  /* Next entry to claim */
+} blake2_tree_group;
+
+typedef struct __blake2_tree
+{
+  const uint8_t *in;
+  size_t inlen;
+  size_t leaf_length;
+  size_t nleaves;
+  uint8_t outlen;
+  uint8_t keylen;
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t *digests;
+  size_t *order;
+  /* Group 0 holds leaves of unknown placement, group 1 + n those on node n */
+  blake2_tree_group groups[1 + BLAKE2_TREE_NODES];
+} blake2_tree;
+
+typedef struct __blake2_tree_worker
+{
+  blake2_tree *T;
+  int group;
+#if defined(HAVE_PTHREAD_H)
+  pthread_t thread;
+#endif
+} blake2_tree_worker;
+
+static void blake2_tree_param( blake2b_param *P, uint8_t outlen, uint8_t keylen, uint32_t leaf_length, uint64_t offset, uint8_t node_depth )
+{
+  P->digest_length = outlen;
+  P->key_length = keylen;
+  P->fanout = 0;
+  P->depth = 2;
+  store32( &P->leaf_length, leaf_length );
+  store64( &P->node_offset, offset );
+  P->node_depth = node_depth;
+  P->inner_length = BLAKE2B_OUTBYTES;
+  memset( P->reserved, 0, sizeof( P->reserved ) );
+  memset( P->salt, 0, sizeof( P->salt ) );
+  memset( P->personal, 0, sizeof( P->personal ) );
+}
+
+static void blake2_tree_leaf( blake2_tree *T, size_t i )
+{
+  const size_t off = i * T->leaf_length;
+  const size_t len = T->inlen - off < T->leaf_length ? T->inlen - off : T->leaf_length;
+  blake2b_state S[1];
+  blake2b_param P[1];
+
+  blake2_tree_param( P, T->outlen, T->keylen, ( uint32_t )T->leaf_length, i, 0 );
+  blake2b_init_param( S, P );
+  S->outlen = BLAKE2B_OUTBYTES;
+
+  if( i + 1 == T->nleaves ) S->last_node = 1;
+
+  if( T->keylen ) blake2b_update( S, T->block, BLAKE2B_BLOCKBYTES );
+
+  blake2b_update( S, T->in + off, len );
+  blake2b_final( S, T->digests + i * BLAKE2B_OUTBYTES, BLAKE2B_OUTBYTES );
+}
+
+static void blake2_tree_drain( blake2_tree *T, blake2_tree_group *G )
+{
+  for( ;; )
+  {
+    const size_t j = __atomic_fetch_add( &G->next, 1, __ATOMIC_RELAXED );
+
+    if( j >= G->last ) break;
+
+    blake2_tree_leaf( T, T->order[j] );
+  }
+}
+
+static void *blake2_tree_work( void *arg )
+{
+  blake2_tree_worker *W = ( blake2_tree_worker * )arg;
+
+  blake2_tree_drain( W->T, &W->T->groups[W->group] );
+
+  for( int g = 0; g <= BLAKE2_TREE_NODES; ++g )
+  {
+    if( g != W->group ) blake2_tree_drain( W->T, &W->T->groups[g] );
+  }
+
+  return NULL;
+}
+
+#if defined(BLAKE2_HAVE_NUMA)
+/* The allowed CPUs of a node, from its sysfs cpulist ("0-3,8-11"); -1 if the node does not exist */
+static int blake2_tree_cpus( int node, const cpu_set_t *allowed, cpu_set_t *cpus )
+{
+  char path[64];
+  unsigned a, b;
+  int c, n = 0;
+  FILE *fp;
+
+  snprintf( path, sizeof( path ), "/sys/devices/system/node/node%d/cpulist", node );
+
+  if( NULL == ( fp = fopen( path, "r" ) ) ) return -1;
+
+  CPU_ZERO( cpus );
+
+  while( fscanf( fp, "%u", &a ) == 1 )
+  {
+    b = a;
+
+    if( '-' == ( c = fgetc( fp ) ) )
+    {
+      if( fscanf( fp, "%u", &b ) != 1 ) break;
+
+      c = fgetc( fp );
+    }
+
+    for( ; a <= b && a < CPU_SETSIZE; ++a )
+    {
+      if( CPU_ISSET( a, allowed ) )
+      {
+        CPU_SET( a, cpus );
+        ++n;
+      }
+    }
+
+    if( ',' != c ) break;
+  }
+
+  fclose( fp );
+  return n;
+}
+
+/* Node of each leaf, the most common among a few sampled pages, or -1 where none is resident */
+static void blake2_tree_place( const blake2_tree *T, size_t pagesize, int *node )
+{
+  void *pages[BLAKE2_TREE_QUERY];
+  int status[BLAKE2_TREE_QUERY];
+
+  for( size_t first = 0; first < T->nleaves; first += BLAKE2_TREE_QUERY / BLAKE2_TREE_SAMPLES )
+  {
+    const size_t n = T->nleaves - first < BLAKE2_TREE_QUERY / BLAKE2_TREE_SAMPLES ? T->nleaves - first : BLAKE2_TREE_QUERY / BLAKE2_TREE_SAMPLES;
+    size_t k = 0;
+
+    for( size_t i = first; i < first + n; ++i )
+    {
+      const size_t off = i * T->leaf_length;
+      const size_t len = T->inlen - off < T->leaf_length ? T->inlen - off : T->leaf_length;
+
+      for( size_t s = 0; s < BLAKE2_TREE_SAMPLES; ++s )
+        pages[k++] = ( void * )( ( uintptr_t )( T->in + off + s * len / BLAKE2_TREE_SAMPLES ) & ~( uintptr_t )( pagesize - 1 ) );
+    }
+
+    if( syscall( __NR_move_pages, 0, ( unsigned long )k, pages, NULL, status, 0 ) != 0 ) continue;
+
+    for( size_t i = 0; i < n; ++i )
+    {
+      const int *v = status + i * BLAKE2_TREE_SAMPLES;
+      size_t best = 0;
+
+      for( size_t s = 0; s < BLAKE2_TREE_SAMPLES; ++s )
+      {
+        size_t votes = 0;
+
+        if( v[s] < 0 || v[s] >= BLAKE2_TREE_NODES ) continue;
+
+        for( size_t t = 0; t < BLAKE2_TREE_SAMPLES; ++t )
+          votes += v[t] == v[s];
+
+        if( votes > best )
+        {
+          best = votes;
+          node[first + i] = v[s];
+        }
+      }
+    }
+  }
+}
+#endif
+
+int blake2b_tree( uint8_t *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen, size_t leaf_length )
+{
+  blake2_tree *T;
+  blake2_tree_worker *W = NULL;
+  blake2_tree_worker self;
+  blake2b_state S[1];
+  blake2b_param P[1];
+  size_t pagesize = 4096, nworkers = 0, budget = 1;
+  int *node = NULL;
+  int ret = -1;
+#if defined(BLAKE2_HAVE_NUMA)
+  cpu_set_t allowed, cpus[BLAKE2_TREE_NODES];
+  int ncpus[BLAKE2_TREE_NODES] = { 0 }, nodes = 0;
+#endif
+
+  if( NULL == out || 0 == outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  if( ( NULL == in && inlen > 0 ) || ( NULL == key && keylen > 0 ) || keylen > BLAKE2B_KEYBYTES ) return -1;
+
+#if defined(HAVE_UNISTD_H) && defined(_SC_PAGESIZE)
+  if( sysconf( _SC_PAGESIZE ) > 0 ) pagesize = ( size_t )sysconf( _SC_PAGESIZE );
+#endif
+
+  if( 0 == leaf_length ) leaf_length = BLAKE2_TREE_LEAF;
+
+  if( leaf_length % pagesize || leaf_length > UINT32_MAX ) return -1;
+
+  if( NULL == ( T = ( blake2_tree * )calloc( 1, sizeof( *T ) ) ) ) return -1;
+
+  T->in = ( const uint8_t * )in;
+  T->inlen = inlen;
+  T->leaf_length = leaf_length;
+  T->nleaves = inlen ? ( inlen - 1 ) / leaf_length + 1 : 1;
+  T->outlen = ( uint8_t )outlen;
+  T->keylen = ( uint8_t )keylen;
+
+  if( keylen ) memcpy( T->block, key, keylen );
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  if( sysconf( _SC_NPROCESSORS_ONLN ) > 0 ) budget = ( size_t )sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+
+#if defined(BLAKE2_HAVE_NUMA)
+  if( budget > 1 && T->nleaves > 1 && 0 == sched_getaffinity( 0, sizeof( allowed ), &allowed ) )
+  {
+    if( ( size_t )CPU_COUNT( &allowed ) < budget ) budget = ( size_t )CPU_COUNT( &allowed );
+
+    for( int n = 0; n < BLAKE2_TREE_NODES; ++n )
+    {
+      if( ( ncpus[n] = blake2_tree_cpus( n, &allowed, &cpus[n] ) ) > 0 ) ++nodes;
+    }
+  }
+#endif
+
+  if( budget > T->nleaves ) budget = T->nleaves;
+
+  if( NULL == ( T->digests = ( uint8_t * )malloc( T->nleaves * BLAKE2B_OUTBYTES ) ) ||
+      NULL == ( T->order = ( size_t * )malloc( T->nleaves * sizeof( *T->order ) ) ) ||
+      NULL == ( node = ( int * )malloc( T->nleaves * sizeof( *node ) ) ) ||
+      NULL == ( W = ( blake2_tree_worker * )calloc( budget, sizeof( *W ) ) ) )
+    goto out;
+
+  for( size_t i = 0; i < T->nleaves; ++i )
+    node[i] = -1;
+
+#if defined(BLAKE2_HAVE_NUMA)
+  if( nodes > 1 )
+  {
+    blake2_tree_place( T, pagesize, node );
+
+    for( size_t i = 0; i < T->nleaves; ++i )
+    {
+      if( node[i] >= 0 && ncpus[node[i]] <= 0 ) node[i] = -1;
+    }
+  }
+#endif
+
+  /* Counting sort of the leaves into their groups */
+  for( size_t i = 0; i < T->nleaves; ++i )
+    ++T->groups[1 + node[i]].last;
+
+  for( size_t g = 0, at = 0; g <= BLAKE2_TREE_NODES; ++g )
+  {
+    const size_t n = T->groups[g].last;
+
+    T->groups[g].first = T->groups[g].next = T->groups[g].last = at;
+    at += n;
+  }
+
+  for( size_t i = 0; i < T->nleaves; ++i )
+    T->order[T->groups[1 + node[i]].last++] = i;
+
+#if defined(BLAKE2_HAVE_NUMA)
+  /* The calling thread is one worker; the others are pinned to the node whose leaves they take */
+  for( int n = 0; n < BLAKE2_TREE_NODES && nodes > 1; ++n )
+  {
+    const blake2_tree_group *G = &T->groups[1 + n];
+    size_t want = G->last - G->first < ( size_t )ncpus[n] ? G->last - G->first : ( size_t )ncpus[n];
+    pthread_attr_t attr;
+
+    if( 0 == want || pthread_attr_init( &attr ) != 0 ) continue;
+
+    pthread_attr_setaffinity_np( &attr, sizeof( cpus[n] ), &cpus[n] );
+
+    for( ; want > 0 && nworkers + 1 < budget; --want )
+    {
+      W[nworkers].T = T;
+      W[nworkers].group = 1 + n;
+
+      if( pthread_create( &W[nworkers].thread, &attr, blake2_tree_work, &W[nworkers] ) != 0 ) break;
+
+      ++nworkers;
+    }
+
+    pthread_attr_destroy( &attr );
+  }
+#endif
+
+#if defined(HAVE_PTHREAD_H)
+  for( ; nworkers + 1 < budget; ++nworkers )
+  {
+    W[nworkers].T = T;
+    W[nworkers].group = 0;
+
+    if( pthread_create( &W[nworkers].thread, NULL, blake2_tree_work, &W[nworkers] ) != 0 ) break;
+  }
+#endif
+
+  self.T = T;
+  self.group = 0;
+  blake2_tree_work( &self );
+
+#if defined(HAVE_PTHREAD_H)
+  for( size_t i = 0; i < nworkers; ++i )
+    pthread_join( W[i].thread, NULL );
+#endif
+
+  blake2_tree_param( P, T->outlen, T->keylen, ( uint32_t )T->leaf_length, 0, 1 );
+  blake2b_init_param( S, P );
+  S->outlen = T->outlen;
+  S->last_node = 1;
+
+  if( T->keylen ) blake2b_update( S, T->block, BLAKE2B_BLOCKBYTES );
+
+  blake2b_update( S, T->digests, T->nleaves * BLAKE2B_OUTBYTES );
+  ret = blake2b_final( S, out, outlen );
+out:
+  secure_zero_memory( T->block, sizeof( T->block ) );
+  free( W );
+  free( node );
+  free( T->order );
+  free( T->digests );
+  free( T );
+  return ret;
+}
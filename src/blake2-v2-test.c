@@ -0,0 +1,174 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define MSGBYTES 2100
+#define NSTATES 5
+
+static const size_t lengths[] = { 0, 1, 63, 64, 65, 127, 128, 129, 255, 256, 257, 511, 512, 513, 1024, 2100 };
+#define NLENGTHS ( sizeof( lengths ) / sizeof( lengths[0] ) )
+
+/* Feeds msg[0..inlen) in pieces of step bytes */
+#define FEED(update, S, msg, inlen, step) \
+  for( size_t off__ = 0; off__ < ( inlen ); off__ += ( step ) ) \
+    update( S, ( msg ) + off__, ( inlen ) - off__ < ( step ) ? ( inlen ) - off__ : ( step ) )
+
+static int test_serial( const uint8_t *key, const uint8_t *msg )
+{
+  for( size_t i = 0; i < NLENGTHS; ++i )
+    for( size_t keylen = 0; keylen <= BLAKE2B_KEYBYTES; keylen += 32 )
+      for( size_t step = 1; step <= 300; step += 73 )
+      {
+        uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+        blake2s_state_v2 SS[1];
+        blake2b_state_v2 SB[1];
+
+        if( keylen <= BLAKE2S_KEYBYTES )
+        {
+          if( keylen ) blake2s_v2_init_key( SS, BLAKE2S_OUTBYTES, key, keylen );
+          else blake2s_v2_init( SS, BLAKE2S_OUTBYTES );
+
+          FEED( blake2s_v2_update, SS, msg, lengths[i], step );
+          blake2s( a, msg, key, BLAKE2S_OUTBYTES, lengths[i], keylen );
+
+          if( blake2s_v2_final( SS, b, BLAKE2S_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+            return -1;
+        }
+
+        if( keylen ) blake2b_v2_init_key( SB, 40, key, keylen );
+        else blake2b_v2_init( SB, 40 );
+
+        FEED( blake2b_v2_update, SB, msg, lengths[i], step );
+        blake2b( a, msg, key, 40, lengths[i], keylen );
+
+        if( blake2b_v2_final( SB, b, 40 ) < 0 || 0 != memcmp( a, b, 40 ) )
+          return -1;
+      }
+
+  return 0;
+}
+
+static int test_param( const uint8_t *msg )
+{
+  blake2b_param P[1];
+  blake2b_state S[1];
+  blake2b_state_v2 V[1];
+  uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+  memset( P, 0, sizeof( P ) );
+  P->digest_length = 48;
+  P->fanout = 1;
+  P->depth = 1;
+  memset( P->salt, 0x5a, sizeof( P->salt ) );
+  memset( P->personal, 0xa5, sizeof( P->personal ) );
+
+  blake2b_init_param( S, P );
+  blake2b_update( S, msg, 1000 );
+  blake2b_final( S, a, 48 );
+
+  if( blake2b_v2_init_param( V, P ) < 0 || blake2b_v2_update( V, msg, 1000 ) < 0 ||
+      blake2b_v2_final( V, b, 48 ) < 0 || 0 != memcmp( a, b, 48 ) )
+    return -1;
+
+  return 0;
+}
+
+static int test_parallel( const uint8_t *key, const uint8_t *msg )
+{
+  for( size_t i = 0; i < NLENGTHS; ++i )
+    for( size_t step = 1; step <= 1100; step += 367 )
+    {
+      uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+      blake2sp_state_v2 SS[1];
+      blake2bp_state_v2 SB[1];
+
+      blake2sp_v2_init_key( SS, BLAKE2S_OUTBYTES, key, BLAKE2S_KEYBYTES );
+      FEED( blake2sp_v2_update, SS, msg, lengths[i], step );
+      blake2sp( a, msg, key, BLAKE2S_OUTBYTES, lengths[i], BLAKE2S_KEYBYTES );
+
+      if( blake2sp_v2_final( SS, b, BLAKE2S_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2S_OUTBYTES ) )
+        return -1;
+
+      blake2bp_v2_init( SB, BLAKE2B_OUTBYTES );
+      FEED( blake2bp_v2_update, SB, msg, lengths[i], step );
+      blake2bp( a, msg, NULL, BLAKE2B_OUTBYTES, lengths[i], 0 );
+
+      if( blake2bp_v2_final( SB, b, BLAKE2B_OUTBYTES ) < 0 || 0 != memcmp( a, b, BLAKE2B_OUTBYTES ) )
+        return -1;
+
+      /* The leaves are spent, so finishing again must be refused */
+      if( blake2sp_v2_final( SS, b, BLAKE2S_OUTBYTES ) == 0 || blake2bp_v2_final( SB, b, BLAKE2B_OUTBYTES ) == 0 )
+        return -1;
+    }
+
+  return 0;
+}
+
+static int test_alloc( const uint8_t *msg )
+{
+  blake2b_state_v2 *S = blake2b_v2_new( NSTATES );
+  blake2sp_state_v2 *P = blake2sp_v2_new( 2 );
+  int ret = -1;
+
+  if( NULL == S || NULL == P ) goto out;
+
+  if( sizeof( blake2b_state_v2 ) >= sizeof( blake2b_state ) ||
+      sizeof( blake2sp_state_v2 ) >= sizeof( blake2sp_state ) )
+    goto out;
+
+  for( size_t i = 0; i < NSTATES; ++i )
+  {
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+    if( 0 != ( ( uintptr_t )&S[i] & 63 ) ) goto out;
+
+    blake2b_v2_init( &S[i], 1 + i );
+    blake2b_v2_update( &S[i], msg, 100 * i );
+    blake2b( a, msg, NULL, 1 + i, 100 * i, 0 );
+
+    if( blake2b_v2_final( &S[i], b, 1 + i ) < 0 || 0 != memcmp( a, b, 1 + i ) ) goto out;
+  }
+
+  if( 0 != ( ( uintptr_t )&P[1] & 63 ) ) goto out;
+
+  ret = 0;
+out:
+  blake2_v2_free( S );
+  blake2_v2_free( P );
+  return ret;
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t msg[MSGBYTES];
+
+  for( size_t i = 0; i < sizeof( key ); ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t i = 0; i < sizeof( msg ); ++i )
+    msg[i] = ( uint8_t )( i * 7 + 3 );
+
+  if( test_serial( key, msg ) < 0 || test_param( msg ) < 0 ||
+      test_parallel( key, msg ) < 0 || test_alloc( msg ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
+  puts( "ok" );
+  return 0;
+}
@@ -0,0 +1,198 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+   Setup and allocation for the v2 states. Only update and final touch the
+   compression function, so they live with the per-ISA code; everything here
+   is plain word arithmetic on the parameter block.
+*/
+
+static const uint32_t blake2s_IV[8] =
+{
+  0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+  0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static const uint64_t blake2b_IV[8] =
+{
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+  0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+  0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+int blake2s_v2_init_param( blake2s_state_v2 *S, const blake2s_param *P )
+{
+  const uint8_t *p = ( const uint8_t * )P;
+
+  if( !P->digest_length || P->digest_length > BLAKE2S_OUTBYTES ) return -1;
+
+  memset( S, 0, sizeof( *S ) );
+
+  /* IV XOR ParamBlock */
+  for( size_t i = 0; i < 8; ++i )
+    S->h[i] = blake2s_IV[i] ^ load32( p + i * sizeof( S->h[i] ) );
+
+  S->outlen = P->digest_length;
+  return 0;
+}
+
+/* The padded key block just sits in the buffer until the message arrives */
+static int blake2s_v2_setup( blake2s_state_v2 *S, size_t outlen, const void *key, size_t keylen )
+{
+  blake2s_param P[1];
+
+  if( !outlen || outlen > BLAKE2S_OUTBYTES ) return -1;
+
+  if( ( NULL == key && keylen > 0 ) || keylen > BLAKE2S_KEYBYTES ) return -1;
+
+  memset( P, 0, sizeof( P ) );
+  P->digest_length = ( uint8_t ) outlen;
+  P->key_length    = ( uint8_t ) keylen;
+  P->fanout        = 1;
+  P->depth         = 1;
+
+  if( blake2s_v2_init_param( S, P ) < 0 ) return -1;
+
+  if( keylen > 0 )
+  {
+    memcpy( S->buf, key, keylen );
+    S->buflen = BLAKE2S_BLOCKBYTES;
+  }
+
+  return 0;
+}
+
+int blake2s_v2_init( blake2s_state_v2 *S, size_t outlen )
+{
+  return blake2s_v2_setup( S, outlen, NULL, 0 );
+}
+
+int blake2s_v2_init_key( blake2s_state_v2 *S, size_t outlen, const void *key, size_t keylen )
+{
+  if( !key || !keylen ) return -1;
+
+  return blake2s_v2_setup( S, outlen, key, keylen );
+}
+
+int blake2b_v2_init_param( blake2b_state_v2 *S, const blake2b_param *P )
+{
+  const uint8_t *p = ( const uint8_t * )P;
+
+  if( !P->digest_length || P->digest_length > BLAKE2B_OUTBYTES ) return -1;
+
+  memset( S, 0, sizeof( *S ) );
+
+  /* IV XOR ParamBlock */
+  for( size_t i = 0; i < 8; ++i )
+    S->h[i] = blake2b_IV[i] ^ load64( p + i * sizeof( S->h[i] ) );
+
+  S->outlen = P->digest_length;
+  return 0;
+}
+
+static int blake2b_v2_setup( blake2b_state_v2 *S, size_t outlen, const void *key, size_t keylen )
+{
+  blake2b_param P[1];
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  if( ( NULL == key && keylen > 0 ) || keylen > BLAKE2B_KEYBYTES ) return -1;
+
+  memset( P, 0, sizeof( P ) );
+  P->digest_length = ( uint8_t ) outlen;
+  P->key_length    = ( uint8_t ) keylen;
+  P->fanout        = 1;
+  P->depth         = 1;
+
+  if( blake2b_v2_init_param( S, P ) < 0 ) return -1;
+
+  if( keylen > 0 )
+  {
+    memcpy( S->buf, key, keylen );
+    S->buflen = BLAKE2B_BLOCKBYTES;
+  }
+
+  return 0;
+}
+
+int blake2b_v2_init( blake2b_state_v2 *S, size_t outlen )
+{
+  return blake2b_v2_setup( S, outlen, NULL, 0 );
+}
+
+int blake2b_v2_init_key( blake2b_state_v2 *S, size_t outlen, const void *key, size_t keylen )
+{
+  if( !key || !keylen ) return -1;
+
+  return blake2b_v2_setup( S, outlen, key, keylen );
+}
+
+
+static void *blake2_v2_alloc( size_t size, size_t count )
+{
+  void *p = NULL;
+
+  if( !count || count > SIZE_MAX / size ) return NULL;
+
+#if defined(_WIN32)
+  p = _aligned_malloc( size * count, 64 );
+#elif defined(HAVE_POSIX_MEMALIGN)
+  if( posix_memalign( &p, 64, size * count ) != 0 ) p = NULL;
+#else
+  p = malloc( size * count );
+#endif
+
+  if( p ) memset( p, 0, size * count );
+
+  return p;
+}
+
+blake2s_state_v2 *blake2s_v2_new( size_t count )
+{
+  return ( blake2s_state_v2 * )blake2_v2_alloc( sizeof( blake2s_state_v2 ), count );
+}
+
+blake2b_state_v2 *blake2b_v2_new( size_t count )
+{
+  return ( blake2b_state_v2 * )blake2_v2_alloc( sizeof( blake2b_state_v2 ), count );
+}
+
+blake2sp_state_v2 *blake2sp_v2_new( size_t count )
+{
+  return ( blake2sp_state_v2 * )blake2_v2_alloc( sizeof( blake2sp_state_v2 ), count );
+}
+
+blake2bp_state_v2 *blake2bp_v2_new( size_t count )
+{
+  return ( blake2bp_state_v2 * )blake2_v2_alloc( sizeof( blake2bp_state_v2 ), count );
+}
+
+void blake2_v2_free( void *p )
+{
+#if defined(_WIN32)
+  _aligned_free( p );
+#else
+  free( p );
+#endif
+}
@@ -49,6 +49,9 @@ extern "C" {
 #define inline __inline
 #endif
 
+  struct iovec;
+  struct msghdr;
+
   enum blake2s_constant
   {
     BLAKE2S_BLOCKBYTES = 64,
@@ -67,6 +70,36 @@ extern "C" {
     BLAKE2B_PERSONALBYTES = 16
   };
 
+  // Largest records written by the _export functions
+  enum blake2_export_constant
+  {
+    BLAKE2S_EXPORTBYTES  = 8 + 12 * 4 + 2 * BLAKE2S_BLOCKBYTES,
+    BLAKE2B_EXPORTBYTES  = 8 + 12 * 8 + 2 * BLAKE2B_BLOCKBYTES,
+    BLAKE2SP_EXPORTBYTES = 8 + 9 * BLAKE2S_EXPORTBYTES + 8 * BLAKE2S_BLOCKBYTES,
+    BLAKE2BP_EXPORTBYTES = 8 + 5 * BLAKE2B_EXPORTBYTES + 4 * BLAKE2B_BLOCKBYTES
+  };
+
+  // Per-file digests in a manifest are BLAKE2bp of this length
+  enum blake2_manifest_constant
+  {
+    BLAKE2_MANIFEST_DIGESTBYTES = 32
+  };
+
+  // Chunk IDs are BLAKE2b of this length; the sizes are the defaults for zero blake2_chunk_param fields
+  enum blake2_chunk_constant
+  {
+    BLAKE2_CHUNK_DIGESTBYTES = 32,
+    BLAKE2_CHUNK_MINBYTES    = 2 * 1024,
+    BLAKE2_CHUNK_AVGBYTES    = 8 * 1024,
+    BLAKE2_CHUNK_MAXBYTES    = 64 * 1024
+  };
+
+  // Flags for the _file_direct functions
+  enum blake2_direct_flag
+  {
+    BLAKE2_DIRECT_PREAD = 1
+  };
+
 #pragma pack(push, 1)
   typedef struct __blake2s_param
   {
@@ -139,28 +172,425 @@ extern "C" {
   } blake2bp_state;
 #pragma pack(pop)
 
+#if defined(_MSC_VER)
+#define BLAKE2_ALIGN(n) __declspec(align(n))
+#else
+#define BLAKE2_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+  /*
+     Opt-in v2 layout: naturally aligned words on a cache line boundary and a
+     one-block buffer, about two thirds the size of the packed states. Used
+     only through the blake2*_v2_ functions, never mixed with the packed states.
+  */
+  typedef struct __blake2s_state_v2
+  {
+    BLAKE2_ALIGN( 64 ) uint32_t h[8];
+    uint32_t t[2];
+    uint32_t f[2];
+    uint8_t  buf[BLAKE2S_BLOCKBYTES];
+    uint32_t buflen;
+    uint8_t  outlen;
+    uint8_t  last_node;
+  } blake2s_state_v2;
+
+  typedef struct __blake2b_state_v2
+  {
+    BLAKE2_ALIGN( 64 ) uint64_t h[8];
+    uint64_t t[2];
+    uint64_t f[2];
+    uint8_t  buf[BLAKE2B_BLOCKBYTES];
+    uint32_t buflen;
+    uint8_t  outlen;
+    uint8_t  last_node;
+  } blake2b_state_v2;
+
+  // The root node is only needed in final and is rebuilt there from outlen and keylen
+  typedef struct __blake2sp_state_v2
+  {
+    blake2s_state_v2 S[8];
+    uint8_t  buf[8 * BLAKE2S_BLOCKBYTES];
+    uint32_t buflen;
+    uint8_t  outlen;
+    uint8_t  keylen;
+  } blake2sp_state_v2;
+
+  typedef struct __blake2bp_state_v2
+  {
+    blake2b_state_v2 S[4];
+    uint8_t  buf[4 * BLAKE2B_BLOCKBYTES];
+    uint32_t buflen;
+    uint8_t  outlen;
+    uint8_t  keylen;
+  } blake2bp_state_v2;
+
+  // One pending blake2b_update call; see blake2b_update_multi
+  typedef struct __blake2b_update_item
+  {
+    blake2b_state *S;
+    const uint8_t *in;
+    size_t inlen;
+  } blake2b_update_item;
+
+  // One keyed BLAKE2s MAC to check: key may differ per item, tags share one length
+  typedef struct __blake2s_mac_item
+  {
+    const uint8_t *key;
+    size_t keylen;
+    const uint8_t *in;
+    size_t inlen;
+    const uint8_t *tag;
+  } blake2s_mac_item;
+
+  // Keyed midstate: the chaining value after the key block, and the MAC of the empty message
+  typedef struct __blake2s_prepared_key
+  {
+    uint32_t h[8];
+    uint8_t  empty[BLAKE2S_OUTBYTES];
+    uint8_t  outlen;
+    uint8_t  last_node;
+  } blake2s_prepared_key;
+
+  typedef struct __blake2b_prepared_key
+  {
+    uint64_t h[8];
+    uint8_t  empty[BLAKE2B_OUTBYTES];
+    uint8_t  outlen;
+    uint8_t  last_node;
+  } blake2b_prepared_key;
+
+  typedef struct __blake2sp_prepared_key
+  {
+    blake2s_prepared_key S[8][1];
+    uint8_t  keylen;
+    uint8_t  outlen;
+  } blake2sp_prepared_key;
+
+  typedef struct __blake2bp_prepared_key
+  {
+    blake2b_prepared_key S[4][1];
+    uint8_t  keylen;
+    uint8_t  outlen;
+  } blake2bp_prepared_key;
+
+  // HMAC (RFC 2104) over unkeyed BLAKE2: the inner and outer pad blocks, already compressed
+  typedef struct __blake2s_hmac_key
+  {
+    blake2s_prepared_key I[1];
+    blake2s_prepared_key O[1];
+  } blake2s_hmac_key;
+
+  typedef struct __blake2b_hmac_key
+  {
+    blake2b_prepared_key I[1];
+    blake2b_prepared_key O[1];
+  } blake2b_hmac_key;
+
+  typedef struct __blake2s_hmac_state
+  {
+    blake2s_state S[1];
+    blake2s_prepared_key O[1];
+  } blake2s_hmac_state;
+
+  typedef struct __blake2b_hmac_state
+  {
+    blake2b_state S[1];
+    blake2b_prepared_key O[1];
+  } blake2b_hmac_state;
+
+  // Bounded LRU of prepared blake2b keys, looked up by caller-chosen key id
+  typedef struct __blake2b_key_cache blake2b_key_cache;
+
+  // Sees each manifest entry in path order; returning a negative value stops the scan
+  typedef int ( *blake2_manifest_fn )( void *ctx, const char *path, uint64_t size, const uint8_t *digest );
+
+  // Budgets for blake2b_scrub; a zero field leaves that resource unbounded
+  typedef struct __blake2_scrub_limits
+  {
+    uint64_t bytes_per_sec;
+    uint32_t cpu_percent; // Share of one core, 1 to 100
+  } blake2_scrub_limits;
+
+  typedef struct __blake2_scrub_progress
+  {
+    uint64_t done;
+    uint64_t total;      // 0 when fd is not a regular file
+    uint64_t elapsed_ns;
+    uint64_t rate;       // Bytes per second since the start
+    uint64_t eta_ns;     // UINT64_MAX while unknown
+  } blake2_scrub_progress;
+
+  // Sees the scrub progress about once a second and once at the end; returning a negative value stops the scrub
+  typedef int ( *blake2_scrub_fn )( void *ctx, const blake2_scrub_progress *P );
+
+  typedef struct __blake2_chunk_param
+  {
+    uint32_t min_size;
+    uint32_t avg_size;
+    uint32_t max_size;
+  } blake2_chunk_param;
+
+  typedef struct __blake2_chunk
+  {
+    uint64_t offset;
+    uint32_t length;
+    uint8_t  digest[BLAKE2_CHUNK_DIGESTBYTES];
+  } blake2_chunk;
+
+  // Sees each chunk in offset order; returning a negative value stops the chunking
+  typedef int ( *blake2_chunk_fn )( void *ctx, const blake2_chunk *C );
+
+  typedef enum
+  {
+    BLAKE2_DIGEST_S  = 0,
+    BLAKE2_DIGEST_B  = 1,
+    BLAKE2_DIGEST_SP = 2,
+    BLAKE2_DIGEST_BP = 3
+  } blake2_digest_kind;
+
+  // One of several initialized states fed the same input by blake2_update_digests
+  typedef struct __blake2_digest
+  {
+    blake2_digest_kind kind;
+    union
+    {
+      blake2s_state  *s;
+      blake2b_state  *b;
+      blake2sp_state *sp;
+      blake2bp_state *bp;
+    } S;
+  } blake2_digest;
+
+  // Worker pool fed by blake2_queue_submit
+  typedef struct __blake2_queue blake2_queue;
+
+  // One hashing job; iov, the buffers it points to, key and out must stay valid until the job completes
+  typedef struct __blake2_job
+  {
+    blake2_digest_kind kind;
+    const struct iovec *iov;
+    int iovcnt;
+    const void *key;
+    size_t keylen;
+    uint8_t *out;
+    size_t outlen;
+    void *user;   // Not touched by the queue
+    int status;   // Written on completion: 0, or -1 for bad parameters
+  } blake2_job;
+
+  // Runs on a worker thread once the job's digest and status are written
+  typedef void ( *blake2_job_fn )( void *ctx, blake2_job *J );
+
+  // Hashing service shared by local processes over a Unix socket, and a connection to one
+  typedef struct __blake2_daemon blake2_daemon;
+  typedef struct __blake2_client blake2_client;
+
+  // One completed blake2_client_submit request
+  typedef struct __blake2_client_result
+  {
+    uint64_t tag;
+    int      status; // 0, or -1 for bad parameters or a range outside the arena
+    uint8_t  outlen;
+    uint8_t  digest[BLAKE2B_OUTBYTES];
+  } blake2_client_result;
+
+  enum blake2b_drbg_constant
+  {
+    BLAKE2B_DRBG_BUFBLOCKS = 16,
+    BLAKE2B_DRBG_BUFBYTES  = BLAKE2B_DRBG_BUFBLOCKS * BLAKE2B_OUTBYTES
+  };
+
+  typedef struct __blake2b_drbg_state
+  {
+    blake2b_state T[1];     // keyed template at node_offset 0
+    uint8_t  key[BLAKE2B_KEYBYTES];
+    uint8_t  keylen;
+    uint64_t counter;       // node_offset of the next block to generate
+    uint64_t fork_id;       // fork generation the state was seeded in
+    uint8_t  buf[BLAKE2B_DRBG_BUFBYTES];
+    uint32_t buflen;        // unread bytes at the end of buf
+  } blake2b_drbg_state;
+
+  enum blake2_argon2_constant
+  {
+    BLAKE2_ARGON2_VERSION     = 0x13,
+    BLAKE2_ARGON2_BLOCKBYTES  = 1024,
+    BLAKE2_ARGON2_SYNC_POINTS = 4
+  };
+
+  typedef enum
+  {
+    BLAKE2_ARGON2D  = 0,
+    BLAKE2_ARGON2I  = 1,
+    BLAKE2_ARGON2ID = 2
+  } blake2_argon2_type;
+
+  typedef struct __blake2_argon2_param
+  {
+    const uint8_t *pwd;
+    uint32_t pwdlen;
+    const uint8_t *salt;     // at least 8 bytes
+    uint32_t saltlen;
+    const uint8_t *secret;   // optional
+    uint32_t secretlen;
+    const uint8_t *ad;       // optional
+    uint32_t adlen;
+    uint32_t t_cost;         // passes
+    uint32_t m_cost;         // memory in KiB, at least 8 * lanes
+    uint32_t lanes;
+    uint32_t type;           // blake2_argon2_type
+  } blake2_argon2_param;
+
   // Streaming API
   BLAKE2_API int blake2s_init( blake2s_state *S, size_t outlen );
   BLAKE2_API int blake2s_init_key( blake2s_state *S, size_t outlen, const void *key, size_t keylen );
   BLAKE2_API int blake2s_init_param( blake2s_state *S, const blake2s_param *P );
   BLAKE2_API int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen );
   BLAKE2_API int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen );
+  // Digest of the input so far without finishing S; clone copies only the live part of the buffer
+  BLAKE2_API int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2s_clone( blake2s_state *dst, const blake2s_state *src );
+  // Versioned, endian-neutral encoding holding only the live buffer bytes; export returns its length,
+  // or with out == NULL the length it needs, and import accepts exactly one record
+  BLAKE2_API int blake2s_export( const blake2s_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2s_import( blake2s_state *S, const uint8_t *in, size_t inlen );
+  // Scatter-gather update: hashes iov[0] || ... || iov[iovcnt - 1] like one blake2s_update
+  BLAKE2_API int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  // Hashes the first len bytes of msg->msg_iov, len being what recvmsg returned; -1 without sys/socket.h
+  BLAKE2_API int blake2s_update_msg( blake2s_state *S, const struct msghdr *msg, size_t len );
+  // memcpy( dst, src, len ) and update( S, src, len ) in one pass over memory; dst and src must not overlap
+  BLAKE2_API int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  // Sets bit i % 8 of bitmap[i / 8] iff item i's tag matches, without branching on tag contents
+  BLAKE2_API int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
 
   BLAKE2_API int blake2b_init( blake2b_state *S, size_t outlen );
   BLAKE2_API int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t keylen );
   BLAKE2_API int blake2b_init_param( blake2b_state *S, const blake2b_param *P );
   BLAKE2_API int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  BLAKE2_API int blake2b_update_msg( blake2b_state *S, const struct msghdr *msg, size_t len );
+  BLAKE2_API int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
+  // Same result as blake2b_update( items[i].S, items[i].in, items[i].inlen ) for each i; the states must be distinct
+  BLAKE2_API int blake2b_update_multi( const blake2b_update_item *items, size_t count );
   BLAKE2_API int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2b_clone( blake2b_state *dst, const blake2b_state *src );
+  BLAKE2_API int blake2b_export( const blake2b_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2b_import( blake2b_state *S, const uint8_t *in, size_t inlen );
+  // Hashes prefix || suffix[i] for count suffixes of suffixlen bytes, S holding the prefix
+  BLAKE2_API int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
 
   BLAKE2_API int blake2sp_init( blake2sp_state *S, size_t outlen );
   BLAKE2_API int blake2sp_init_key( blake2sp_state *S, size_t outlen, const void *key, size_t keylen );
   BLAKE2_API int blake2sp_update( blake2sp_state *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2sp_updatev( blake2sp_state *S, const struct iovec *iov, int iovcnt );
+  BLAKE2_API int blake2sp_update_msg( blake2sp_state *S, const struct msghdr *msg, size_t len );
+  BLAKE2_API int blake2sp_update_copy( blake2sp_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   BLAKE2_API int blake2sp_final( blake2sp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2sp_final_peek( const blake2sp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2sp_clone( blake2sp_state *dst, const blake2sp_state *src );
+  BLAKE2_API int blake2sp_export( const blake2sp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2sp_import( blake2sp_state *S, const uint8_t *in, size_t inlen );
 
   BLAKE2_API int blake2bp_init( blake2bp_state *S, size_t outlen );
   BLAKE2_API int blake2bp_init_key( blake2bp_state *S, size_t outlen, const void *key, size_t keylen );
   BLAKE2_API int blake2bp_update( blake2bp_state *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2bp_updatev( blake2bp_state *S, const struct iovec *iov, int iovcnt );
+  BLAKE2_API int blake2bp_update_msg( blake2bp_state *S, const struct msghdr *msg, size_t len );
+  BLAKE2_API int blake2bp_update_copy( blake2bp_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   BLAKE2_API int blake2bp_final( blake2bp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2bp_final_peek( const blake2bp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2bp_clone( blake2bp_state *dst, const blake2bp_state *src );
+  BLAKE2_API int blake2bp_export( const blake2bp_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2bp_import( blake2bp_state *S, const uint8_t *in, size_t inlen );
+
+  // Raw compression of nblocks blocks into h: t advances by one block before each of them but the
+  // last, which counts lastlen bytes (0 to a whole block, zero-padded by the caller) so a message can
+  // be finished with its real length; f (zero if NULL) is applied to the last block only
+  BLAKE2_API int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
+  BLAKE2_API int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
+
+  // v2 states; the _new helpers return count zeroed, cache line aligned states, released with blake2_v2_free
+  BLAKE2_API int blake2s_v2_init( blake2s_state_v2 *S, size_t outlen );
+  BLAKE2_API int blake2s_v2_init_key( blake2s_state_v2 *S, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2s_v2_init_param( blake2s_state_v2 *S, const blake2s_param *P );
+  BLAKE2_API int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+
+  BLAKE2_API int blake2b_v2_init( blake2b_state_v2 *S, size_t outlen );
+  BLAKE2_API int blake2b_v2_init_key( blake2b_state_v2 *S, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2b_v2_init_param( blake2b_state_v2 *S, const blake2b_param *P );
+  BLAKE2_API int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+
+  BLAKE2_API int blake2sp_v2_init( blake2sp_state_v2 *S, size_t outlen );
+  BLAKE2_API int blake2sp_v2_init_key( blake2sp_state_v2 *S, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2sp_v2_update( blake2sp_state_v2 *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2sp_v2_final( blake2sp_state_v2 *S, uint8_t *out, size_t outlen );
+
+  BLAKE2_API int blake2bp_v2_init( blake2bp_state_v2 *S, size_t outlen );
+  BLAKE2_API int blake2bp_v2_init_key( blake2bp_state_v2 *S, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2bp_v2_update( blake2bp_state_v2 *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2bp_v2_final( blake2bp_state_v2 *S, uint8_t *out, size_t outlen );
+
+  BLAKE2_API blake2s_state_v2 *blake2s_v2_new( size_t count );
+  BLAKE2_API blake2b_state_v2 *blake2b_v2_new( size_t count );
+  BLAKE2_API blake2sp_state_v2 *blake2sp_v2_new( size_t count );
+  BLAKE2_API blake2bp_state_v2 *blake2bp_v2_new( size_t count );
+  BLAKE2_API void blake2_v2_free( void *p );
+
+  // Prepared keys: init from a stored midstate instead of compressing the key block every time
+  BLAKE2_API int blake2s_prepare_key( blake2s_prepared_key *K, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2s_prepare_key_param( blake2s_prepared_key *K, const blake2s_param *P, const void *key );
+  BLAKE2_API int blake2s_prepare_state( blake2s_prepared_key *K, const blake2s_state *S );
+  BLAKE2_API int blake2s_init_prepared( blake2s_state *S, const blake2s_prepared_key *K );
+
+  BLAKE2_API int blake2b_prepare_key( blake2b_prepared_key *K, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2b_prepare_key_param( blake2b_prepared_key *K, const blake2b_param *P, const void *key );
+  BLAKE2_API int blake2b_prepare_state( blake2b_prepared_key *K, const blake2b_state *S );
+  BLAKE2_API int blake2b_init_prepared( blake2b_state *S, const blake2b_prepared_key *K );
+
+  BLAKE2_API int blake2sp_prepare_key( blake2sp_prepared_key *K, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2sp_init_prepared( blake2sp_state *S, const blake2sp_prepared_key *K );
+
+  BLAKE2_API int blake2bp_prepare_key( blake2bp_prepared_key *K, size_t outlen, const void *key, size_t keylen );
+  BLAKE2_API int blake2bp_init_prepared( blake2bp_state *S, const blake2bp_prepared_key *K );
+
+  // Not thread-safe; a hit moves the entry to the front, a put into a full cache evicts the least recently used
+  BLAKE2_API blake2b_key_cache *blake2b_key_cache_new( size_t capacity );
+  BLAKE2_API void blake2b_key_cache_free( blake2b_key_cache *C );
+  BLAKE2_API int blake2b_key_cache_put( blake2b_key_cache *C, uint64_t id, const blake2b_prepared_key *K );
+  BLAKE2_API int blake2b_key_cache_remove( blake2b_key_cache *C, uint64_t id );
+  BLAKE2_API int blake2b_key_cache_init( blake2b_key_cache *C, blake2b_state *S, uint64_t id );
+
+  // HMAC-BLAKE2s/b and HKDF (RFC 5869); outputs are always the full digest length
+  BLAKE2_API int blake2s_hmac_key_init( blake2s_hmac_key *K, const void *key, size_t keylen );
+  BLAKE2_API int blake2s_hmac_init( blake2s_hmac_state *S, const blake2s_hmac_key *K );
+  BLAKE2_API int blake2s_hmac_update( blake2s_hmac_state *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2s_hmac_final( blake2s_hmac_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2s_hmac( uint8_t *out, const void *in, const void *key, size_t inlen, size_t keylen );
+  BLAKE2_API int blake2s_hkdf_extract( uint8_t *prk, const void *salt, size_t saltlen, const void *ikm, size_t ikmlen );
+  BLAKE2_API int blake2s_hkdf_expand( uint8_t *out, size_t outlen, const blake2s_hmac_key *K, const void *info, size_t infolen );
+  // Expands count keys of outlen bytes from one PRK, the i-th with the infolen bytes at infos + i * infolen
+  BLAKE2_API int blake2s_hkdf_expand_batch( uint8_t *out, size_t outlen, const blake2s_hmac_key *K, const void *infos, size_t infolen, size_t count );
+
+  BLAKE2_API int blake2b_hmac_key_init( blake2b_hmac_key *K, const void *key, size_t keylen );
+  BLAKE2_API int blake2b_hmac_init( blake2b_hmac_state *S, const blake2b_hmac_key *K );
+  BLAKE2_API int blake2b_hmac_update( blake2b_hmac_state *S, const uint8_t *in, size_t inlen );
+  BLAKE2_API int blake2b_hmac_final( blake2b_hmac_state *S, uint8_t *out, size_t outlen );
+  BLAKE2_API int blake2b_hmac( uint8_t *out, const void *in, const void *key, size_t inlen, size_t keylen );
+  BLAKE2_API int blake2b_hkdf_extract( uint8_t *prk, const void *salt, size_t saltlen, const void *ikm, size_t ikmlen );
+  BLAKE2_API int blake2b_hkdf_expand( uint8_t *out, size_t outlen, const blake2b_hmac_key *K, const void *info, size_t infolen );
+  BLAKE2_API int blake2b_hkdf_expand_batch( uint8_t *out, size_t outlen, const blake2b_hmac_key *K, const void *infos, size_t infolen, size_t count );
+
+  // Same as updating each state with in[0..inlen), reading in only once; the states must be distinct
+  BLAKE2_API int blake2_update_digests( const blake2_digest *D, size_t count, const void *in, size_t inlen );
+
+  // Keystream generator: block i is the keyed BLAKE2b-512 of the empty message at node_offset i
+  // The buffer is per state, so each thread keeps its own state; large fills are split over OpenMP threads
+  BLAKE2_API int blake2b_drbg_init( blake2b_drbg_state *S, const void *key, size_t keylen );
+  BLAKE2_API int blake2b_drbg_reseed( blake2b_drbg_state *S, const void *seed, size_t seedlen );
+  BLAKE2_API int blake2b_drbg_fill( blake2b_drbg_state *S, void *out, size_t outlen );
 
   // Simple API
   BLAKE2_API int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
@@ -169,6 +599,77 @@ extern "C" {
   BLAKE2_API int blake2sp( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
   BLAKE2_API int blake2bp( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 
+  // Hash everything readable from fd: regular files are read from offset 0 with read-ahead hints (and
+  // mapped when sealed against shrinking), pipes and other streams from the current position to end of file
+  BLAKE2_API int blake2s_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen );
+  BLAKE2_API int blake2b_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen );
+  BLAKE2_API int blake2sp_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen );
+  BLAKE2_API int blake2bp_file( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen );
+  // Cold reads: several O_DIRECT reads stay in flight while completed buffers are hashed in file order,
+  // through io_uring or, where it is refused or flags has BLAKE2_DIRECT_PREAD, a pread thread
+  BLAKE2_API int blake2s_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags );
+  BLAKE2_API int blake2b_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags );
+  BLAKE2_API int blake2sp_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags );
+  BLAKE2_API int blake2bp_file_direct( uint8_t *out, size_t outlen, const char *path, const void *key, size_t keylen, unsigned flags );
+  // Copies in_fd to out_fd until end of file and hashes the bytes into S on the way; with splice and tee
+  // the forwarded data never passes through user memory, only the copy that is hashed does
+  BLAKE2_API int blake2b_forward( blake2b_state *S, int out_fd, int in_fd );
+  BLAKE2_API int blake2bp_forward( blake2bp_state *S, int out_fd, int in_fd );
+  // Background re-verification: hashes fd like blake2b_file while pacing reads to the byte rate and
+  // CPU share in limits, yielding between chunks and dropping scrubbed pages from the page cache
+  BLAKE2_API int blake2b_scrub( uint8_t *out, size_t outlen, int fd, const void *key, size_t keylen, const blake2_scrub_limits *limits, blake2_scrub_fn fn, void *ctx );
+
+  // Digest of every regular file below root: the sorted (path, size, BLAKE2bp digest) list folded into
+  // BLAKE2b. Files whose (dev, inode, size, mtime) match a record in cache_path are not read again, and
+  // the cache is rewritten afterwards; cache_path and fn may be NULL
+  BLAKE2_API int blake2_manifest( uint8_t *out, size_t outlen, const char *root, const char *cache_path, blake2_manifest_fn fn, void *ctx );
+
+  // Content-defined chunking for deduplication: FastCDC cut points from a gear hash, each chunk hashed
+  // to BLAKE2b-256 as it is found. Cut points depend only on the data and P, never on the thread count
+  BLAKE2_API int blake2b_chunk( const void *in, size_t inlen, const blake2_chunk_param *P, blake2_chunk_fn fn, void *ctx );
+
+  // BLAKE2b tree over a large in-memory buffer: contiguous leaves of leaf_length bytes (a multiple of the
+  // page size, 0 for 2 MiB) are hashed by threads pinned to the NUMA node holding them, and the leaf
+  // digests are combined by a root node. The digest depends on leaf_length and differs from blake2bp
+  BLAKE2_API int blake2b_tree( uint8_t *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen, size_t leaf_length );
+
+  // Asynchronous hashing on threads worker threads, with at most depth jobs submitted and not yet
+  // reaped. Pending BLAKE2b jobs are run together in the lanes of blake2b_update_multi. Completed jobs
+  // go to fn when it is not NULL; otherwise they wait in a completion ring for _reap or _wait, and the
+  // eventfd from _fd (-1 without eventfd) counts them for event loops. _submit fails with EAGAIN when
+  // the queue is full; _destroy finishes every submitted job first
+  BLAKE2_API blake2_queue *blake2_queue_create( unsigned threads, size_t depth, blake2_job_fn fn, void *ctx );
+  BLAKE2_API int blake2_queue_submit( blake2_queue *Q, blake2_job *J );
+  BLAKE2_API size_t blake2_queue_reap( blake2_queue *Q, blake2_job **jobs, size_t max );
+  BLAKE2_API size_t blake2_queue_wait( blake2_queue *Q, blake2_job **jobs, size_t max );
+  BLAKE2_API int blake2_queue_fd( const blake2_queue *Q );
+  BLAKE2_API void blake2_queue_destroy( blake2_queue *Q );
+
+  // The daemon listens on path and feeds the requests of every client into one blake2_queue of threads
+  // workers (0 for one per CPU), so small messages from different processes share the SIMD lanes.
+  // _run serves until _stop, which may be called from another thread or a signal handler
+  BLAKE2_API blake2_daemon *blake2_daemon_create( const char *path, unsigned threads );
+  BLAKE2_API int blake2_daemon_run( blake2_daemon *D );
+  BLAKE2_API void blake2_daemon_stop( blake2_daemon *D );
+  BLAKE2_API void blake2_daemon_destroy( blake2_daemon *D );
+  // A client shares an arena of arena_bytes with the daemon: data placed there is hashed by offset and
+  // length, with requests and results passed through lock-free rings of depth slots in the same mapping
+  // and the socket only used to wake a sleeping side. A client must be used by one thread at a time;
+  // _submit fails with EAGAIN while depth requests are unreaped, and _wait returns -1 once the daemon
+  // is gone. _hash is a synchronous round trip through the start of the arena, for idle clients only.
+  // The mapping is a memfd sealed against shrinking; where that is unavailable _open fails with ENOSYS
+  BLAKE2_API blake2_client *blake2_client_open( const char *path, size_t arena_bytes, size_t depth );
+  BLAKE2_API uint8_t *blake2_client_arena( blake2_client *C, size_t *arena_bytes );
+  BLAKE2_API int blake2_client_submit( blake2_client *C, blake2_digest_kind kind, size_t offset, size_t length, const void *key, size_t keylen, size_t outlen, uint64_t tag );
+  BLAKE2_API size_t blake2_client_reap( blake2_client *C, blake2_client_result *R, size_t max );
+  BLAKE2_API int blake2_client_wait( blake2_client *C, blake2_client_result *R, size_t max );
+  BLAKE2_API int blake2_client_hash( blake2_client *C, blake2_digest_kind kind, uint8_t *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
+  BLAKE2_API void blake2_client_close( blake2_client *C );
+
+  // Argon2 (RFC 9106) and its variable-length hash H'
+  BLAKE2_API int blake2b_long( uint8_t *out, size_t outlen, const void *in, size_t inlen );
+  BLAKE2_API int blake2_argon2( uint8_t *out, size_t outlen, const blake2_argon2_param *P );
+
   static inline int blake2( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
   {
     return blake2b( out, in, key, outlen, inlen, keylen );
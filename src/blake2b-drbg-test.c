@@ -0,0 +1,105 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blake2.h"
+
+#define STREAM_BLOCKS 2100
+
+static int keystream_block( uint8_t out[BLAKE2B_OUTBYTES], const uint8_t *key, size_t keylen, uint64_t offset )
+{
+  blake2b_param P[1];
+  blake2b_state S[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  memset( P, 0, sizeof( P ) );
+  P->digest_length = BLAKE2B_OUTBYTES;
+  P->key_length = ( uint8_t ) keylen;
+  P->fanout = 1;
+  P->depth = 1;
+
+  for( size_t i = 0; i < 8; ++i )
+    ( ( uint8_t * )&P->node_offset )[i] = ( uint8_t )( offset >> ( 8 * i ) );
+
+  memset( block, 0, sizeof( block ) );
+  memcpy( block, key, keylen );
+
+  if( blake2b_init_param( S, P ) < 0 ) return -1;
+  if( blake2b_update( S, block, sizeof( block ) ) < 0 ) return -1;
+  return blake2b_final( S, out, BLAKE2B_OUTBYTES );
+}
+
+int main( int argc, char **argv )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t *whole = malloc( STREAM_BLOCKS * BLAKE2B_OUTBYTES );
+  uint8_t *chunked = malloc( STREAM_BLOCKS * BLAKE2B_OUTBYTES );
+  uint8_t block[BLAKE2B_OUTBYTES];
+  blake2b_drbg_state S[1];
+
+  if( !whole || !chunked ) goto fail;
+
+  for( size_t i = 0; i < BLAKE2B_KEYBYTES; ++i )
+    key[i] = ( uint8_t )i;
+
+  for( size_t keylen = 1; keylen <= BLAKE2B_KEYBYTES; keylen += 21 )
+  {
+    const size_t total = STREAM_BLOCKS * BLAKE2B_OUTBYTES;
+
+    /* One bulk fill, large enough to take the threaded path */
+    if( blake2b_drbg_init( S, key, keylen ) < 0 ||
+        blake2b_drbg_fill( S, whole, total ) < 0 )
+      goto fail;
+
+    for( size_t i = 0; i < STREAM_BLOCKS; i += 97 )
+    {
+      if( keystream_block( block, key, keylen, i ) < 0 ||
+          0 != memcmp( block, whole + i * BLAKE2B_OUTBYTES, BLAKE2B_OUTBYTES ) )
+        goto fail;
+    }
+
+    /* The stream must not depend on how it is read */
+    if( blake2b_drbg_init( S, key, keylen ) < 0 ) goto fail;
+
+    for( size_t off = 0, step = 1; off < total; off += step, step = step * 3 % 1031 + 1 )
+    {
+      if( step > total - off ) step = total - off;
+      if( blake2b_drbg_fill( S, chunked + off, step ) < 0 ) goto fail;
+    }
+
+    if( 0 != memcmp( whole, chunked, total ) ) goto fail;
+
+    /* Reseeding is deterministic and leaves the old stream */
+    if( blake2b_drbg_init( S, key, keylen ) < 0 ||
+        blake2b_drbg_reseed( S, "seed", 4 ) < 0 ||
+        blake2b_drbg_fill( S, chunked, total ) < 0 ||
+        0 == memcmp( whole, chunked, BLAKE2B_OUTBYTES ) )
+      goto fail;
+
+    if( blake2b_drbg_init( S, key, keylen ) < 0 ||
+        blake2b_drbg_reseed( S, "seed", 4 ) < 0 ||
+        blake2b_drbg_fill( S, whole, total ) < 0 ||
+        0 != memcmp( whole, chunked, total ) )
+      goto fail;
+  }
+
+  free( whole );
+  free( chunked );
+  puts( "ok" );
+  return 0;
+fail:
+  free( whole );
+  free( chunked );
+  puts( "error" );
+  return -1;
+}
@@ -0,0 +1,202 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+#if defined(HAVE_PTHREAD_ATFORK)
+#include <pthread.h>
+#elif defined(HAVE_GETPID)
+#include <unistd.h>
+#endif
+
+/* Below this many blocks a fill is not worth waking up the thread team */
+#define PARALLEL_BLOCKS 1024
+
+#if defined(HAVE_PTHREAD_ATFORK)
+static volatile uint64_t fork_generation = 1;
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+static void blake2b_drbg_atfork_child( void )
+{
+  ++fork_generation;
+}
+
+static void blake2b_drbg_atfork_register( void )
+{
+  pthread_atfork( NULL, NULL, blake2b_drbg_atfork_child );
+}
+#endif
+
+/* Identifies the process image a state was seeded in, so a forked child cannot replay its parent's stream */
+static uint64_t blake2b_drbg_fork_id( void )
+{
+#if defined(HAVE_PTHREAD_ATFORK)
+  pthread_once( &fork_once, blake2b_drbg_atfork_register );
+  return fork_generation;
+#elif defined(HAVE_GETPID)
+  return ( uint64_t )getpid();
+#else
+  return 0;
+#endif
+}
+
+/* Keyed state at node_offset 0 with the key block absorbed; node_depth separates reseeding from output */
+static int blake2b_drbg_init_keyed( blake2b_state *S, const uint8_t *key, uint8_t keylen, uint8_t node_depth )
+{
+  blake2b_param P[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  P->digest_length = BLAKE2B_OUTBYTES;
+  P->key_length = keylen;
+  P->fanout = 1;
+  P->depth = 1;
+  store32( &P->leaf_length, 0 );
+  store64( &P->node_offset, 0 );
+  P->node_depth = node_depth;
+  P->inner_length = 0;
+  memset( P->reserved, 0, sizeof( P->reserved ) );
+  memset( P->salt, 0, sizeof( P->salt ) );
+  memset( P->personal, 0, sizeof( P->personal ) );
+
+  if( blake2b_init_param( S, P ) < 0 ) return -1;
+
+  memset( block, 0, BLAKE2B_BLOCKBYTES );
+  memcpy( block, key, keylen );
+  blake2b_update( S, block, BLAKE2B_BLOCKBYTES );
+  secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
+  return 0;
+}
+
+/* Rebuilds the template from S->key and restarts the stream */
+static int blake2b_drbg_rekey( blake2b_drbg_state *S, size_t keylen )
+{
+  S->keylen = ( uint8_t ) keylen;
+
+  if( blake2b_drbg_init_keyed( S->T, S->key, S->keylen, 0 ) < 0 ) return -1;
+
+  S->counter = 0;
+  S->fork_id = blake2b_drbg_fork_id();
+  secure_zero_memory( S->buf, sizeof( S->buf ) );
+  S->buflen = 0;
+  return 0;
+}
+
+/* Each block only finalizes a copy of the template; node_offset sits in the second parameter word */
+static void blake2b_drbg_blocks( const blake2b_state *T, uint64_t counter, uint8_t *out, size_t nblocks )
+{
+  blake2b_state S[1];
+
+  for( size_t i = 0; i < nblocks; ++i )
+  {
+    memcpy( S, T, sizeof( S ) );
+    S->h[1] ^= counter + i;
+    blake2b_final( S, out + i * BLAKE2B_OUTBYTES, BLAKE2B_OUTBYTES );
+  }
+
+  secure_zero_memory( S, sizeof( S ) );
+}
+
+static void blake2b_drbg_generate( const blake2b_drbg_state *S, uint64_t counter, uint8_t *out, size_t nblocks )
+{
+#if defined(_OPENMP)
+  if( nblocks >= PARALLEL_BLOCKS )
+  {
+    #pragma omp parallel shared(S, out)
+    {
+      size_t nt__ = ( size_t ) omp_get_num_threads();
+      size_t id__ = ( size_t ) omp_get_thread_num();
+      size_t lo__ = nblocks / nt__ * id__;
+      size_t hi__ = id__ == nt__ - 1 ? nblocks : lo__ + nblocks / nt__;
+      blake2b_drbg_blocks( S->T, counter + lo__, out + lo__ * BLAKE2B_OUTBYTES, hi__ - lo__ );
+    }
+    return;
+  }
+#endif
+  blake2b_drbg_blocks( S->T, counter, out, nblocks );
+}
+
+int blake2b_drbg_init( blake2b_drbg_state *S, const void *key, size_t keylen )
+{
+  if( !key || !keylen || keylen > BLAKE2B_KEYBYTES ) return -1;
+
+  memset( S->key, 0, sizeof( S->key ) );
+  memcpy( S->key, key, keylen );
+  return blake2b_drbg_rekey( S, keylen );
+}
+
+/* The new key is the old key's BLAKE2b-512 MAC of the seed, at node_depth 1 so it never equals an output block */
+int blake2b_drbg_reseed( blake2b_drbg_state *S, const void *seed, size_t seedlen )
+{
+  blake2b_state R[1];
+
+  if( NULL == seed && seedlen > 0 ) return -1;
+
+  if( blake2b_drbg_init_keyed( R, S->key, S->keylen, 1 ) < 0 ) return -1;
+
+  blake2b_update( R, ( const uint8_t * )seed, seedlen );
+  blake2b_final( R, S->key, BLAKE2B_OUTBYTES );
+  secure_zero_memory( R, sizeof( R ) );
+  return blake2b_drbg_rekey( S, BLAKE2B_OUTBYTES );
+}
+
+int blake2b_drbg_fill( blake2b_drbg_state *S, void *out, size_t outlen )
+{
+  uint8_t *p = ( uint8_t * )out;
+
+  if( NULL == out && outlen > 0 ) return -1;
+
+  if( S->fork_id != blake2b_drbg_fork_id() ) return -1; /* Inherited across fork(); reseed first */
+
+  if( S->buflen )
+  {
+    size_t n = outlen < S->buflen ? outlen : S->buflen;
+    uint8_t *q = S->buf + sizeof( S->buf ) - S->buflen;
+    memcpy( p, q, n );
+    secure_zero_memory( q, n );
+    S->buflen -= ( uint32_t ) n;
+    p += n;
+    outlen -= n;
+  }
+
+  if( outlen >= BLAKE2B_OUTBYTES )
+  {
+    size_t nblocks = outlen / BLAKE2B_OUTBYTES;
+
+    if( S->counter + nblocks < S->counter ) return -1;
+
+    blake2b_drbg_generate( S, S->counter, p, nblocks );
+    S->counter += nblocks;
+    p += nblocks * BLAKE2B_OUTBYTES;
+    outlen -= nblocks * BLAKE2B_OUTBYTES;
+  }
+
+  if( outlen > 0 )
+  {
+    if( S->counter + BLAKE2B_DRBG_BUFBLOCKS < S->counter ) return -1;
+
+    blake2b_drbg_blocks( S->T, S->counter, S->buf, BLAKE2B_DRBG_BUFBLOCKS );
+    S->counter += BLAKE2B_DRBG_BUFBLOCKS;
+    memcpy( p, S->buf, outlen );
+    secure_zero_memory( S->buf, outlen );
+    S->buflen = ( uint32_t )( sizeof( S->buf ) - outlen );
+  }
+
+  return 0;
+}
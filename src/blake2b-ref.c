@@ -15,6 +15,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "blake2.h"
 #include "blake2-impl.h"
 
@@ -149,7 +153,15 @@ static inline int blake2b_init0( blake2b_state *S )
 #define blake2b_init_param BLAKE2_IMPL_NAME(blake2b_init_param)
 #define blake2b_init_key BLAKE2_IMPL_NAME(blake2b_init_key)
 #define blake2b_update BLAKE2_IMPL_NAME(blake2b_update)
+#define blake2b_updatev BLAKE2_IMPL_NAME(blake2b_updatev)
+#define blake2b_update_copy BLAKE2_IMPL_NAME(blake2b_update_copy)
 #define blake2b_final BLAKE2_IMPL_NAME(blake2b_final)
+#define blake2b_final_peek BLAKE2_IMPL_NAME(blake2b_final_peek)
+#define blake2b_compress_blocks BLAKE2_IMPL_NAME(blake2b_compress_blocks)
+#define blake2b_v2_update BLAKE2_IMPL_NAME(blake2b_v2_update)
+#define blake2b_v2_final BLAKE2_IMPL_NAME(blake2b_v2_final)
+#define blake2b_final_batch BLAKE2_IMPL_NAME(blake2b_final_batch)
+#define blake2b_update_multi BLAKE2_IMPL_NAME(blake2b_update_multi)
 #define blake2b BLAKE2_IMPL_NAME(blake2b)
 
 #if defined(__cplusplus)
@@ -159,7 +171,15 @@ extern "C" {
   int blake2b_init_param( blake2b_state *S, const blake2b_param *P );
   int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t keylen );
   int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen );
+  int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
+  int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi( const blake2b_update_item *items, size_t count );
   int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 #if defined(__cplusplus)
 }
@@ -234,7 +254,8 @@ int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t k
   return 0;
 }
 
-static int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+/* Works on the chaining value, counter and flags directly, so the v2 state shares it */
+static int blake2b_compress_words( uint64_t h[8], const uint64_t t[2], const uint64_t f[2], const uint8_t block[BLAKE2B_BLOCKBYTES] )
 {
   uint64_t m[16];
   uint64_t v[16];
@@ -244,16 +265,16 @@ static int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCK
     m[i] = load64( block + i * sizeof( m[i] ) );
 
   for( i = 0; i < 8; ++i )
-    v[i] = S->h[i];
+    v[i] = h[i];
 
   v[ 8] = blake2b_IV[0];
   v[ 9] = blake2b_IV[1];
   v[10] = blake2b_IV[2];
   v[11] = blake2b_IV[3];
-  v[12] = S->t[0] ^ blake2b_IV[4];
-  v[13] = S->t[1] ^ blake2b_IV[5];
-  v[14] = S->f[0] ^ blake2b_IV[6];
-  v[15] = S->f[1] ^ blake2b_IV[7];
+  v[12] = t[0] ^ blake2b_IV[4];
+  v[13] = t[1] ^ blake2b_IV[5];
+  v[14] = f[0] ^ blake2b_IV[6];
+  v[15] = f[1] ^ blake2b_IV[7];
 #define G(r,i,a,b,c,d) \
   do { \
     a = a + b + m[blake2b_sigma[r][2*i+0]]; \
@@ -290,13 +311,23 @@ static int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCK
   ROUND( 11 );
 
   for( i = 0; i < 8; ++i )
-    S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
+    h[i] = h[i] ^ v[i] ^ v[i + 8];
 
 #undef G
 #undef ROUND
   return 0;
 }
 
+static int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  return blake2b_compress_words( S->h, S->t, S->f, block );
+}
+
+static int blake2b_v2_compress( blake2b_state_v2 *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  return blake2b_compress_words( S->h, S->t, S->f, block );
+}
+
 
 int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen )
 {
@@ -328,6 +359,115 @@ int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen )
   return 0;
 }
 
+/*
+   Same buffering rule as blake2b_update, applied to the concatenation of the
+   fragments: blocks lying inside one fragment are compressed where they are,
+   only blocks straddling the buffer or a fragment boundary are assembled on
+   the stack, and the final one to two blocks are left in the buffer.
+*/
+int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  const size_t left = S->buflen;
+  uint64_t total = left, nblocks;
+  size_t pos = 0, seg = 0, off = 0, n;
+
+  if( iovcnt < 0 || ( NULL == iov && iovcnt > 0 ) ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+  {
+    if( NULL == iov[i].iov_base && iov[i].iov_len > 0 ) return -1;
+
+    total += iov[i].iov_len;
+  }
+
+  nblocks = total > 2 * BLAKE2B_BLOCKBYTES ? ( total - BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    const uint8_t *p;
+
+    while( seg < ( size_t )iovcnt && off == iov[seg].iov_len )
+    {
+      ++seg;
+      off = 0;
+    }
+
+    if( left - pos >= BLAKE2B_BLOCKBYTES )
+    {
+      p = S->buf + pos;
+      pos += BLAKE2B_BLOCKBYTES;
+    }
+    else if( pos == left && iov[seg].iov_len - off >= BLAKE2B_BLOCKBYTES )
+    {
+      p = ( const uint8_t * )iov[seg].iov_base + off;
+      off += BLAKE2B_BLOCKBYTES;
+    }
+    else
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      pos = left;
+
+      while( n < BLAKE2B_BLOCKBYTES )
+      {
+        size_t take = iov[seg].iov_len - off;
+
+        if( take > BLAKE2B_BLOCKBYTES - n ) take = BLAKE2B_BLOCKBYTES - n;
+
+        memcpy( block + n, ( const uint8_t * )iov[seg].iov_base + off, take );
+        n += take;
+        off += take;
+
+        if( off == iov[seg].iov_len )
+        {
+          ++seg;
+          off = 0;
+        }
+      }
+
+      p = block;
+    }
+
+    blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
+    blake2b_compress( S, p );
+  }
+
+  /* Whatever is left, at most two blocks, becomes the new buffer */
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  for( ; seg < ( size_t )iovcnt; ++seg, off = 0 )
+  {
+    if( off == iov[seg].iov_len ) continue;
+
+    memcpy( S->buf + n, ( const uint8_t * )iov[seg].iov_base + off, iov[seg].iov_len - off );
+    n += iov[seg].iov_len - off;
+  }
+
+  S->buflen = ( uint32_t )n;
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
+/* Copies and hashes page-sized pieces, so src is read from memory once and hashed from L1 */
+int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  if( len > 0 && ( NULL == dst || NULL == src ) ) return -1;
+
+  while( len > 0 )
+  {
+    const size_t n = len < 4096 ? len : 4096;
+    memcpy( dst, src, n );
+    blake2b_update( S, src, n );
+    dst += n;
+    src += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
 int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
 {
   uint8_t buffer[BLAKE2B_OUTBYTES];
@@ -335,6 +475,12 @@ int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
 
   if(S->outlen != outlen) return -1;
 
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
   if( S->buflen > BLAKE2B_BLOCKBYTES )
   {
     blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
@@ -355,6 +501,340 @@ int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
   return 0;
 }
 
+/*
+   Digest of everything absorbed so far, leaving S untouched: the chaining
+   value, counter and flags are copied to the stack and only the buffered
+   bytes are read, so checkpointing a stream costs one or two compressions.
+*/
+int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+  uint64_t h[8], t[2], f[2];
+  const uint8_t *p = S->buf;
+  size_t left = S->buflen;
+
+  if( S->outlen != outlen ) return -1;
+
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
+  memcpy( h, S->h, sizeof( h ) );
+  t[0] = S->t[0];
+  t[1] = S->t[1];
+  f[0] = 0;
+  f[1] = 0;
+
+  if( left > BLAKE2B_BLOCKBYTES )
+  {
+    t[0] += BLAKE2B_BLOCKBYTES;
+    t[1] += ( t[0] < BLAKE2B_BLOCKBYTES );
+    blake2b_compress_words( h, t, f, p );
+    p += BLAKE2B_BLOCKBYTES;
+    left -= BLAKE2B_BLOCKBYTES;
+  }
+
+  memcpy( block, p, left );
+  memset( block + left, 0, BLAKE2B_BLOCKBYTES - left ); /* Padding */
+  t[0] += ( uint64_t )left;
+  t[1] += ( t[0] < ( uint64_t )left );
+  f[0] = ( uint64_t )-1;
+
+  if( S->last_node ) f[1] = ( uint64_t )-1;
+
+  blake2b_compress_words( h, t, f, block );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store64( buffer + sizeof( h[i] ) * i, h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] )
+{
+  uint64_t H[8], T[2], F[2] = { 0, 0 };
+
+  if( NULL == h || NULL == t || ( nblocks && NULL == blocks ) || lastlen > BLAKE2B_BLOCKBYTES ) return -1;
+
+  memcpy( H, h, sizeof( H ) );
+  T[0] = t[0];
+  T[1] = t[1];
+
+  for( size_t i = 0; i < nblocks; ++i, blocks += BLAKE2B_BLOCKBYTES )
+  {
+    const uint64_t inc = i + 1 == nblocks ? ( uint64_t )lastlen : BLAKE2B_BLOCKBYTES;
+
+    T[0] += inc;
+    T[1] += ( T[0] < inc );
+
+    if( i + 1 == nblocks && f )
+    {
+      F[0] = f[0];
+      F[1] = f[1];
+    }
+
+    blake2b_compress_words( H, T, F, blocks );
+  }
+
+  memcpy( h, H, sizeof( H ) );
+  t[0] = T[0];
+  t[1] = T[1];
+  return 0;
+}
+
+static inline void blake2b_v2_increment_counter( blake2b_state_v2 *S, const uint64_t inc )
+{
+  S->t[0] += inc;
+  S->t[1] += ( S->t[0] < inc );
+}
+
+/* One-block buffer: a full block stays buffered until more input shows it is not the last */
+int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  if( 0 == inlen ) return 0;
+
+  if( NULL == in ) return -1;
+
+  if( inlen > BLAKE2B_BLOCKBYTES - S->buflen )
+  {
+    const size_t fill = BLAKE2B_BLOCKBYTES - S->buflen;
+    memcpy( S->buf + S->buflen, in, fill );
+    blake2b_v2_increment_counter( S, BLAKE2B_BLOCKBYTES );
+    blake2b_v2_compress( S, S->buf );
+    S->buflen = 0;
+    in += fill;
+    inlen -= fill;
+
+    while( inlen > BLAKE2B_BLOCKBYTES )
+    {
+      blake2b_v2_increment_counter( S, BLAKE2B_BLOCKBYTES );
+      blake2b_v2_compress( S, in );
+      in += BLAKE2B_BLOCKBYTES;
+      inlen -= BLAKE2B_BLOCKBYTES;
+    }
+  }
+
+  memcpy( S->buf + S->buflen, in, inlen );
+  S->buflen += ( uint32_t ) inlen;
+  return 0;
+}
+
+int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+
+  if( S->outlen != outlen || S->f[0] ) return -1;
+
+  blake2b_v2_increment_counter( S, S->buflen );
+  S->f[0] = ( uint64_t )-1;
+
+  if( S->last_node ) S->f[1] = ( uint64_t )-1;
+
+  memset( S->buf + S->buflen, 0, BLAKE2B_BLOCKBYTES - S->buflen ); /* Padding */
+  blake2b_v2_compress( S, S->buf );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+
+/* Below this many suffixes a batch is not worth waking up the thread team */
+#define BATCH_PARALLEL_ITEMS 1024
+
+/* P holds less than one block; block starts as its tail and only the suffix bytes change per item */
+static void blake2b_final_batch_range( const blake2b_state *P, uint8_t *out, size_t outlen,
+                                       const uint8_t *in, size_t suffixlen, size_t lo, size_t hi )
+{
+  const size_t left = P->buflen;
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t last[BLAKE2B_BLOCKBYTES];
+  blake2b_state W[1];
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+
+  memcpy( block, P->buf, left );
+  memset( block + left, 0, BLAKE2B_BLOCKBYTES - left );
+  W->last_node = P->last_node;
+
+  for( size_t i = lo; i < hi; ++i )
+  {
+    const uint8_t *suffix = in + i * suffixlen;
+    size_t inlen = suffixlen;
+
+    memcpy( W->h, P->h, sizeof( W->h ) );
+    memcpy( W->t, P->t, sizeof( W->t ) );
+    W->f[0] = W->f[1] = 0;
+
+    if( left + inlen <= BLAKE2B_BLOCKBYTES )
+    {
+      memcpy( block + left, suffix, inlen );
+      blake2b_increment_counter( W, left + inlen );
+      blake2b_set_lastblock( W );
+      blake2b_compress( W, block );
+    }
+    else
+    {
+      memcpy( block + left, suffix, BLAKE2B_BLOCKBYTES - left );
+      blake2b_increment_counter( W, BLAKE2B_BLOCKBYTES );
+      blake2b_compress( W, block );
+      suffix += BLAKE2B_BLOCKBYTES - left;
+      inlen -= BLAKE2B_BLOCKBYTES - left;
+
+      while( inlen > BLAKE2B_BLOCKBYTES )
+      {
+        blake2b_increment_counter( W, BLAKE2B_BLOCKBYTES );
+        blake2b_compress( W, suffix );
+        suffix += BLAKE2B_BLOCKBYTES;
+        inlen -= BLAKE2B_BLOCKBYTES;
+      }
+
+      memcpy( last, suffix, inlen );
+      memset( last + inlen, 0, BLAKE2B_BLOCKBYTES - inlen ); /* Padding */
+      blake2b_increment_counter( W, inlen );
+      blake2b_set_lastblock( W );
+      blake2b_compress( W, last );
+    }
+
+    for( size_t j = 0; j < 8; ++j ) /* Output full hash to temp buffer */
+      store64( buffer + sizeof( W->h[j] ) * j, W->h[j] );
+
+    memcpy( out + i * outlen, buffer, outlen );
+  }
+
+  /* The copies may hold a keyed prefix */
+  secure_zero_memory( block, sizeof( block ) );
+  secure_zero_memory( last, sizeof( last ) );
+  secure_zero_memory( W, sizeof( W ) );
+  secure_zero_memory( buffer, sizeof( buffer ) );
+}
+
+/*
+   Finalizes count copies of the midstate S, each extended by its own
+   suffixlen-byte suffix, so a shared prefix is compressed only once.
+*/
+int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count )
+{
+  blake2b_state P[1];
+  const uint8_t *in = ( const uint8_t * )suffixes;
+
+  if( NULL == out && count > 0 ) return -1;
+
+  if( NULL == in && suffixlen > 0 && count > 0 ) return -1;
+
+  if( S->outlen != outlen ) return -1;
+
+  memcpy( P, S, sizeof( P ) );
+
+  if( 0 == suffixlen )
+  {
+    uint8_t hash[BLAKE2B_OUTBYTES];
+    blake2b_final( P, hash, outlen );
+
+    for( size_t i = 0; i < count; ++i )
+      memcpy( out + i * outlen, hash, outlen );
+
+    secure_zero_memory( hash, sizeof( hash ) );
+    secure_zero_memory( P, sizeof( P ) );
+    return 0;
+  }
+
+  /* Every item appends at least one byte, so no buffered full block can be the last one */
+  while( P->buflen >= BLAKE2B_BLOCKBYTES )
+  {
+    blake2b_increment_counter( P, BLAKE2B_BLOCKBYTES );
+    blake2b_compress( P, P->buf );
+    P->buflen -= BLAKE2B_BLOCKBYTES;
+    memmove( P->buf, P->buf + BLAKE2B_BLOCKBYTES, P->buflen );
+  }
+
+#if defined(_OPENMP)
+  if( count >= BATCH_PARALLEL_ITEMS )
+  {
+    #pragma omp parallel shared(P, out, in)
+    {
+      size_t nt__ = ( size_t ) omp_get_num_threads();
+      size_t id__ = ( size_t ) omp_get_thread_num();
+      size_t lo__ = count / nt__ * id__;
+      size_t hi__ = id__ == nt__ - 1 ? count : lo__ + count / nt__;
+      blake2b_final_batch_range( P, out, outlen, in, suffixlen, lo__, hi__ );
+    }
+    secure_zero_memory( P, sizeof( P ) );
+    return 0;
+  }
+#endif
+  blake2b_final_batch_range( P, out, outlen, in, suffixlen, 0, count );
+  secure_zero_memory( P, sizeof( P ) );
+  return 0;
+}
+
+/* No lanes to fill without SIMD: the states are simply updated in turn */
+int blake2b_update_multi( const blake2b_update_item *items, size_t count )
+{
+  if( NULL == items && count > 0 ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+    if( NULL == items[i].S || ( NULL == items[i].in && items[i].inlen > 0 ) ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+    blake2b_update( items[i].S, items[i].in, items[i].inlen );
+
+  return 0;
+}
+
+/*
+   One-shot path for inputs of at most one block: the chaining value comes
+   straight from the default parameter block and the message is padded on the
+   stack, so only h, t and f of S are ever touched.
+*/
+static int blake2b_one_block( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+{
+  blake2b_state S[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+
+  for( int i = 0; i < 8; ++i ) S->h[i] = blake2b_IV[i];
+
+  /* digest_length, key_length, fanout = 1, depth = 1 */
+  S->h[0] ^= 0x01010000UL ^ ( keylen << 8 ) ^ outlen;
+  S->t[1] = 0;
+  S->f[1] = 0;
+
+  if( keylen > 0 )
+  {
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+    memcpy( block, key, keylen );
+    S->t[0] = BLAKE2B_BLOCKBYTES;
+    S->f[0] = inlen > 0 ? 0 : ~0ULL;
+    blake2b_compress( S, block );
+  }
+
+  if( inlen > 0 || 0 == keylen )
+  {
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+
+    if( inlen > 0 ) memcpy( block, in, inlen );
+
+    S->t[0] = ( keylen > 0 ? BLAKE2B_BLOCKBYTES : 0 ) + inlen;
+    S->f[0] = ~0ULL;
+    blake2b_compress( S, block );
+  }
+
+  for( int i = 0; i < 8; ++i )
+    store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+
+  if( keylen > 0 ) secure_zero_memory( block, sizeof( block ) ); /* Burn the key from stack */
+
+  return 0;
+}
+
 int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   blake2b_state S[1];
@@ -370,6 +850,8 @@ int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_
 
   if( keylen > BLAKE2B_KEYBYTES ) return -1;
 
+  if( inlen <= BLAKE2B_BLOCKBYTES ) return blake2b_one_block( out, in, key, outlen, inlen, keylen );
+
   if( keylen > 0 )
   {
     if( blake2b_init_key( S, outlen, key, keylen ) < 0 ) return -1;
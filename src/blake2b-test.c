@@ -11,9 +11,241 @@
    this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "blake2.h"
 #include "blake2-kat.h"
+#include "blake2-small.h"
+
+#define BATCH_COUNT 1500
+
+/* Every suffix of a batch must hash like the concatenation prefix || suffix */
+static int test_final_batch( const uint8_t *key, size_t keylen )
+{
+  static const size_t prefixlens[] = { 0, 1, 127, 128, 129, 255, 256, 257, 300 };
+  static const size_t suffixlens[] = { 0, 1, 8, 120, 128, 129, 300 };
+  static uint8_t suffixes[BATCH_COUNT * 300];
+  static uint8_t hashes[BATCH_COUNT * BLAKE2B_OUTBYTES];
+  uint8_t msg[600];
+
+  for( size_t i = 0; i < sizeof( suffixes ); ++i )
+    suffixes[i] = ( uint8_t )( i * 7 + 3 );
+
+  for( size_t p = 0; p < sizeof( prefixlens ) / sizeof( prefixlens[0] ); ++p )
+  for( size_t q = 0; q < sizeof( suffixlens ) / sizeof( suffixlens[0] ); ++q )
+  {
+    const size_t prefixlen = prefixlens[p], suffixlen = suffixlens[q];
+    const size_t outlen = 1 + ( prefixlen + suffixlen ) % BLAKE2B_OUTBYTES;
+    const size_t count = ( p + q ) % 2 ? BATCH_COUNT : 3;
+    blake2b_state S[1];
+
+    for( size_t i = 0; i < prefixlen; ++i )
+      msg[i] = ( uint8_t )i;
+
+    if( ( keylen ? blake2b_init_key( S, outlen, key, keylen ) : blake2b_init( S, outlen ) ) < 0 ||
+        blake2b_update( S, msg, prefixlen ) < 0 ||
+        blake2b_final_batch( S, hashes, outlen, suffixes, suffixlen, count ) < 0 )
+      return -1;
+
+    for( size_t i = 0; i < count; i += 97 )
+    {
+      uint8_t hash[BLAKE2B_OUTBYTES];
+      memcpy( msg + prefixlen, suffixes + i * suffixlen, suffixlen );
+
+      if( blake2b( hash, msg, key, outlen, prefixlen + suffixlen, keylen ) < 0 ||
+          0 != memcmp( hash, hashes + i * outlen, outlen ) )
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+#define MULTI_STREAMS 37
+
+/* Streams fed through blake2b_update_multi must end up exactly where blake2b_update leaves them */
+static int test_update_multi( const uint8_t *key )
+{
+  static const size_t chunks[] = { 0, 1, 127, 128, 129, 255, 256, 257, 1000, 4096, 16384 };
+  static uint8_t data[16384 + MULTI_STREAMS];
+  blake2b_state S[MULTI_STREAMS], R[MULTI_STREAMS];
+  blake2b_update_item items[MULTI_STREAMS];
+
+  for( size_t i = 0; i < sizeof( data ); ++i )
+    data[i] = ( uint8_t )( i * 11 + 5 );
+
+  for( size_t i = 0; i < MULTI_STREAMS; ++i )
+  {
+    if( i % 3 ) blake2b_init_key( &S[i], BLAKE2B_OUTBYTES, key, 1 + i % BLAKE2B_KEYBYTES );
+    else blake2b_init( &S[i], 1 + i );
+
+    blake2b_update( &S[i], data, ( i * 29 ) % 300 );
+    memcpy( &R[i], &S[i], sizeof( S[i] ) );
+  }
+
+  for( size_t round = 0; round < 6; ++round )
+  {
+    for( size_t i = 0; i < MULTI_STREAMS; ++i )
+    {
+      items[i].S = &S[i];
+      items[i].in = data + i;
+      items[i].inlen = chunks[( i * 7 + round * 3 ) % ( sizeof( chunks ) / sizeof( chunks[0] ) )];
+      blake2b_update( &R[i], items[i].in, items[i].inlen );
+    }
+
+    if( blake2b_update_multi( items, MULTI_STREAMS - round ) < 0 ) return -1;
+
+    /* Streams left out of this round catch up one at a time */
+    for( size_t i = MULTI_STREAMS - round; i < MULTI_STREAMS; ++i )
+      blake2b_update( &S[i], items[i].in, items[i].inlen );
+  }
+
+  for( size_t i = 0; i < MULTI_STREAMS; ++i )
+  {
+    uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+
+    if( S[i].buflen != R[i].buflen || S[i].t[0] != R[i].t[0] ) return -1;
+
+    blake2b_final( &S[i], a, S[i].outlen );
+    blake2b_final( &R[i], b, R[i].outlen );
+
+    if( 0 != memcmp( a, b, S[i].outlen ) ) return -1;
+  }
+
+  return 0;
+}
+
+/* Past the 1 MiB non-temporal store threshold */
+#define BLAKE2_COPY_BIG ( ( 3 << 20 ) + 200 )
+
+/* update_copy must leave dst equal to src and the state where update leaves it, streaming or not */
+static int test_update_copy( void )
+{
+  static const size_t lengths[] = { 0, 1, 63, 64, 65, 127, 128, 129, 1000, 4096, BLAKE2_COPY_BIG };
+  static const size_t prefixes[] = { 0, 1, 64, 129, 256 };
+  uint8_t *src = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  uint8_t *dst = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  int ret = -1;
+
+  if( !src || !dst ) goto out;
+
+  for( size_t i = 0; i < BLAKE2_COPY_BIG + 8; ++i )
+    src[i] = ( uint8_t )( i * 13 + 1 );
+
+  for( size_t i = 0; i < sizeof( lengths ) / sizeof( lengths[0] ); ++i )
+    for( size_t j = 0; j < sizeof( prefixes ) / sizeof( prefixes[0] ); ++j )
+      for( size_t skew = 0; skew < 16; skew += 8 )
+      {
+        uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES];
+        blake2b_state S[1], R[1];
+
+        blake2b_init( S, BLAKE2B_OUTBYTES );
+        blake2b_update( S, src, prefixes[j] );
+        memcpy( R, S, sizeof( S ) );
+        memset( dst, 0, BLAKE2_COPY_BIG + 8 );
+
+        if( blake2b_update_copy( S, dst + skew, src + skew, lengths[i] ) < 0 ||
+            0 != memcmp( dst + skew, src + skew, lengths[i] ) )
+          goto out;
+
+        blake2b_update( R, src + skew, lengths[i] );
+        blake2b_final( S, a, BLAKE2B_OUTBYTES );
+        blake2b_final( R, b, BLAKE2B_OUTBYTES );
+
+        if( 0 != memcmp( a, b, sizeof( a ) ) ) goto out;
+      }
+
+  ret = 0;
+out:
+  free( src );
+  free( dst );
+  return ret;
+}
+
+/* The one-block paths, library and header alike, must agree with the streaming API */
+static int test_small( const uint8_t *key, const uint8_t *buf )
+{
+  static const size_t keylens[] = { 0, 1, BLAKE2B_KEYBYTES };
+  static const size_t outlens[] = { 1, 20, BLAKE2B_OUTBYTES };
+
+  for( size_t inlen = 0; inlen <= BLAKE2B_BLOCKBYTES + 1; ++inlen )
+    for( size_t k = 0; k < 3; ++k )
+      for( size_t o = 0; o < 3; ++o )
+      {
+        uint8_t a[BLAKE2B_OUTBYTES], b[BLAKE2B_OUTBYTES], c[BLAKE2B_OUTBYTES];
+        blake2b_state S[1];
+
+        if( keylens[k] ) blake2b_init_key( S, outlens[o], key, keylens[k] );
+        else blake2b_init( S, outlens[o] );
+
+        blake2b_update( S, buf, inlen );
+        blake2b_final( S, a, outlens[o] );
+
+        if( blake2b( b, buf, key, outlens[o], inlen, keylens[k] ) < 0 || 0 != memcmp( a, b, outlens[o] ) )
+          return -1;
+
+        /* The header only takes a single block */
+        if( inlen > BLAKE2B_BLOCKBYTES )
+        {
+          if( blake2b_small( c, buf, key, outlens[o], inlen, keylens[k] ) == 0 ) return -1;
+        }
+        else if( blake2b_small( c, buf, key, outlens[o], inlen, keylens[k] ) < 0 || 0 != memcmp( a, c, outlens[o] ) )
+          return -1;
+      }
+
+  return 0;
+}
+
+/* Keyed hashes of the non-empty KAT messages rebuilt from the raw compression function, the last block counted with its real length */
+static int test_compress_blocks( const uint8_t *key, const uint8_t *buf )
+{
+  uint8_t blocks[BLAKE2B_BLOCKBYTES + KAT_LENGTH + BLAKE2B_BLOCKBYTES];
+  static const uint64_t f[2] = { ( uint64_t )-1, 0 };
+  uint8_t out[BLAKE2B_OUTBYTES], expect[BLAKE2B_OUTBYTES];
+  uint64_t t[2] = { 0, 0 };
+  blake2b_state S[1];
+
+  for( size_t len = 1; len < KAT_LENGTH; ++len )
+  {
+    const size_t n = ( len + BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES;
+
+    memset( blocks, 0, sizeof( blocks ) );
+    memcpy( blocks, key, BLAKE2B_KEYBYTES );
+    memcpy( blocks + BLAKE2B_BLOCKBYTES, buf, len );
+    blake2b_init_key( S, BLAKE2B_OUTBYTES, key, BLAKE2B_KEYBYTES );
+    t[0] = t[1] = 0;
+
+    /* The key block alone, then the message in one run carrying the final flag */
+    if( blake2b_compress_blocks( S->h, blocks, 1, BLAKE2B_BLOCKBYTES, t, NULL ) < 0 ||
+        blake2b_compress_blocks( S->h, blocks + BLAKE2B_BLOCKBYTES, n, len - ( n - 1 ) * BLAKE2B_BLOCKBYTES, t, f ) < 0 )
+      return -1;
+
+    if( t[0] != BLAKE2B_BLOCKBYTES + len || t[1] != 0 ) return -1;
+
+    for( size_t i = 0; i < BLAKE2B_OUTBYTES; ++i )
+      out[i] = ( uint8_t )( S->h[i / sizeof( S->h[0] )] >> ( 8 * ( i % sizeof( S->h[0] ) ) ) );
+
+    if( 0 != memcmp( out, blake2b_keyed_kat[len], BLAKE2B_OUTBYTES ) ) return -1;
+  }
+
+  /* An unkeyed message shorter than a block, finished in one call without wrapping the counter */
+  memset( blocks, 0, sizeof( blocks ) );
+  memcpy( blocks, buf, 3 );
+  blake2b_init( S, BLAKE2B_OUTBYTES );
+  t[0] = t[1] = 0;
+
+  if( blake2b_compress_blocks( S->h, blocks, 1, 3, t, f ) < 0 || t[0] != 3 || t[1] != 0 ) return -1;
+
+  for( size_t i = 0; i < BLAKE2B_OUTBYTES; ++i )
+    out[i] = ( uint8_t )( S->h[i / sizeof( S->h[0] )] >> ( 8 * ( i % sizeof( S->h[0] ) ) ) );
+
+  blake2b( expect, buf, NULL, BLAKE2B_OUTBYTES, 3, 0 );
+
+  if( 0 != memcmp( out, expect, BLAKE2B_OUTBYTES ) ) return -1;
+
+  return blake2b_compress_blocks( S->h, blocks, 1, BLAKE2B_BLOCKBYTES + 1, t, f ) < 0 ? 0 : -1;
+}
+
 int main( int argc, char **argv )
 {
   uint8_t key[BLAKE2B_KEYBYTES];
@@ -37,6 +269,14 @@ int main( int argc, char **argv )
     }
   }
 
+  if( test_final_batch( key, 0 ) < 0 || test_final_batch( key, BLAKE2B_KEYBYTES ) < 0 ||
+      test_update_multi( key ) < 0 || test_update_copy() < 0 ||
+      test_small( key, buf ) < 0 || test_compress_blocks( key, buf ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
   puts( "ok" );
   return 0;
 }
@@ -15,6 +15,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "blake2.h"
 #include "blake2-impl.h"
 
@@ -193,7 +197,15 @@ static inline int blake2b_init0( blake2b_state *S )
 #define blake2b_init_param BLAKE2_IMPL_NAME(blake2b_init_param)
 #define blake2b_init_key BLAKE2_IMPL_NAME(blake2b_init_key)
 #define blake2b_update BLAKE2_IMPL_NAME(blake2b_update)
+#define blake2b_updatev BLAKE2_IMPL_NAME(blake2b_updatev)
+#define blake2b_update_copy BLAKE2_IMPL_NAME(blake2b_update_copy)
 #define blake2b_final BLAKE2_IMPL_NAME(blake2b_final)
+#define blake2b_final_peek BLAKE2_IMPL_NAME(blake2b_final_peek)
+#define blake2b_compress_blocks BLAKE2_IMPL_NAME(blake2b_compress_blocks)
+#define blake2b_v2_update BLAKE2_IMPL_NAME(blake2b_v2_update)
+#define blake2b_v2_final BLAKE2_IMPL_NAME(blake2b_v2_final)
+#define blake2b_final_batch BLAKE2_IMPL_NAME(blake2b_final_batch)
+#define blake2b_update_multi BLAKE2_IMPL_NAME(blake2b_update_multi)
 #define blake2b BLAKE2_IMPL_NAME(blake2b)
 
 #if defined(__cplusplus)
@@ -203,7 +215,15 @@ extern "C" {
   int blake2b_init_param( blake2b_state *S, const blake2b_param *P );
   int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t keylen );
   int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen );
+  int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt );
+  int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen );
+  int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] );
+  int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count );
+  int blake2b_update_multi( const blake2b_update_item *items, size_t count );
   int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 #if defined(__cplusplus)
 }
@@ -284,7 +304,16 @@ int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t k
   return 0;
 }
 
-static inline int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+/*
+   The chaining value, counter and flags are passed as words so that both the
+   packed state and the aligned v2 state share one kernel; aligned is a
+   constant at every call site and selects aligned loads and stores for them.
+*/
+#define LOADH(p) ( aligned ? LOAD( p ) : LOADU( p ) )
+#define STOREH(p,r) do { if( aligned ) _mm_store_si128( ( __m128i * )( p ), r ); else STOREU( p, r ); } while(0)
+
+static inline int blake2b_compress_words( uint64_t h[8], const uint64_t t[2], const uint64_t f[2],
+    const uint8_t block[BLAKE2B_BLOCKBYTES], const int aligned )
 {
   __m128i row1l, row1h;
   __m128i row2l, row2h;
@@ -323,14 +352,14 @@ static inline int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2
   const uint64_t m14 = ( ( uint64_t * )block )[14];
   const uint64_t m15 = ( ( uint64_t * )block )[15];
 #endif
-  row1l = LOADU( &S->h[0] );
-  row1h = LOADU( &S->h[2] );
-  row2l = LOADU( &S->h[4] );
-  row2h = LOADU( &S->h[6] );
+  row1l = LOADH( &h[0] );
+  row1h = LOADH( &h[2] );
+  row2l = LOADH( &h[4] );
+  row2h = LOADH( &h[6] );
   row3l = LOADU( &blake2b_IV[0] );
   row3h = LOADU( &blake2b_IV[2] );
-  row4l = _mm_xor_si128( LOADU( &blake2b_IV[4] ), LOADU( &S->t[0] ) );
-  row4h = _mm_xor_si128( LOADU( &blake2b_IV[6] ), LOADU( &S->f[0] ) );
+  row4l = _mm_xor_si128( LOADU( &blake2b_IV[4] ), LOADH( &t[0] ) );
+  row4h = _mm_xor_si128( LOADU( &blake2b_IV[6] ), LOADH( &f[0] ) );
   ROUND( 0 );
   ROUND( 1 );
   ROUND( 2 );
@@ -345,15 +374,28 @@ static inline int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2
   ROUND( 11 );
   row1l = _mm_xor_si128( row3l, row1l );
   row1h = _mm_xor_si128( row3h, row1h );
-  STOREU( &S->h[0], _mm_xor_si128( LOADU( &S->h[0] ), row1l ) );
-  STOREU( &S->h[2], _mm_xor_si128( LOADU( &S->h[2] ), row1h ) );
+  STOREH( &h[0], _mm_xor_si128( LOADH( &h[0] ), row1l ) );
+  STOREH( &h[2], _mm_xor_si128( LOADH( &h[2] ), row1h ) );
   row2l = _mm_xor_si128( row4l, row2l );
   row2h = _mm_xor_si128( row4h, row2h );
-  STOREU( &S->h[4], _mm_xor_si128( LOADU( &S->h[4] ), row2l ) );
-  STOREU( &S->h[6], _mm_xor_si128( LOADU( &S->h[6] ), row2h ) );
+  STOREH( &h[4], _mm_xor_si128( LOADH( &h[4] ), row2l ) );
+  STOREH( &h[6], _mm_xor_si128( LOADH( &h[6] ), row2h ) );
   return 0;
 }
 
+#undef STOREH
+#undef LOADH
+
+static inline int blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  return blake2b_compress_words( S->h, S->t, S->f, block, 0 );
+}
+
+static inline int blake2b_v2_compress( blake2b_state_v2 *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  return blake2b_compress_words( S->h, S->t, S->f, block, 1 );
+}
+
 
 int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen )
 {
@@ -385,11 +427,181 @@ int blake2b_update( blake2b_state *S, const uint8_t *in, size_t inlen )
   return 0;
 }
 
+/*
+   Same buffering rule as blake2b_update, applied to the concatenation of the
+   fragments: blocks lying inside one fragment are compressed where they are,
+   only blocks straddling the buffer or a fragment boundary are assembled on
+   the stack, and the final one to two blocks are left in the buffer.
+*/
+int blake2b_updatev( blake2b_state *S, const struct iovec *iov, int iovcnt )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  const size_t left = S->buflen;
+  uint64_t total = left, nblocks;
+  size_t pos = 0, seg = 0, off = 0, n;
+
+  if( iovcnt < 0 || ( NULL == iov && iovcnt > 0 ) ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+  {
+    if( NULL == iov[i].iov_base && iov[i].iov_len > 0 ) return -1;
+
+    total += iov[i].iov_len;
+  }
+
+  nblocks = total > 2 * BLAKE2B_BLOCKBYTES ? ( total - BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    const uint8_t *p;
+
+    while( seg < ( size_t )iovcnt && off == iov[seg].iov_len )
+    {
+      ++seg;
+      off = 0;
+    }
+
+    if( left - pos >= BLAKE2B_BLOCKBYTES )
+    {
+      p = S->buf + pos;
+      pos += BLAKE2B_BLOCKBYTES;
+    }
+    else if( pos == left && iov[seg].iov_len - off >= BLAKE2B_BLOCKBYTES )
+    {
+      p = ( const uint8_t * )iov[seg].iov_base + off;
+      off += BLAKE2B_BLOCKBYTES;
+    }
+    else
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      pos = left;
+
+      while( n < BLAKE2B_BLOCKBYTES )
+      {
+        size_t take = iov[seg].iov_len - off;
+
+        if( take > BLAKE2B_BLOCKBYTES - n ) take = BLAKE2B_BLOCKBYTES - n;
+
+        memcpy( block + n, ( const uint8_t * )iov[seg].iov_base + off, take );
+        n += take;
+        off += take;
+
+        if( off == iov[seg].iov_len )
+        {
+          ++seg;
+          off = 0;
+        }
+      }
+
+      p = block;
+    }
+
+    blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
+    blake2b_compress( S, p );
+  }
+
+  /* Whatever is left, at most two blocks, becomes the new buffer */
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  for( ; seg < ( size_t )iovcnt; ++seg, off = 0 )
+  {
+    if( off == iov[seg].iov_len ) continue;
+
+    memcpy( S->buf + n, ( const uint8_t * )iov[seg].iov_base + off, iov[seg].iov_len - off );
+    n += iov[seg].iov_len - off;
+  }
+
+  S->buflen = ( uint32_t )n;
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
+/* Copies one block through registers; the compression that follows reads src from L1 */
+static inline void blake2b_copy_block( uint8_t *dst, const uint8_t *src, int stream )
+{
+  for( size_t i = 0; i < BLAKE2B_BLOCKBYTES; i += 16 )
+  {
+    const __m128i m = LOADU( src + i );
+
+    if( stream ) _mm_stream_si128( ( __m128i * )( dst + i ), m );
+    else STOREU( dst + i, m );
+  }
+}
+
+/*
+   memcpy( dst, src, len ) followed by blake2b_update( S, src, len ), in one
+   pass: every block compressed straight from src is first stored to dst from
+   the registers that loaded it. Large copies to 16-byte aligned destinations
+   use non-temporal stores so dst does not evict the working set.
+*/
+int blake2b_update_copy( blake2b_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  const size_t left = S->buflen;
+  const int stream = len >= BLAKE2_STREAM_BYTES;
+  uint64_t nblocks;
+  size_t pos = 0, off = 0, n;
+
+  if( len > 0 && ( NULL == dst || NULL == src ) ) return -1;
+
+  nblocks = left + len > 2 * BLAKE2B_BLOCKBYTES ? ( left + len - BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
+
+    if( left - pos >= BLAKE2B_BLOCKBYTES )
+    {
+      blake2b_compress( S, S->buf + pos );
+      pos += BLAKE2B_BLOCKBYTES;
+    }
+    else if( pos < left )
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      memcpy( block + n, src, BLAKE2B_BLOCKBYTES - n );
+      memcpy( dst, src, BLAKE2B_BLOCKBYTES - n );
+      off = BLAKE2B_BLOCKBYTES - n;
+      pos = left;
+      blake2b_compress( S, block );
+    }
+    else
+    {
+      blake2b_copy_block( dst + off, src + off, stream && 0 == ( ( uintptr_t )( dst + off ) & 15 ) );
+      blake2b_compress( S, src + off );
+      off += BLAKE2B_BLOCKBYTES;
+    }
+  }
+
+  if( stream ) _mm_sfence();
+
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  if( len > off )
+  {
+    memcpy( S->buf + n, src + off, len - off );
+    memcpy( dst + off, src + off, len - off );
+  }
+
+  S->buflen = ( uint32_t )( n + len - off );
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
 
 int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
 {
   if(S->outlen != outlen) return -1;
 
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
   if( S->buflen > BLAKE2B_BLOCKBYTES )
   {
     blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
@@ -406,6 +618,566 @@ int blake2b_final( blake2b_state *S, uint8_t *out, size_t outlen )
   return 0;
 }
 
+/*
+   Digest of everything absorbed so far, leaving S untouched: the chaining
+   value, counter and flags are copied to the stack and only the buffered
+   bytes are read, so checkpointing a stream costs one or two compressions.
+*/
+int blake2b_final_peek( const blake2b_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+  uint64_t h[8], t[2], f[2];
+  const uint8_t *p = S->buf;
+  size_t left = S->buflen;
+
+  if( S->outlen != outlen ) return -1;
+
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2B_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
+  memcpy( h, S->h, sizeof( h ) );
+  t[0] = S->t[0];
+  t[1] = S->t[1];
+  f[0] = 0;
+  f[1] = 0;
+
+  if( left > BLAKE2B_BLOCKBYTES )
+  {
+    t[0] += BLAKE2B_BLOCKBYTES;
+    t[1] += ( t[0] < BLAKE2B_BLOCKBYTES );
+    blake2b_compress_words( h, t, f, p, 0 );
+    p += BLAKE2B_BLOCKBYTES;
+    left -= BLAKE2B_BLOCKBYTES;
+  }
+
+  memcpy( block, p, left );
+  memset( block + left, 0, BLAKE2B_BLOCKBYTES - left ); /* Padding */
+  t[0] += ( uint64_t )left;
+  t[1] += ( t[0] < ( uint64_t )left );
+  f[0] = ( uint64_t )-1;
+
+  if( S->last_node ) f[1] = ( uint64_t )-1;
+
+  blake2b_compress_words( h, t, f, block, 0 );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store64( buffer + sizeof( h[i] ) * i, h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+/* The words live in aligned locals for the whole run, so each block goes
+   straight from one kernel call to the next */
+int blake2b_compress_blocks( uint64_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint64_t t[2], const uint64_t f[2] )
+{
+  BLAKE2_ALIGN( 16 ) uint64_t H[8];
+  BLAKE2_ALIGN( 16 ) uint64_t T[2];
+  BLAKE2_ALIGN( 16 ) uint64_t F[2] = { 0, 0 };
+
+  if( NULL == h || NULL == t || ( nblocks && NULL == blocks ) || lastlen > BLAKE2B_BLOCKBYTES ) return -1;
+
+  memcpy( H, h, sizeof( H ) );
+  T[0] = t[0];
+  T[1] = t[1];
+
+  for( size_t i = 0; i < nblocks; ++i, blocks += BLAKE2B_BLOCKBYTES )
+  {
+    const uint64_t inc = i + 1 == nblocks ? ( uint64_t )lastlen : BLAKE2B_BLOCKBYTES;
+
+    T[0] += inc;
+    T[1] += ( T[0] < inc );
+
+    if( i + 1 == nblocks && f )
+    {
+      F[0] = f[0];
+      F[1] = f[1];
+    }
+
+    blake2b_compress_words( H, T, F, blocks, 1 );
+  }
+
+  memcpy( h, H, sizeof( H ) );
+  t[0] = T[0];
+  t[1] = T[1];
+  return 0;
+}
+
+static inline void blake2b_v2_increment_counter( blake2b_state_v2 *S, const uint64_t inc )
+{
+  S->t[0] += inc;
+  S->t[1] += ( S->t[0] < inc );
+}
+
+/* One-block buffer: a full block stays buffered until more input shows it is not the last */
+int blake2b_v2_update( blake2b_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  if( 0 == inlen ) return 0;
+
+  if( NULL == in ) return -1;
+
+  if( inlen > BLAKE2B_BLOCKBYTES - S->buflen )
+  {
+    const size_t fill = BLAKE2B_BLOCKBYTES - S->buflen;
+    memcpy( S->buf + S->buflen, in, fill );
+    blake2b_v2_increment_counter( S, BLAKE2B_BLOCKBYTES );
+    blake2b_v2_compress( S, S->buf );
+    S->buflen = 0;
+    in += fill;
+    inlen -= fill;
+
+    while( inlen > BLAKE2B_BLOCKBYTES )
+    {
+      blake2b_v2_increment_counter( S, BLAKE2B_BLOCKBYTES );
+      blake2b_v2_compress( S, in );
+      in += BLAKE2B_BLOCKBYTES;
+      inlen -= BLAKE2B_BLOCKBYTES;
+    }
+  }
+
+  memcpy( S->buf + S->buflen, in, inlen );
+  S->buflen += ( uint32_t ) inlen;
+  return 0;
+}
+
+int blake2b_v2_final( blake2b_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+
+  if( S->outlen != outlen || S->f[0] ) return -1;
+
+  blake2b_v2_increment_counter( S, S->buflen );
+  S->f[0] = ( uint64_t )-1;
+
+  if( S->last_node ) S->f[1] = ( uint64_t )-1;
+
+  memset( S->buf + S->buflen, 0, BLAKE2B_BLOCKBYTES - S->buflen ); /* Padding */
+  blake2b_v2_compress( S, S->buf );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+
+
+/* Below this many suffixes a batch is not worth waking up the thread team */
+#define BATCH_PARALLEL_ITEMS 1024
+
+/* P holds less than one block; block starts as its tail and only the suffix bytes change per item */
+static void blake2b_final_batch_range( const blake2b_state *P, uint8_t *out, size_t outlen,
+                                       const uint8_t *in, size_t suffixlen, size_t lo, size_t hi )
+{
+  const size_t left = P->buflen;
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t last[BLAKE2B_BLOCKBYTES];
+  blake2b_state W[1];
+
+  memcpy( block, P->buf, left );
+  memset( block + left, 0, BLAKE2B_BLOCKBYTES - left );
+  W->last_node = P->last_node;
+
+  for( size_t i = lo; i < hi; ++i )
+  {
+    const uint8_t *suffix = in + i * suffixlen;
+    size_t inlen = suffixlen;
+
+    memcpy( W->h, P->h, sizeof( W->h ) );
+    memcpy( W->t, P->t, sizeof( W->t ) );
+    W->f[0] = W->f[1] = 0;
+
+    if( left + inlen <= BLAKE2B_BLOCKBYTES )
+    {
+      memcpy( block + left, suffix, inlen );
+      blake2b_increment_counter( W, left + inlen );
+      blake2b_set_lastblock( W );
+      blake2b_compress( W, block );
+    }
+    else
+    {
+      memcpy( block + left, suffix, BLAKE2B_BLOCKBYTES - left );
+      blake2b_increment_counter( W, BLAKE2B_BLOCKBYTES );
+      blake2b_compress( W, block );
+      suffix += BLAKE2B_BLOCKBYTES - left;
+      inlen -= BLAKE2B_BLOCKBYTES - left;
+
+      while( inlen > BLAKE2B_BLOCKBYTES )
+      {
+        blake2b_increment_counter( W, BLAKE2B_BLOCKBYTES );
+        blake2b_compress( W, suffix );
+        suffix += BLAKE2B_BLOCKBYTES;
+        inlen -= BLAKE2B_BLOCKBYTES;
+      }
+
+      memcpy( last, suffix, inlen );
+      memset( last + inlen, 0, BLAKE2B_BLOCKBYTES - inlen ); /* Padding */
+      blake2b_increment_counter( W, inlen );
+      blake2b_set_lastblock( W );
+      blake2b_compress( W, last );
+    }
+
+    memcpy( out + i * outlen, &W->h[0], outlen );
+  }
+
+  /* The copies may hold a keyed prefix */
+  secure_zero_memory( block, sizeof( block ) );
+  secure_zero_memory( last, sizeof( last ) );
+  secure_zero_memory( W, sizeof( W ) );
+}
+
+/*
+   Finalizes count copies of the midstate S, each extended by its own
+   suffixlen-byte suffix, so a shared prefix is compressed only once.
+*/
+int blake2b_final_batch( const blake2b_state *S, uint8_t *out, size_t outlen, const void *suffixes, size_t suffixlen, size_t count )
+{
+  blake2b_state P[1];
+  const uint8_t *in = ( const uint8_t * )suffixes;
+
+  if( NULL == out && count > 0 ) return -1;
+
+  if( NULL == in && suffixlen > 0 && count > 0 ) return -1;
+
+  if( S->outlen != outlen ) return -1;
+
+  memcpy( P, S, sizeof( P ) );
+
+  if( 0 == suffixlen )
+  {
+    uint8_t hash[BLAKE2B_OUTBYTES];
+    blake2b_final( P, hash, outlen );
+
+    for( size_t i = 0; i < count; ++i )
+      memcpy( out + i * outlen, hash, outlen );
+
+    secure_zero_memory( hash, sizeof( hash ) );
+    secure_zero_memory( P, sizeof( P ) );
+    return 0;
+  }
+
+  /* Every item appends at least one byte, so no buffered full block can be the last one */
+  while( P->buflen >= BLAKE2B_BLOCKBYTES )
+  {
+    blake2b_increment_counter( P, BLAKE2B_BLOCKBYTES );
+    blake2b_compress( P, P->buf );
+    P->buflen -= BLAKE2B_BLOCKBYTES;
+    memmove( P->buf, P->buf + BLAKE2B_BLOCKBYTES, P->buflen );
+  }
+
+#if defined(_OPENMP)
+  if( count >= BATCH_PARALLEL_ITEMS )
+  {
+    #pragma omp parallel shared(P, out, in)
+    {
+      size_t nt__ = ( size_t ) omp_get_num_threads();
+      size_t id__ = ( size_t ) omp_get_thread_num();
+      size_t lo__ = count / nt__ * id__;
+      size_t hi__ = id__ == nt__ - 1 ? count : lo__ + count / nt__;
+      blake2b_final_batch_range( P, out, outlen, in, suffixlen, lo__, hi__ );
+    }
+    secure_zero_memory( P, sizeof( P ) );
+    return 0;
+  }
+#endif
+  blake2b_final_batch_range( P, out, outlen, in, suffixlen, 0, count );
+  secure_zero_memory( P, sizeof( P ) );
+  return 0;
+}
+
+/*
+   Multi-stream updates run independent states through the compression
+   function side by side, one state per 64-bit lane, so no diagonalization
+   is needed. Chaining values and counters are kept transposed in memory, so
+   a lane can be handed the next state as soon as its current one runs out
+   of blocks.
+*/
+#if defined(HAVE_AVX512F)
+#define BLAKE2B_LANES 8
+#define LANES_VEC __m512i
+#define LANES_LOAD(p) _mm512_loadu_si512( ( const void * )( p ) )
+#define LANES_STORE(p,r) _mm512_storeu_si512( ( void * )( p ), r )
+#define LANES_SET1(x) _mm512_set1_epi64( ( long long )( x ) )
+#define LANES_ADD(a,b) _mm512_add_epi64( a, b )
+#define LANES_XOR(a,b) _mm512_xor_si512( a, b )
+#define LANES_ROR(x,c) _mm512_ror_epi64( x, c )
+#elif defined(HAVE_AVX2)
+#define BLAKE2B_LANES 4
+#define LANES_VEC __m256i
+#define LANES_LOAD(p) _mm256_loadu_si256( ( const __m256i * )( p ) )
+#define LANES_STORE(p,r) _mm256_storeu_si256( ( __m256i * )( p ), r )
+#define LANES_SET1(x) _mm256_set1_epi64x( ( long long )( x ) )
+#define LANES_ADD(a,b) _mm256_add_epi64( a, b )
+#define LANES_XOR(a,b) _mm256_xor_si256( a, b )
+#define LANES_ROR(x,c) \
+    ( (c) == 32 ? _mm256_shuffle_epi32( (x), _MM_SHUFFLE(2,3,0,1) ) \
+    : (c) == 24 ? _mm256_shuffle_epi8( (x), r24 ) \
+    : (c) == 16 ? _mm256_shuffle_epi8( (x), r16 ) \
+    : _mm256_xor_si256( _mm256_srli_epi64( (x), 63 ), _mm256_add_epi64( (x), (x) ) ) )
+#else
+#define BLAKE2B_LANES 2
+#define LANES_VEC __m128i
+#define LANES_LOAD(p) LOADU( p )
+#define LANES_STORE(p,r) STOREU( p, r )
+#define LANES_SET1(x) _mm_set1_epi64x( ( long long )( x ) )
+#define LANES_ADD(a,b) _mm_add_epi64( a, b )
+#define LANES_XOR(a,b) _mm_xor_si128( a, b )
+#define LANES_ROR(x,c) _mm_roti_epi64( x, -(c) )
+#endif
+
+typedef struct
+{
+  uint64_t h[8][BLAKE2B_LANES];
+  uint64_t t[2][BLAKE2B_LANES];
+  uint64_t f[2][BLAKE2B_LANES];
+} blake2b_lanes;
+
+#define GL(a,b,c,d,x,y) \
+  a = LANES_ADD( LANES_ADD( a, b ), x ); \
+  d = LANES_ROR( LANES_XOR( d, a ), 32 ); \
+  c = LANES_ADD( c, d ); \
+  b = LANES_ROR( LANES_XOR( b, c ), 24 ); \
+  a = LANES_ADD( LANES_ADD( a, b ), y ); \
+  d = LANES_ROR( LANES_XOR( d, a ), 16 ); \
+  c = LANES_ADD( c, d ); \
+  b = LANES_ROR( LANES_XOR( b, c ), 63 );
+
+/* One block per lane; the caller has already advanced L->t */
+static void blake2b_compress_lanes( blake2b_lanes *L, const uint8_t *const block[BLAKE2B_LANES] )
+{
+  uint64_t w[16][BLAKE2B_LANES];
+  LANES_VEC m[16], v[16];
+#if defined(HAVE_AVX2) && !defined(HAVE_AVX512F)
+  const __m256i r16 = _mm256_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m256i r24 = _mm256_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+#elif !defined(HAVE_AVX2) && defined(HAVE_SSSE3) && !defined(HAVE_XOP)
+  const __m128i r16 = _mm_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m128i r24 = _mm_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+#endif
+
+  for( size_t l = 0; l < BLAKE2B_LANES; ++l )
+    for( size_t i = 0; i < 16; ++i )
+      w[i][l] = load64( block[l] + 8 * i );
+
+  for( size_t i = 0; i < 16; ++i ) m[i] = LANES_LOAD( w[i] );
+
+  for( size_t i = 0; i < 8; ++i ) v[i] = LANES_LOAD( L->h[i] );
+
+  for( size_t i = 0; i < 4; ++i ) v[i + 8] = LANES_SET1( blake2b_IV[i] );
+
+  v[12] = LANES_XOR( LANES_SET1( blake2b_IV[4] ), LANES_LOAD( L->t[0] ) );
+  v[13] = LANES_XOR( LANES_SET1( blake2b_IV[5] ), LANES_LOAD( L->t[1] ) );
+  v[14] = LANES_XOR( LANES_SET1( blake2b_IV[6] ), LANES_LOAD( L->f[0] ) );
+  v[15] = LANES_XOR( LANES_SET1( blake2b_IV[7] ), LANES_LOAD( L->f[1] ) );
+
+  for( size_t r = 0; r < 12; ++r )
+  {
+    const uint8_t *s = blake2b_sigma[r];
+    GL( v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]] );
+    GL( v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]] );
+    GL( v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]] );
+    GL( v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]] );
+    GL( v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]] );
+    GL( v[1], v[6], v[11], v[12], m[s[10]], m[s[11]] );
+    GL( v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]] );
+    GL( v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]] );
+  }
+
+  for( size_t i = 0; i < 8; ++i )
+    LANES_STORE( L->h[i], LANES_XOR( LANES_XOR( LANES_LOAD( L->h[i] ), v[i] ), v[i + 8] ) );
+}
+
+#undef GL
+
+/* blake2b_update keeps between 1 and 2 blocks buffered, so only blocks followed by more than 2 blocks' worth of input get compressed */
+static inline uint64_t blake2b_update_blocks( const blake2b_state *S, size_t inlen )
+{
+  const uint64_t pending = ( uint64_t )S->buflen + inlen;
+  return pending > 2 * BLAKE2B_BLOCKBYTES ? ( pending - BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES : 0;
+}
+
+/* Block j of buf || in; a block straddling both is assembled in tmp */
+static inline const uint8_t *blake2b_update_block( const blake2b_update_item *I, uint64_t j, uint8_t tmp[BLAKE2B_BLOCKBYTES] )
+{
+  const size_t left = I->S->buflen;
+  const uint64_t offset = j * BLAKE2B_BLOCKBYTES;
+
+  if( offset + BLAKE2B_BLOCKBYTES <= left ) return I->S->buf + offset;
+
+  if( offset >= left ) return I->in + ( offset - left );
+
+  memcpy( tmp, I->S->buf + offset, left - offset );
+  memcpy( tmp + ( left - offset ), I->in, BLAKE2B_BLOCKBYTES - ( left - offset ) );
+  return tmp;
+}
+
+/* Leaves what follows the first nblocks blocks of buf || in in the buffer, as blake2b_update would */
+static inline void blake2b_update_rebuffer( const blake2b_update_item *I, uint64_t nblocks )
+{
+  blake2b_state *S = I->S;
+  const size_t left = S->buflen;
+  const uint64_t offset = nblocks * BLAKE2B_BLOCKBYTES;
+
+  if( offset < left )
+  {
+    memmove( S->buf, S->buf + offset, left - offset );
+    if( I->inlen ) memcpy( S->buf + ( left - offset ), I->in, I->inlen );
+    S->buflen = ( uint32_t )( left - offset + I->inlen );
+  }
+  else
+  {
+    memcpy( S->buf, I->in + ( offset - left ), ( size_t )( left + I->inlen - offset ) );
+    S->buflen = ( uint32_t )( left + I->inlen - offset );
+  }
+}
+
+int blake2b_update_multi( const blake2b_update_item *items, size_t count )
+{
+  static const uint8_t zero[BLAKE2B_BLOCKBYTES] = {0};
+  uint8_t tmp[BLAKE2B_LANES][BLAKE2B_BLOCKBYTES];
+  size_t item[BLAKE2B_LANES];
+  uint64_t done[BLAKE2B_LANES], todo[BLAKE2B_LANES];
+  blake2b_lanes L[1];
+  size_t next = 0, active = 0;
+
+  if( NULL == items && count > 0 ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+    if( NULL == items[i].S || ( NULL == items[i].in && items[i].inlen > 0 ) ) return -1;
+
+  memset( L, 0, sizeof( L ) );
+
+  for( size_t l = 0; l < BLAKE2B_LANES; ++l ) todo[l] = 0;
+
+  for( ;; )
+  {
+    /* Hand idle lanes the next states with whole blocks to compress; the rest only buffer */
+    for( size_t l = 0; l < BLAKE2B_LANES; ++l )
+    {
+      if( todo[l] ) continue;
+
+      while( next < count && 0 == blake2b_update_blocks( items[next].S, items[next].inlen ) )
+      {
+        blake2b_update_rebuffer( &items[next], 0 );
+        ++next;
+      }
+
+      if( next == count ) continue;
+
+      item[l] = next;
+      done[l] = 0;
+      todo[l] = blake2b_update_blocks( items[next].S, items[next].inlen );
+
+      for( size_t i = 0; i < 8; ++i ) L->h[i][l] = items[next].S->h[i];
+
+      for( size_t i = 0; i < 2; ++i )
+      {
+        L->t[i][l] = items[next].S->t[i];
+        L->f[i][l] = items[next].S->f[i];
+      }
+
+      ++active;
+      ++next;
+    }
+
+    if( 0 == active ) break;
+
+    {
+      const uint8_t *block[BLAKE2B_LANES];
+
+      for( size_t l = 0; l < BLAKE2B_LANES; ++l )
+      {
+        if( !todo[l] )
+        {
+          block[l] = zero;
+          continue;
+        }
+
+        block[l] = blake2b_update_block( &items[item[l]], done[l], tmp[l] );
+        L->t[0][l] += BLAKE2B_BLOCKBYTES;
+        L->t[1][l] += ( L->t[0][l] < BLAKE2B_BLOCKBYTES );
+      }
+
+      blake2b_compress_lanes( L, block );
+    }
+
+    for( size_t l = 0; l < BLAKE2B_LANES; ++l )
+    {
+      blake2b_state *S;
+
+      if( !todo[l] || ++done[l] < todo[l] ) continue;
+
+      S = items[item[l]].S;
+
+      for( size_t i = 0; i < 8; ++i ) S->h[i] = L->h[i][l];
+
+      S->t[0] = L->t[0][l];
+      S->t[1] = L->t[1][l];
+      blake2b_update_rebuffer( &items[item[l]], todo[l] );
+      todo[l] = 0;
+      --active;
+    }
+  }
+
+  secure_zero_memory( tmp, sizeof( tmp ) );
+  secure_zero_memory( L, sizeof( L ) );
+  return 0;
+}
+
+/*
+   One-shot path for inputs of at most one block: the chaining value comes
+   straight from the default parameter block and the message is padded on the
+   stack, so only h, t and f of S are ever touched.
+*/
+static int blake2b_one_block( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+{
+  blake2b_state S[1];
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint8_t buffer[BLAKE2B_OUTBYTES];
+
+  for( int i = 0; i < 8; ++i ) S->h[i] = blake2b_IV[i];
+
+  /* digest_length, key_length, fanout = 1, depth = 1 */
+  S->h[0] ^= 0x01010000UL ^ ( keylen << 8 ) ^ outlen;
+  S->t[1] = 0;
+  S->f[1] = 0;
+
+  if( keylen > 0 )
+  {
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+    memcpy( block, key, keylen );
+    S->t[0] = BLAKE2B_BLOCKBYTES;
+    S->f[0] = inlen > 0 ? 0 : ~0ULL;
+    blake2b_compress( S, block );
+  }
+
+  if( inlen > 0 || 0 == keylen )
+  {
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+
+    if( inlen > 0 ) memcpy( block, in, inlen );
+
+    S->t[0] = ( keylen > 0 ? BLAKE2B_BLOCKBYTES : 0 ) + inlen;
+    S->f[0] = ~0ULL;
+    blake2b_compress( S, block );
+  }
+
+  for( int i = 0; i < 8; ++i )
+    store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+
+  if( keylen > 0 ) secure_zero_memory( block, sizeof( block ) ); /* Burn the key from stack */
+
+  return 0;
+}
 
 int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
@@ -422,6 +1194,8 @@ int blake2b( uint8_t *out, const void *in, const void *key, size_t outlen, size_
 
   if( keylen > BLAKE2B_KEYBYTES ) return -1;
 
+  if( inlen <= BLAKE2B_BLOCKBYTES ) return blake2b_one_block( out, in, key, outlen, inlen, keylen );
+
   if( keylen )
   {
     if( blake2b_init_key( S, outlen, key, keylen ) < 0 ) return -1;
@@ -142,7 +142,14 @@ static inline int blake2s_init0( blake2s_state *S )
 #define blake2s_init_param BLAKE2_IMPL_NAME(blake2s_init_param)
 #define blake2s_init_key BLAKE2_IMPL_NAME(blake2s_init_key)
 #define blake2s_update BLAKE2_IMPL_NAME(blake2s_update)
+#define blake2s_updatev BLAKE2_IMPL_NAME(blake2s_updatev)
+#define blake2s_update_copy BLAKE2_IMPL_NAME(blake2s_update_copy)
 #define blake2s_final BLAKE2_IMPL_NAME(blake2s_final)
+#define blake2s_final_peek BLAKE2_IMPL_NAME(blake2s_final_peek)
+#define blake2s_compress_blocks BLAKE2_IMPL_NAME(blake2s_compress_blocks)
+#define blake2s_v2_update BLAKE2_IMPL_NAME(blake2s_v2_update)
+#define blake2s_v2_final BLAKE2_IMPL_NAME(blake2s_v2_final)
+#define blake2s_verify_batch BLAKE2_IMPL_NAME(blake2s_verify_batch)
 #define blake2s BLAKE2_IMPL_NAME(blake2s)
 
 #if defined(__cplusplus)
@@ -152,7 +159,14 @@ extern "C" {
   int blake2s_init_param( blake2s_state *S, const blake2s_param *P );
   int blake2s_init_key( blake2s_state *S, size_t outlen, const void *key, size_t keylen );
   int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen );
+  int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
+  int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
   int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 #if defined(__cplusplus)
 }
@@ -227,7 +241,8 @@ int blake2s_init_key( blake2s_state *S, size_t outlen, const void *key, size_t k
   return 0;
 }
 
-static int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+/* Works on the chaining value, counter and flags directly, so the v2 state shares it */
+static int blake2s_compress_words( uint32_t h[8], const uint32_t t[2], const uint32_t f[2], const uint8_t block[BLAKE2S_BLOCKBYTES] )
 {
   uint32_t m[16];
   uint32_t v[16];
@@ -236,16 +251,16 @@ static int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCK
     m[i] = load32( block + i * sizeof( m[i] ) );
 
   for( size_t i = 0; i < 8; ++i )
-    v[i] = S->h[i];
+    v[i] = h[i];
 
   v[ 8] = blake2s_IV[0];
   v[ 9] = blake2s_IV[1];
   v[10] = blake2s_IV[2];
   v[11] = blake2s_IV[3];
-  v[12] = S->t[0] ^ blake2s_IV[4];
-  v[13] = S->t[1] ^ blake2s_IV[5];
-  v[14] = S->f[0] ^ blake2s_IV[6];
-  v[15] = S->f[1] ^ blake2s_IV[7];
+  v[12] = t[0] ^ blake2s_IV[4];
+  v[13] = t[1] ^ blake2s_IV[5];
+  v[14] = f[0] ^ blake2s_IV[6];
+  v[15] = f[1] ^ blake2s_IV[7];
 #define G(r,i,a,b,c,d) \
   do { \
     a = a + b + m[blake2s_sigma[r][2*i+0]]; \
@@ -280,13 +295,23 @@ static int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCK
   ROUND( 9 );
 
   for( size_t i = 0; i < 8; ++i )
-    S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
+    h[i] = h[i] ^ v[i] ^ v[i + 8];
 
 #undef G
 #undef ROUND
   return 0;
 }
 
+static int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+{
+  return blake2s_compress_words( S->h, S->t, S->f, block );
+}
+
+static int blake2s_v2_compress( blake2s_state_v2 *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+{
+  return blake2s_compress_words( S->h, S->t, S->f, block );
+}
+
 
 int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen )
 {
@@ -318,6 +343,115 @@ int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen )
   return 0;
 }
 
+/*
+   Same buffering rule as blake2s_update, applied to the concatenation of the
+   fragments: blocks lying inside one fragment are compressed where they are,
+   only blocks straddling the buffer or a fragment boundary are assembled on
+   the stack, and the final one to two blocks are left in the buffer.
+*/
+int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  const size_t left = S->buflen;
+  uint64_t total = left, nblocks;
+  size_t pos = 0, seg = 0, off = 0, n;
+
+  if( iovcnt < 0 || ( NULL == iov && iovcnt > 0 ) ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+  {
+    if( NULL == iov[i].iov_base && iov[i].iov_len > 0 ) return -1;
+
+    total += iov[i].iov_len;
+  }
+
+  nblocks = total > 2 * BLAKE2S_BLOCKBYTES ? ( total - BLAKE2S_BLOCKBYTES - 1 ) / BLAKE2S_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    const uint8_t *p;
+
+    while( seg < ( size_t )iovcnt && off == iov[seg].iov_len )
+    {
+      ++seg;
+      off = 0;
+    }
+
+    if( left - pos >= BLAKE2S_BLOCKBYTES )
+    {
+      p = S->buf + pos;
+      pos += BLAKE2S_BLOCKBYTES;
+    }
+    else if( pos == left && iov[seg].iov_len - off >= BLAKE2S_BLOCKBYTES )
+    {
+      p = ( const uint8_t * )iov[seg].iov_base + off;
+      off += BLAKE2S_BLOCKBYTES;
+    }
+    else
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      pos = left;
+
+      while( n < BLAKE2S_BLOCKBYTES )
+      {
+        size_t take = iov[seg].iov_len - off;
+
+        if( take > BLAKE2S_BLOCKBYTES - n ) take = BLAKE2S_BLOCKBYTES - n;
+
+        memcpy( block + n, ( const uint8_t * )iov[seg].iov_base + off, take );
+        n += take;
+        off += take;
+
+        if( off == iov[seg].iov_len )
+        {
+          ++seg;
+          off = 0;
+        }
+      }
+
+      p = block;
+    }
+
+    blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
+    blake2s_compress( S, p );
+  }
+
+  /* Whatever is left, at most two blocks, becomes the new buffer */
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  for( ; seg < ( size_t )iovcnt; ++seg, off = 0 )
+  {
+    if( off == iov[seg].iov_len ) continue;
+
+    memcpy( S->buf + n, ( const uint8_t * )iov[seg].iov_base + off, iov[seg].iov_len - off );
+    n += iov[seg].iov_len - off;
+  }
+
+  S->buflen = ( uint32_t )n;
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
+/* Copies and hashes page-sized pieces, so src is read from memory once and hashed from L1 */
+int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  if( len > 0 && ( NULL == dst || NULL == src ) ) return -1;
+
+  while( len > 0 )
+  {
+    const size_t n = len < 4096 ? len : 4096;
+    memcpy( dst, src, n );
+    blake2s_update( S, src, n );
+    dst += n;
+    src += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
 int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
 {
   uint8_t buffer[BLAKE2S_OUTBYTES];
@@ -325,6 +459,12 @@ int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
 
   if(S->outlen != outlen) return -1;
 
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
   if( S->buflen > BLAKE2S_BLOCKBYTES )
   {
     blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
@@ -345,6 +485,197 @@ int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
   return 0;
 }
 
+/*
+   Digest of everything absorbed so far, leaving S untouched: the chaining
+   value, counter and flags are copied to the stack and only the buffered
+   bytes are read, so checkpointing a stream costs one or two compressions.
+*/
+int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+  uint32_t h[8], t[2], f[2];
+  const uint8_t *p = S->buf;
+  size_t left = S->buflen;
+
+  if( S->outlen != outlen ) return -1;
+
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
+  memcpy( h, S->h, sizeof( h ) );
+  t[0] = S->t[0];
+  t[1] = S->t[1];
+  f[0] = 0;
+  f[1] = 0;
+
+  if( left > BLAKE2S_BLOCKBYTES )
+  {
+    t[0] += BLAKE2S_BLOCKBYTES;
+    t[1] += ( t[0] < BLAKE2S_BLOCKBYTES );
+    blake2s_compress_words( h, t, f, p );
+    p += BLAKE2S_BLOCKBYTES;
+    left -= BLAKE2S_BLOCKBYTES;
+  }
+
+  memcpy( block, p, left );
+  memset( block + left, 0, BLAKE2S_BLOCKBYTES - left ); /* Padding */
+  t[0] += ( uint32_t )left;
+  t[1] += ( t[0] < ( uint32_t )left );
+  f[0] = ( uint32_t )-1;
+
+  if( S->last_node ) f[1] = ( uint32_t )-1;
+
+  blake2s_compress_words( h, t, f, block );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store32( buffer + sizeof( h[i] ) * i, h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] )
+{
+  uint32_t H[8], T[2], F[2] = { 0, 0 };
+
+  if( NULL == h || NULL == t || ( nblocks && NULL == blocks ) || lastlen > BLAKE2S_BLOCKBYTES ) return -1;
+
+  memcpy( H, h, sizeof( H ) );
+  T[0] = t[0];
+  T[1] = t[1];
+
+  for( size_t i = 0; i < nblocks; ++i, blocks += BLAKE2S_BLOCKBYTES )
+  {
+    const uint32_t inc = i + 1 == nblocks ? ( uint32_t )lastlen : BLAKE2S_BLOCKBYTES;
+
+    T[0] += inc;
+    T[1] += ( T[0] < inc );
+
+    if( i + 1 == nblocks && f )
+    {
+      F[0] = f[0];
+      F[1] = f[1];
+    }
+
+    blake2s_compress_words( H, T, F, blocks );
+  }
+
+  memcpy( h, H, sizeof( H ) );
+  t[0] = T[0];
+  t[1] = T[1];
+  return 0;
+}
+
+static inline void blake2s_v2_increment_counter( blake2s_state_v2 *S, const uint32_t inc )
+{
+  S->t[0] += inc;
+  S->t[1] += ( S->t[0] < inc );
+}
+
+/* One-block buffer: a full block stays buffered until more input shows it is not the last */
+int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  if( 0 == inlen ) return 0;
+
+  if( NULL == in ) return -1;
+
+  if( inlen > BLAKE2S_BLOCKBYTES - S->buflen )
+  {
+    const size_t fill = BLAKE2S_BLOCKBYTES - S->buflen;
+    memcpy( S->buf + S->buflen, in, fill );
+    blake2s_v2_increment_counter( S, BLAKE2S_BLOCKBYTES );
+    blake2s_v2_compress( S, S->buf );
+    S->buflen = 0;
+    in += fill;
+    inlen -= fill;
+
+    while( inlen > BLAKE2S_BLOCKBYTES )
+    {
+      blake2s_v2_increment_counter( S, BLAKE2S_BLOCKBYTES );
+      blake2s_v2_compress( S, in );
+      in += BLAKE2S_BLOCKBYTES;
+      inlen -= BLAKE2S_BLOCKBYTES;
+    }
+  }
+
+  memcpy( S->buf + S->buflen, in, inlen );
+  S->buflen += ( uint32_t ) inlen;
+  return 0;
+}
+
+int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+
+  if( S->outlen != outlen || S->f[0] ) return -1;
+
+  blake2s_v2_increment_counter( S, S->buflen );
+  S->f[0] = ( uint32_t )-1;
+
+  if( S->last_node ) S->f[1] = ( uint32_t )-1;
+
+  memset( S->buf + S->buflen, 0, BLAKE2S_BLOCKBYTES - S->buflen ); /* Padding */
+  blake2s_v2_compress( S, S->buf );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store32( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+/*
+   One-shot path for inputs of at most one block: the chaining value comes
+   straight from the default parameter block and the message is padded on the
+   stack, so only h, t and f of S are ever touched.
+*/
+static int blake2s_one_block( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+{
+  blake2s_state S[1];
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+
+  for( int i = 0; i < 8; ++i ) S->h[i] = blake2s_IV[i];
+
+  /* digest_length, key_length, fanout = 1, depth = 1 */
+  S->h[0] ^= 0x01010000UL ^ ( keylen << 8 ) ^ outlen;
+  S->t[1] = 0;
+  S->f[1] = 0;
+
+  if( keylen > 0 )
+  {
+    memset( block, 0, BLAKE2S_BLOCKBYTES );
+    memcpy( block, key, keylen );
+    S->t[0] = BLAKE2S_BLOCKBYTES;
+    S->f[0] = inlen > 0 ? 0 : ~0U;
+    blake2s_compress( S, block );
+  }
+
+  if( inlen > 0 || 0 == keylen )
+  {
+    memset( block, 0, BLAKE2S_BLOCKBYTES );
+
+    if( inlen > 0 ) memcpy( block, in, inlen );
+
+    S->t[0] = ( keylen > 0 ? BLAKE2S_BLOCKBYTES : 0 ) + inlen;
+    S->f[0] = ~0U;
+    blake2s_compress( S, block );
+  }
+
+  for( int i = 0; i < 8; ++i )
+    store32( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+
+  if( keylen > 0 ) secure_zero_memory( block, sizeof( block ) ); /* Burn the key from stack */
+
+  return 0;
+}
+
 int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   blake2s_state S[1];
@@ -360,6 +691,8 @@ int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_
 
   if( keylen > BLAKE2S_KEYBYTES ) return -1;
 
+  if( inlen <= BLAKE2S_BLOCKBYTES ) return blake2s_one_block( out, in, key, outlen, inlen, keylen );
+
   if( keylen > 0 )
   {
     if( blake2s_init_key( S, outlen, key, keylen ) < 0 ) return -1;
@@ -373,3 +706,48 @@ int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_
   return blake2s_final( S, out, outlen );
 }
 
+/* Folds the tag difference into one bit without branching on where the tags differ */
+static inline uint32_t blake2s_tag_equal( const uint8_t *a, const uint8_t *b, size_t n )
+{
+  uint32_t d = 0;
+
+  for( size_t i = 0; i < n; ++i ) d |= a[i] ^ b[i];
+
+  return 1 & ( ( d - 1 ) >> 8 );
+}
+
+static int blake2s_verify_check( const uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  if( NULL == bitmap || ( NULL == items && count > 0 ) ) return -1;
+
+  if( !taglen || taglen > BLAKE2S_OUTBYTES ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    const blake2s_mac_item *I = &items[i];
+
+    if( NULL == I->tag || ( NULL == I->in && I->inlen > 0 ) ) return -1;
+
+    if( ( NULL == I->key && I->keylen > 0 ) || I->keylen > BLAKE2S_KEYBYTES ) return -1;
+  }
+
+  return 0;
+}
+
+int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  uint8_t mac[BLAKE2S_OUTBYTES];
+
+  if( blake2s_verify_check( bitmap, items, count, taglen ) < 0 ) return -1;
+
+  memset( bitmap, 0, ( count + 7 ) / 8 );
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    blake2s( mac, items[i].in, items[i].key, taglen, items[i].inlen, items[i].keylen );
+    bitmap[i / 8] |= ( uint8_t )( blake2s_tag_equal( mac, items[i].tag, taglen ) << ( i % 8 ) );
+  }
+
+  secure_zero_memory( mac, sizeof( mac ) );
+  return 0;
+}
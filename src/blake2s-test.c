@@ -11,9 +11,184 @@
    this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "blake2.h"
 #include "blake2-kat.h"
+#include "blake2-small.h"
+
+/* Every KAT entry as one burst, with every fifth tag corrupted, then mixed key lengths against blake2s() */
+static int test_verify_batch( const uint8_t *key, const uint8_t *buf )
+{
+  static blake2s_mac_item items[KAT_LENGTH];
+  static uint8_t tags[KAT_LENGTH][BLAKE2S_OUTBYTES];
+  uint8_t bitmap[KAT_LENGTH / 8];
+
+  for( size_t i = 0; i < KAT_LENGTH; ++i )
+  {
+    memcpy( tags[i], blake2s_keyed_kat[i], BLAKE2S_OUTBYTES );
+
+    if( i % 5 == 3 ) tags[i][i % BLAKE2S_OUTBYTES] ^= 0x80;
+
+    items[i].key = key;
+    items[i].keylen = BLAKE2S_KEYBYTES;
+    items[i].in = buf;
+    items[i].inlen = i;
+    items[i].tag = tags[i];
+  }
+
+  if( blake2s_verify_batch( bitmap, items, KAT_LENGTH, BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  for( size_t i = 0; i < KAT_LENGTH; ++i )
+    if( ( ( bitmap[i / 8] >> ( i % 8 ) ) & 1 ) != ( i % 5 != 3 ) ) return -1;
+
+  for( size_t i = 0; i < KAT_LENGTH; ++i )
+  {
+    items[i].keylen = ( i * 7 ) % ( BLAKE2S_KEYBYTES + 1 );
+    items[i].inlen = ( i * 13 ) % KAT_LENGTH;
+    blake2s( tags[i], buf, key, 16, items[i].inlen, items[i].keylen );
+  }
+
+  /* An odd count leaves the last group of lanes partly empty */
+  if( blake2s_verify_batch( bitmap, items, KAT_LENGTH - 3, 16 ) < 0 ) return -1;
+
+  for( size_t i = 0; i < KAT_LENGTH - 3; ++i )
+    if( ( ( bitmap[i / 8] >> ( i % 8 ) ) & 1 ) != 1 ) return -1;
+
+  return 0;
+}
+
+/* Past the 1 MiB non-temporal store threshold */
+#define BLAKE2_COPY_BIG ( ( 3 << 20 ) + 200 )
+
+/* update_copy must leave dst equal to src and the state where update leaves it, streaming or not */
+static int test_update_copy( void )
+{
+  static const size_t lengths[] = { 0, 1, 63, 64, 65, 127, 128, 129, 1000, 4096, BLAKE2_COPY_BIG };
+  static const size_t prefixes[] = { 0, 1, 64, 129, 256 };
+  uint8_t *src = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  uint8_t *dst = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  int ret = -1;
+
+  if( !src || !dst ) goto out;
+
+  for( size_t i = 0; i < BLAKE2_COPY_BIG + 8; ++i )
+    src[i] = ( uint8_t )( i * 13 + 1 );
+
+  for( size_t i = 0; i < sizeof( lengths ) / sizeof( lengths[0] ); ++i )
+    for( size_t j = 0; j < sizeof( prefixes ) / sizeof( prefixes[0] ); ++j )
+      for( size_t skew = 0; skew < 16; skew += 8 )
+      {
+        uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+        blake2s_state S[1], R[1];
+
+        blake2s_init( S, BLAKE2S_OUTBYTES );
+        blake2s_update( S, src, prefixes[j] );
+        memcpy( R, S, sizeof( S ) );
+        memset( dst, 0, BLAKE2_COPY_BIG + 8 );
+
+        if( blake2s_update_copy( S, dst + skew, src + skew, lengths[i] ) < 0 ||
+            0 != memcmp( dst + skew, src + skew, lengths[i] ) )
+          goto out;
+
+        blake2s_update( R, src + skew, lengths[i] );
+        blake2s_final( S, a, BLAKE2S_OUTBYTES );
+        blake2s_final( R, b, BLAKE2S_OUTBYTES );
+
+        if( 0 != memcmp( a, b, sizeof( a ) ) ) goto out;
+      }
+
+  ret = 0;
+out:
+  free( src );
+  free( dst );
+  return ret;
+}
+
+/* The one-block paths, library and header alike, must agree with the streaming API */
+static int test_small( const uint8_t *key, const uint8_t *buf )
+{
+  static const size_t keylens[] = { 0, 1, BLAKE2S_KEYBYTES };
+  static const size_t outlens[] = { 1, 20, BLAKE2S_OUTBYTES };
+
+  for( size_t inlen = 0; inlen <= BLAKE2S_BLOCKBYTES + 1; ++inlen )
+    for( size_t k = 0; k < 3; ++k )
+      for( size_t o = 0; o < 3; ++o )
+      {
+        uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES], c[BLAKE2S_OUTBYTES];
+        blake2s_state S[1];
+
+        if( keylens[k] ) blake2s_init_key( S, outlens[o], key, keylens[k] );
+        else blake2s_init( S, outlens[o] );
+
+        blake2s_update( S, buf, inlen );
+        blake2s_final( S, a, outlens[o] );
+
+        if( blake2s( b, buf, key, outlens[o], inlen, keylens[k] ) < 0 || 0 != memcmp( a, b, outlens[o] ) )
+          return -1;
+
+        /* The header only takes a single block */
+        if( inlen > BLAKE2S_BLOCKBYTES )
+        {
+          if( blake2s_small( c, buf, key, outlens[o], inlen, keylens[k] ) == 0 ) return -1;
+        }
+        else if( blake2s_small( c, buf, key, outlens[o], inlen, keylens[k] ) < 0 || 0 != memcmp( a, c, outlens[o] ) )
+          return -1;
+      }
+
+  return 0;
+}
+
+/* Keyed hashes of the non-empty KAT messages rebuilt from the raw compression function, the last block counted with its real length */
+static int test_compress_blocks( const uint8_t *key, const uint8_t *buf )
+{
+  uint8_t blocks[BLAKE2S_BLOCKBYTES + KAT_LENGTH + BLAKE2S_BLOCKBYTES];
+  static const uint32_t f[2] = { ( uint32_t )-1, 0 };
+  uint8_t out[BLAKE2S_OUTBYTES], expect[BLAKE2S_OUTBYTES];
+  uint32_t t[2] = { 0, 0 };
+  blake2s_state S[1];
+
+  for( size_t len = 1; len < KAT_LENGTH; ++len )
+  {
+    const size_t n = ( len + BLAKE2S_BLOCKBYTES - 1 ) / BLAKE2S_BLOCKBYTES;
+
+    memset( blocks, 0, sizeof( blocks ) );
+    memcpy( blocks, key, BLAKE2S_KEYBYTES );
+    memcpy( blocks + BLAKE2S_BLOCKBYTES, buf, len );
+    blake2s_init_key( S, BLAKE2S_OUTBYTES, key, BLAKE2S_KEYBYTES );
+    t[0] = t[1] = 0;
+
+    /* The key block alone, then the message in one run carrying the final flag */
+    if( blake2s_compress_blocks( S->h, blocks, 1, BLAKE2S_BLOCKBYTES, t, NULL ) < 0 ||
+        blake2s_compress_blocks( S->h, blocks + BLAKE2S_BLOCKBYTES, n, len - ( n - 1 ) * BLAKE2S_BLOCKBYTES, t, f ) < 0 )
+      return -1;
+
+    if( t[0] != BLAKE2S_BLOCKBYTES + len || t[1] != 0 ) return -1;
+
+    for( size_t i = 0; i < BLAKE2S_OUTBYTES; ++i )
+      out[i] = ( uint8_t )( S->h[i / sizeof( S->h[0] )] >> ( 8 * ( i % sizeof( S->h[0] ) ) ) );
+
+    if( 0 != memcmp( out, blake2s_keyed_kat[len], BLAKE2S_OUTBYTES ) ) return -1;
+  }
+
+  /* An unkeyed message shorter than a block, finished in one call without wrapping the counter */
+  memset( blocks, 0, sizeof( blocks ) );
+  memcpy( blocks, buf, 3 );
+  blake2s_init( S, BLAKE2S_OUTBYTES );
+  t[0] = t[1] = 0;
+
+  if( blake2s_compress_blocks( S->h, blocks, 1, 3, t, f ) < 0 || t[0] != 3 || t[1] != 0 ) return -1;
+
+  for( size_t i = 0; i < BLAKE2S_OUTBYTES; ++i )
+    out[i] = ( uint8_t )( S->h[i / sizeof( S->h[0] )] >> ( 8 * ( i % sizeof( S->h[0] ) ) ) );
+
+  blake2s( expect, buf, NULL, BLAKE2S_OUTBYTES, 3, 0 );
+
+  if( 0 != memcmp( out, expect, BLAKE2S_OUTBYTES ) ) return -1;
+
+  return blake2s_compress_blocks( S->h, blocks, 1, BLAKE2S_BLOCKBYTES + 1, t, f ) < 0 ? 0 : -1;
+}
+
 int main( int argc, char **argv )
 {
   uint8_t key[BLAKE2S_KEYBYTES];
@@ -37,6 +212,13 @@ int main( int argc, char **argv )
     }
   }
 
+  if( test_verify_batch( key, buf ) < 0 || test_update_copy() < 0 || test_small( key, buf ) < 0 ||
+      test_compress_blocks( key, buf ) < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
   puts( "ok" );
   return 0;
 }
@@ -179,7 +179,14 @@ static inline int blake2s_init0( blake2s_state *S )
 #define blake2s_init_param BLAKE2_IMPL_NAME(blake2s_init_param)
 #define blake2s_init_key BLAKE2_IMPL_NAME(blake2s_init_key)
 #define blake2s_update BLAKE2_IMPL_NAME(blake2s_update)
+#define blake2s_updatev BLAKE2_IMPL_NAME(blake2s_updatev)
+#define blake2s_update_copy BLAKE2_IMPL_NAME(blake2s_update_copy)
 #define blake2s_final BLAKE2_IMPL_NAME(blake2s_final)
+#define blake2s_final_peek BLAKE2_IMPL_NAME(blake2s_final_peek)
+#define blake2s_compress_blocks BLAKE2_IMPL_NAME(blake2s_compress_blocks)
+#define blake2s_v2_update BLAKE2_IMPL_NAME(blake2s_v2_update)
+#define blake2s_v2_final BLAKE2_IMPL_NAME(blake2s_v2_final)
+#define blake2s_verify_batch BLAKE2_IMPL_NAME(blake2s_verify_batch)
 #define blake2s BLAKE2_IMPL_NAME(blake2s)
 
 #if defined(__cplusplus)
@@ -189,7 +196,14 @@ extern "C" {
   int blake2s_init_param( blake2s_state *S, const blake2s_param *P );
   int blake2s_init_key( blake2s_state *S, size_t outlen, const void *key, size_t keylen );
   int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen );
+  int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt );
+  int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len );
   int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen );
+  int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] );
+  int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen );
+  int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen );
+  int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen );
   int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen );
 #if defined(__cplusplus)
 }
@@ -270,7 +284,16 @@ int blake2s_init_key( blake2s_state *S, size_t outlen, const void *key, size_t k
 }
 
 
-static inline int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+/*
+   The chaining value, counter and flags are passed as words so that both the
+   packed state and the aligned v2 state share one kernel; aligned is a
+   constant at every call site and selects aligned loads and stores for them.
+*/
+#define LOADH(p) ( aligned ? LOAD( p ) : LOADU( p ) )
+#define STOREH(p,r) do { if( aligned ) _mm_store_si128( ( __m128i * )( p ), r ); else STOREU( p, r ); } while(0)
+
+static inline int blake2s_compress_words( uint32_t h[8], const uint32_t t[2], const uint32_t f[2],
+    const uint8_t block[BLAKE2S_BLOCKBYTES], const int aligned )
 {
   __m128i row1, row2, row3, row4;
   __m128i buf1, buf2, buf3, buf4;
@@ -308,10 +331,11 @@ static inline int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2
   const uint32_t m14 = ( ( uint32_t * )block )[14];
   const uint32_t m15 = ( ( uint32_t * )block )[15];
 #endif
-  row1 = ff0 = LOADU( &S->h[0] );
-  row2 = ff1 = LOADU( &S->h[4] );
+  row1 = ff0 = LOADH( &h[0] );
+  row2 = ff1 = LOADH( &h[4] );
   row3 = _mm_setr_epi32( 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A );
-  row4 = _mm_xor_si128( _mm_setr_epi32( 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 ), LOADU( &S->t[0] ) );
+  row4 = _mm_xor_si128( _mm_setr_epi32( 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 ),
+                        _mm_unpacklo_epi64( _mm_loadl_epi64( ( const __m128i * )t ), _mm_loadl_epi64( ( const __m128i * )f ) ) );
   ROUND( 0 );
   ROUND( 1 );
   ROUND( 2 );
@@ -322,11 +346,24 @@ static inline int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2
   ROUND( 7 );
   ROUND( 8 );
   ROUND( 9 );
-  STOREU( &S->h[0], _mm_xor_si128( ff0, _mm_xor_si128( row1, row3 ) ) );
-  STOREU( &S->h[4], _mm_xor_si128( ff1, _mm_xor_si128( row2, row4 ) ) );
+  STOREH( &h[0], _mm_xor_si128( ff0, _mm_xor_si128( row1, row3 ) ) );
+  STOREH( &h[4], _mm_xor_si128( ff1, _mm_xor_si128( row2, row4 ) ) );
   return 0;
 }
 
+#undef STOREH
+#undef LOADH
+
+static inline int blake2s_compress( blake2s_state *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+{
+  return blake2s_compress_words( S->h, S->t, S->f, block, 0 );
+}
+
+static inline int blake2s_v2_compress( blake2s_state_v2 *S, const uint8_t block[BLAKE2S_BLOCKBYTES] )
+{
+  return blake2s_compress_words( S->h, S->t, S->f, block, 1 );
+}
+
 
 int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen )
 {
@@ -358,6 +395,170 @@ int blake2s_update( blake2s_state *S, const uint8_t *in, size_t inlen )
   return 0;
 }
 
+/*
+   Same buffering rule as blake2s_update, applied to the concatenation of the
+   fragments: blocks lying inside one fragment are compressed where they are,
+   only blocks straddling the buffer or a fragment boundary are assembled on
+   the stack, and the final one to two blocks are left in the buffer.
+*/
+int blake2s_updatev( blake2s_state *S, const struct iovec *iov, int iovcnt )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  const size_t left = S->buflen;
+  uint64_t total = left, nblocks;
+  size_t pos = 0, seg = 0, off = 0, n;
+
+  if( iovcnt < 0 || ( NULL == iov && iovcnt > 0 ) ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+  {
+    if( NULL == iov[i].iov_base && iov[i].iov_len > 0 ) return -1;
+
+    total += iov[i].iov_len;
+  }
+
+  nblocks = total > 2 * BLAKE2S_BLOCKBYTES ? ( total - BLAKE2S_BLOCKBYTES - 1 ) / BLAKE2S_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    const uint8_t *p;
+
+    while( seg < ( size_t )iovcnt && off == iov[seg].iov_len )
+    {
+      ++seg;
+      off = 0;
+    }
+
+    if( left - pos >= BLAKE2S_BLOCKBYTES )
+    {
+      p = S->buf + pos;
+      pos += BLAKE2S_BLOCKBYTES;
+    }
+    else if( pos == left && iov[seg].iov_len - off >= BLAKE2S_BLOCKBYTES )
+    {
+      p = ( const uint8_t * )iov[seg].iov_base + off;
+      off += BLAKE2S_BLOCKBYTES;
+    }
+    else
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      pos = left;
+
+      while( n < BLAKE2S_BLOCKBYTES )
+      {
+        size_t take = iov[seg].iov_len - off;
+
+        if( take > BLAKE2S_BLOCKBYTES - n ) take = BLAKE2S_BLOCKBYTES - n;
+
+        memcpy( block + n, ( const uint8_t * )iov[seg].iov_base + off, take );
+        n += take;
+        off += take;
+
+        if( off == iov[seg].iov_len )
+        {
+          ++seg;
+          off = 0;
+        }
+      }
+
+      p = block;
+    }
+
+    blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
+    blake2s_compress( S, p );
+  }
+
+  /* Whatever is left, at most two blocks, becomes the new buffer */
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  for( ; seg < ( size_t )iovcnt; ++seg, off = 0 )
+  {
+    if( off == iov[seg].iov_len ) continue;
+
+    memcpy( S->buf + n, ( const uint8_t * )iov[seg].iov_base + off, iov[seg].iov_len - off );
+    n += iov[seg].iov_len - off;
+  }
+
+  S->buflen = ( uint32_t )n;
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
+/* Copies one block through registers; the compression that follows reads src from L1 */
+static inline void blake2s_copy_block( uint8_t *dst, const uint8_t *src, int stream )
+{
+  for( size_t i = 0; i < BLAKE2S_BLOCKBYTES; i += 16 )
+  {
+    const __m128i m = LOADU( src + i );
+
+    if( stream ) _mm_stream_si128( ( __m128i * )( dst + i ), m );
+    else STOREU( dst + i, m );
+  }
+}
+
+/*
+   memcpy( dst, src, len ) followed by blake2s_update( S, src, len ), in one
+   pass: every block compressed straight from src is first stored to dst from
+   the registers that loaded it. Large copies to 16-byte aligned destinations
+   use non-temporal stores so dst does not evict the working set.
+*/
+int blake2s_update_copy( blake2s_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  const size_t left = S->buflen;
+  const int stream = len >= BLAKE2_STREAM_BYTES;
+  uint64_t nblocks;
+  size_t pos = 0, off = 0, n;
+
+  if( len > 0 && ( NULL == dst || NULL == src ) ) return -1;
+
+  nblocks = left + len > 2 * BLAKE2S_BLOCKBYTES ? ( left + len - BLAKE2S_BLOCKBYTES - 1 ) / BLAKE2S_BLOCKBYTES : 0;
+
+  for( uint64_t j = 0; j < nblocks; ++j )
+  {
+    blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
+
+    if( left - pos >= BLAKE2S_BLOCKBYTES )
+    {
+      blake2s_compress( S, S->buf + pos );
+      pos += BLAKE2S_BLOCKBYTES;
+    }
+    else if( pos < left )
+    {
+      n = left - pos;
+      memcpy( block, S->buf + pos, n );
+      memcpy( block + n, src, BLAKE2S_BLOCKBYTES - n );
+      memcpy( dst, src, BLAKE2S_BLOCKBYTES - n );
+      off = BLAKE2S_BLOCKBYTES - n;
+      pos = left;
+      blake2s_compress( S, block );
+    }
+    else
+    {
+      blake2s_copy_block( dst + off, src + off, stream && 0 == ( ( uintptr_t )( dst + off ) & 15 ) );
+      blake2s_compress( S, src + off );
+      off += BLAKE2S_BLOCKBYTES;
+    }
+  }
+
+  if( stream ) _mm_sfence();
+
+  n = left - pos;
+  memmove( S->buf, S->buf + pos, n );
+
+  if( len > off )
+  {
+    memcpy( S->buf + n, src + off, len - off );
+    memcpy( dst + off, src + off, len - off );
+  }
+
+  S->buflen = ( uint32_t )( n + len - off );
+  secure_zero_memory( block, sizeof( block ) );
+  return 0;
+}
+
 
 int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
 {
@@ -365,6 +566,12 @@ int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
 
   if(outlen != S->outlen ) return -1;
 
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
   if( S->buflen > BLAKE2S_BLOCKBYTES )
   {
     blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
@@ -385,6 +592,201 @@ int blake2s_final( blake2s_state *S, uint8_t *out, size_t outlen )
   return 0;
 }
 
+/*
+   Digest of everything absorbed so far, leaving S untouched: the chaining
+   value, counter and flags are copied to the stack and only the buffered
+   bytes are read, so checkpointing a stream costs one or two compressions.
+*/
+int blake2s_final_peek( const blake2s_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+  uint32_t h[8], t[2], f[2];
+  const uint8_t *p = S->buf;
+  size_t left = S->buflen;
+
+  if( S->outlen != outlen ) return -1;
+
+  if( BLAKE2_PREPARED_EMPTY( S, BLAKE2S_BLOCKBYTES ) )
+  {
+    memcpy( out, S->buf, outlen );
+    return 0;
+  }
+
+  memcpy( h, S->h, sizeof( h ) );
+  t[0] = S->t[0];
+  t[1] = S->t[1];
+  f[0] = 0;
+  f[1] = 0;
+
+  if( left > BLAKE2S_BLOCKBYTES )
+  {
+    t[0] += BLAKE2S_BLOCKBYTES;
+    t[1] += ( t[0] < BLAKE2S_BLOCKBYTES );
+    blake2s_compress_words( h, t, f, p, 0 );
+    p += BLAKE2S_BLOCKBYTES;
+    left -= BLAKE2S_BLOCKBYTES;
+  }
+
+  memcpy( block, p, left );
+  memset( block + left, 0, BLAKE2S_BLOCKBYTES - left ); /* Padding */
+  t[0] += ( uint32_t )left;
+  t[1] += ( t[0] < ( uint32_t )left );
+  f[0] = ( uint32_t )-1;
+
+  if( S->last_node ) f[1] = ( uint32_t )-1;
+
+  blake2s_compress_words( h, t, f, block, 0 );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store32( buffer + sizeof( h[i] ) * i, h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+/* The words live in aligned locals for the whole run, so each block goes
+   straight from one kernel call to the next */
+int blake2s_compress_blocks( uint32_t h[8], const uint8_t *blocks, size_t nblocks, size_t lastlen, uint32_t t[2], const uint32_t f[2] )
+{
+  BLAKE2_ALIGN( 16 ) uint32_t H[8];
+  BLAKE2_ALIGN( 16 ) uint32_t T[2];
+  BLAKE2_ALIGN( 16 ) uint32_t F[2] = { 0, 0 };
+
+  if( NULL == h || NULL == t || ( nblocks && NULL == blocks ) || lastlen > BLAKE2S_BLOCKBYTES ) return -1;
+
+  memcpy( H, h, sizeof( H ) );
+  T[0] = t[0];
+  T[1] = t[1];
+
+  for( size_t i = 0; i < nblocks; ++i, blocks += BLAKE2S_BLOCKBYTES )
+  {
+    const uint32_t inc = i + 1 == nblocks ? ( uint32_t )lastlen : BLAKE2S_BLOCKBYTES;
+
+    T[0] += inc;
+    T[1] += ( T[0] < inc );
+
+    if( i + 1 == nblocks && f )
+    {
+      F[0] = f[0];
+      F[1] = f[1];
+    }
+
+    blake2s_compress_words( H, T, F, blocks, 1 );
+  }
+
+  memcpy( h, H, sizeof( H ) );
+  t[0] = T[0];
+  t[1] = T[1];
+  return 0;
+}
+
+static inline void blake2s_v2_increment_counter( blake2s_state_v2 *S, const uint32_t inc )
+{
+  S->t[0] += inc;
+  S->t[1] += ( S->t[0] < inc );
+}
+
+/* One-block buffer: a full block stays buffered until more input shows it is not the last */
+int blake2s_v2_update( blake2s_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  if( 0 == inlen ) return 0;
+
+  if( NULL == in ) return -1;
+
+  if( inlen > BLAKE2S_BLOCKBYTES - S->buflen )
+  {
+    const size_t fill = BLAKE2S_BLOCKBYTES - S->buflen;
+    memcpy( S->buf + S->buflen, in, fill );
+    blake2s_v2_increment_counter( S, BLAKE2S_BLOCKBYTES );
+    blake2s_v2_compress( S, S->buf );
+    S->buflen = 0;
+    in += fill;
+    inlen -= fill;
+
+    while( inlen > BLAKE2S_BLOCKBYTES )
+    {
+      blake2s_v2_increment_counter( S, BLAKE2S_BLOCKBYTES );
+      blake2s_v2_compress( S, in );
+      in += BLAKE2S_BLOCKBYTES;
+      inlen -= BLAKE2S_BLOCKBYTES;
+    }
+  }
+
+  memcpy( S->buf + S->buflen, in, inlen );
+  S->buflen += ( uint32_t ) inlen;
+  return 0;
+}
+
+int blake2s_v2_final( blake2s_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+
+  if( S->outlen != outlen || S->f[0] ) return -1;
+
+  blake2s_v2_increment_counter( S, S->buflen );
+  S->f[0] = ( uint32_t )-1;
+
+  if( S->last_node ) S->f[1] = ( uint32_t )-1;
+
+  memset( S->buf + S->buflen, 0, BLAKE2S_BLOCKBYTES - S->buflen ); /* Padding */
+  blake2s_v2_compress( S, S->buf );
+
+  for( int i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
+    store32( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+  return 0;
+}
+
+/*
+   One-shot path for inputs of at most one block: the chaining value comes
+   straight from the default parameter block and the message is padded on the
+   stack, so only h, t and f of S are ever touched.
+*/
+static int blake2s_one_block( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
+{
+  blake2s_state S[1];
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+  uint8_t buffer[BLAKE2S_OUTBYTES];
+
+  for( int i = 0; i < 8; ++i ) S->h[i] = blake2s_IV[i];
+
+  /* digest_length, key_length, fanout = 1, depth = 1 */
+  S->h[0] ^= 0x01010000UL ^ ( keylen << 8 ) ^ outlen;
+  S->t[1] = 0;
+  S->f[1] = 0;
+
+  if( keylen > 0 )
+  {
+    memset( block, 0, BLAKE2S_BLOCKBYTES );
+    memcpy( block, key, keylen );
+    S->t[0] = BLAKE2S_BLOCKBYTES;
+    S->f[0] = inlen > 0 ? 0 : ~0U;
+    blake2s_compress( S, block );
+  }
+
+  if( inlen > 0 || 0 == keylen )
+  {
+    memset( block, 0, BLAKE2S_BLOCKBYTES );
+
+    if( inlen > 0 ) memcpy( block, in, inlen );
+
+    S->t[0] = ( keylen > 0 ? BLAKE2S_BLOCKBYTES : 0 ) + inlen;
+    S->f[0] = ~0U;
+    blake2s_compress( S, block );
+  }
+
+  for( int i = 0; i < 8; ++i )
+    store32( buffer + sizeof( S->h[i] ) * i, S->h[i] );
+
+  memcpy( out, buffer, outlen );
+
+  if( keylen > 0 ) secure_zero_memory( block, sizeof( block ) ); /* Burn the key from stack */
+
+  return 0;
+}
+
 int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
   blake2s_state S[1];
@@ -400,6 +802,8 @@ int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_
 
   if( keylen > BLAKE2S_KEYBYTES ) return -1;
 
+  if( inlen <= BLAKE2S_BLOCKBYTES ) return blake2s_one_block( out, in, key, outlen, inlen, keylen );
+
   if( keylen > 0 )
   {
     if( blake2s_init_key( S, outlen, key, keylen ) < 0 ) return -1;
@@ -413,6 +817,223 @@ int blake2s( uint8_t *out, const void *in, const void *key, size_t outlen, size_
   return blake2s_final( S, out, outlen );
 }
 
+/* Folds the tag difference into one bit without branching on where the tags differ */
+static inline uint32_t blake2s_tag_equal( const uint8_t *a, const uint8_t *b, size_t n )
+{
+  uint32_t d = 0;
+
+  for( size_t i = 0; i < n; ++i ) d |= a[i] ^ b[i];
+
+  return 1 & ( ( d - 1 ) >> 8 );
+}
+
+static int blake2s_verify_check( const uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  if( NULL == bitmap || ( NULL == items && count > 0 ) ) return -1;
+
+  if( !taglen || taglen > BLAKE2S_OUTBYTES ) return -1;
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    const blake2s_mac_item *I = &items[i];
+
+    if( NULL == I->tag || ( NULL == I->in && I->inlen > 0 ) ) return -1;
+
+    if( ( NULL == I->key && I->keylen > 0 ) || I->keylen > BLAKE2S_KEYBYTES ) return -1;
+  }
+
+  return 0;
+}
+
+/*
+   Batch verification runs four independent messages through the compression
+   function at once, one per 32-bit lane. v[i] holds word i of all four working
+   states, so no diagonalization is needed. Lanes whose message has already
+   ended are fed a zero block and masked out of the chaining value update.
+*/
+#define BLAKE2S_LANES 4
+
+#define G4(a,b,c,d,x,y) \
+  a = _mm_add_epi32( _mm_add_epi32( a, b ), x ); \
+  d = _mm_roti_epi32( _mm_xor_si128( d, a ), -16 ); \
+  c = _mm_add_epi32( c, d ); \
+  b = _mm_roti_epi32( _mm_xor_si128( b, c ), -12 ); \
+  a = _mm_add_epi32( _mm_add_epi32( a, b ), y ); \
+  d = _mm_roti_epi32( _mm_xor_si128( d, a ), -8 ); \
+  c = _mm_add_epi32( c, d ); \
+  b = _mm_roti_epi32( _mm_xor_si128( b, c ), -7 );
+
+static void blake2s_compress_x4( __m128i h[8], const uint8_t *const block[BLAKE2S_LANES],
+                                 const uint64_t t[BLAKE2S_LANES], const uint32_t f[BLAKE2S_LANES], __m128i live )
+{
+  __m128i m[16], v[16];
+#if defined(HAVE_SSSE3) && !defined(HAVE_XOP)
+  const __m128i r8 = _mm_set_epi8( 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1 );
+  const __m128i r16 = _mm_set_epi8( 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2 );
+#endif
+
+  /* Transpose 4x4 word tiles so m[i] holds message word i of every lane */
+  for( size_t i = 0; i < 4; ++i )
+  {
+    const __m128i a = LOADU( block[0] + 16 * i );
+    const __m128i b = LOADU( block[1] + 16 * i );
+    const __m128i c = LOADU( block[2] + 16 * i );
+    const __m128i d = LOADU( block[3] + 16 * i );
+    const __m128i ab0 = _mm_unpacklo_epi32( a, b );
+    const __m128i ab1 = _mm_unpackhi_epi32( a, b );
+    const __m128i cd0 = _mm_unpacklo_epi32( c, d );
+    const __m128i cd1 = _mm_unpackhi_epi32( c, d );
+    m[4 * i + 0] = _mm_unpacklo_epi64( ab0, cd0 );
+    m[4 * i + 1] = _mm_unpackhi_epi64( ab0, cd0 );
+    m[4 * i + 2] = _mm_unpacklo_epi64( ab1, cd1 );
+    m[4 * i + 3] = _mm_unpackhi_epi64( ab1, cd1 );
+  }
+
+  for( size_t i = 0; i < 8; ++i ) v[i] = h[i];
+
+  for( size_t i = 0; i < 4; ++i ) v[i + 8] = _mm_set1_epi32( ( int )blake2s_IV[i] );
+
+  v[12] = _mm_xor_si128( _mm_set1_epi32( ( int )blake2s_IV[4] ),
+                         _mm_set_epi32( ( int )t[3], ( int )t[2], ( int )t[1], ( int )t[0] ) );
+  v[13] = _mm_xor_si128( _mm_set1_epi32( ( int )blake2s_IV[5] ),
+                         _mm_set_epi32( ( int )( t[3] >> 32 ), ( int )( t[2] >> 32 ), ( int )( t[1] >> 32 ), ( int )( t[0] >> 32 ) ) );
+  v[14] = _mm_xor_si128( _mm_set1_epi32( ( int )blake2s_IV[6] ),
+                         _mm_set_epi32( ( int )f[3], ( int )f[2], ( int )f[1], ( int )f[0] ) );
+  v[15] = _mm_set1_epi32( ( int )blake2s_IV[7] );
+
+  for( size_t r = 0; r < 10; ++r )
+  {
+    const uint8_t *s = blake2s_sigma[r];
+    G4( v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]] );
+    G4( v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]] );
+    G4( v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]] );
+    G4( v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]] );
+    G4( v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]] );
+    G4( v[1], v[6], v[11], v[12], m[s[10]], m[s[11]] );
+    G4( v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]] );
+    G4( v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]] );
+  }
+
+  for( size_t i = 0; i < 8; ++i )
+  {
+    const __m128i x = _mm_xor_si128( _mm_xor_si128( h[i], v[i] ), v[i + 8] );
+    h[i] = _mm_xor_si128( h[i], _mm_and_si128( live, _mm_xor_si128( x, h[i] ) ) );
+  }
+}
+
+#undef G4
+
+/* Items first .. first + n - 1, n <= BLAKE2S_LANES; the stream of lane l is its key block, if any, then its message */
+static void blake2s_verify_x4( uint8_t *bitmap, const blake2s_mac_item *items, size_t first, size_t n, size_t taglen )
+{
+  static const uint8_t zero[BLAKE2S_BLOCKBYTES] = {0};
+  uint8_t keyblock[BLAKE2S_LANES][BLAKE2S_BLOCKBYTES];
+  uint8_t tail[BLAKE2S_LANES][BLAKE2S_BLOCKBYTES];
+  uint8_t mac[BLAKE2S_OUTBYTES];
+  uint32_t words[8][BLAKE2S_LANES];
+  uint32_t p0[BLAKE2S_LANES];
+  uint64_t prefix[BLAKE2S_LANES], total[BLAKE2S_LANES], nblocks[BLAKE2S_LANES];
+  uint64_t maxblocks = 0;
+  __m128i h[8];
+
+  for( size_t l = 0; l < BLAKE2S_LANES; ++l )
+  {
+    const blake2s_mac_item *I = l < n ? &items[first + l] : NULL;
+    const size_t keylen = I ? I->keylen : 0;
+
+    p0[l] = 0x01010000UL ^ ( ( uint32_t )keylen << 8 ) ^ ( uint32_t )taglen;
+    prefix[l] = keylen ? BLAKE2S_BLOCKBYTES : 0;
+    total[l] = 0;
+    nblocks[l] = 0;
+
+    if( NULL == I ) continue;
+
+    total[l] = prefix[l] + I->inlen;
+    nblocks[l] = total[l] ? ( total[l] + BLAKE2S_BLOCKBYTES - 1 ) / BLAKE2S_BLOCKBYTES : 1;
+
+    if( nblocks[l] > maxblocks ) maxblocks = nblocks[l];
+
+    if( keylen )
+    {
+      memset( keyblock[l], 0, BLAKE2S_BLOCKBYTES );
+      memcpy( keyblock[l], I->key, keylen );
+    }
+
+    /* The last block is copied and zero-padded unless it is the key block itself */
+    if( ( nblocks[l] - 1 ) * BLAKE2S_BLOCKBYTES >= prefix[l] )
+    {
+      const size_t offset = ( size_t )( ( nblocks[l] - 1 ) * BLAKE2S_BLOCKBYTES - prefix[l] );
+      memset( tail[l], 0, BLAKE2S_BLOCKBYTES );
+
+      if( I->inlen > offset ) memcpy( tail[l], I->in + offset, I->inlen - offset );
+    }
+  }
+
+  h[0] = _mm_xor_si128( _mm_set1_epi32( ( int )blake2s_IV[0] ),
+                        _mm_set_epi32( ( int )p0[3], ( int )p0[2], ( int )p0[1], ( int )p0[0] ) );
+
+  for( size_t i = 1; i < 8; ++i ) h[i] = _mm_set1_epi32( ( int )blake2s_IV[i] );
+
+  for( uint64_t j = 0; j < maxblocks; ++j )
+  {
+    const uint8_t *block[BLAKE2S_LANES];
+    uint64_t t[BLAKE2S_LANES];
+    uint32_t f[BLAKE2S_LANES], live[BLAKE2S_LANES];
+
+    for( size_t l = 0; l < BLAKE2S_LANES; ++l )
+    {
+      const uint64_t start = j * BLAKE2S_BLOCKBYTES;
+
+      if( j >= nblocks[l] )
+      {
+        block[l] = zero;
+        t[l] = 0;
+        f[l] = 0;
+        live[l] = 0;
+        continue;
+      }
+
+      if( start < prefix[l] ) block[l] = keyblock[l];
+      else if( j == nblocks[l] - 1 ) block[l] = tail[l];
+      else block[l] = items[first + l].in + ( start - prefix[l] );
+
+      t[l] = start + BLAKE2S_BLOCKBYTES < total[l] ? start + BLAKE2S_BLOCKBYTES : total[l];
+      f[l] = j == nblocks[l] - 1 ? ~0U : 0U;
+      live[l] = ~0U;
+    }
+
+    blake2s_compress_x4( h, block, t, f, _mm_set_epi32( ( int )live[3], ( int )live[2], ( int )live[1], ( int )live[0] ) );
+  }
+
+  for( size_t i = 0; i < 8; ++i ) STOREU( words[i], h[i] );
+
+  for( size_t l = 0; l < n; ++l )
+  {
+    const size_t i = first + l;
+
+    for( size_t w = 0; w < 8; ++w ) store32( mac + 4 * w, words[w][l] );
+
+    bitmap[i / 8] |= ( uint8_t )( blake2s_tag_equal( mac, items[i].tag, taglen ) << ( i % 8 ) );
+  }
+
+  secure_zero_memory( keyblock, sizeof( keyblock ) );
+  secure_zero_memory( tail, sizeof( tail ) );
+  secure_zero_memory( words, sizeof( words ) );
+  secure_zero_memory( mac, sizeof( mac ) );
+}
+
+int blake2s_verify_batch( uint8_t *bitmap, const blake2s_mac_item *items, size_t count, size_t taglen )
+{
+  if( blake2s_verify_check( bitmap, items, count, taglen ) < 0 ) return -1;
+
+  memset( bitmap, 0, ( count + 7 ) / 8 );
+
+  for( size_t i = 0; i < count; i += BLAKE2S_LANES )
+    blake2s_verify_x4( bitmap, items, i, count - i < BLAKE2S_LANES ? count - i : BLAKE2S_LANES, taglen );
+
+  return 0;
+}
+
 #if defined(SUPERCOP)
 int crypto_hash( unsigned char *out, unsigned char *in, unsigned long long inlen )
 {
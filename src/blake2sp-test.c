@@ -11,10 +11,63 @@
    this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "blake2.h"
 #include "blake2-kat.h"
 
+/* Past the 1 MiB non-temporal store threshold */
+#define BLAKE2_COPY_BIG ( ( 3 << 20 ) + 200 )
+
+/* update_copy must leave dst equal to src and the state where update leaves it, streaming or not */
+static int test_update_copy( void )
+{
+  static const size_t lengths[] = { 0, 1, 63, 64, 65, 127, 128, 129, 1000, 4096, BLAKE2_COPY_BIG };
+  static const size_t prefixes[] = { 0, 1, 64, 129, 256 };
+  uint8_t *src = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  uint8_t *dst = ( uint8_t * )malloc( BLAKE2_COPY_BIG + 8 );
+  int ret = -1;
+
+  if( !src || !dst ) goto out;
+
+  for( size_t i = 0; i < BLAKE2_COPY_BIG + 8; ++i )
+    src[i] = ( uint8_t )( i * 13 + 1 );
+
+  for( size_t i = 0; i < sizeof( lengths ) / sizeof( lengths[0] ); ++i )
+    for( size_t j = 0; j < sizeof( prefixes ) / sizeof( prefixes[0] ); ++j )
+      for( size_t skew = 0; skew < 16; skew += 8 )
+      {
+        uint8_t a[BLAKE2S_OUTBYTES], b[BLAKE2S_OUTBYTES];
+        blake2sp_state S[1], R[1];
+
+        /* Keyed leaves start out with their key block buffered */
+        if( j & 1 )
+          blake2sp_init_key( S, BLAKE2S_OUTBYTES, src, 20 );
+        else
+          blake2sp_init( S, BLAKE2S_OUTBYTES );
+
+        blake2sp_update( S, src, prefixes[j] );
+        memcpy( R, S, sizeof( S ) );
+        memset( dst, 0, BLAKE2_COPY_BIG + 8 );
+
+        if( blake2sp_update_copy( S, dst + skew, src + skew, lengths[i] ) < 0 ||
+            0 != memcmp( dst + skew, src + skew, lengths[i] ) )
+          goto out;
+
+        blake2sp_update( R, src + skew, lengths[i] );
+        blake2sp_final( S, a, BLAKE2S_OUTBYTES );
+        blake2sp_final( R, b, BLAKE2S_OUTBYTES );
+
+        if( 0 != memcmp( a, b, sizeof( a ) ) ) goto out;
+      }
+
+  ret = 0;
+out:
+  free( src );
+  free( dst );
+  return ret;
+}
+
 int main( int argc, char **argv )
 {
   uint8_t key[BLAKE2S_KEYBYTES];
@@ -37,6 +90,12 @@ int main( int argc, char **argv )
     }
   }
 
+  if( test_update_copy() < 0 )
+  {
+    puts( "error" );
+    return -1;
+  }
+
   puts( "ok" );
   return 0;
 }
@@ -19,24 +19,33 @@
 #include <omp.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "blake2.h"
 #include "blake2-impl.h"
 
 #define PARALLELISM_DEGREE 8
 
-static int blake2sp_init_leaf( blake2s_state *S, uint8_t outlen, uint8_t keylen, uint64_t offset )
+static void blake2sp_node_param( blake2s_param *P, uint8_t outlen, uint8_t keylen, uint64_t offset, uint8_t node_depth )
 {
-  blake2s_param P[1];
   P->digest_length = outlen;
   P->key_length = keylen;
   P->fanout = PARALLELISM_DEGREE;
   P->depth = 2;
   P->leaf_length = 0;
   store48( P->node_offset, offset );
-  P->node_depth = 0;
+  P->node_depth = node_depth;
   P->inner_length = BLAKE2S_OUTBYTES;
   memset( P->salt, 0, sizeof( P->salt ) );
   memset( P->personal, 0, sizeof( P->personal ) );
+}
+
+static int blake2sp_init_leaf( blake2s_state *S, uint8_t outlen, uint8_t keylen, uint64_t offset )
+{
+  blake2s_param P[1];
+  blake2sp_node_param( P, outlen, keylen, offset, 0 );
   blake2s_init_param( S, P );
   S->outlen = P->inner_length;
   return 0;
@@ -45,16 +54,7 @@ static int blake2sp_init_leaf( blake2s_state *S, uint8_t outlen, uint8_t keylen,
 static int blake2sp_init_root( blake2s_state *S, uint8_t outlen, uint8_t keylen )
 {
   blake2s_param P[1];
-  P->digest_length = outlen;
-  P->key_length = keylen;
-  P->fanout = PARALLELISM_DEGREE;
-  P->depth = 2;
-  P->leaf_length = 0;
-  store48( P->node_offset, 0ULL );
-  P->node_depth = 1;
-  P->inner_length = BLAKE2S_OUTBYTES;
-  memset( P->salt, 0, sizeof( P->salt ) );
-  memset( P->personal, 0, sizeof( P->personal ) );
+  blake2sp_node_param( P, outlen, keylen, 0, 1 );
   blake2s_init_param( S, P );
   S->outlen = P->digest_length;
   return 0;
@@ -113,6 +113,39 @@ int blake2sp_init_key( blake2sp_state *S, size_t outlen, const void *key, size_t
 }
 
 
+/* Leaf midstates are taken from a keyed state; the unkeyed root is cheap to rebuild */
+int blake2sp_prepare_key( blake2sp_prepared_key *K, size_t outlen, const void *key, size_t keylen )
+{
+  blake2sp_state S[1];
+  int ret = 0;
+
+  if( blake2sp_init_key( S, outlen, key, keylen ) < 0 ) return -1;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+    if( blake2s_prepare_state( K->S[i], S->S[i] ) < 0 ) ret = -1;
+
+  K->keylen = ( uint8_t ) keylen;
+  K->outlen = ( uint8_t ) outlen;
+  secure_zero_memory( S, sizeof( S ) );
+  return ret;
+}
+
+int blake2sp_init_prepared( blake2sp_state *S, const blake2sp_prepared_key *K )
+{
+  S->buflen = 0;
+
+  if( blake2sp_init_root( S->R, K->outlen, K->keylen ) < 0 )
+    return -1;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+    blake2s_init_prepared( S->S[i], K->S[i] );
+
+  S->R->last_node = 1;
+  S->outlen = K->outlen;
+  return 0;
+}
+
+
 int blake2sp_update( blake2sp_state *S, const uint8_t *in, size_t inlen )
 {
   size_t left = S->buflen;
@@ -131,15 +164,10 @@ int blake2sp_update( blake2sp_state *S, const uint8_t *in, size_t inlen )
   }
 
 #if defined(_OPENMP)
-  omp_set_num_threads(PARALLELISM_DEGREE);
-  #pragma omp parallel shared(S)
-#else
-  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
+  #pragma omp parallel for num_threads(PARALLELISM_DEGREE) shared(S)
 #endif
+  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
   {
-#if defined(_OPENMP)
-    size_t      id__ = ( size_t ) omp_get_thread_num();
-#endif
     size_t inlen__ = inlen;
     const uint8_t *in__ = ( const uint8_t * )in;
     in__ += id__ * BLAKE2S_BLOCKBYTES;
@@ -162,6 +190,116 @@ int blake2sp_update( blake2sp_state *S, const uint8_t *in, size_t inlen )
   return 0;
 }
 
+/*
+   Stripes that fit inside a fragment are hashed in place by blake2sp_update,
+   but each fragment still goes through its own update call: a stripe cut by
+   a fragment boundary is assembled in S->buf, so a stripe tail is copied
+   once per fragment rather than fed to the leaves where it lies.
+*/
+int blake2sp_updatev( blake2sp_state *S, const struct iovec *iov, int iovcnt )
+{
+  if( iovcnt < 0 || ( NULL == iov && iovcnt > 0 ) ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+    if( NULL == iov[i].iov_base && iov[i].iov_len > 0 ) return -1;
+
+  for( int i = 0; i < iovcnt; ++i )
+    if( iov[i].iov_len > 0 && blake2sp_update( S, ( const uint8_t * )iov[i].iov_base, iov[i].iov_len ) < 0 ) return -1;
+
+  return 0;
+}
+
+/* One leaf block from src to dst; streaming stores keep a large dst from evicting the working set */
+static inline void blake2sp_copy_block( uint8_t *dst, const uint8_t *src, const int stream )
+{
+#if defined(__SSE2__)
+  if( stream )
+  {
+    for( size_t i = 0; i < BLAKE2S_BLOCKBYTES; i += 16 )
+      _mm_stream_si128( ( __m128i * )( dst + i ), _mm_loadu_si128( ( const __m128i * )( src + i ) ) );
+
+    return;
+  }
+#endif
+  memcpy( dst, src, BLAKE2S_BLOCKBYTES );
+}
+
+/*
+   Each leaf copies the blocks it hashes, so every thread streams its own
+   share of src to dst. A block is compressed straight from src right after
+   it is copied, while it is still in L1; only the leaf's last block goes
+   through its buffer, kept back for final as blake2s_update would.
+*/
+int blake2sp_update_copy( blake2sp_state *S, uint8_t *dst, const uint8_t *src, size_t len )
+{
+  size_t left = S->buflen;
+  size_t fill = sizeof( S->buf ) - left;
+  int stream;
+
+  if( len > 0 && ( NULL == dst || NULL == src ) ) return -1;
+
+  if( left && len >= fill )
+  {
+    memcpy( S->buf + left, src, fill );
+    memcpy( dst, src, fill );
+
+    for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+      blake2s_update( S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
+
+    dst += fill;
+    src += fill;
+    len -= fill;
+    left = 0;
+  }
+
+  stream = len >= BLAKE2_STREAM_BYTES && 0 == ( ( uintptr_t )dst & 15 );
+
+#if defined(_OPENMP)
+  #pragma omp parallel for num_threads(PARALLELISM_DEGREE) shared(S)
+#endif
+  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
+  {
+    blake2s_state *L = S->S[id__];
+    size_t n__ = len / ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
+    const uint8_t *src__ = src + id__ * BLAKE2S_BLOCKBYTES;
+    uint8_t *dst__ = dst + id__ * BLAKE2S_BLOCKBYTES;
+
+    if( 0 == n__ ) continue;
+
+    /* Leaves only ever take whole blocks, and more follow, so whatever is buffered can go now */
+    for( size_t i = 0; i < L->buflen / BLAKE2S_BLOCKBYTES; ++i )
+      blake2s_compress_blocks( L->h, L->buf + i * BLAKE2S_BLOCKBYTES, 1, BLAKE2S_BLOCKBYTES, L->t, NULL );
+
+    for( ; n__ > 1; --n__ )
+    {
+      blake2sp_copy_block( dst__, src__, stream );
+      blake2s_compress_blocks( L->h, src__, 1, BLAKE2S_BLOCKBYTES, L->t, NULL );
+      src__ += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+      dst__ += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+    }
+
+    blake2sp_copy_block( dst__, src__, stream );
+    memcpy( L->buf, src__, BLAKE2S_BLOCKBYTES );
+    L->buflen = BLAKE2S_BLOCKBYTES;
+#if defined(__SSE2__)
+    if( stream ) _mm_sfence();
+#endif
+  }
+
+  src += len - len % ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
+  dst += len - len % ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
+  len %= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+
+  if( len > 0 )
+  {
+    memcpy( S->buf + left, src, len );
+    memcpy( dst, src, len );
+  }
+
+  S->buflen = ( uint32_t ) left + ( uint32_t ) len;
+  return 0;
+}
+
 
 int blake2sp_final( blake2sp_state *S, uint8_t *out, size_t outlen )
 {
@@ -190,6 +328,165 @@ int blake2sp_final( blake2sp_state *S, uint8_t *out, size_t outlen )
   return 0;
 }
 
+/* Leaves with bytes still in the stripe buffer are finished on a clone; the others are peeked directly */
+int blake2sp_final_peek( const blake2sp_state *S, uint8_t *out, size_t outlen )
+{
+  uint8_t hash[PARALLELISM_DEGREE][BLAKE2S_OUTBYTES];
+  blake2s_state T[1];
+
+  if( S->outlen != outlen ) return -1;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    if( S->buflen > i * BLAKE2S_BLOCKBYTES )
+    {
+      size_t left = S->buflen - i * BLAKE2S_BLOCKBYTES;
+
+      if( left > BLAKE2S_BLOCKBYTES ) left = BLAKE2S_BLOCKBYTES;
+
+      blake2s_clone( T, S->S[i] );
+      blake2s_update( T, S->buf + i * BLAKE2S_BLOCKBYTES, left );
+      blake2s_final( T, hash[i], BLAKE2S_OUTBYTES );
+    }
+    else
+      blake2s_final_peek( S->S[i], hash[i], BLAKE2S_OUTBYTES );
+  }
+
+  blake2s_clone( T, S->R );
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+    blake2s_update( T, hash[i], BLAKE2S_OUTBYTES );
+
+  blake2s_final( T, out, outlen );
+  secure_zero_memory( T, sizeof( T ) );
+  return 0;
+}
+
+static int blake2sp_v2_init_nodes( blake2sp_state_v2 *S, size_t outlen, size_t keylen )
+{
+  blake2s_param P[1];
+
+  S->buflen = 0;
+  S->outlen = ( uint8_t ) outlen;
+  S->keylen = ( uint8_t ) keylen;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    blake2sp_node_param( P, ( uint8_t ) outlen, ( uint8_t ) keylen, i, 0 );
+
+    if( blake2s_v2_init_param( &S->S[i], P ) < 0 ) return -1;
+
+    S->S[i].outlen = P->inner_length;
+  }
+
+  S->S[PARALLELISM_DEGREE - 1].last_node = 1;
+  return 0;
+}
+
+int blake2sp_v2_init( blake2sp_state_v2 *S, size_t outlen )
+{
+  if( !outlen || outlen > BLAKE2S_OUTBYTES ) return -1;
+
+  return blake2sp_v2_init_nodes( S, outlen, 0 );
+}
+
+int blake2sp_v2_init_key( blake2sp_state_v2 *S, size_t outlen, const void *key, size_t keylen )
+{
+  uint8_t block[BLAKE2S_BLOCKBYTES];
+
+  if( !outlen || outlen > BLAKE2S_OUTBYTES ) return -1;
+
+  if( !key || !keylen || keylen > BLAKE2S_KEYBYTES ) return -1;
+
+  if( blake2sp_v2_init_nodes( S, outlen, keylen ) < 0 ) return -1;
+
+  memset( block, 0, BLAKE2S_BLOCKBYTES );
+  memcpy( block, key, keylen );
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+    blake2s_v2_update( &S->S[i], block, BLAKE2S_BLOCKBYTES );
+
+  secure_zero_memory( block, BLAKE2S_BLOCKBYTES ); /* Burn the key from stack */
+  return 0;
+}
+
+int blake2sp_v2_update( blake2sp_state_v2 *S, const uint8_t *in, size_t inlen )
+{
+  size_t left = S->buflen;
+  size_t fill = sizeof( S->buf ) - left;
+
+  if( left && inlen >= fill )
+  {
+    memcpy( S->buf + left, in, fill );
+
+    for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+      blake2s_v2_update( &S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
+
+    in += fill;
+    inlen -= fill;
+    left = 0;
+  }
+
+#if defined(_OPENMP)
+  #pragma omp parallel for num_threads(PARALLELISM_DEGREE) shared(S)
+#endif
+  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
+  {
+    size_t inlen__ = inlen;
+    const uint8_t *in__ = ( const uint8_t * )in;
+    in__ += id__ * BLAKE2S_BLOCKBYTES;
+
+    while( inlen__ >= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES )
+    {
+      blake2s_v2_update( &S->S[id__], in__, BLAKE2S_BLOCKBYTES );
+      in__ += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+      inlen__ -= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+    }
+  }
+
+  in += inlen - inlen % ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
+  inlen %= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+
+  if( inlen > 0 )
+    memcpy( S->buf + left, in, inlen );
+
+  S->buflen = ( uint32_t ) left + ( uint32_t ) inlen;
+  return 0;
+}
+
+int blake2sp_v2_final( blake2sp_state_v2 *S, uint8_t *out, size_t outlen )
+{
+  uint8_t hash[PARALLELISM_DEGREE][BLAKE2S_OUTBYTES];
+  blake2s_state_v2 R[1];
+  blake2s_param P[1];
+
+  if( S->outlen != outlen ) return -1;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    if( S->buflen > i * BLAKE2S_BLOCKBYTES )
+    {
+      size_t left = S->buflen - i * BLAKE2S_BLOCKBYTES;
+
+      if( left > BLAKE2S_BLOCKBYTES ) left = BLAKE2S_BLOCKBYTES;
+
+      if( blake2s_v2_update( &S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, left ) < 0 ) return -1;
+    }
+
+    /* A leaf that was already finalized refuses, so a second final does too */
+    if( blake2s_v2_final( &S->S[i], hash[i], BLAKE2S_OUTBYTES ) < 0 ) return -1;
+  }
+
+  blake2sp_node_param( P, S->outlen, S->keylen, 0, 1 );
+  blake2s_v2_init_param( R, P );
+  R->last_node = 1;
+
+  for( size_t i = 0; i < PARALLELISM_DEGREE; ++i )
+    if( blake2s_v2_update( R, hash[i], BLAKE2S_OUTBYTES ) < 0 ) return -1;
+
+  return blake2s_v2_final( R, out, outlen );
+}
+
 
 int blake2sp( uint8_t *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen )
 {
@@ -227,16 +524,10 @@ int blake2sp( uint8_t *out, const void *in, const void *key, size_t outlen, size
   }
 
 #if defined(_OPENMP)
-  omp_set_num_threads(PARALLELISM_DEGREE);
-  #pragma omp parallel shared(S,hash)
-#else
-
-  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
+  #pragma omp parallel for num_threads(PARALLELISM_DEGREE) shared(S,hash)
 #endif
+  for( size_t id__ = 0; id__ < PARALLELISM_DEGREE; ++id__ )
   {
-#if defined(_OPENMP)
-    size_t      id__ = ( size_t ) omp_get_thread_num();
-#endif
     size_t inlen__ = inlen;
     const uint8_t *in__ = ( const uint8_t * )in;
     in__ += id__ * BLAKE2S_BLOCKBYTES;
@@ -0,0 +1,223 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Written in 2012 by Samuel Neves <sneves@dei.uc.pt>
+
+   To the extent possible under law, the author(s) have dedicated all copyright
+   and related and neighboring rights to this software to the public domain
+   worldwide. This software is distributed without any warranty.
+
+   You should have received a copy of the CC0 Public Domain Dedication along with
+   this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+*/
+#pragma once
+#ifndef __BLAMKA_ROUND_H__
+#define __BLAMKA_ROUND_H__
+
+/*
+   BlaMka is the BLAKE2b round without message words, with every a + b
+   replaced by a + b + 2 * lo32(a) * lo32(b). Exactly one engine is defined,
+   matching the best instruction set the translation unit is built for.
+*/
+
+#if defined(HAVE_AVX512F)
+
+/* 8 independent permutations, one per 64-bit lane; no diagonalization shuffles needed */
+static inline __m512i fBlaMka( __m512i x, __m512i y )
+{
+  const __m512i z = _mm512_mul_epu32( x, y );
+  return _mm512_add_epi64( _mm512_add_epi64( x, y ), _mm512_add_epi64( z, z ) );
+}
+
+#define GB(a,b,c,d) \
+  a = fBlaMka(a, b); \
+  d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32); \
+  c = fBlaMka(c, d); \
+  b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24); \
+  a = fBlaMka(a, b); \
+  d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16); \
+  c = fBlaMka(c, d); \
+  b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);
+
+#define BLAMKA_ROUND(v) \
+  GB(v[ 0], v[ 4], v[ 8], v[12]); \
+  GB(v[ 1], v[ 5], v[ 9], v[13]); \
+  GB(v[ 2], v[ 6], v[10], v[14]); \
+  GB(v[ 3], v[ 7], v[11], v[15]); \
+  GB(v[ 0], v[ 5], v[10], v[15]); \
+  GB(v[ 1], v[ 6], v[11], v[12]); \
+  GB(v[ 2], v[ 7], v[ 8], v[13]); \
+  GB(v[ 3], v[ 4], v[ 9], v[14]);
+
+#elif defined(HAVE_AVX2)
+
+static inline __m256i fBlaMka( __m256i x, __m256i y )
+{
+  const __m256i z = _mm256_mul_epu32( x, y );
+  return _mm256_add_epi64( _mm256_add_epi64( x, y ), _mm256_add_epi64( z, z ) );
+}
+
+#define _mm256_roti_epi64(x, c) \
+    (-(c) == 32) ? _mm256_shuffle_epi32((x), _MM_SHUFFLE(2,3,0,1))  \
+    : (-(c) == 24) ? _mm256_shuffle_epi8((x), r24) \
+    : (-(c) == 16) ? _mm256_shuffle_epi8((x), r16) \
+    : _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define G1(row1,row2,row3,row4) \
+  row1 = fBlaMka(row1, row2); \
+  row4 = _mm256_roti_epi64(_mm256_xor_si256(row4, row1), -32); \
+  row3 = fBlaMka(row3, row4); \
+  row2 = _mm256_roti_epi64(_mm256_xor_si256(row2, row3), -24);
+
+#define G2(row1,row2,row3,row4) \
+  row1 = fBlaMka(row1, row2); \
+  row4 = _mm256_roti_epi64(_mm256_xor_si256(row4, row1), -16); \
+  row3 = fBlaMka(row3, row4); \
+  row2 = _mm256_roti_epi64(_mm256_xor_si256(row2, row3), -63);
+
+/* Each register holds one row of a 4x4 state: rotate rows 2-4 within the register */
+#define DIAGONALIZE_1(row2,row3,row4) \
+  row2 = _mm256_permute4x64_epi64(row2, _MM_SHUFFLE(0,3,2,1)); \
+  row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(1,0,3,2)); \
+  row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(2,1,0,3));
+
+#define UNDIAGONALIZE_1(row2,row3,row4) \
+  row2 = _mm256_permute4x64_epi64(row2, _MM_SHUFFLE(2,1,0,3)); \
+  row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(1,0,3,2)); \
+  row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(0,3,2,1));
+
+/* Each register holds half a row of two 4x4 states: the rotation crosses the register pair */
+#define DIAGONALIZE_2(row2l,row2h,row3l,row3h,row4l,row4h) \
+  t0 = _mm256_blend_epi32(row2l, row2h, 0xCC); \
+  t1 = _mm256_blend_epi32(row2l, row2h, 0x33); \
+  row2h = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2,3,0,1)); \
+  row2l = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2,3,0,1)); \
+  t0 = row3l; \
+  row3l = row3h; \
+  row3h = t0; \
+  t0 = _mm256_blend_epi32(row4l, row4h, 0xCC); \
+  t1 = _mm256_blend_epi32(row4l, row4h, 0x33); \
+  row4l = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2,3,0,1)); \
+  row4h = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2,3,0,1));
+
+#define UNDIAGONALIZE_2(row2l,row2h,row3l,row3h,row4l,row4h) \
+  t0 = _mm256_blend_epi32(row2l, row2h, 0xCC); \
+  t1 = _mm256_blend_epi32(row2l, row2h, 0x33); \
+  row2l = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2,3,0,1)); \
+  row2h = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2,3,0,1)); \
+  t0 = row3l; \
+  row3l = row3h; \
+  row3h = t0; \
+  t0 = _mm256_blend_epi32(row4l, row4h, 0x33); \
+  t1 = _mm256_blend_epi32(row4l, row4h, 0xCC); \
+  row4l = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2,3,0,1)); \
+  row4h = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2,3,0,1));
+
+#define BLAMKA_ROUND_1(row1l,row1h,row2l,row2h,row3l,row3h,row4l,row4h) \
+  G1(row1l,row2l,row3l,row4l); G1(row1h,row2h,row3h,row4h); \
+  G2(row1l,row2l,row3l,row4l); G2(row1h,row2h,row3h,row4h); \
+  DIAGONALIZE_1(row2l,row3l,row4l); DIAGONALIZE_1(row2h,row3h,row4h); \
+  G1(row1l,row2l,row3l,row4l); G1(row1h,row2h,row3h,row4h); \
+  G2(row1l,row2l,row3l,row4l); G2(row1h,row2h,row3h,row4h); \
+  UNDIAGONALIZE_1(row2l,row3l,row4l); UNDIAGONALIZE_1(row2h,row3h,row4h);
+
+#define BLAMKA_ROUND_2(row1l,row1h,row2l,row2h,row3l,row3h,row4l,row4h) \
+  G1(row1l,row2l,row3l,row4l); G1(row1h,row2h,row3h,row4h); \
+  G2(row1l,row2l,row3l,row4l); G2(row1h,row2h,row3h,row4h); \
+  DIAGONALIZE_2(row2l,row2h,row3l,row3h,row4l,row4h); \
+  G1(row1l,row2l,row3l,row4l); G1(row1h,row2h,row3h,row4h); \
+  G2(row1l,row2l,row3l,row4l); G2(row1h,row2h,row3h,row4h); \
+  UNDIAGONALIZE_2(row2l,row2h,row3l,row3h,row4l,row4h);
+
+#elif defined(HAVE_SSE2)
+
+/* Reuses the rotations and (un)diagonalization of the BLAKE2b engine */
+#include "blake2b-round.h"
+
+static inline __m128i fBlaMka( __m128i x, __m128i y )
+{
+  const __m128i z = _mm_mul_epu32( x, y );
+  return _mm_add_epi64( _mm_add_epi64( x, y ), _mm_add_epi64( z, z ) );
+}
+
+#define BLAMKA_G1(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h) \
+  row1l = fBlaMka(row1l, row2l); \
+  row1h = fBlaMka(row1h, row2h); \
+  \
+  row4l = _mm_xor_si128(row4l, row1l); \
+  row4h = _mm_xor_si128(row4h, row1h); \
+  \
+  row4l = _mm_roti_epi64(row4l, -32); \
+  row4h = _mm_roti_epi64(row4h, -32); \
+  \
+  row3l = fBlaMka(row3l, row4l); \
+  row3h = fBlaMka(row3h, row4h); \
+  \
+  row2l = _mm_xor_si128(row2l, row3l); \
+  row2h = _mm_xor_si128(row2h, row3h); \
+  \
+  row2l = _mm_roti_epi64(row2l, -24); \
+  row2h = _mm_roti_epi64(row2h, -24); \
+
+#define BLAMKA_G2(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h) \
+  row1l = fBlaMka(row1l, row2l); \
+  row1h = fBlaMka(row1h, row2h); \
+  \
+  row4l = _mm_xor_si128(row4l, row1l); \
+  row4h = _mm_xor_si128(row4h, row1h); \
+  \
+  row4l = _mm_roti_epi64(row4l, -16); \
+  row4h = _mm_roti_epi64(row4h, -16); \
+  \
+  row3l = fBlaMka(row3l, row4l); \
+  row3h = fBlaMka(row3h, row4h); \
+  \
+  row2l = _mm_xor_si128(row2l, row3l); \
+  row2h = _mm_xor_si128(row2h, row3h); \
+  \
+  row2l = _mm_roti_epi64(row2l, -63); \
+  row2h = _mm_roti_epi64(row2h, -63); \
+
+#define BLAMKA_ROUND(row1l,row1h,row2l,row2h,row3l,row3h,row4l,row4h) \
+  BLAMKA_G1(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h); \
+  BLAMKA_G2(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h); \
+  DIAGONALIZE(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h); \
+  BLAMKA_G1(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h); \
+  BLAMKA_G2(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h); \
+  UNDIAGONALIZE(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h);
+
+#else
+
+static inline uint64_t fBlaMka( uint64_t x, uint64_t y )
+{
+  const uint64_t m = 0xFFFFFFFFULL;
+  return x + y + 2 * ( ( x & m ) * ( y & m ) );
+}
+
+#define GB(a,b,c,d) \
+  do { \
+    a = fBlaMka(a, b); \
+    d = rotr64(d ^ a, 32); \
+    c = fBlaMka(c, d); \
+    b = rotr64(b ^ c, 24); \
+    a = fBlaMka(a, b); \
+    d = rotr64(d ^ a, 16); \
+    c = fBlaMka(c, d); \
+    b = rotr64(b ^ c, 63); \
+  } while(0)
+
+#define BLAMKA_ROUND(v0,v1,v2,v3,v4,v5,v6,v7,v8,v9,v10,v11,v12,v13,v14,v15) \
+  do { \
+    GB(v0, v4,  v8, v12); \
+    GB(v1, v5,  v9, v13); \
+    GB(v2, v6, v10, v14); \
+    GB(v3, v7, v11, v15); \
+    GB(v0, v5, v10, v15); \
+    GB(v1, v6, v11, v12); \
+    GB(v2, v7,  v8, v13); \
+    GB(v3, v4,  v9, v14); \
+  } while(0)
+
+#endif
+
+#endif